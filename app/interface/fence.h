@@ -39,6 +39,7 @@ enum FenceType_e {
   FENCE_TYPE_UNLIMITED = 0,
   FENCE_TYPE_ALWAYS_BREACHED = 1,
   FENCE_TYPE_AXIS_ALIGNED_BOUNDING_BOX = 2,
+  FENCE_TYPE_POLYGON = 3,  // convex or concave polygon in the XY plane with altitude limits
 };
 
 struct fenceLocationDescription
@@ -28,13 +28,15 @@
 enum LightProgramLocation_e {
   LIGHT_PROGRAM_LOCATION_INVALID = 0,
   LIGHT_PROGRAM_LOCATION_MEM     = 1,
-  // Future features might include light programs on flash or uSD card
+  LIGHT_PROGRAM_LOCATION_FLASH   = 2, // in the show assets stored in flash
+  // Future features might include light programs on uSD card
 };
 
 enum LightProgramType_e {
   LIGHT_PROGRAM_TYPE_RGB = 0,
   LIGHT_PROGRAM_TYPE_RGB565 = 1,
   LIGHT_PROGRAM_TYPE_LEDCTRL = 2,
+  LIGHT_PROGRAM_TYPE_FRAMES = 3, // RGB or RGB565 frames compressed with lightFrames
 };
 
 struct lightProgramDescription
@@ -45,9 +47,9 @@ struct lightProgramDescription
   union
   {
     struct {
-      uint32_t offset;     // offset in light program memory
-      uint32_t size;       // size of data in light program memory
-    } __attribute__((packed)) mem; // if lightProgramLocation is LIGHT_PROGRAM_LOCATION_MEM
+      uint32_t offset;     // offset in light program memory or in the show assets
+      uint32_t size;       // size of data in light program memory or in the show assets
+    } __attribute__((packed)) mem; // if lightProgramLocation is LIGHT_PROGRAM_LOCATION_MEM or LIGHT_PROGRAM_LOCATION_FLASH
   } lightProgramIdentifier;
 } __attribute__((packed));
 
@@ -77,6 +79,16 @@ int lightProgramPlayerDefineProgram(uint8_t programId, struct lightProgramDescri
  */
 void lightProgramPlayerEvaluate(uint8_t* color);
 
+/**
+ * Evaluates the light program at the current timestamp, unless the program is
+ * being changed at the same time. Does not block.
+ *
+ * \param  color      pointer to a memory location where the evaluated RGB
+ *         color should be written (3 bytes)
+ * \return whether the color was evaluated; the color is left untouched if not
+ */
+bool lightProgramPlayerTryEvaluate(uint8_t* color);
+
 /**
  * Evaluates the light program at the given timestamp.
  *
@@ -0,0 +1,76 @@
+/*
+ * Crazyflie LED ring light renderer
+ *
+ * This file is part of the Skybrush compatibility layer for the Crazyflie firmware.
+ *
+ * Copyright 2026 CollMot Robotics Ltd.
+ *
+ * This app is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This app is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIGHT_RENDERER_H__
+#define __LIGHT_RENDERER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Index of the LED ring effect that hands the LED ring over to the light
+ * renderer. The renderer writes to the LEDs only while this effect is
+ * selected.
+ */
+#define LIGHT_RENDERER_LED_RING_EFFECT 19
+
+/* Public functions */
+
+/**
+ * Initializes the light renderer and starts its task.
+ */
+void lightRendererInit(void);
+
+/**
+ * Tests whether the light renderer is ready to be used.
+ */
+bool lightRendererTest(void);
+
+/**
+ * Makes the light renderer show a solid color, fading to it linearly from the
+ * color currently shown.
+ *
+ * \param  color      pointer to the desired RGB color (3 bytes)
+ * \param  fadeMsec   duration of the fade, in milliseconds; zero to switch
+ *                    to the color immediately
+ */
+void lightRendererSetColor(const uint8_t* color, uint16_t fadeMsec);
+
+/**
+ * Makes the light renderer show the light program of the light program
+ * player, evaluated at the refresh rate of the renderer.
+ */
+void lightRendererPlayProgram(void);
+
+/**
+ * Makes the light renderer turn off the LEDs.
+ */
+void lightRendererStop(void);
+
+/**
+ * Returns the color that was rendered last.
+ *
+ * \param  color      pointer to a memory location where the RGB color should
+ *         be written (3 bytes)
+ */
+void lightRendererGetLastColor(uint8_t* color);
+
+#endif /* __LIGHT_RENDERER_H__ */
@@ -38,6 +38,7 @@
 #include "fence.h"
 #include "gcs_light_effects.h"
 #include "light_program.h"
+#include "light_renderer.h"
 #include "preflight.h"
 
 #define DRONE_SHOW_APP_STACKSIZE 300
@@ -76,6 +77,7 @@ static bool appTest()
   pass &= preflightTest();
   pass &= gcsLightEffectsTest();
   pass &= lightProgramPlayerTest();
+  pass &= lightRendererTest();
   pass &= droneShowSrvTest();
   pass &= droneShowTest();
 
@@ -91,6 +93,7 @@ static void appTask(void *param)
   armingInit();
   preflightInit();
   gcsLightEffectsInit();
+  lightRendererInit();
   droneShowSrvInit();
   droneShowInit();
 
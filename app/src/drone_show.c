@@ -33,11 +33,13 @@
 #include "drone_show.h"
 #include "gcs_light_effects.h"
 #include "light_program.h"
+#include "light_renderer.h"
 #include "log.h"
 #include "param.h"
 #include "platform_defaults.h"
 #include "pm.h"
 #include "preflight.h"
+#include "show_clock.h"
 #include "system.h"
 #include "stabilizer.h"
 #include "supervisor.h"
@@ -80,7 +82,8 @@ static const char* stateMessages[NUM_STATES] = {
 
 #define SHOW_TAKEOFF_HEIGHT (CONFIG_SHOW_TAKEOFF_HEIGHT_CM / 100.0f)
 
-/* 20fps because we are now driving the LED light from the loop */
+/* The light renderer fades between the colors set by the loop so 20fps is
+ * enough for the status patterns */
 #define LOOP_INTERVAL_MSEC 50
 #define TAKEOFF_DURATION_MSEC 2000
 #define TAKEOFF_VELOCITY_METERS_PER_SEC (SHOW_TAKEOFF_HEIGHT * 1000.0f / TAKEOFF_DURATION_MSEC)
@@ -110,8 +113,9 @@ static bool isInit = false;
 static bool isEnabled = false;
 static bool isTesting = false;
 
-/** Value of the internal clock of the Crazyflie when the show clock starts,
- * in microseconds.
+/** Value of the show clock (see show_clock.h) when the show starts, in
+ * microseconds. The show clock is shared by all drones that receive time sync
+ * broadcasts from the ground station.
  */
 static uint64_t startTime;
 
@@ -151,9 +155,6 @@ static uint8_t waitCounter;
 static uint8_t lowBatteryCounter;
 
 static struct {
-  paramVarId_t ledColorRed;
-  paramVarId_t ledColorGreen;
-  paramVarId_t ledColorBlue;
   paramVarId_t ledRingEffect;
   paramVarId_t pmCriticalLowVoltage;
 } paramIds;
@@ -198,9 +199,6 @@ void droneShowInit() {
   xTimerStart(timer, LOOP_INTERVAL_MSEC);
 
   /* Retrieve the IDs of the log variables and parameters that we will need */
-  paramIds.ledColorRed = paramGetVarId("ring", "solidRed");
-  paramIds.ledColorGreen = paramGetVarId("ring", "solidGreen");
-  paramIds.ledColorBlue = paramGetVarId("ring", "solidBlue");
   paramIds.ledRingEffect = paramGetVarId("ring", "effect");
   paramIds.pmCriticalLowVoltage = paramGetVarId("pm", "criticalLowVoltage");
 
@@ -258,7 +256,7 @@ void droneShowStart(void) {
 
 void droneShowDelayedStart(int16_t delayMsec) {
   bool startTimeChanged = 0;
-  uint64_t now = usecTimestamp();
+  uint64_t now = showClockGetUs();
 
   if (delayMsec == 0) {
     /* We need to start immediately */
@@ -482,7 +480,7 @@ static void droneShowTimer(xTimerHandle timer) {
  * time; minus infinity if we have no scheduled start time yet.
  */
 static int64_t getMicrosecondsSinceStart() {
-  return startTime > 0 ? (int64_t) (usecTimestamp() - startTime) : INT64_MIN;
+  return startTime > 0 ? (int64_t) (showClockGetUs() - startTime) : INT64_MIN;
 }
 
 /**
@@ -500,7 +498,7 @@ static float getSecondsSinceLastStateSwitch() {
  */
 static float getSecondsSinceStart() {
   if (startTime > 0) {
-    return ((int64_t) (usecTimestamp() - startTime)) / 1000000.0f;
+    return ((int64_t) (showClockGetUs() - startTime)) / 1000000.0f;
   } else {
     return -INFINITY;
   }
@@ -551,7 +549,7 @@ static uint64_t getUsecTimestampForLightPatterns() {
   if (startTime > 0) {
     return getMicrosecondsSinceStart();
   } else {
-    return usecTimestamp();
+    return showClockGetUs();
   }
 }
 
@@ -560,7 +558,7 @@ static uint64_t getUsecTimestampForLightPatterns() {
  * mean that the _takeoff_ time has passed, though).
  */
 static bool hasStartTimePassed() {
-  return startTime > 0 && usecTimestamp() > startTime;
+  return startTime > 0 && showClockGetUs() > startTime;
 }
 
 /**
@@ -576,13 +574,13 @@ static bool hasTakeoffTimePassed() {
  */
 static uint8_t desiredLEDEffectForState(show_state_t state) {
   if (areGcsLightEffectsActive()) {
-    return 7;     /* solid color */
+    return LIGHT_RENDERER_LED_RING_EFFECT;
   } else if (shouldRunPreflightChecksInState(state)) {
-    return 7;     /* solid color */
+    return LIGHT_RENDERER_LED_RING_EFFECT;
   } else if (shouldRunLightProgramInState(state)) {
-    return 7;     /* solid color */
+    return LIGHT_RENDERER_LED_RING_EFFECT;
   } else if (shouldRunLandingLightInState(state)) {
-    return 7;     /* solid color */
+    return LIGHT_RENDERER_LED_RING_EFFECT;
   } else if (isErrorState(state)) {
     return 11;    /* siren */
   } else {
@@ -952,7 +950,6 @@ static void modulateColorWithBreathingPattern(uint8_t* color, uint64_t timestamp
 static void updateLEDRing() {
   uint64_t now;
   bool canStart;
-  bool updateLights = true;
   preflight_check_result_t preflightCheckSummary;
 
   if (areGcsLightEffectsActive()) {
@@ -1001,8 +998,11 @@ static void updateLEDRing() {
       }
     }
   } else if (shouldRunLightProgramInState(state)) {
-    /* Light program is running in this state so evaluate the light program */
-    lightProgramPlayerEvaluate(lastColor);
+    /* Light program is running in this state; the light renderer evaluates
+     * it at the refresh rate of the LED ring */
+    lightRendererPlayProgram();
+    lightRendererGetLastColor(lastColor);
+    return;
   } else if (shouldRunLandingLightInState(state)) {
     /* Landing light should be shown in this state */
     now = getUsecTimestampForLightPatterns();
@@ -1014,14 +1014,11 @@ static void updateLEDRing() {
     /* we are not controlling the LED ring in this state. Errors are handled by
      * the "siren" pattern */
     lastColor[0] = lastColor[1] = lastColor[2] = 0;
-    updateLights = false;
+    lightRendererStop();
+    return;
   }
 
-  if (updateLights) {
-    paramSetInt(paramIds.ledColorRed, lastColor[0]);
-    paramSetInt(paramIds.ledColorGreen, lastColor[1]);
-    paramSetInt(paramIds.ledColorBlue, lastColor[2]);
-  }
+  lightRendererSetColor(lastColor, LOOP_INTERVAL_MSEC);
 }
 
 /**
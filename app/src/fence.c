@@ -20,12 +20,16 @@
  */
 
 #include <errno.h>
+#include <math.h>
 #include <memory.h>
 
 /* FreeRtos includes */
 #include "FreeRTOS.h"   /* bool is defined there */
+#include "semphr.h"
 #include "timers.h"
 
+#include "autoconf.h"
+
 #include "estimator_kalman.h"
 #include "fence.h"
 #include "log.h"
@@ -43,7 +47,7 @@
 /**
  * Time between consecutive fence breach checks, in milliseconds.
  */
-#define FENCE_CHECK_INTERVAL_MSEC 250
+#define FENCE_CHECK_INTERVAL_MSEC CONFIG_SHOW_FENCE_CHECK_INTERVAL_MSEC
 
 /**
  * Minimum duration that the drone needs to stay outside the fence to declare it
@@ -51,10 +55,27 @@
  */
 #define FENCE_BREACH_MIN_DURATION_MSEC 500
 
+/**
+ * Number of consecutive failed fence checks that make up a fence breach.
+ */
+#define FENCE_BREACH_MIN_CHECKS ((FENCE_BREACH_MIN_DURATION_MSEC - 1) / FENCE_CHECK_INTERVAL_MSEC + 1)
+
 /**
  * Size of the memory segment that can store safety fence data.
  */
-#define FENCE_MEMORY_SIZE 64
+#define FENCE_MEMORY_SIZE CONFIG_SHOW_FENCE_MEMORY_SIZE
+
+/**
+ * Maximum number of vertices of a polygon fence.
+ */
+#define FENCE_MAX_POLYGON_VERTICES 64
+
+/**
+ * Number of horizontal bands that the bounding box of a polygon fence is
+ * divided into. Each band lists the edges that overlap with it so a check
+ * only needs to look at the edges in the band of the point.
+ */
+#define FENCE_POLYGON_BANDS 16
 
 uint8_t fenceMemory[FENCE_MEMORY_SIZE];
 
@@ -71,18 +92,58 @@ struct fenceDefinition
       float yMax;
       float zMax;
     } __attribute__((packed)) axisAlignedBoundingBox;
+
+    // followed by numVertices (x, y) pairs of floats in the fence memory
+    struct {
+      float zMin;
+      float zMax;
+      uint8_t numVertices;
+    } __attribute__((packed)) polygon;
   } parameters;
 };
 
+/**
+ * Polygon edge with precomputed coefficients for the crossing test of a ray
+ * pointing towards +X. Horizontal edges never cross such a ray and are not
+ * stored.
+ */
+struct fencePolygonEdge
+{
+  float yLow;   // smaller Y coordinate of the endpoints
+  float yHigh;  // larger Y coordinate of the endpoints
+  float xLow;   // X coordinate of the endpoint with the smaller Y coordinate
+  float dxdy;   // change of X along the edge per unit of Y
+};
+
+/**
+ * Acceleration structure of the active polygon fence. The edges of band i are
+ * edgeIndices[bandStart[i]] to edgeIndices[bandStart[i + 1] - 1].
+ */
+struct fencePolygonIndex
+{
+  float xMin, xMax, yMin, yMax;
+  float bandsPerMeter;
+  uint8_t numEdges;
+  struct fencePolygonEdge edges[FENCE_MAX_POLYGON_VERTICES];
+  uint16_t bandStart[FENCE_POLYGON_BANDS + 1];
+  uint8_t edgeIndices[FENCE_MAX_POLYGON_VERTICES * FENCE_POLYGON_BANDS];
+};
+
 static struct fenceDefinition activeFence = {
   /* .type = */ FENCE_TYPE_UNLIMITED
 };
 
+static struct fencePolygonIndex polygonIndex;
+
+// makes sure that we don't check the fence while it is being changed
+static xSemaphoreHandle lockFence;
+static StaticSemaphore_t lockFenceBuffer;
+
 static StaticTimer_t timerBuffer;
 
 static bool isInit = false;
 
-static uint8_t breachCounter = 0;
+static uint16_t breachCounter = 0;
 static bool isEnabled = false;
 static bool isBreached = false;
 static enum FenceAction_e action = FENCE_ACTION_NONE;
@@ -91,11 +152,13 @@ static void clearCurrentBreach();
 static void clearFence();
 static void handleBreach();
 static bool isPointInsideFence(const point_t* p);
+static bool isPointInsidePolygon(const point_t* p);
+static int buildPolygonIndex(uint32_t offset, uint8_t numVertices);
 static int setupFenceFromMemory(struct fenceLocationDescription* description);
 static void startNewBreach();
 
 static void fenceTimer(xTimerHandle timer);
-static void fenceWorker(void* data);
+static void fenceBreachWorker(void* data);
 
 // Safety fence memory handling from the memory module
 static uint32_t handleMemGetSize(void) { return fenceMemSize(); }
@@ -113,6 +176,8 @@ void fenceInit() {
     return;
   }
 
+  lockFence = xSemaphoreCreateMutexStatic(&lockFenceBuffer);
+
   xTimerHandle timer = xTimerCreateStatic("fenceTimer", M2T(FENCE_CHECK_INTERVAL_MSEC), pdTRUE, NULL, fenceTimer, &timerBuffer);
   xTimerStart(timer, FENCE_CHECK_INTERVAL_MSEC);
 
@@ -140,6 +205,8 @@ bool fenceTest(void) {
 int fenceSetup(struct fenceLocationDescription* description) {
   int result = EINVAL;
 
+  xSemaphoreTake(lockFence, portMAX_DELAY);
+
   switch (description->fenceLocation) {
     case FENCE_LOCATION_INVALID:
       clearFence();
@@ -159,6 +226,8 @@ int fenceSetup(struct fenceLocationDescription* description) {
     clearCurrentBreach();
   }
 
+  xSemaphoreGive(lockFence);
+
   return result;
 }
 
@@ -183,7 +252,8 @@ static void clearFence() {
 }
 
 /**
- * Callback that is called when a previous fence breach has cleared.
+ * Callback that is called when a previous fence breach has cleared. Must be
+ * called with lockFence held.
  */
 static void clearCurrentBreach() {
   breachCounter = 0;
@@ -191,8 +261,8 @@ static void clearCurrentBreach() {
 }
 
 /**
- * Callback that is called periodically from the fence worker during the time
- * when the fence is breached.
+ * Callback that is called from the fence worker when the fence has newly been
+ * breached, after startNewBreach().
  */
 static void handleBreach() {
   switch (action) {
@@ -244,14 +314,144 @@ static bool isPointInsideFence(const point_t* p) {
         p->z <= activeFence.parameters.axisAlignedBoundingBox.zMax
       );
 
+    case FENCE_TYPE_POLYGON:
+      return isPointInsidePolygon(p);
+
     default:
       return true;
   }
 }
 
+/**
+ * Returns whether the given point is inside the active polygon fence, using
+ * the even-odd rule on the edges in the band of the point. This works for
+ * concave polygons as well.
+ */
+static bool isPointInsidePolygon(const point_t* p) {
+  const struct fencePolygonIndex* index = &polygonIndex;
+  bool inside = false;
+  int band;
+
+  if (
+    p->z < activeFence.parameters.polygon.zMin || p->z > activeFence.parameters.polygon.zMax ||
+    p->x < index->xMin || p->x > index->xMax || p->y < index->yMin || p->y > index->yMax
+  ) {
+    return false;
+  }
+
+  band = (p->y - index->yMin) * index->bandsPerMeter;
+  if (band >= FENCE_POLYGON_BANDS) {
+    band = FENCE_POLYGON_BANDS - 1;
+  }
+
+  for (int i = index->bandStart[band]; i < index->bandStart[band + 1]; i++) {
+    const struct fencePolygonEdge* edge = &index->edges[index->edgeIndices[i]];
+    if (
+      p->y >= edge->yLow && p->y < edge->yHigh &&
+      p->x < edge->xLow + (p->y - edge->yLow) * edge->dxdy
+    ) {
+      inside = !inside;
+    }
+  }
+
+  return inside;
+}
+
+/**
+ * Precomputes the edges and the band index of a polygon fence from the
+ * vertices stored in the fence memory at the given offset.
+ */
+static int buildPolygonIndex(uint32_t offset, uint8_t numVertices) {
+  struct fencePolygonIndex* index = &polygonIndex;
+  const uint8_t* vertices = &fenceMemory[offset];
+  uint8_t bandCount[FENCE_POLYGON_BANDS];
+  float xMin, xMax, yMin, yMax;
+  float v0[2], v1[2], x0, y0, x1, y1;
+  int i, j, low, high;
+
+  if (numVertices < 3 || numVertices > FENCE_MAX_POLYGON_VERTICES) {
+    return EINVAL;
+  }
+
+  if (offset + numVertices * sizeof(v0) > sizeof(fenceMemory)) {
+    return EIO;
+  }
+
+  /* validate the bounding box before the active index is touched */
+  memcpy(v0, vertices, sizeof(v0));
+  xMin = xMax = v0[0];
+  yMin = yMax = v0[1];
+  for (i = 1; i < numVertices; i++) {
+    memcpy(v0, vertices + i * sizeof(v0), sizeof(v0));
+    xMin = fminf(xMin, v0[0]);
+    xMax = fmaxf(xMax, v0[0]);
+    yMin = fminf(yMin, v0[1]);
+    yMax = fmaxf(yMax, v0[1]);
+  }
+
+  if (!(yMax > yMin) || !(xMax > xMin)) {
+    return EINVAL;
+  }
+
+  index->xMin = xMin;
+  index->xMax = xMax;
+  index->yMin = yMin;
+  index->yMax = yMax;
+  index->bandsPerMeter = FENCE_POLYGON_BANDS / (yMax - yMin);
+
+  /* precompute the edge coefficients, skipping horizontal edges */
+  index->numEdges = 0;
+  for (i = 0; i < numVertices; i++) {
+    j = (i + 1) % numVertices;
+    memcpy(v0, vertices + i * sizeof(v0), sizeof(v0));
+    memcpy(v1, vertices + j * sizeof(v1), sizeof(v1));
+    if (v0[1] <= v1[1]) {
+      x0 = v0[0]; y0 = v0[1];
+      x1 = v1[0]; y1 = v1[1];
+    } else {
+      x0 = v1[0]; y0 = v1[1];
+      x1 = v0[0]; y1 = v0[1];
+    }
+
+    if (y1 > y0) {
+      struct fencePolygonEdge* edge = &index->edges[index->numEdges++];
+      edge->yLow = y0;
+      edge->yHigh = y1;
+      edge->xLow = x0;
+      edge->dxdy = (x1 - x0) / (y1 - y0);
+    }
+  }
+
+  /* sort the edges into the bands that they overlap with */
+  memset(bandCount, 0, sizeof(bandCount));
+  for (i = 0; i < index->numEdges; i++) {
+    low = (index->edges[i].yLow - index->yMin) * index->bandsPerMeter;
+    high = (index->edges[i].yHigh - index->yMin) * index->bandsPerMeter;
+    for (j = low; j <= high && j < FENCE_POLYGON_BANDS; j++) {
+      bandCount[j]++;
+    }
+  }
+
+  index->bandStart[0] = 0;
+  for (j = 0; j < FENCE_POLYGON_BANDS; j++) {
+    index->bandStart[j + 1] = index->bandStart[j] + bandCount[j];
+    bandCount[j] = 0;
+  }
+
+  for (i = 0; i < index->numEdges; i++) {
+    low = (index->edges[i].yLow - index->yMin) * index->bandsPerMeter;
+    high = (index->edges[i].yHigh - index->yMin) * index->bandsPerMeter;
+    for (j = low; j <= high && j < FENCE_POLYGON_BANDS; j++) {
+      index->edgeIndices[index->bandStart[j] + bandCount[j]++] = i;
+    }
+  }
+
+  return 0;
+}
+
 /**
  * Callback that is invoked when the fence has newly been breached (i.e. it
- * was not breached before).
+ * was not breached before). Must be called with lockFence held.
  */
 static void startNewBreach() {
   isBreached = true;
@@ -282,6 +482,7 @@ static void startNewBreach() {
 static int setupFenceFromMemory(struct fenceLocationDescription* description) {
   struct fenceDefinition newFence;
   uint32_t offset, size;
+  int result;
   
   ASSERT(description->fenceLocation == FENCE_LOCATION_MEM);
 
@@ -321,6 +522,28 @@ static int setupFenceFromMemory(struct fenceLocationDescription* description) {
       }
       break;
 
+    case FENCE_TYPE_POLYGON:
+      if (size < sizeof(newFence.parameters.polygon)) {
+        return EIO;
+      }
+
+      if (!handleMemRead(offset, sizeof(newFence.parameters.polygon), (uint8_t*) &newFence.parameters.polygon)) {
+        return EIO;
+      }
+
+      offset += sizeof(newFence.parameters.polygon);
+      size -= sizeof(newFence.parameters.polygon);
+
+      if (size != newFence.parameters.polygon.numVertices * 2 * sizeof(float)) {
+        return EIO;
+      }
+
+      result = buildPolygonIndex(offset, newFence.parameters.polygon.numVertices);
+      if (result) {
+        return result;
+      }
+      break;
+
     default:
       return EINVAL;
   }
@@ -332,40 +555,56 @@ static int setupFenceFromMemory(struct fenceLocationDescription* description) {
 }
 
 /**
- * Timer function that is called regularly (2 times every second by default).
- * This function executes the fence checks and sets the corresponding log
- * variable appropriately.
+ * Timer function that is called regularly (every
+ * FENCE_CHECK_INTERVAL_MSEC milliseconds). This function executes the fence
+ * checks, which are cheap enough to be done directly in the timer task, and
+ * counts the consecutive failed checks. The timer never blocks: the check is
+ * skipped while the fence is being changed, and the breach is handled on the
+ * worker thread, which is scheduled only once when the counter reaches
+ * FENCE_BREACH_MIN_CHECKS.
  */
 static void fenceTimer(xTimerHandle timer) {
-  workerSchedule(fenceWorker, NULL);
-}
-
-/**
- * Worker function that is called regularly on the worker thread. This
- * function is responsible for checking whether the fence has been breached.
- */
-static void fenceWorker(void* data) {
   point_t pos;
+  bool isNewBreach = false;
 
-  if (!isEnabled) {
-    clearCurrentBreach();
+  /* skip this check if the fence is being changed */
+  if (xSemaphoreTake(lockFence, 0) != pdTRUE) {
     return;
   }
 
-  estimatorKalmanGetEstimatedPos(&pos);
-  
-  if (isPointInsideFence(&pos)) {
+  if (!isEnabled) {
     clearCurrentBreach();
   } else {
-    if (breachCounter <= (FENCE_BREACH_MIN_DURATION_MSEC - 1) / FENCE_CHECK_INTERVAL_MSEC) {
+    estimatorKalmanGetEstimatedPos(&pos);
+    if (isPointInsideFence(&pos)) {
+      clearCurrentBreach();
+    } else if (breachCounter < FENCE_BREACH_MIN_CHECKS) {
       breachCounter++;
-    } else {
-      if (!isBreached) {
-        startNewBreach();
-      }
-      handleBreach();
+      isNewBreach = (breachCounter == FENCE_BREACH_MIN_CHECKS);
     }
   }
+
+  xSemaphoreGive(lockFence);
+
+  if (isNewBreach) {
+    workerScheduleWithPriority(fenceBreachWorker, NULL, WORKER_PRIORITY_HIGH, 0);
+  }
+}
+
+/**
+ * Worker function that is scheduled by the fence timer when the fence has
+ * newly been breached.
+ */
+static void fenceBreachWorker(void* data) {
+  xSemaphoreTake(lockFence, portMAX_DELAY);
+
+  /* the breach may have cleared in the meantime */
+  if (isEnabled && breachCounter == FENCE_BREACH_MIN_CHECKS && !isBreached) {
+    startNewBreach();
+    handleBreach();
+  }
+
+  xSemaphoreGive(lockFence);
 }
 
 static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
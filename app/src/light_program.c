@@ -20,6 +20,7 @@
  */
 
 #include <errno.h>
+#include <math.h>
 #include <memory.h>
 
 /* FreeRtos includes */
@@ -29,8 +30,11 @@
 /* libskybrush includes */
 #include <skybrush/lights.h>
 
+#include "asset_storage.h"
+#include "lightFrames.h"
 #include "light_program.h"
 #include "mem.h"
+#include "show_clock.h"
 
 #define DEBUG_MODULE "LIGHT"
 #include "debug.h"
@@ -71,16 +75,19 @@ static bool lightSequenceInitialized = 0;
 
 static sb_light_player_t lightSequencePlayer;  // player object that plays Skybrush light sequences
 
-static uint8_t* startOfCurrentProgramInMemory();
+static lightFramesDecoder_t framesDecoder;  // decoder of compressed frames, keeps the playback position
+
+static const uint8_t* startOfCurrentProgramInMemory();
 static uint32_t sizeOfCurrentProgramInMemory();
 
-static uint16_t timeToFrame(float t);
-static uint8_t* timeToPointer(float t, uint8_t bytesPerFrame);
+static uint32_t timeToFrame(float t, uint32_t frameCount);
+static const uint8_t* frameToPointer(uint32_t frame, uint8_t bytesPerFrame);
 
 static void evaluateBlack(float t, uint8_t* color);
 static void evaluateRGBAt(float t, uint8_t* color);
 static void evaluateRGB565At(float t, uint8_t* color);
 static void evaluateLightSequenceAt(float t, uint8_t* color);
+static void evaluateCompressedFramesAt(float t, uint8_t* color);
 
 typedef void (*evaluator_t)(float, uint8_t*);
 static evaluator_t evaluator = evaluateBlack;
@@ -123,13 +130,12 @@ int lightProgramPlayerDefineProgram(uint8_t programId, struct lightProgramDescri
   return 0;
 }
 
-void lightProgramPlayerEvaluate(uint8_t* color) {
+/* Must be called with lockLightProgram taken */
+static void evaluateNow(uint8_t* color) {
   uint64_t now;
   float t;
 
-  xSemaphoreTake(lockLightProgram, portMAX_DELAY);
-
-  now = usecTimestamp();
+  now = showClockGetUs();
   t = (now < startedAt) ? 0 : ((now - startedAt) / 1e6);
 
   if (!currentProgram) {
@@ -137,8 +143,23 @@ void lightProgramPlayerEvaluate(uint8_t* color) {
   }
 
   evaluator(t * currentTimescale, color);
+}
+
+void lightProgramPlayerEvaluate(uint8_t* color) {
+  xSemaphoreTake(lockLightProgram, portMAX_DELAY);
+  evaluateNow(color);
+  xSemaphoreGive(lockLightProgram);
+}
 
+bool lightProgramPlayerTryEvaluate(uint8_t* color) {
+  if (xSemaphoreTake(lockLightProgram, 0) != pdTRUE) {
+    return false;
+  }
+
+  evaluateNow(color);
   xSemaphoreGive(lockLightProgram);
+
+  return true;
 }
 
 void lightProgramPlayerEvaluateAt(float t, uint8_t* color) {
@@ -164,33 +185,82 @@ static void evaluateBlack(float scaledT, uint8_t* color) {
   color[0] = color[1] = color[2] = 0;
 }
 
-static void evaluateRGBAt(float scaledT, uint8_t* color) {
-  uint8_t* ptr = timeToPointer(scaledT, 3);
-  if (!ptr) {
-    return evaluateBlack(scaledT, color);
+static void decodeRGB565(const uint8_t* ptr, uint8_t* color) {
+  uint8_t x;
+
+  /* red */
+  x = ptr[0] & 0xf8;
+  color[0] = x | (x >> 5);
+
+  /* green */
+  x = ((ptr[0] & 0x07) << 3) | ((ptr[1] & 0xe0) >> 5);
+  color[1] = (x << 2) | (x >> 4);
+
+  /* blue */
+  x = ptr[1] & 0x1f;
+  color[2] = (x << 3) | (x >> 2);
+}
+
+static void decodeFrame(const uint8_t* ptr, uint8_t bytesPerFrame, uint8_t* color) {
+  if (bytesPerFrame == 2) {
+    decodeRGB565(ptr, color);
   } else {
     memcpy(color, ptr, 3);
   }
 }
 
-static void evaluateRGB565At(float scaledT, uint8_t* color) {
-  uint8_t* ptr = timeToPointer(scaledT, 2);
-  uint8_t x;
+/**
+ * Blends the color of the frame at the given time with the next frame, so the
+ * program can be evaluated at a higher rate than its frame rate without
+ * visible steps in fades.
+ */
+static void interpolateFrames(float scaledT, const uint8_t* nextColor, uint8_t* color) {
+  float frames, frac;
+  int i;
+
+  frames = scaledT * currentProgram->fps;
+  frac = frames - floorf(frames);
+
+  for (i = 0; i < 3; i++) {
+    color[i] += (nextColor[i] - color[i]) * frac;
+  }
+}
+
+static void evaluateFramesAt(float scaledT, uint8_t bytesPerFrame, uint8_t* color) {
+  uint8_t nextColor[3];
+  uint32_t frame = timeToFrame(scaledT, sizeOfCurrentProgramInMemory() / bytesPerFrame);
+  const uint8_t* ptr = frameToPointer(frame, bytesPerFrame);
+  const uint8_t* nextPtr;
 
   if (!ptr) {
-    return evaluateBlack(scaledT, color);
-  } else {
-    /* red */
-    x = ptr[0] & 0xf8;
-    color[0] = x | (x >> 5);
+    evaluateBlack(scaledT, color);
+    return;
+  }
+
+  decodeFrame(ptr, bytesPerFrame, color);
+
+  nextPtr = frameToPointer(frame + 1, bytesPerFrame);
+  if (nextPtr) {
+    decodeFrame(nextPtr, bytesPerFrame, nextColor);
+    interpolateFrames(scaledT, nextColor, color);
+  }
+}
+
+static void evaluateRGBAt(float scaledT, uint8_t* color) {
+  evaluateFramesAt(scaledT, 3, color);
+}
 
-    /* green */
-    x = ((ptr[0] & 0x07) << 3) | ((ptr[1] & 0xe0) >> 5);
-    color[1] = (x << 2) | (x >> 4);
+static void evaluateRGB565At(float scaledT, uint8_t* color) {
+  evaluateFramesAt(scaledT, 2, color);
+}
 
-    /* blue */
-    x = ptr[1] & 0x1f;
-    color[2] = (x << 3) | (x >> 2);
+static void evaluateCompressedFramesAt(float scaledT, uint8_t* color) {
+  uint8_t nextColor[3];
+
+  if (!lightFramesDecode(&framesDecoder, timeToFrame(scaledT, framesDecoder.frameCount), color, nextColor)) {
+    evaluateBlack(scaledT, color);
+  } else {
+    interpolateFrames(scaledT, nextColor, color);
   }
 }
 
@@ -227,7 +297,7 @@ static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const
 }
 
 int lightProgramPlayerPlay(uint8_t programId, float timescale) {
-  return lightProgramPlayerSchedulePlayFrom(usecTimestamp(), programId, timescale);
+  return lightProgramPlayerSchedulePlayFrom(showClockGetUs(), programId, timescale);
 }
 
 int lightProgramPlayerPause(void) {
@@ -251,7 +321,8 @@ int lightProgramPlayerSchedulePlayFrom(uint64_t timestamp, uint8_t programId, fl
 
   description = &lightProgramDescriptions[programId];
 
-  if (description->lightProgramLocation != LIGHT_PROGRAM_LOCATION_MEM) {
+  if (description->lightProgramLocation != LIGHT_PROGRAM_LOCATION_MEM &&
+      description->lightProgramLocation != LIGHT_PROGRAM_LOCATION_FLASH) {
     return ENOEXEC;
   }
 
@@ -266,6 +337,19 @@ int lightProgramPlayerSchedulePlayFrom(uint64_t timestamp, uint8_t programId, fl
       evaluator = evaluateRGB565At;
       break;
 
+    case LIGHT_PROGRAM_TYPE_FRAMES:
+      oldProgram = currentProgram;
+      currentProgram = description;
+      if (!startOfCurrentProgramInMemory() ||
+          !lightFramesDecoderInit(&framesDecoder, startOfCurrentProgramInMemory(), sizeOfCurrentProgramInMemory())) {
+        /* light program not available or not valid */
+        result = ENOEXEC;
+      } else {
+        evaluator = evaluateCompressedFramesAt;
+      }
+      currentProgram = oldProgram;
+      break;
+
     case LIGHT_PROGRAM_TYPE_LEDCTRL:
       oldProgram = currentProgram;
       currentProgram = description;
@@ -273,6 +357,9 @@ int lightProgramPlayerSchedulePlayFrom(uint64_t timestamp, uint8_t programId, fl
         /* light program too large */
         DEBUG_PRINT("Program too large\n");
         result = ENOEXEC;
+      } else if (!startOfCurrentProgramInMemory()) {
+        /* light program not available */
+        result = ENOEXEC;
       } else {
         evaluator = evaluateLightSequenceAt;
         if (lightSequenceInitialized) {
@@ -281,7 +368,7 @@ int lightProgramPlayerSchedulePlayFrom(uint64_t timestamp, uint8_t programId, fl
           lightSequenceInitialized = false;
         }
         if (sb_light_program_init_from_buffer(
-          &lightSequence, startOfCurrentProgramInMemory(),
+          &lightSequence, (uint8_t*) startOfCurrentProgramInMemory(),
           sizeOfCurrentProgramInMemory()
         )) {
           /* something happened while loading the program */
@@ -320,27 +407,70 @@ int lightProgramPlayerStop(void) {
   return 0;
 }
 
-static uint16_t timeToFrame(float t) {
-  return currentProgram ? t * currentProgram->fps : 0;
+/**
+ * Returns the frame at the given time, or the frame count if the time is past
+ * the end of the program. The time is clamped before it is converted, the
+ * conversion of a float that does not fit in the integer is undefined.
+ */
+static uint32_t timeToFrame(float t, uint32_t frameCount) {
+  float frame;
+
+  if (!currentProgram || t <= 0) {
+    return 0;
+  }
+
+  frame = t * currentProgram->fps;
+  return frame < frameCount ? (uint32_t) frame : frameCount;
 }
 
 static uint32_t sizeOfCurrentProgramInMemory() {
   return currentProgram ? currentProgram->lightProgramIdentifier.mem.size : 0;
 }
 
-static uint8_t* startOfCurrentProgramInMemory() {
-  return currentProgram ? &lightProgramMemory[currentProgram->lightProgramIdentifier.mem.offset] : 0;
+/**
+ * Returns a pointer to the data of the current program, NULL if there is no
+ * current program or the program is out of bounds. Programs in flash are
+ * used in place.
+ */
+static const uint8_t* startOfCurrentProgramInMemory() {
+  uint32_t offset, size;
+
+  if (!currentProgram) {
+    return 0;
+  }
+
+  offset = currentProgram->lightProgramIdentifier.mem.offset;
+  size = currentProgram->lightProgramIdentifier.mem.size;
+
+  switch (currentProgram->lightProgramLocation) {
+    case LIGHT_PROGRAM_LOCATION_MEM:
+      if (offset < sizeof(lightProgramMemory) && size <= sizeof(lightProgramMemory) - offset) {
+        return &lightProgramMemory[offset];
+      }
+      break;
+
+    case LIGHT_PROGRAM_LOCATION_FLASH:
+      if (offset < assetStorageLength() && size <= assetStorageLength() - offset) {
+        return assetStorageData() + offset;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return 0;
 }
 
-static uint8_t* timeToPointer(float t, uint8_t bytesPerFrame) {
+static const uint8_t* frameToPointer(uint32_t frame, uint8_t bytesPerFrame) {
   uint32_t offset;
-  uint8_t* ptr;
+  const uint8_t* ptr;
 
   if (!currentProgram) {
     return 0;
   }
 
-  offset = timeToFrame(t) * bytesPerFrame;
+  offset = frame * bytesPerFrame;
   ptr = startOfCurrentProgramInMemory();
 
   if (ptr == 0 || offset > sizeOfCurrentProgramInMemory() - bytesPerFrame) {
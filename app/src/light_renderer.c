@@ -0,0 +1,256 @@
+/*
+ * Crazyflie LED ring light renderer
+ *
+ * This file is part of the Skybrush compatibility layer for the Crazyflie firmware.
+ *
+ * Copyright 2026 CollMot Robotics Ltd.
+ *
+ * This app is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This app is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "autoconf.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "light_program.h"
+#include "light_renderer.h"
+#include "log.h"
+#include "param.h"
+#include "static_mem.h"
+#include "ws2812.h"
+
+#define DEBUG_MODULE "LIGHTS"
+#include "debug.h"
+
+#define LIGHT_RENDERER_STACKSIZE 200
+#define RENDER_INTERVAL_MSEC (1000 / CONFIG_SHOW_LIGHT_RENDER_RATE_HZ)
+
+typedef enum {
+  LIGHT_RENDERER_OFF = 0,
+  LIGHT_RENDERER_COLOR = 1,
+  LIGHT_RENDERER_PROGRAM = 2
+} light_renderer_mode_t;
+
+/**
+ * Request posted by the show state machine. It is copied in a critical
+ * section so the renderer never waits for the state machine or for the light
+ * program player.
+ */
+typedef struct {
+  light_renderer_mode_t mode;
+  uint8_t color[3];
+  uint16_t fadeMsec;
+  uint16_t sequence;
+} light_renderer_request_t;
+
+static bool isInit = false;
+
+static light_renderer_request_t request;
+
+/* State of the renderer task */
+static uint16_t handledSequence;
+static uint8_t fadeFromColor[3];
+static TickType_t fadeStartedAt;
+static uint8_t lastColor[3];
+
+static struct {
+  paramVarId_t ledRingEffect;
+  paramVarId_t ledRingDeckConnected;
+} paramIds;
+
+/* Statistics */
+static uint16_t busyCount;
+
+#ifdef CONFIG_DECK_LEDRING
+/* ws2812Send() keeps reading the buffer while the LEDs are updated so the
+ * next frame is prepared in the other one */
+static uint8_t ledBuffers[2][CONFIG_DECK_LEDRING_NBR_LEDS][3];
+static uint8_t ledBufferIndex;
+#endif
+
+STATIC_MEM_TASK_ALLOC(lightRendererTask, LIGHT_RENDERER_STACKSIZE);
+
+static void lightRendererTask(void *param);
+
+static void postRequest(light_renderer_mode_t mode, const uint8_t* color, uint16_t fadeMsec);
+static void renderColor(const light_renderer_request_t* current, TickType_t now);
+static bool shouldDriveLEDRing();
+static void writeToLEDRing(const uint8_t* color);
+
+void lightRendererInit(void) {
+  if (isInit) {
+    return;
+  }
+
+  paramIds.ledRingEffect = paramGetVarId("ring", "effect");
+  paramIds.ledRingDeckConnected = paramGetVarId("deck", "bcLedRing");
+
+  STATIC_MEM_TASK_CREATE(lightRendererTask, lightRendererTask, "lights", NULL, CONFIG_APP_PRIORITY);
+
+  isInit = true;
+}
+
+bool lightRendererTest(void) {
+  return isInit;
+}
+
+void lightRendererSetColor(const uint8_t* color, uint16_t fadeMsec) {
+  postRequest(LIGHT_RENDERER_COLOR, color, fadeMsec);
+}
+
+void lightRendererPlayProgram(void) {
+  postRequest(LIGHT_RENDERER_PROGRAM, 0, 0);
+}
+
+void lightRendererStop(void) {
+  postRequest(LIGHT_RENDERER_OFF, 0, 0);
+}
+
+void lightRendererGetLastColor(uint8_t* color) {
+  taskENTER_CRITICAL();
+  memcpy(color, lastColor, 3);
+  taskEXIT_CRITICAL();
+}
+
+static void postRequest(light_renderer_mode_t mode, const uint8_t* color, uint16_t fadeMsec) {
+  taskENTER_CRITICAL();
+  request.mode = mode;
+  if (color) {
+    memcpy(request.color, color, 3);
+  } else {
+    memset(request.color, 0, 3);
+  }
+  request.fadeMsec = fadeMsec;
+  request.sequence++;
+  taskEXIT_CRITICAL();
+}
+
+static void lightRendererTask(void *param) {
+  light_renderer_request_t current;
+  uint8_t color[3];
+  TickType_t lastWakeTime = xTaskGetTickCount();
+
+  while (1) {
+    vTaskDelayUntil(&lastWakeTime, M2T(RENDER_INTERVAL_MSEC));
+
+    taskENTER_CRITICAL();
+    current = request;
+    taskEXIT_CRITICAL();
+
+    switch (current.mode) {
+      case LIGHT_RENDERER_COLOR:
+        renderColor(&current, lastWakeTime);
+        memcpy(color, lastColor, 3);
+        break;
+
+      case LIGHT_RENDERER_PROGRAM:
+        /* The lock of the player only guards the playback state. Scheduling a
+         * light program holds it while the decoder is set up, which can take
+         * a while; keep the previous frame instead of waiting for it */
+        if (lightProgramPlayerTryEvaluate(color)) {
+          taskENTER_CRITICAL();
+          memcpy(lastColor, color, 3);
+          taskEXIT_CRITICAL();
+        } else {
+          busyCount++;
+          memcpy(color, lastColor, 3);
+        }
+        break;
+
+      default:
+        memset(color, 0, 3);
+        taskENTER_CRITICAL();
+        memset(lastColor, 0, 3);
+        taskEXIT_CRITICAL();
+        break;
+    }
+
+    handledSequence = current.sequence;
+
+    if (shouldDriveLEDRing()) {
+      writeToLEDRing(color);
+    }
+  }
+}
+
+/**
+ * Updates the last color with a linear fade from the color that was shown
+ * when the request arrived to the requested color.
+ */
+static void renderColor(const light_renderer_request_t* current, TickType_t now) {
+  uint8_t color[3];
+  uint32_t elapsedMsec;
+  uint8_t i;
+
+  if (current->sequence != handledSequence) {
+    memcpy(fadeFromColor, lastColor, 3);
+    fadeStartedAt = now;
+  }
+
+  elapsedMsec = T2M(now - fadeStartedAt);
+  if (elapsedMsec >= current->fadeMsec) {
+    memcpy(color, current->color, 3);
+  } else {
+    for (i = 0; i < 3; i++) {
+      color[i] = fadeFromColor[i] +
+        ((int32_t)current->color[i] - fadeFromColor[i]) * (int32_t)elapsedMsec / current->fadeMsec;
+    }
+  }
+
+  taskENTER_CRITICAL();
+  memcpy(lastColor, color, 3);
+  taskEXIT_CRITICAL();
+}
+
+/**
+ * Returns whether the LED ring deck is attached and has been handed over to
+ * the renderer.
+ */
+static bool shouldDriveLEDRing() {
+  return (
+    PARAM_VARID_IS_VALID(paramIds.ledRingDeckConnected) &&
+    PARAM_VARID_IS_VALID(paramIds.ledRingEffect) &&
+    paramGetUint(paramIds.ledRingDeckConnected) &&
+    paramGetUint(paramIds.ledRingEffect) == LIGHT_RENDERER_LED_RING_EFFECT
+  );
+}
+
+static void writeToLEDRing(const uint8_t* color) {
+#ifdef CONFIG_DECK_LEDRING
+  uint8_t (*buffer)[3] = ledBuffers[ledBufferIndex];
+  uint8_t i, j;
+
+  for (i = 0; i < CONFIG_DECK_LEDRING_NBR_LEDS; i++) {
+    for (j = 0; j < 3; j++) {
+      buffer[i][j] = color[j] >> CONFIG_DECK_LEDRING_DIMMER;
+    }
+  }
+
+  ws2812Send(buffer, CONFIG_DECK_LEDRING_NBR_LEDS);
+  ledBufferIndex ^= 1;
+#endif
+}
+
+/**
+ * Statistics of the light renderer that drives the LED ring at a fixed rate.
+ */
+LOG_GROUP_START(showLights)
+  /**
+   * @brief Number of frames that repeated the previous color because a light program was being scheduled
+   */
+  LOG_ADD(LOG_UINT16, busy, &busyCount)
+LOG_GROUP_STOP(showLights)
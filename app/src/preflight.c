@@ -19,7 +19,6 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <float.h>
 #include <math.h>
 
 #include "autoconf.h"
@@ -39,6 +38,7 @@
 #include "pulse_processor.h"
 #include "sensors.h"
 #include "system.h"
+#include "windowStats.h"
 #include "worker.h"
 
 #define DEBUG_MODULE "PREFLT"
@@ -102,7 +102,7 @@
 #endif
 
 #define PREFLIGHT_CHECK_INTERVAL_MSEC 500
-#define KALMAN_VARIANCE_LOG_LENGTH 10     /* 5 seconds @ 2 Hz */
+#define KALMAN_VARIANCE_WINDOW_LENGTH 10  /* 5 seconds @ 2 Hz */
 
 /* Bitcraze uses a variance threshold of 0.001f in their example scripts,
  * but it is apparently too low for Lighthouse because the interference
@@ -126,13 +126,16 @@ static bool isForcedToPass = false;
 static bool kalmanFilterResetRequested = false;
 static float homeCoordinate[3] = { 0, 0, -10000 };
 
+/* Addresses of the log variables that the checks read, resolved once */
 static struct {
-  logVarId_t kalmanPosVariance[3];
-  logVarId_t yaw;
-  logVarId_t lighthouseBsHasCalibrationData;
-  logVarId_t lighthouseBsHasGeometryData;
-  logVarId_t lighthouseBsActive;
-} logIds;
+  const float* kalmanPosVariance[3];
+  const float* yaw;
+  const uint16_t* lighthouseBsHasCalibrationData;
+  const uint16_t* lighthouseBsHasGeometryData;
+  const uint16_t* lighthouseBsActive;
+} logVars;
+
+static windowStats_t kalmanVarianceStats[3];
 
 static struct {
   paramVarId_t kalmanInitialX;
@@ -149,6 +152,7 @@ static void preflightTimer(xTimerHandle timer);
 static void preflightWorker(void* data);
 
 static preflight_check_result_t calculatePreflightCheckSummary(uint16_t status);
+static const void* getLogVarAddress(const char* group, const char* name, int type);
 static void requestKalmanFilterReset(void);
 
 void preflightInit() {
@@ -176,27 +180,31 @@ void preflightInit() {
     return;
   }
 
-  logIds.kalmanPosVariance[0] = logGetVarId("kalman", "varPX");
-  logIds.kalmanPosVariance[1] = logGetVarId("kalman", "varPY");
-  logIds.kalmanPosVariance[2] = logGetVarId("kalman", "varPZ");
-  logIds.yaw = logGetVarId("stateEstimate", "yaw");
-  logIds.lighthouseBsActive = logGetVarId("lighthouse", "bsActive");
-  logIds.lighthouseBsHasCalibrationData = logGetVarId("lighthouse", "bsCalVal");
-  logIds.lighthouseBsHasGeometryData = logGetVarId("lighthouse", "bsGeoVal");
+  logVars.kalmanPosVariance[0] = getLogVarAddress("kalman", "varPX", LOG_FLOAT);
+  logVars.kalmanPosVariance[1] = getLogVarAddress("kalman", "varPY", LOG_FLOAT);
+  logVars.kalmanPosVariance[2] = getLogVarAddress("kalman", "varPZ", LOG_FLOAT);
+  logVars.yaw = getLogVarAddress("stateEstimate", "yaw", LOG_FLOAT);
+  logVars.lighthouseBsActive = getLogVarAddress("lighthouse", "bsActive", LOG_UINT16);
+  logVars.lighthouseBsHasCalibrationData = getLogVarAddress("lighthouse", "bsCalVal", LOG_UINT16);
+  logVars.lighthouseBsHasGeometryData = getLogVarAddress("lighthouse", "bsGeoVal", LOG_UINT16);
 
   if (
-    !logVarIdIsValid(logIds.kalmanPosVariance[0]) ||
-    !logVarIdIsValid(logIds.kalmanPosVariance[1]) ||
-    !logVarIdIsValid(logIds.kalmanPosVariance[2]) ||
-    !logVarIdIsValid(logIds.yaw) ||
-    !logVarIdIsValid(logIds.lighthouseBsActive) ||
-    !logVarIdIsValid(logIds.lighthouseBsHasCalibrationData) ||
-    !logVarIdIsValid(logIds.lighthouseBsHasGeometryData)
+    !logVars.kalmanPosVariance[0] ||
+    !logVars.kalmanPosVariance[1] ||
+    !logVars.kalmanPosVariance[2] ||
+    !logVars.yaw ||
+    !logVars.lighthouseBsActive ||
+    !logVars.lighthouseBsHasCalibrationData ||
+    !logVars.lighthouseBsHasGeometryData
   ) {
     /* required log variables missing from firmware */
     return;
   }
 
+  for (uint8_t dim = 0; dim < 3; dim++) {
+    windowStatsInit(&kalmanVarianceStats[dim], KALMAN_VARIANCE_WINDOW_LENGTH);
+  }
+
   isInit = true;
 }
 
@@ -300,6 +308,20 @@ static preflight_check_result_t calculatePreflightCheckSummary(uint16_t x) {
   return preflightResultPass;
 }
 
+/**
+ * Returns the address of a log variable that is stored in memory with the
+ * given type, NULL if there is no such variable.
+ */
+static const void* getLogVarAddress(const char* group, const char* name, int type) {
+  logVarId_t varId = logGetVarId(group, name);
+
+  if (!logVarIdIsValid(varId) || logGetType(varId) != type) {
+    return 0;
+  }
+
+  return logGetAddress(varId);
+}
+
 static void requestKalmanFilterReset(void) {
   kalmanFilterResetRequested = 1;
 }
@@ -333,7 +355,7 @@ static preflight_check_result_t testHomePosition() {
   float dxy, dz, yaw;
 
   /* check yaw -- it must be close to zero */
-  yaw = logGetFloat(logIds.yaw);
+  yaw = *logVars.yaw;
   if (yaw >= 180) {
     yaw -= 360.0f;
   }
@@ -368,13 +390,10 @@ static preflight_check_result_t testHomePosition() {
  * filter is stable enough.
  */
 static preflight_check_result_t testKalmanFilter() {
-  static float varianceLog[KALMAN_VARIANCE_LOG_LENGTH][3];
-  static uint16_t writeIndex;
   static uint8_t failureCounter = 0;
-  static bool initialized = 0;
   static bool convergedAtLeastOnce = 0;
 
-  uint16_t i, dim, count;
+  uint8_t dim;
   float minValue, maxValue;
   bool diffTooLarge = false;
   preflight_check_result_t result = preflightResultWait;
@@ -386,51 +405,32 @@ static preflight_check_result_t testKalmanFilter() {
     kalmanFilterResetRequested = 0;
     failureCounter = 0;
     convergedAtLeastOnce = 0;
-    initialized = 0;  /* to clear the variance log */
-  }
 
-  /* Perform initializations if needed (at first invocation and after every
-   * reset of the Kalman filter) */
-  if (!initialized) {
-    /* Clear Kalman filter variance log */
+    /* Clear the variance history */
     for (dim = 0; dim < 3; dim++) {
-      for (i = 0; i < KALMAN_VARIANCE_LOG_LENGTH; i++) {
-        varianceLog[i][dim] = FLT_MAX;
-      }
+      windowStatsReset(&kalmanVarianceStats[dim]);
     }
-
-    writeIndex = 0;
-    initialized = 1;
   }
 
   /* Store the current variances from the filter */
   for (dim = 0; dim < 3; dim++) {
-    varianceLog[writeIndex][dim] = logGetFloat(logIds.kalmanPosVariance[dim]);
+    windowStatsAdd(&kalmanVarianceStats[dim], *logVars.kalmanPosVariance[dim]);
   }
 
   /* Be optimistic :) */
   result = preflightResultPass;
 
   for (dim = 0; dim < 3; dim++) {
-    /* Re-scan minimum and maximum */
-    minValue = FLT_MAX;
-    maxValue = FLT_MIN;
-    count = 0;
-    for (i = 0; i < KALMAN_VARIANCE_LOG_LENGTH; i++) {
-      if (varianceLog[i][dim] != FLT_MAX) {
-        count++;
-        minValue = fminf(minValue, varianceLog[i][dim]);
-        maxValue = fmaxf(maxValue, varianceLog[i][dim]);
-      }
-    }
-
-    if (count < KALMAN_VARIANCE_LOG_LENGTH / 2) {
+    if (windowStatsCount(&kalmanVarianceStats[dim]) < KALMAN_VARIANCE_WINDOW_LENGTH / 2) {
       /* Not enough samples yet. There's no point in checking further, break
        * out of the loop and return "wait" */
       result = preflightResultWait;
       break;
     }
 
+    minValue = windowStatsMin(&kalmanVarianceStats[dim]);
+    maxValue = windowStatsMax(&kalmanVarianceStats[dim]);
+
     /* If we have passed the test at least once, and we are using Lighthouse,
      * and the maxValue is not too large, exit here because there are occasional
      * spikes in the variance with Lighthouse and we don't want that to influence
@@ -438,30 +438,17 @@ static preflight_check_result_t testKalmanFilter() {
     if (PREFLIGHT_MIN_LH_BS_COUNT > 0 && convergedAtLeastOnce && maxValue < 10 * KALMAN_VARIANCE_THRESHOLD) {
       continue;
     }
-    
+
     if ((maxValue - minValue) > KALMAN_VARIANCE_THRESHOLD) {
       /* Difference too large. If the trend is increasing, remember that so we
        * can trigger a reset later if needed */
-      if (writeIndex < KALMAN_VARIANCE_LOG_LENGTH - 1) {
-        if (varianceLog[writeIndex][dim] > varianceLog[writeIndex+1][dim]) {
-          diffTooLarge = true;
-          break;
-        }
-      } else {
-        if (varianceLog[KALMAN_VARIANCE_LOG_LENGTH - 1][dim] > varianceLog[0][dim]) {
-          diffTooLarge = true;
-          break;
-        }
+      if (windowStatsSlope(&kalmanVarianceStats[dim]) > 0) {
+        diffTooLarge = true;
+        break;
       }
     }
   }
 
-  /* Advance the write pointer */
-  writeIndex++;
-  if (writeIndex >= KALMAN_VARIANCE_LOG_LENGTH) {
-    writeIndex = 0;
-  }
-
   /* If the variance difference between min and max is too large and it has been
    * so for a long while now, reset the filter */
   if (diffTooLarge) {
@@ -506,10 +493,10 @@ static preflight_check_result_t testPositioningSystem() {
   } else if (PREFLIGHT_MIN_LH_BS_COUNT > 0) {
     /* Positioning system is Lighthouse */
     unsigned int baseStationsWithCalibrationAndGeometryData = (
-      logGetUint(logIds.lighthouseBsHasCalibrationData) &
-      logGetUint(logIds.lighthouseBsHasGeometryData)
+      *logVars.lighthouseBsHasCalibrationData &
+      *logVars.lighthouseBsHasGeometryData
     );
-    unsigned int activeBaseStations = logGetUint(logIds.lighthouseBsActive);
+    unsigned int activeBaseStations = *logVars.lighthouseBsActive;
     uint8_t i, mask = 1;
 
     for (i = 0; i < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS; i++) {
@@ -573,7 +560,7 @@ static preflight_check_result_t testTrajectoriesAndLightsAreDefined() {
  * variable appropriately.
  */
 static void preflightTimer(xTimerHandle timer) {
-  workerSchedule(preflightWorker, NULL);
+  workerScheduleWithPriority(preflightWorker, NULL, WORKER_PRIORITY_LOW, 0);
 }
 
 /**
@@ -66,6 +66,7 @@
 #define PASSTHROUGH_TASK_PRI    5
 #define STABILIZER_TASK_PRI     5
 #define SENSORS_TASK_PRI        4
+#define SENSORS_BARO_TASK_PRI   2
 #define ADC_TASK_PRI            3
 #define FLOW_TASK_PRI           3
 #define MULTIRANGER_TASK_PRI    3
@@ -122,6 +123,7 @@
 #define MEM_TASK_NAME           "MEM"
 #define PARAM_TASK_NAME         "PARAM"
 #define SENSORS_TASK_NAME       "SENSORS"
+#define SENSORS_BARO_TASK_NAME  "BARO"
 #define STABILIZER_TASK_NAME    "STABILIZER"
 #define NRF24LINK_TASK_NAME     "NRF24LINK"
 #define ESKYLINK_TASK_NAME      "ESKYLINK"
@@ -174,6 +176,7 @@
 #define MEM_TASK_STACKSIZE            (2 * configMINIMAL_STACK_SIZE)
 #define PARAM_TASK_STACKSIZE          (2 * configMINIMAL_STACK_SIZE)
 #define SENSORS_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
+#define SENSORS_BARO_TASK_STACKSIZE   (2 * configMINIMAL_STACK_SIZE)
 #define STABILIZER_TASK_STACKSIZE     (3 * configMINIMAL_STACK_SIZE)
 #define NRF24LINK_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define ESKYLINK_TASK_STACKSIZE       configMINIMAL_STACK_SIZE
@@ -120,6 +120,10 @@ bool lpsGetLppShort(lpsLppShortPacket_t* shortPacket);
 uint16_t locoDeckGetRangingState();
 void locoDeckSetRangingState(const uint16_t newState);
 
+// Time of the DW1000 interrupt that is being handled, in ms. To be used by the algorithms to time stamp a received
+// packet with the time it arrived rather than the time it is processed.
+uint32_t locoDeckGetInterruptTimeMs();
+
 // LPP Packet types and format
 #define LPP_HEADER_SHORT_PACKET 0xF0
 
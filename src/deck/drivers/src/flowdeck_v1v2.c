@@ -88,6 +88,7 @@ static void flowdeckTask(void *param)
     vTaskDelay(10);
 
     pmw3901ReadMotion(NCS_PIN, &currentMotion);
+    const uint32_t captureMs = T2M(xTaskGetTickCount());
 
     // Flip motion information to comply with sensor mounting
     // (might need to be changed if mounted differently)
@@ -155,7 +156,7 @@ static void flowdeckTask(void *param)
       // Push measurements into the estimator if flow is not disabled
       //    and the PMW flow sensor indicates motion detection
       if (!useFlowDisabled && currentMotion.motion == 0xB0) {
-        estimatorEnqueueFlow(&flowData);
+        estimatorEnqueueFlowAt(&flowData, captureMs);
       }
     } else {
       outlierCount++;
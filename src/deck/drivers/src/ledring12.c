@@ -950,6 +950,14 @@ static void timeMemEffect(uint8_t outputBuffer[][3], bool reset)
         (1-percentShift) * currentBuffer[(i+1) % CONFIG_DECK_LEDRING_NBR_LEDS][j];
 }
 
+/**
+ * The LEDs are driven by another module, for instance a light show renderer
+ * that writes to the LEDs at a higher rate than the effects are updated.
+ */
+static void externalEffect(uint8_t buffer[][3], bool reset)
+{
+}
+
 /**************** Effect list ***************/
 
 
@@ -974,6 +982,7 @@ Ledring12Effect effectsFct[] =
   locSrvStatus,
   timeMemEffect,
   lighthouseEffect,
+  externalEffect,
 };
 
 /********** Light signal overriding **********/
@@ -1043,6 +1052,10 @@ void ledring12Worker(void * data)
     DEBUG_PRINT("Bad value for effect (> neffect)\n");
   }
 
+  if (effectsFct[current_effect] == externalEffect) {
+    return;
+  }
+
   effectsFct[current_effect](buffer, reset);
   overrideWithLightSignal(buffer);
 
@@ -1174,6 +1187,7 @@ PARAM_GROUP_START(ring)
  * | 16 | Status Localization Service   | \n
  * | 17 | LED timing from memory        | \n
  * | 18 | Lighthouse  Positioning       | \n
+ * | 19 | Driven by another module      | \n
  */
 PARAM_ADD_CORE(PARAM_UINT8 | PARAM_PERSISTENT, effect, &effect)
 
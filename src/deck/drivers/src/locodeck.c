@@ -135,6 +135,10 @@ static QueueHandle_t lppShortQueue;
 
 static uint32_t timeout;
 
+// Tick of the latest DW1000 interrupt, set in the ISR, and of the one that is being handled
+static volatile TickType_t irqTick;
+static TickType_t handledIrqTick;
+
 static STATS_CNT_RATE_DEFINE(spiWriteCount, 1000);
 static STATS_CNT_RATE_DEFINE(spiReadCount, 1000);
 
@@ -362,6 +366,7 @@ static void uwbTask(void* parameters) {
     xSemaphoreGive(algoSemaphore);
 
     if (ulTaskNotifyTake(pdTRUE, timeout / portTICK_PERIOD_MS) > 0) {
+      handledIrqTick = irqTick;
       do{
         xSemaphoreTake(algoSemaphore, portMAX_DELAY);
         dwHandleInterrupt(dwm);
@@ -437,6 +442,8 @@ static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
   {
     portBASE_TYPE  xHigherPriorityTaskWoken = pdFALSE;
 
+    irqTick = xTaskGetTickCountFromISR();
+
     // Unlock interrupt handling task
     vTaskNotifyGiveFromISR(uwbTaskHandle, &xHigherPriorityTaskWoken);
 
@@ -559,6 +566,10 @@ void locoDeckSetRangingState(const uint16_t newState) {
   algoOptions.rangingState = newState;
 }
 
+uint32_t locoDeckGetInterruptTimeMs() {
+  return T2M(handledIrqTick);
+}
+
 
 static bool dwm1000Test()
 {
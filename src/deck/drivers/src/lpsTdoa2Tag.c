@@ -280,7 +280,8 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
   // Override the default standard deviation set by the TDoA engine.
   tdoaMeasurement->stdDev = stdDev;
 
-  estimatorEnqueueTDOA(tdoaMeasurement);
+  // The callback runs while the packet is processed, stamp it with the time it was received
+  estimatorEnqueueTDOAAt(tdoaMeasurement, locoDeckGetInterruptTimeMs());
 
   #ifdef CONFIG_DECK_LOCO_2D_POSITION
   heightMeasurement_t heightData;
@@ -300,7 +301,7 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
 
 static void Initialize(dwDevice_t *dev) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmYoungest);
+  tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, 0, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmYoungest);
 
   previousAnchor = 0;
 
@@ -323,7 +324,7 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
   tdoaAnchorContext_t anchorCtx;
   uint32_t now_ms = T2M(xTaskGetTickCount());
 
-  bool contextFound = tdoaStorageGetAnchorCtx(tdoaEngineState.anchorInfoArray, anchorId, now_ms, &anchorCtx);
+  bool contextFound = tdoaStorageGetAnchorCtx(&tdoaEngineState.anchorStorage, anchorId, now_ms, &anchorCtx);
   if (contextFound) {
     tdoaStorageGetAnchorPosition(&anchorCtx, position);
     return true;
@@ -333,12 +334,12 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
 }
 
 static uint8_t getAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
-  return tdoaStorageGetListOfAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize);
+  return tdoaStorageGetListOfAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize);
 }
 
 static uint8_t getActiveAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  return tdoaStorageGetListOfActiveAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize, now_ms);
+  return tdoaStorageGetListOfActiveAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize, now_ms);
 }
 
 // Loco Posisioning Protocol (LPP) handling
@@ -267,7 +267,8 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
   // Override the default standard deviation set by the TDoA engine.
   tdoaMeasurement->stdDev = stdDev;
 
-  estimatorEnqueueTDOA(tdoaMeasurement);
+  // The callback runs while the packet is processed, stamp it with the time it was received
+  estimatorEnqueueTDOAAt(tdoaMeasurement, locoDeckGetInterruptTimeMs());
 
   #ifdef CONFIG_DECK_LOCO_2D_POSITION
   heightMeasurement_t heightData;
@@ -278,11 +279,28 @@ static void sendTdoaToEstimatorCallback(tdoaMeasurement_t* tdoaMeasurement) {
   #endif
 }
 
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+static void sendTdoaBatchToEstimatorCallback(tdoaBatchMeasurement_t* tdoaBatchMeasurement) {
+  // Override the default standard deviation set by the TDoA engine.
+  tdoaBatchMeasurement->stdDev = stdDev;
+
+  estimatorEnqueueTDOABatchAt(tdoaBatchMeasurement, locoDeckGetInterruptTimeMs());
+
+  #ifdef CONFIG_DECK_LOCO_2D_POSITION
+  heightMeasurement_t heightData;
+  heightData.timestamp = xTaskGetTickCount();
+  heightData.height = DECK_LOCO_2D_POSITION_HEIGHT;
+  heightData.stdDev = 0.0001;
+  estimatorEnqueueAbsoluteHeight(&heightData);
+  #endif
+}
+#endif
+
 static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
   tdoaAnchorContext_t anchorCtx;
   uint32_t now_ms = T2M(xTaskGetTickCount());
 
-  bool contextFound = tdoaStorageGetAnchorCtx(tdoaEngineState.anchorInfoArray, anchorId, now_ms, &anchorCtx);
+  bool contextFound = tdoaStorageGetAnchorCtx(&tdoaEngineState.anchorStorage, anchorId, now_ms, &anchorCtx);
   if (contextFound) {
     tdoaStorageGetAnchorPosition(&anchorCtx, position);
     return true;
@@ -292,17 +310,21 @@ static bool getAnchorPosition(const uint8_t anchorId, point_t* position) {
 }
 
 static uint8_t getAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
-  return tdoaStorageGetListOfAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize);
+  return tdoaStorageGetListOfAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize);
 }
 
 static uint8_t getActiveAnchorIdList(uint8_t unorderedAnchorList[], const int maxListSize) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  return tdoaStorageGetListOfActiveAnchorIds(tdoaEngineState.anchorInfoArray, unorderedAnchorList, maxListSize, now_ms);
+  return tdoaStorageGetListOfActiveAnchorIds(&tdoaEngineState.anchorStorage, unorderedAnchorList, maxListSize, now_ms);
 }
 
 static void Initialize(dwDevice_t *dev) {
   uint32_t now_ms = T2M(xTaskGetTickCount());
-  tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmRandom);
+  #ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+  tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, sendTdoaBatchToEstimatorCallback, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmBatch);
+  #else
+  tdoaEngineInit(&tdoaEngineState, now_ms, sendTdoaToEstimatorCallback, 0, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmRandom);
+  #endif
 
   #ifdef CONFIG_DECK_LOCO_2D_POSITION
   DEBUG_PRINT("2D positioning enabled at %f m height\n", DECK_LOCO_2D_POSITION_HEIGHT);
@@ -36,6 +36,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <math.h>
 #include "stm32fxxx.h"
 
 #include "FreeRTOS.h"
@@ -62,6 +63,8 @@
 #include "static_mem.h"
 #include "mem.h"
 #include "eventtrigger.h"
+#include "worker.h"
+#include "crtp_commander_high_level.h"
 
 #include "autoconf.h"
 
@@ -95,17 +98,50 @@
 #define FIXED_FREQUENCY_EVENT_ID          (0xFFFF)
 #define FIXED_FREQUENCY_EVENT_NAME        "fixedFrequency"
 
+// Maximum size of a delta-encoded record: event id, flags, timestamp and
+// one varint (at most 5 bytes) per variable
+#define MAX_USD_DELTA_RECORD_SIZE         (2 + 1 + 8 + 5 * MAX_USD_LOG_VARIABLES_PER_EVENT)
+#define USD_DELTA_FLAG_KEYFRAME           (0x01)
+
+#define USD_SECTOR_SIZE                   (512)
+#define USD_WRITE_BLOCK_SIZE              (CONFIG_DECK_USD_WRITE_BLOCK_SECTORS * USD_SECTOR_SIZE)
+
 
 /* set to true when graceful shutdown is triggered */
 static volatile bool in_shutdown = false;
 
+// Precompiled access to a log variable, resolved when the config is read so
+// that records can be assembled without going through the log subsystem
+typedef struct usdLogVarAccessor_s {
+  const void* address;
+  uint8_t size;
+  uint8_t type;
+} usdLogVarAccessor_t;
+
 typedef struct usdLogEventConfig_s {
   uint16_t eventId;
   uint8_t numVars;
-  uint16_t numBytes;
+  uint16_t numBytes;        // size of all variables of a record
+  uint16_t recordSize;      // size of a record, excluding the event payload
   logVarId_t varIds[MAX_USD_LOG_VARIABLES_PER_EVENT];
+  usdLogVarAccessor_t vars[MAX_USD_LOG_VARIABLES_PER_EVENT];
+  // fixed-point scale for float variables in delta-encoded records,
+  // 0 stores the raw float
+  float scales[MAX_USD_LOG_VARIABLES_PER_EVENT];
+  // number of records between keyframes, 0 disables delta encoding
+  uint16_t keyframeInterval;
 } usdLogEventConfig_t;
 
+// State of the delta encoder of the fixed frequency event. Values are kept
+// as the 32 bit integers that are actually encoded (scaled floats are
+// quantized first).
+typedef struct usdLogDeltaState_s {
+  bool needKeyframe;
+  uint16_t recordsSinceKeyframe;
+  uint64_t lastTimestamp;
+  int32_t lastValues[MAX_USD_LOG_VARIABLES_PER_EVENT];
+} usdLogDeltaState_t;
+
 typedef struct usdLogConfig_s {
   char filename[13];
   uint16_t frequency;
@@ -121,8 +157,23 @@ typedef struct usdLogConfig_s {
 typedef struct usdLogStats_s {
   uint32_t eventsRequested;
   uint32_t eventsWritten;
+  uint32_t blocksWritten;
+  uint32_t lastWriteLatency;  // [us]
+  uint32_t maxWriteLatency;   // [us]
 } usdLogStats_t;
 
+// Staging block for the write task. Data is collected here and handed to
+// FatFS only as whole, sector-aligned blocks so that FatFS can write
+// directly to the card (multi-sector) instead of going through its sector
+// window with read-modify-write cycles. Together with the ring buffer this
+// forms a double buffer: the producers keep filling the ring buffer while a
+// full block is being written to the card.
+typedef struct usdBlockWriter_s {
+  uint8_t* buffer;        // pointer to staging block
+  uint16_t capacity;      // size of staging block, multiple of the sector size
+  uint16_t fill;          // number of bytes staged
+} usdBlockWriter_t;
+
 // Ring buffer
 typedef struct ringBuffer_s {
   uint8_t* buffer;        // pointer to buffer
@@ -156,26 +207,47 @@ uint16_t ringBuffer_availableSpace(const ringBuffer_t* b)
   return b->capacity - b->size;
 }
 
+// Copies data to the write position without checking for space. Space must
+// have been reserved with ringBuffer_reserve() and the data is visible to
+// readers only after ringBuffer_commit().
+static inline void ringBuffer_write(ringBuffer_t* b, const void* data, uint16_t size)
+{
+  uint16_t untilEnd = b->buffer + b->capacity - b->writePtr;
+  if (size < untilEnd) {
+    memcpy(b->writePtr, data, size);
+    b->writePtr += size;
+  } else {
+    const uint8_t* dataTyped = (const uint8_t*)data;
+    memcpy(b->writePtr, dataTyped, untilEnd);
+    memcpy(b->buffer, dataTyped + untilEnd, size - untilEnd);
+    b->writePtr = b->buffer + (size - untilEnd);
+  }
+}
+
+static inline bool ringBuffer_reserve(const ringBuffer_t* b, uint16_t size)
+{
+  return ringBuffer_availableSpace(b) >= size;
+}
+
+static inline void ringBuffer_commit(ringBuffer_t* b, uint16_t size)
+{
+  b->size += size;
+}
+
 bool ringBuffer_push(ringBuffer_t* b, const void* data, uint16_t size)
 {
-  if (ringBuffer_availableSpace(b) < size) {
+  if (!ringBuffer_reserve(b, size)) {
     return false;
   }
-  const uint8_t* dataTyped = (const uint8_t*)data;
-  for (uint16_t i = 0; i < size; ++i) {
-    *(b->writePtr) = dataTyped[i];
-    ++b->writePtr;
-    if (b->writePtr ==  b->buffer + b->capacity) {
-      b->writePtr = b->buffer;
-    }
-  }
-  b->size += size;
+  ringBuffer_write(b, data, size);
+  ringBuffer_commit(b, size);
   return true;
 }
 
-bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size)
+// starts a pop of at most "maxSize" contiguous bytes
+bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size, uint16_t maxSize)
 {
-  if (b->size == 0) {
+  if (b->size == 0 || maxSize == 0) {
     return false;
   }
 
@@ -183,10 +255,15 @@ bool ringBuffer_pop_start(ringBuffer_t* b, const uint8_t** buf, uint16_t* size)
   if (b->writePtr > b->readPtr) {
     // writer did not wrap around yet
     *size = b->writePtr - b->readPtr;
-    b->readPtr = b->writePtr;
   } else {
     // wrap around -> read until end of buffer, only
     *size = b->buffer + b->capacity - b->readPtr;
+  }
+  if (*size > maxSize) {
+    *size = maxSize;
+  }
+  b->readPtr += *size;
+  if (b->readPtr == b->buffer + b->capacity) {
     b->readPtr = b->buffer;
   }
   b->popSize = *size;
@@ -219,6 +296,7 @@ static STATS_CNT_RATE_DEFINE(fatWriteRate, 1000);
 
 static usdLogConfig_t usdLogConfig;
 static usdLogStats_t usdLogStats;
+static usdLogDeltaState_t usdLogDeltaState;
 
 static BYTE exchangeBuff[512];
 static uint16_t spiSpeed;
@@ -235,7 +313,9 @@ static SemaphoreHandle_t logFileMutex;
 
 static SemaphoreHandle_t logBufferMutex;
 static ringBuffer_t logBuffer;
+static uint16_t writeTriggerThreshold;
 static TaskHandle_t xHandleWriteTask;
+static usdBlockWriter_t blockWriter;
 
 static bool enableLogging;
 static uint32_t lastFileSize = 0;
@@ -246,6 +326,18 @@ static void usdTimer(xTimerHandle timer);
 
 static SemaphoreHandle_t shutdownMutex;
 
+#ifdef CONFIG_DECK_USD_TRAJECTORY_STREAM
+// Compressed trajectory streamed to the high-level commander while it is
+// executed. The file is read by the worker task, or by the write task while
+// it owns the card for logging.
+#define USD_TRAJECTORY_FILE "traj.bin"
+static FIL trajFile;
+static bool trajFileOpen;
+static volatile bool trajRefillPending;
+static uint8_t trajReadBuffer[128];
+static void usdTrajectoryStreamRefill(void* arg);
+#endif
+
 // Handling from the memory module
 static uint32_t handleMemGetSize(void) { return usddeckFileSize(); }
 static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
@@ -475,6 +567,211 @@ static void usdInit(DeckInfo *info)
   isInit = true;
 }
 
+#ifdef CONFIG_DECK_USD_TRAJECTORY_STREAM
+/*********** Trajectory streaming ***************/
+
+// Reads the trajectory file into the trajectory stream of the high-level
+// commander until the stream is full or the end of the file is reached.
+// Must be called with logFileMutex taken.
+static void usdTrajectoryStreamRead(void)
+{
+  uint32_t offset = crtpCommanderHighLevelTrajectoryStreamWriteOffset();
+  uint32_t space = crtpCommanderHighLevelTrajectoryStreamFree();
+
+  if (!trajFileOpen || space == 0 || f_lseek(&trajFile, offset) != FR_OK) {
+    return;
+  }
+
+  while (space > 0) {
+    UINT toRead = space < sizeof(trajReadBuffer) ? space : sizeof(trajReadBuffer);
+    UINT bytesRead;
+    if (f_read(&trajFile, trajReadBuffer, toRead, &bytesRead) != FR_OK || bytesRead == 0) {
+      break;
+    }
+    // fails if the stream was reset or written by someone else meanwhile
+    if (!crtpCommanderHighLevelWriteTrajectoryStream(offset, bytesRead, trajReadBuffer)) {
+      break;
+    }
+    offset += bytesRead;
+    space -= bytesRead;
+  }
+}
+
+static void usdTrajectoryStreamRefill(void* arg)
+{
+  if (xSemaphoreTake(logFileMutex, 0) == pdTRUE) {
+    usdTrajectoryStreamRead();
+    xSemaphoreGive(logFileMutex);
+  } else if (enableLogging && xHandleWriteTask) {
+    // the write task owns the card while logging, let it do the refill
+    trajRefillPending = true;
+    vTaskResume(xHandleWriteTask);
+  }
+}
+
+static void usdTrajectoryStreamInit(void)
+{
+  xSemaphoreTake(logFileMutex, portMAX_DELAY);
+  trajFileOpen = f_open(&trajFile, USD_TRAJECTORY_FILE, FA_READ) == FR_OK;
+  xSemaphoreGive(logFileMutex);
+
+  if (trajFileOpen) {
+    DEBUG_PRINT("Streaming trajectory from: %s\n", USD_TRAJECTORY_FILE);
+    crtpCommanderHighLevelSetTrajectoryStreamSource(usdTrajectoryStreamRefill);
+  }
+}
+#endif
+
+/*********** Delta-encoded records ***************/
+
+static uint8_t* writeVarint(uint8_t* dst, uint32_t value)
+{
+  while (value >= 0x80) {
+    *dst++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *dst++ = (uint8_t)value;
+  return dst;
+}
+
+static inline uint32_t zigzagEncode(int32_t value)
+{
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+// Reads a log variable as the 32 bit integer that is delta-encoded. Float
+// variables with a scale are stored in fixed-point, floats without a scale
+// are returned as their raw bit pattern.
+static int32_t readVarForDelta(const usdLogVarAccessor_t* var, float scale)
+{
+  const void* address = var->address;
+  switch (var->type) {
+  case LOG_UINT8:
+    return *(const uint8_t*)address;
+  case LOG_INT8:
+    return *(const int8_t*)address;
+  case LOG_UINT16:
+    return *(const uint16_t*)address;
+  case LOG_INT16:
+    return *(const int16_t*)address;
+  case LOG_UINT32:
+  case LOG_INT32:
+    return *(const int32_t*)address;
+  case LOG_FLOAT:
+    {
+      float value = *(const float*)address;
+      if (scale == 0.0f) {
+        int32_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        return raw;
+      }
+      value *= scale;
+      if (value >= (float)INT32_MAX) {
+        return INT32_MAX;
+      }
+      if (value <= (float)INT32_MIN) {
+        return INT32_MIN;
+      }
+      return lroundf(value);
+    }
+  default:
+    ASSERT(false);
+    return 0;
+  }
+}
+
+// Encodes a record of the fixed frequency event. Keyframes carry the full
+// timestamp and delta-encode the values against zero so the decoder can
+// resynchronize. Unscaled floats are always stored raw as their bit
+// patterns do not compress.
+// Returns the number of bytes written to "dst"
+static uint16_t encodeDeltaRecord(const usdLogEventConfig_t* cfg, uint64_t timestamp,
+                                  int32_t values[MAX_USD_LOG_VARIABLES_PER_EVENT], uint8_t* dst)
+{
+  usdLogDeltaState_t* state = &usdLogDeltaState;
+  uint8_t* p = dst;
+
+  bool keyframe = state->needKeyframe
+                  || state->recordsSinceKeyframe >= cfg->keyframeInterval
+                  || timestamp - state->lastTimestamp > UINT32_MAX;
+
+  memcpy(p, &cfg->eventId, sizeof(cfg->eventId));
+  p += sizeof(cfg->eventId);
+  *p++ = keyframe ? USD_DELTA_FLAG_KEYFRAME : 0;
+
+  if (keyframe) {
+    memcpy(p, &timestamp, sizeof(timestamp));
+    p += sizeof(timestamp);
+  } else {
+    p = writeVarint(p, (uint32_t)(timestamp - state->lastTimestamp));
+  }
+
+  for (int i = 0; i < cfg->numVars; ++i) {
+    values[i] = readVarForDelta(&cfg->vars[i], cfg->scales[i]);
+    if (cfg->vars[i].type == LOG_FLOAT && cfg->scales[i] == 0.0f) {
+      memcpy(p, &values[i], sizeof(values[i]));
+      p += sizeof(values[i]);
+    } else {
+      int32_t previous = keyframe ? 0 : state->lastValues[i];
+      p = writeVarint(p, zigzagEncode((int32_t)((uint32_t)values[i] - (uint32_t)previous)));
+    }
+  }
+
+  return p - dst;
+}
+
+// Updates the encoder state once a record has made it into the log buffer.
+// If a record is dropped the next one has to be a keyframe since the decoder
+// would otherwise apply the deltas to the wrong reference.
+static void updateDeltaState(const usdLogEventConfig_t* cfg, const uint8_t* record, uint64_t timestamp,
+                             const int32_t values[MAX_USD_LOG_VARIABLES_PER_EVENT], bool written)
+{
+  usdLogDeltaState_t* state = &usdLogDeltaState;
+
+  if (!written) {
+    state->needKeyframe = true;
+    return;
+  }
+
+  if (record[sizeof(cfg->eventId)] & USD_DELTA_FLAG_KEYFRAME) {
+    state->needKeyframe = false;
+    state->recordsSinceKeyframe = 0;
+  }
+  ++state->recordsSinceKeyframe;
+  state->lastTimestamp = timestamp;
+  memcpy(state->lastValues, values, cfg->numVars * sizeof(values[0]));
+}
+
+static void usddeckWriteDeltaEventData(const usdLogEventConfig_t* cfg)
+{
+  uint64_t ticks = usecTimestamp();
+
+  if (!enableLogging) {
+    return;
+  }
+
+  ++usdLogStats.eventsRequested;
+
+  uint8_t record[MAX_USD_DELTA_RECORD_SIZE];
+  int32_t values[MAX_USD_LOG_VARIABLES_PER_EVENT];
+  uint16_t recordSize = encodeDeltaRecord(cfg, ticks, values, record);
+
+  xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+
+  // trigger writing once there is enough data for a full block
+  if (logBuffer.size >= writeTriggerThreshold && xHandleWriteTask) {
+    vTaskResume(xHandleWriteTask);
+  }
+
+  bool written = ringBuffer_push(&logBuffer, record, recordSize);
+  if (written) {
+    ++usdLogStats.eventsWritten;
+  }
+  xSemaphoreGive(logBufferMutex);
+
+  updateDeltaState(cfg, record, ticks, values, written);
+}
+
 static void usddeckWriteEventData(const usdLogEventConfig_t* cfg, const uint8_t* payload, uint8_t payloadSize)
 {
   uint64_t ticks = usecTimestamp();
@@ -487,44 +784,27 @@ static void usddeckWriteEventData(const usdLogEventConfig_t* cfg, const uint8_t*
 
   xSemaphoreTake(logBufferMutex, portMAX_DELAY);
 
-  // trigger writing once there is some data
-  if (logBuffer.size > 0 && xHandleWriteTask) {
+  // trigger writing once there is enough data for a full block
+  if (logBuffer.size >= writeTriggerThreshold && xHandleWriteTask) {
     vTaskResume(xHandleWriteTask);
   }
 
-  int dataSize = sizeof(cfg->eventId) + sizeof(ticks) + payloadSize + cfg->numBytes;
+  uint16_t dataSize = cfg->recordSize + payloadSize;
 
   // only write if we have enough space
-  if (ringBuffer_availableSpace(&logBuffer) >= dataSize) {
+  if (ringBuffer_reserve(&logBuffer, dataSize)) {
     /* write data into buffer */
-    uint16_t event_id = cfg->eventId;
-    ringBuffer_push(&logBuffer, &event_id, sizeof(event_id));
-    ringBuffer_push(&logBuffer, &ticks, sizeof(ticks));
+    ringBuffer_write(&logBuffer, &cfg->eventId, sizeof(cfg->eventId));
+    ringBuffer_write(&logBuffer, &ticks, sizeof(ticks));
     if (payloadSize) {
-      ringBuffer_push(&logBuffer, payload, payloadSize);
+      ringBuffer_write(&logBuffer, payload, payloadSize);
     }
 
-    for (int i = 0; i < cfg->numVars; ++i) {
-      logVarId_t varid = cfg->varIds[i];
-      switch (logGetType(varid)) {
-      case LOG_UINT8:
-      case LOG_INT8:
-        ringBuffer_push(&logBuffer, logGetAddress(varid), sizeof(uint8_t));
-        break;
-      case LOG_UINT16:
-      case LOG_INT16:
-        ringBuffer_push(&logBuffer, logGetAddress(varid), sizeof(uint16_t));
-        break;
-      case LOG_UINT32:
-      case LOG_INT32:
-      case LOG_FLOAT:
-        ringBuffer_push(&logBuffer, logGetAddress(varid), sizeof(uint32_t));
-        break;
-      default:
-        ASSERT(false);
-        break;
-      }
+    const usdLogVarAccessor_t* var = cfg->vars;
+    for (int i = 0; i < cfg->numVars; ++i, ++var) {
+      ringBuffer_write(&logBuffer, var->address, var->size);
     }
+    ringBuffer_commit(&logBuffer, dataSize);
     ++usdLogStats.eventsWritten;
   }
   xSemaphoreGive(logBufferMutex);
@@ -562,6 +842,10 @@ static void usdLogTask(void* prm)
     vTaskDelayUntil(&lastWakeTime, F2T(10));
   }
 
+#ifdef CONFIG_DECK_USD_TRAJECTORY_STREAM
+  usdTrajectoryStreamInit();
+#endif
+
   // loop to break out in case of errors
   while (true) {
     /* open config file */
@@ -575,7 +859,7 @@ static void usdLogTask(void* prm)
       TCHAR* line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
       if (!line) break;
       int version = strtol(line, &endptr, 10);
-      if (version != 1) break;
+      if (version != 1 && version != 2) break;
       // buffer size
       line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
       if (!line) break;
@@ -616,6 +900,13 @@ static void usdLogTask(void* prm)
             line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
             if (!line) break;
             usdLogConfig.mode = strtol(line, &endptr, 10);
+            // keyframe interval of delta-encoded records (version 2 only)
+            cfg->keyframeInterval = 0;
+            if (version >= 2) {
+              line = f_gets_without_comments(readBuffer, sizeof(readBuffer), &logFile);
+              if (!line) break;
+              cfg->keyframeInterval = strtol(line, &endptr, 10);
+            }
             cfg->eventId = FIXED_FREQUENCY_EVENT_ID;
             eventName = FIXED_FREQUENCY_EVENT_NAME;
             usdLogConfig.fixedFrequencyEventIdx = usdLogConfig.numEventConfigs;
@@ -623,6 +914,7 @@ static void usdLogTask(void* prm)
             // handle event triggers
             const eventtrigger *et = eventtriggerGetByName(&line[3]);
             if (et) {
+              cfg->keyframeInterval = 0;
               cfg->eventId = eventtriggerGetId(et);
               eventName = et->name;
             } else {
@@ -654,20 +946,33 @@ static void usdLogTask(void* prm)
                 break;
               }
             }
+            // optional fixed-point scale for delta-encoded records, "group.name:scale"
+            float scale = 0.0f;
+            char *scaleStr = name ? strchr(name, ':') : 0;
+            if (scaleStr) {
+              *scaleStr = 0;
+              scale = strtof(scaleStr + 1, &endptr);
+            }
             logVarId_t varid = logGetVarId(group, name);
             if (!logVarIdIsValid(varid)) {
               DEBUG_PRINT("Unknown log variable %s.%s\n", group, name);
               continue;
             }
             if (cfg->numVars < MAX_USD_LOG_VARIABLES_PER_EVENT) {
+              usdLogVarAccessor_t* var = &cfg->vars[cfg->numVars];
+              var->type = logGetType(varid);
+              var->size = logVarSize(var->type);
+              var->address = logGetAddress(varid);
               cfg->varIds[cfg->numVars] = varid;
+              cfg->scales[cfg->numVars] = scale;
               ++cfg->numVars;
-              cfg->numBytes += logVarSize(logGetType(varid));
+              cfg->numBytes += var->size;
             } else {
               DEBUG_PRINT("Skip log variable %s: %s.%s (out of storage)\n", eventName, group, name);
               continue;
             }
           }
+          cfg->recordSize = sizeof(cfg->eventId) + sizeof(uint64_t) + cfg->numBytes;
           if (usdLogConfig.numEventConfigs < MAX_USD_LOG_EVENTS) {
             ++usdLogConfig.numEventConfigs;
             cfg = &usdLogConfig.eventConfigs[usdLogConfig.numEventConfigs];
@@ -709,6 +1014,25 @@ static void usdLogTask(void* prm)
     }
     ringBuffer_init(&logBuffer, logBufferData, usdLogConfig.bufferSize);
 
+    // wake the writer once a block can be filled, or earlier if the ring
+    // buffer is too small to hold a full block
+    writeTriggerThreshold = USD_WRITE_BLOCK_SIZE;
+    if (writeTriggerThreshold > usdLogConfig.bufferSize / 2) {
+      writeTriggerThreshold = usdLogConfig.bufferSize / 2;
+    }
+
+    /* allocate memory for the sector-aligned write block */
+    DEBUG_PRINT("malloc write block %d bytes ", USD_WRITE_BLOCK_SIZE);
+    blockWriter.buffer = pvPortMalloc(USD_WRITE_BLOCK_SIZE);
+    if (blockWriter.buffer) {
+      DEBUG_PRINT("[OK].\n");
+    } else {
+      DEBUG_PRINT("[FAIL].\n");
+      break;
+    }
+    blockWriter.capacity = USD_WRITE_BLOCK_SIZE;
+    blockWriter.fill = 0;
+
     /* create queue to hand over pointer to usdLogData */
     // usdLogQueue = xQueueCreate(usdLogConfig.queueSize, sizeof(uint8_t*));
 
@@ -760,7 +1084,12 @@ int usddeckFrequency(void)
 void usddeckTriggerLogging(void)
 {
   if (usdLogConfig.fixedFrequencyEventIdx < MAX_USD_LOG_EVENTS) {
-    usddeckWriteEventData(&usdLogConfig.eventConfigs[usdLogConfig.fixedFrequencyEventIdx], 0, 0);
+    const usdLogEventConfig_t* cfg = &usdLogConfig.eventConfigs[usdLogConfig.fixedFrequencyEventIdx];
+    if (cfg->keyframeInterval > 0) {
+      usddeckWriteDeltaEventData(cfg);
+    } else {
+      usddeckWriteEventData(cfg, 0, 0);
+    }
   }
 }
 
@@ -805,19 +1134,69 @@ static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t
   return result;
 }
 
-static void usdWriteData(const void *data, size_t size)
+// Writes a block of data to the file. "size" is a multiple of the block
+// size except for the last write before the file is closed.
+static void usdWriteBlock(const uint8_t *data, UINT size)
 {
   UINT bytesWritten;
+  uint64_t start = usecTimestamp();
   FRESULT status = f_write(&logFile, data, size, &bytesWritten);
+  uint32_t latency = usecTimestamp() - start;
+
+  usdLogStats.lastWriteLatency = latency;
+  if (latency > usdLogStats.maxWriteLatency) {
+    usdLogStats.maxWriteLatency = latency;
+  }
+
   if (status != FR_OK) {
     DEBUG_PRINT("usd deck write failure %d\n", status);
     enableLogging = false;
   } else {
-    crc32Update(&crcContext, data, size);
+    ++usdLogStats.blocksWritten;
     STATS_CNT_RATE_MULTI_EVENT(&fatWriteRate, bytesWritten);
   }
 }
 
+static void usdFlushBlock(void)
+{
+  if (blockWriter.fill > 0) {
+    usdWriteBlock(blockWriter.buffer, blockWriter.fill);
+    blockWriter.fill = 0;
+  }
+}
+
+// Queues data for writing. Data is only written to the file in full blocks,
+// call usdFlushBlock() to write a partially filled block.
+static void usdWriteData(const void *data, size_t size)
+{
+  const uint8_t* src = (const uint8_t*)data;
+
+  crc32Update(&crcContext, data, size);
+
+  // write full blocks directly if nothing is staged
+  if (blockWriter.fill == 0 && size >= blockWriter.capacity) {
+    UINT directSize = size - (size % blockWriter.capacity);
+    usdWriteBlock(src, directSize);
+    src += directSize;
+    size -= directSize;
+  }
+
+  while (size > 0) {
+    size_t chunk = blockWriter.capacity - blockWriter.fill;
+    if (chunk > size) {
+      chunk = size;
+    }
+    memcpy(&blockWriter.buffer[blockWriter.fill], src, chunk);
+    blockWriter.fill += chunk;
+    src += chunk;
+    size -= chunk;
+
+    if (blockWriter.fill == blockWriter.capacity) {
+      usdFlushBlock();
+    }
+  }
+}
+
 static void usdWriteTask(void* prm)
 {
   /* create and start timer for card control timing */
@@ -833,6 +1212,11 @@ static void usdWriteTask(void* prm)
       // reset stats
       usdLogStats.eventsRequested = 0;
       usdLogStats.eventsWritten = 0;
+      usdLogStats.blocksWritten = 0;
+      usdLogStats.lastWriteLatency = 0;
+      usdLogStats.maxWriteLatency = 0;
+      blockWriter.fill = 0;
+      usdLogDeltaState.needKeyframe = true;
 
       // reset the buffer
       xSemaphoreTake(logBufferMutex, portMAX_DELAY);
@@ -869,6 +1253,15 @@ static void usdWriteTask(void* prm)
 
         DEBUG_PRINT("Logging to: %s\n", usdLogConfig.filename);
 
+#if CONFIG_DECK_USD_PREALLOCATE_KB > 0
+        // allocate a contiguous cluster chain up front, the file is
+        // truncated to its actual size when it is closed
+        FRESULT expandResult = f_expand(&logFile, (FSIZE_t)CONFIG_DECK_USD_PREALLOCATE_KB * 1024, 1);
+        if (expandResult != FR_OK) {
+          DEBUG_PRINT("Pre-allocation failed (%d), continuing\n", expandResult);
+        }
+#endif
+
         // iniatialize crc
         crc32ContextInit(&crcContext);
 
@@ -876,7 +1269,14 @@ static void usdWriteTask(void* prm)
         uint8_t magic = 0xBC;
         usdWriteData(&magic, sizeof(magic));
 
-        uint16_t version = 2;
+        // version 3 adds delta-encoded records
+        bool useDeltaRecords = false;
+        for (int i = 0; i < usdLogConfig.numEventConfigs; ++i) {
+          if (usdLogConfig.eventConfigs[i].keyframeInterval > 0) {
+            useDeltaRecords = true;
+          }
+        }
+        uint16_t version = useDeltaRecords ? 3 : 2;
         usdWriteData(&version, sizeof(version));
 
         uint16_t numEventTypes = usdLogConfig.numEventConfigs;
@@ -896,6 +1296,10 @@ static void usdWriteTask(void* prm)
             numVariables += et->numPayloadVariables;
           }
           usdWriteData(&numVariables, sizeof(numVariables));
+          if (useDeltaRecords) {
+            uint8_t encoding = cfg->keyframeInterval > 0 ? 1 : 0;
+            usdWriteData(&encoding, sizeof(encoding));
+          }
           if (et) {
             for (int j = 0; j < et->numPayloadVariables; ++j) {
               usdWriteData(et->payloadDesc[j].name, strlen(et->payloadDesc[j].name));
@@ -971,6 +1375,9 @@ static void usdWriteTask(void* prm)
             }
             usdWriteData(&typeChar, 1);
             usdWriteData(")", 2);
+            if (cfg->keyframeInterval > 0) {
+              usdWriteData(&cfg->scales[j], sizeof(cfg->scales[j]));
+            }
           }
         }
 
@@ -978,28 +1385,40 @@ static void usdWriteTask(void* prm)
           /* sleep */
           vTaskSuspend(NULL);
 
-          // check if we have anything to write
-          xSemaphoreTake(logBufferMutex, portMAX_DELAY);
-          const uint8_t* buf;
-          uint16_t size;
-          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
-          xSemaphoreGive(logBufferMutex);
+          // move data into the staging block, the block is written to the
+          // card as soon as it is full
+          while (true) {
+            xSemaphoreTake(logBufferMutex, portMAX_DELAY);
+            const uint8_t* buf;
+            uint16_t size;
+            bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size,
+                                                blockWriter.capacity - blockWriter.fill);
+            xSemaphoreGive(logBufferMutex);
+
+            if (!hasData) {
+              break;
+            }
 
-          // execute the actual write operation
-          if (hasData) {
             usdWriteData(buf, size);
 
             xSemaphoreTake(logBufferMutex, portMAX_DELAY);
             ringBuffer_pop_done(&logBuffer);
             xSemaphoreGive(logBufferMutex);
           }
+
+#ifdef CONFIG_DECK_USD_TRAJECTORY_STREAM
+          if (trajRefillPending) {
+            trajRefillPending = false;
+            usdTrajectoryStreamRead();
+          }
+#endif
         }
         // write everything that's still in the buffer
         xSemaphoreTake(logBufferMutex, portMAX_DELAY);
         while (true) {
           const uint8_t *buf;
           uint16_t size;
-          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size);
+          bool hasData = ringBuffer_pop_start(&logBuffer, &buf, &size, logBuffer.capacity);
           if (hasData) {
             usdWriteData(buf, size);
             ringBuffer_pop_done(&logBuffer);
@@ -1012,6 +1431,12 @@ static void usdWriteTask(void* prm)
         // write CRC
         uint32_t crcValue = crc32Out(&crcContext);
         usdWriteData(&crcValue, sizeof(crcValue));
+        usdFlushBlock();
+
+#if CONFIG_DECK_USD_PREALLOCATE_KB > 0
+        // drop the unused part of the pre-allocated area
+        f_truncate(&logFile);
+#endif
 
         // close file
         f_close(&logFile);
@@ -1027,6 +1452,9 @@ static void usdWriteTask(void* prm)
           usdLogConfig.filename,
           usdLogStats.eventsWritten,
           usdLogStats.eventsRequested);
+        DEBUG_PRINT("%ld blocks, max write latency %ld us\n",
+          usdLogStats.blocksWritten,
+          usdLogStats.maxWriteLatency);
 
         xSemaphoreGive(logFileMutex);
       } else {
@@ -1125,4 +1553,20 @@ STATS_CNT_RATE_LOG_ADD(spiReBps, &spiReadRate)
  * @brief Data write rate to the SD card [bytes/s]
  */
 STATS_CNT_RATE_LOG_ADD(fatWrBps, &fatWriteRate)
+/**
+ * @brief Number of events requested to be logged since logging started
+ */
+LOG_ADD(LOG_UINT32, evReq, &usdLogStats.eventsRequested)
+/**
+ * @brief Number of events stored in the log buffer since logging started
+ */
+LOG_ADD(LOG_UINT32, evWr, &usdLogStats.eventsWritten)
+/**
+ * @brief Duration of the latest block write to the SD card [us]
+ */
+LOG_ADD(LOG_UINT32, wrLat, &usdLogStats.lastWriteLatency)
+/**
+ * @brief Worst case duration of a block write since logging started [us]
+ */
+LOG_ADD(LOG_UINT32, wrLatMax, &usdLogStats.maxWriteLatency)
 LOG_GROUP_STOP(usd)
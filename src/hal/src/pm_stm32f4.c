@@ -283,7 +283,7 @@ void pmSyslinkUpdate(SyslinkPacket *slp)
     temp = pmSyslinkInfo.temp;
 #endif
   } else if (slp->type == SYSLINK_PM_SHUTDOWN_REQUEST) {
-    workerSchedule(pmGracefulShutdown, NULL);
+    workerScheduleWithPriority(pmGracefulShutdown, NULL, WORKER_PRIORITY_HIGH, 0);
   }
 }
 
@@ -62,7 +62,6 @@
 #define SENSORS_STARTUP_TIME_MS         1000
 #define SENSORS_READ_BARO_HZ            50
 #define SENSORS_READ_MAG_HZ             20
-#define SENSORS_DELAY_BARO              (SENSORS_READ_RATE_HZ/SENSORS_READ_BARO_HZ)
 #define SENSORS_DELAY_MAG               (SENSORS_READ_RATE_HZ/SENSORS_READ_MAG_HZ)
 
 #define SENSORS_BMI088_GYRO_FS_CFG      BMI088_GYRO_RANGE_2000_DPS
@@ -73,6 +72,28 @@
 #define SENSORS_BMI088_G_PER_LSB_CFG    (2.0f * (float)SENSORS_BMI088_ACCEL_CFG) / 65536.0f
 #define SENSORS_BMI088_1G_IN_LSB        (65536 / SENSORS_BMI088_ACCEL_CFG / 2)
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+// The gyro runs at twice the read rate, the watermark interrupt paces the sensors task at SENSORS_READ_RATE_HZ.
+// The rate can not be lowered with a higher watermark, every sample releases one iteration of the stabilizer loop
+// (see sensorsBmi088Bmp388WaitDataReady()) which runs the estimator and the controllers at RATE_MAIN_LOOP.
+#define SENSORS_BMI088_GYRO_FIFO_ODR_HZ       2000
+#define SENSORS_BMI088_GYRO_FIFO_PERIOD_US    (1000000 / SENSORS_BMI088_GYRO_FIFO_ODR_HZ)
+#define SENSORS_BMI088_GYRO_FIFO_WATERMARK    (SENSORS_BMI088_GYRO_FIFO_ODR_HZ / SENSORS_READ_RATE_HZ)
+#define SENSORS_BMI088_GYRO_FIFO_MAX_FRAMES   6
+#define SENSORS_BMI088_GYRO_FIFO_FRAME_SIZE   6
+#define SENSORS_BMI088_GYRO_FIFO_STREAM_MODE  0x80
+#define SENSORS_BMI088_GYRO_FIFO_WM_ENABLE    0x88
+// The FIFO is drained if no watermark interrupt has been seen for this long
+#define SENSORS_BMI088_FIFO_TIMEOUT           M2T(3)
+
+// Room for 4 accel frames (1.6 frames arrive per read), a sensor time frame and the over-read marker
+#define SENSORS_BMI088_ACCEL_FIFO_READ_SIZE   33
+#define SENSORS_BMI088_ACCEL_FIFO_FRAME_SIZE  7
+#define SENSORS_BMI088_ACCEL_FIFO_FILTERED    0x80
+#define SENSORS_BMI088_ACCEL_FIFO_STREAM_MODE 0x02
+#define SENSORS_BMI088_ACCEL_FIFO_ACC_ENABLE  0x50
+#endif
+
 #define SENSORS_VARIANCE_MAN_TEST_TIMEOUT   M2T(1000) // Timeout in ms
 #define SENSORS_MAN_TEST_LEVEL_MAX          5.0f      // Max degrees off
 
@@ -145,7 +166,13 @@ static lpf2pData gyroLpf[3];
 static void applyAxis3fLpf(lpf2pData *data, Axis3f* in);
 
 static bool isBarometerPresent = false;
-static uint8_t baroMeasDelayMin = SENSORS_DELAY_BARO;
+
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+static uint8_t gyroFifoFrames;
+static uint8_t accelFifoFrames;
+static uint16_t gyroFifoOverruns;
+static uint16_t gyroFifoTimeouts;
+#endif
 
 // IMU alignment Euler angles
 static float imuPhi = IMU_PHI;
@@ -175,6 +202,7 @@ static void sensorsAlignToAirframe(Axis3f* in, Axis3f* out);
 static void sensorsAccAlignToGravity(Axis3f* in, Axis3f* out);
 
 STATIC_MEM_TASK_ALLOC(sensorsTask, SENSORS_TASK_STACKSIZE);
+STATIC_MEM_TASK_ALLOC(sensorsBaroTask, SENSORS_BARO_TASK_STACKSIZE);
 
 // Communication routines
 
@@ -241,6 +269,213 @@ static void sensorsAccelGet(Axis3i16* dataOut)
   bmi088_get_accel_data((struct bmi088_sensor_data*)dataOut, &bmi088Dev);
 }
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+static void sensorsFifoInit(void)
+{
+  uint8_t data;
+
+  /* Gyro: stream mode with an interrupt on INT3 when a read period worth of frames is available */
+  data = SENSORS_BMI088_GYRO_FIFO_WATERMARK;
+  bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_0_REG, &data, 1, &bmi088Dev);
+  data = SENSORS_BMI088_GYRO_FIFO_STREAM_MODE;
+  bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_1_REG, &data, 1, &bmi088Dev);
+  data = SENSORS_BMI088_GYRO_FIFO_WM_ENABLE;
+  bmi088_set_gyro_regs(BMI088_GYRO_INT_EN_REG, &data, 1, &bmi088Dev);
+  data = BMI088_GYRO_INT1_FIFO_MASK;
+  bmi088_set_gyro_regs(BMI088_GYRO_INT3_INT4_IO_MAP_REG, &data, 1, &bmi088Dev);
+  data = BMI088_GYRO_FIFO_EN_MASK;
+  bmi088_set_gyro_regs(BMI088_GYRO_INT_CTRL_REG, &data, 1, &bmi088Dev);
+
+  /* Accel: stream mode with filtered data at the full output data rate */
+  data = SENSORS_BMI088_ACCEL_FIFO_FILTERED;
+  bmi088_set_accel_regs(BMI088_ACCEL_FIFO_DOWN_REG, &data, 1, &bmi088Dev);
+  data = SENSORS_BMI088_ACCEL_FIFO_STREAM_MODE;
+  bmi088_set_accel_regs(BMI088_ACCEL_FIFO_CONFIG_0_REG, &data, 1, &bmi088Dev);
+  data = SENSORS_BMI088_ACCEL_FIFO_ACC_ENABLE;
+  bmi088_set_accel_regs(BMI088_ACCEL_FIFO_CONFIG_1_REG, &data, 1, &bmi088Dev);
+}
+
+static void sensorsAverageFrames(const Axis3i32* sum, uint8_t frames, Axis3i16* dataOut)
+{
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    // Round to nearest
+    int32_t half = (sum->axis[i] >= 0 ? frames : -frames) / 2;
+    dataOut->axis[i] = (sum->axis[i] + half) / frames;
+  }
+}
+
+static void sensorsGyroFifoSumFrames(const uint8_t* buffer, const uint8_t frames, Axis3i32* sum)
+{
+  for (uint8_t i = 0; i < frames; i++)
+  {
+    const uint8_t* frame = &buffer[i * SENSORS_BMI088_GYRO_FIFO_FRAME_SIZE];
+    sum->x += (int16_t)((frame[1] << 8) | frame[0]);
+    sum->y += (int16_t)((frame[3] << 8) | frame[2]);
+    sum->z += (int16_t)((frame[5] << 8) | frame[4]);
+  }
+}
+
+/**
+ * Reads the watermark frames that raised the interrupt in one burst and averages them. The FIFO is
+ * below the watermark after the read, which lets the sensor raise the next interrupt.
+ */
+static uint8_t sensorsGyroFifoGet(Axis3i16* dataOut)
+{
+  uint8_t buffer[SENSORS_BMI088_GYRO_FIFO_WATERMARK * SENSORS_BMI088_GYRO_FIFO_FRAME_SIZE];
+  Axis3i32 sum = {.x = 0, .y = 0, .z = 0};
+
+  bmi088_get_gyro_regs(BMI088_GYRO_FIFO_DATA_REG, buffer, sizeof(buffer), &bmi088Dev);
+  sensorsGyroFifoSumFrames(buffer, SENSORS_BMI088_GYRO_FIFO_WATERMARK, &sum);
+  sensorsAverageFrames(&sum, SENSORS_BMI088_GYRO_FIFO_WATERMARK, dataOut);
+
+  return SENSORS_BMI088_GYRO_FIFO_WATERMARK;
+}
+
+/**
+ * Reads all frames in the gyro FIFO and averages them. The watermark interrupt is edge triggered on
+ * the MCU side, if an edge is missed the FIFO stays above the watermark and no more interrupts are
+ * raised until it has been drained.
+ * Keeps the previous value of dataOut if there are no frames.
+ */
+static uint8_t sensorsGyroFifoDrain(Axis3i16* dataOut)
+{
+  uint8_t buffer[SENSORS_BMI088_GYRO_FIFO_MAX_FRAMES * SENSORS_BMI088_GYRO_FIFO_FRAME_SIZE];
+  Axis3i32 sum = {.x = 0, .y = 0, .z = 0};
+  uint8_t total = 0;
+  uint8_t available;
+
+  do
+  {
+    uint8_t status = 0;
+    bmi088_get_gyro_regs(BMI088_GYRO_FIFO_STAT_REG, &status, 1, &bmi088Dev);
+    if (status & BMI088_GYRO_FIFO_OVERRUN_MASK)
+    {
+      // Setting the mode clears the FIFO and the overrun flag, the lost frames can not be recovered
+      uint8_t mode = SENSORS_BMI088_GYRO_FIFO_STREAM_MODE;
+      bmi088_set_gyro_regs(BMI088_GYRO_FIFO_CONFIG_1_REG, &mode, 1, &bmi088Dev);
+      gyroFifoOverruns++;
+      break;
+    }
+
+    available = status & BMI088_GYRO_FIFO_COUNTER_MASK;
+    uint8_t frames = available < SENSORS_BMI088_GYRO_FIFO_MAX_FRAMES ? available : SENSORS_BMI088_GYRO_FIFO_MAX_FRAMES;
+    if (frames == 0)
+    {
+      break;
+    }
+
+    bmi088_get_gyro_regs(BMI088_GYRO_FIFO_DATA_REG, buffer, frames * SENSORS_BMI088_GYRO_FIFO_FRAME_SIZE, &bmi088Dev);
+    sensorsGyroFifoSumFrames(buffer, frames, &sum);
+    total += frames;
+  } while (available > SENSORS_BMI088_GYRO_FIFO_MAX_FRAMES);
+
+  if (total > 0)
+  {
+    sensorsAverageFrames(&sum, total, dataOut);
+  }
+
+  return total;
+}
+
+/**
+ * Reads the accel FIFO in one burst and averages the frames. Reading past the fill level returns the
+ * over-read header, a frame that does not fit in the burst is kept by the sensor for the next read.
+ * Keeps the previous value of dataOut if there are no frames.
+ */
+static uint8_t sensorsAccelFifoGet(Axis3i16* dataOut)
+{
+  uint8_t buffer[SENSORS_BMI088_ACCEL_FIFO_READ_SIZE];
+  Axis3i32 sum = {.x = 0, .y = 0, .z = 0};
+  uint8_t frames = 0;
+  uint8_t index = 0;
+  bool done = false;
+
+  bmi088_get_accel_regs(BMI088_ACCEL_FIFO_DATA_REG, buffer, sizeof(buffer), &bmi088Dev);
+
+  while (!done && index < sizeof(buffer))
+  {
+    switch (buffer[index] & BMI088_FIFO_TAG_INTR_MASK)
+    {
+      case FIFO_HEAD_A:
+        if (index + SENSORS_BMI088_ACCEL_FIFO_FRAME_SIZE > SENSORS_BMI088_ACCEL_FIFO_READ_SIZE)
+        {
+          done = true;
+          break;
+        }
+        sum.x += (int16_t)((buffer[index + 2] << 8) | buffer[index + 1]);
+        sum.y += (int16_t)((buffer[index + 4] << 8) | buffer[index + 3]);
+        sum.z += (int16_t)((buffer[index + 6] << 8) | buffer[index + 5]);
+        frames++;
+        index += SENSORS_BMI088_ACCEL_FIFO_FRAME_SIZE;
+        break;
+      case FIFO_HEAD_SENSOR_TIME:
+        index += 4;
+        break;
+      case FIFO_HEAD_SKIP_FRAME:
+      case FIFO_HEAD_INPUT_CONFIG:
+      case FIFO_HEAD_SAMPLE_DROP:
+        index += 2;
+        break;
+      default:
+        // Over-read, the FIFO is empty
+        done = true;
+        break;
+    }
+  }
+
+  if (frames > 0)
+  {
+    sensorsAverageFrames(&sum, frames, dataOut);
+  }
+
+  return frames;
+}
+
+/**
+ * The time of the averaged gyro frames. The watermark interrupt is raised when the last of the
+ * watermark frames is written, frames beyond it arrived after the interrupt.
+ */
+static uint64_t sensorsFifoSampleTimestamp(const uint64_t interruptTimestamp, const uint8_t frames)
+{
+  if (frames == 0)
+  {
+    return interruptTimestamp;
+  }
+
+  const int32_t newestOffset = ((int32_t)frames - SENSORS_BMI088_GYRO_FIFO_WATERMARK) * SENSORS_BMI088_GYRO_FIFO_PERIOD_US;
+  const int32_t meanOffset = newestOffset - ((int32_t)frames - 1) * SENSORS_BMI088_GYRO_FIFO_PERIOD_US / 2;
+  return interruptTimestamp + meanOffset;
+}
+
+/**
+ * Waits for the gyro FIFO watermark interrupt and reads the averaged samples of both sensors. One
+ * burst per sensor is read, the FIFO status is only read when draining after a missed interrupt.
+ * Returns false if there were no gyro frames.
+ */
+static bool sensorsFifoWaitAndRead(void)
+{
+  if (pdTRUE == xSemaphoreTake(sensorsDataReady, SENSORS_BMI088_FIFO_TIMEOUT))
+  {
+    gyroFifoFrames = sensorsGyroFifoGet(&gyroRaw);
+    sensorData.interruptTimestamp = sensorsFifoSampleTimestamp(imuIntTimestamp, gyroFifoFrames);
+  }
+  else
+  {
+    gyroFifoTimeouts++;
+    gyroFifoFrames = sensorsGyroFifoDrain(&gyroRaw);
+    // The newest frame was just written
+    const uint64_t now = usecTimestamp();
+    const uint32_t meanAge = gyroFifoFrames > 0 ? (gyroFifoFrames - 1) * SENSORS_BMI088_GYRO_FIFO_PERIOD_US / 2 : 0;
+    sensorData.interruptTimestamp = now - meanAge;
+  }
+
+  accelFifoFrames = sensorsAccelFifoGet(&accelRaw);
+
+  return gyroFifoFrames > 0;
+}
+#endif
+
 static void sensorsScaleBaro(baro_t* baroScaled, float pressure,
                              float temperature)
 {
@@ -291,13 +526,17 @@ static void sensorsTask(void *param)
   Axis3f gyroScaledIMU;
   Axis3f accScaledIMU;
   Axis3f accScaled;
-  measurement_t measurement;
   /* wait an additional second the keep bus free
    * this is only required by the z-ranger, since the
    * configuration will be done after system start-up */
   //vTaskDelayUntil(&lastWakeTime, M2T(1500));
   while (1)
   {
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+    /* get the samples since the last read, averaged */
+    if (sensorsFifoWaitAndRead())
+    {
+#else
     if (pdTRUE == xSemaphoreTake(sensorsDataReady, portMAX_DELAY))
     {
       sensorData.interruptTimestamp = imuIntTimestamp;
@@ -305,6 +544,7 @@ static void sensorsTask(void *param)
       /* get data from chosen sensors */
       sensorsGyroGet(&gyroRaw);
       sensorsAccelGet(&accelRaw);
+#endif
 
       /* calibrate if necessary */
 #ifdef GYRO_BIAS_LIGHT_WEIGHT
@@ -324,10 +564,6 @@ static void sensorsTask(void *param)
       sensorsAlignToAirframe(&gyroScaledIMU, &sensorData.gyro);
       applyAxis3fLpf((lpf2pData*)(&gyroLpf), &sensorData.gyro);
 
-      measurement.type = MeasurementTypeGyroscope;
-      measurement.data.gyroscope.gyro = sensorData.gyro;
-      estimatorEnqueue(&measurement);
-
       /* Acelerometer */
       accScaledIMU.x = accelRaw.x * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
       accScaledIMU.y = accelRaw.y * SENSORS_BMI088_G_PER_LSB_CFG / accScale;
@@ -336,38 +572,43 @@ static void sensorsTask(void *param)
       sensorsAccAlignToGravity(&accScaled, &sensorData.acc);
       applyAxis3fLpf((lpf2pData*)(&accLpf), &sensorData.acc);
 
-      measurement.type = MeasurementTypeAcceleration;
-      measurement.data.acceleration.acc = sensorData.acc;
-      estimatorEnqueue(&measurement);
+      estimatorEnqueueImu(&sensorData.gyro, &sensorData.acc);
     }
 
-    if (isBarometerPresent)
-    {
-      static uint8_t baroMeasDelay = SENSORS_DELAY_BARO;
-      if (--baroMeasDelay == 0)
-      {
-        uint8_t sensor_comp = BMP3_PRESS | BMP3_TEMP;
-        struct bmp3_data data;
-        baro_t* baro388 = &sensorData.baro;
-        /* Temperature and Pressure data are read and stored in the bmp3_data instance */
-        bmp3_get_sensor_data(sensor_comp, &data, &bmp388Dev);
-        sensorsScaleBaro(baro388, data.pressure, data.temperature);
-
-        measurement.type = MeasurementTypeBarometer;
-        measurement.data.barometer.baro = sensorData.baro;
-        estimatorEnqueue(&measurement);
-
-        baroMeasDelay = baroMeasDelayMin;
-      }
-    }
     xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
     xQueueOverwrite(gyroDataQueue, &sensorData.gyro);
-    if (isBarometerPresent)
+
+    xSemaphoreGive(dataReady);
+  }
+}
+
+/*
+ * The barometer is read in its own task with a lower priority than the sensors task, the
+ * I2C transfers then never delay the IMU samples that pace the stabilizer.
+ */
+static void sensorsBaroTask(void *param)
+{
+  systemWaitStart();
+
+  measurement_t measurement = {0};
+  measurement.type = MeasurementTypeBarometer;
+  TickType_t lastWakeTime = xTaskGetTickCount();
+
+  while (1)
+  {
+    vTaskDelayUntil(&lastWakeTime, F2T(SENSORS_READ_BARO_HZ));
+
+    uint8_t sensor_comp = BMP3_PRESS | BMP3_TEMP;
+    struct bmp3_data data;
+    /* Temperature and Pressure data are read and stored in the bmp3_data instance */
+    if (bmp3_get_sensor_data(sensor_comp, &data, &bmp388Dev) != BMP3_OK)
     {
-      xQueueOverwrite(barometerDataQueue, &sensorData.baro);
+      continue;
     }
+    sensorsScaleBaro(&measurement.data.barometer.baro, data.pressure, data.temperature);
 
-    xSemaphoreGive(dataReady);
+    estimatorEnqueue(&measurement);
+    xQueueOverwrite(barometerDataQueue, &measurement.data.barometer.baro);
   }
 }
 
@@ -403,9 +644,14 @@ static void sensorsDeviceInit(void)
     bmi088Dev.gyro_cfg.power = BMI088_GYRO_PM_NORMAL;
     rslt |= bmi088_set_gyro_power_mode(&bmi088Dev);
     /* set bandwidth and range of gyro */
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+    bmi088Dev.gyro_cfg.bw = BMI088_GYRO_BW_230_ODR_2000_HZ;
+    bmi088Dev.gyro_cfg.odr = BMI088_GYRO_BW_230_ODR_2000_HZ;
+#else
     bmi088Dev.gyro_cfg.bw = BMI088_GYRO_BW_116_ODR_1000_HZ;
-    bmi088Dev.gyro_cfg.range = SENSORS_BMI088_GYRO_FS_CFG;
     bmi088Dev.gyro_cfg.odr = BMI088_GYRO_BW_116_ODR_1000_HZ;
+#endif
+    bmi088Dev.gyro_cfg.range = SENSORS_BMI088_GYRO_FS_CFG;
     rslt |= bmi088_set_gyro_meas_conf(&bmi088Dev);
 
     intConfig.gyro_int_channel = BMI088_INT_CHANNEL_3;
@@ -449,6 +695,10 @@ static void sensorsDeviceInit(void)
 
     struct bmi088_sensor_data acc;
     rslt |= bmi088_get_accel_data(&acc, &bmi088Dev);
+
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+    sensorsFifoInit();
+#endif
   }
   else
   {
@@ -509,7 +759,6 @@ static void sensorsDeviceInit(void)
 
     /* Print the temperature and pressure data */
 //    DEBUG_PRINT("BMP388 T:%0.2f  P:%0.2f\n",data.temperature, data.pressure/100.0f);
-    baroMeasDelayMin = SENSORS_DELAY_BARO;
   }
   else
   {
@@ -543,6 +792,10 @@ static void sensorsTaskInit(void)
   barometerDataQueue = STATIC_MEM_QUEUE_CREATE(barometerDataQueue);
 
   STATIC_MEM_TASK_CREATE(sensorsTask, sensorsTask, SENSORS_TASK_NAME, NULL, SENSORS_TASK_PRI);
+  if (isBarometerPresent)
+  {
+    STATIC_MEM_TASK_CREATE(sensorsBaroTask, sensorsBaroTask, SENSORS_BARO_TASK_NAME, NULL, SENSORS_BARO_TASK_PRI);
+  }
 }
 
 static void sensorsInterruptInit(void)
@@ -995,6 +1248,27 @@ LOG_ADD(LOG_FLOAT, zVariance, &gyroBiasRunning.variance.z)
 LOG_GROUP_STOP(gyro)
 #endif
 
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+LOG_GROUP_START(imuFifo)
+/**
+ * @brief Number of gyro frames averaged into the latest sample
+ */
+LOG_ADD(LOG_UINT8, gyroFrames, &gyroFifoFrames)
+/**
+ * @brief Number of accelerometer frames averaged into the latest sample
+ */
+LOG_ADD(LOG_UINT8, accFrames, &accelFifoFrames)
+/**
+ * @brief Number of times the gyro FIFO overflowed and was cleared
+ */
+LOG_ADD(LOG_UINT16, gyroOvr, &gyroFifoOverruns)
+/**
+ * @brief Number of times the gyro FIFO was drained after a missed watermark interrupt
+ */
+LOG_ADD(LOG_UINT16, gyroTmo, &gyroFifoTimeouts)
+LOG_GROUP_STOP(imuFifo)
+#endif
+
 PARAM_GROUP_START(imu_sensors)
 
 /**
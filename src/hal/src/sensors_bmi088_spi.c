@@ -40,7 +40,12 @@
 
 /* Defines and buffers for full duplex SPI DMA transactions */
 /* The buffers must not be placed in CCM */
+#ifdef CONFIG_SENSORS_BMI088_FIFO
+// Room for the accelerometer FIFO burst (SENSORS_BMI088_ACCEL_FIFO_READ_SIZE) and its dummy byte
+#define SPI_MAX_DMA_TRANSACTION_SIZE    40
+#else
 #define SPI_MAX_DMA_TRANSACTION_SIZE    15
+#endif
 static uint8_t spiTxBuffer[SPI_MAX_DMA_TRANSACTION_SIZE + 1];
 static uint8_t spiRxBuffer[SPI_MAX_DMA_TRANSACTION_SIZE + 1];
 static xSemaphoreHandle spiTxDMAComplete;
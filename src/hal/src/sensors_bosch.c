@@ -485,7 +485,7 @@ sensorsAccelCalibrate(BiasObj* accel, BiasObj* gyro, uint8_t type) {
 
 static void sensorsTask(void *param)
 {
-  measurement_t measurement;
+  measurement_t measurement = {0};
 
   systemWaitStart();
 
@@ -656,14 +656,8 @@ static void sensorsTask(void *param)
             }
         }
 
-      measurement.type = MeasurementTypeAcceleration;
-      measurement.data.acceleration.acc = sensors.acc;
-      estimatorEnqueue(&measurement);
+      estimatorEnqueueImu(&sensors.gyro, &sensors.acc);
       xQueueOverwrite(accelPrimDataQueue, &sensors.acc);
-
-      measurement.type = MeasurementTypeGyroscope;
-      measurement.data.gyroscope.gyro = sensors.gyro;
-      estimatorEnqueue(&measurement);
       xQueueOverwrite(gyroPrimDataQueue, &sensors.gyro);
 
 #ifdef LOG_SEC_IMU
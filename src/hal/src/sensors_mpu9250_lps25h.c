@@ -215,7 +215,7 @@ bool sensorsMpu9250Lps25hAreCalibrated() {
 
 static void sensorsTask(void *param)
 {
-  measurement_t measurement;
+  measurement_t measurement = {0};
 
   systemWaitStart();
 
@@ -244,14 +244,8 @@ static void sensorsTask(void *param)
                   SENSORS_MPU6500_BUFF_LEN + SENSORS_MAG_BUFF_LEN : SENSORS_MPU6500_BUFF_LEN]));
       }
 
-      measurement.type = MeasurementTypeAcceleration;
-      measurement.data.acceleration.acc = sensorData.acc;
-      estimatorEnqueue(&measurement);
+      estimatorEnqueueImu(&sensorData.gyro, &sensorData.acc);
       xQueueOverwrite(accelerometerDataQueue, &sensorData.acc);
-
-      measurement.type = MeasurementTypeGyroscope;
-      measurement.data.gyroscope.gyro = sensorData.gyro;
-      estimatorEnqueue(&measurement);
       xQueueOverwrite(gyroDataQueue, &sensorData.gyro);
       if (isMagnetometerPresent)
       {
@@ -0,0 +1,65 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2024 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * asset_storage.h - Persistent storage of show assets in internal flash
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Initialize the asset storage and validate the content of the flash region.
+ */
+void assetStorageInit(void);
+
+/**
+ * Test the asset storage.
+ */
+bool assetStorageTest(void);
+
+/**
+ * @brief Get a pointer to the stored assets. The data is memory mapped flash
+ * and can be used in place, it stays valid until a new upload is started,
+ * which is not possible while flying.
+ *
+ * @return Pointer to the assets, NULL if no valid assets are stored
+ */
+const uint8_t* assetStorageData(void);
+
+/**
+ * @brief Get the length of the stored assets
+ *
+ * @return Length of the stored assets in bytes, 0 if no valid assets are stored
+ */
+uint32_t assetStorageLength(void);
+
+/**
+ * @brief Get the content hash (CRC32) of the stored assets. Clients can
+ * compare it to the hash of the data they are about to upload and skip the
+ * upload if they match.
+ *
+ * @return The CRC32 of the stored assets, 0 if no valid assets are stored
+ */
+uint32_t assetStorageHash(void);
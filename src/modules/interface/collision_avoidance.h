@@ -80,6 +80,12 @@ typedef struct collision_avoidance_params_s
   // If negative, never ignore.
   int maxPeerLocAgeMillis;
 
+  // Peer positions are extrapolated to the current time with their estimated
+  // velocity, but by no more than this duration. This allows a lower rate of
+  // peer localization measurements for the same safety margin. If zero, the
+  // last measured positions are used.
+  int maxPeerPredictionMillis;
+
   // Tolerance for projecting position vectors into our Voronoi cell. Units are
   // roughly Euclidean distance in meters, but not exactly.
   //
@@ -225,6 +225,30 @@ int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crt
  */
 uint32_t crtpCommanderHighLevelTrajectoryMemSize();
 
+/**
+ * @brief Define a trajectory that is stored in the show assets in flash.
+ *        The trajectory is executed in place from flash and the assets
+ *        survive resets, so only the definition has to be repeated after a
+ *        restart.
+ *
+ * @param trajectoryId The id of the trajectory
+ * @param type         The type of trajectory that is stored in flash.
+ * @param offset       offset in the stored assets (bytes)
+ * @param nPieces      Nr of pieces in the trajectory
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelDefineTrajectoryInFlash(const uint8_t trajectoryId, const crtpCommanderTrajectoryType_t type, const uint32_t offset, const uint8_t nPieces);
+
+/**
+ * @brief Define a compressed trajectory that is streamed through the
+ *        trajectory stream. Restarts the stream from offset zero, fails if a
+ *        streamed trajectory is currently executed.
+ *
+ * @param trajectoryId The id of the trajectory
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelDefineTrajectoryStream(const uint8_t trajectoryId);
+
 /**
  * @brief Copy trajectory data to the trajectory memeory. After the copy crtpCommanderHighLevelDefineTrajectory()
  *        must be called before the trajectory can be used.
@@ -249,6 +273,41 @@ bool crtpCommanderHighLevelWriteTrajectory(const uint32_t offset, const uint32_t
  */
 bool crtpCommanderHighLevelReadTrajectory(const uint32_t offset, const uint32_t length, uint8_t* destination);
 
+/**
+ * @brief Append data to the trajectory stream. Streamed trajectories are
+ *        defined with crtpCommanderHighLevelDefineTrajectoryStream() and are
+ *        consumed while they are executed, so data can be appended during
+ *        the flight as long as there is free space in the stream.
+ *
+ * @param offset    absolute stream offset of the data, must match the current write offset
+ * @param length    Length of the data (bytes) to append
+ * @param data[in]  pointer to the trajectory data source
+ *
+ * @return true   If data was appended
+ * @return false  If the offset does not match or there is not enough free space
+ */
+bool crtpCommanderHighLevelWriteTrajectoryStream(const uint32_t offset, const uint32_t length, const uint8_t* data);
+
+/**
+ * @brief Get the absolute stream offset where the next write to the trajectory stream is expected
+ */
+uint32_t crtpCommanderHighLevelTrajectoryStreamWriteOffset();
+
+/**
+ * @brief Get the number of bytes that can currently be appended to the trajectory stream
+ */
+uint32_t crtpCommanderHighLevelTrajectoryStreamFree();
+
+/**
+ * @brief Register a function that refills the trajectory stream. The function
+ *        is executed by the worker task when the stream is defined and
+ *        whenever the buffered data runs low while a streamed trajectory is
+ *        executed. It must not block for long.
+ *
+ * @param refill  refill function, NULL to unregister
+ */
+void crtpCommanderHighLevelSetTrajectoryStreamSource(void (*refill)(void*));
+
 /**
  * @brief Query if the current trajectory has finished
  *
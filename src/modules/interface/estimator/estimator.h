@@ -27,6 +27,7 @@
 
 #include "autoconf.h"
 #include "stabilizer_types.h"
+#include "imuChannel.h"
 
 typedef enum {
   StateEstimatorTypeAutoSelect = 0,
@@ -53,14 +54,18 @@ typedef enum {
   MeasurementTypeFlow,
   MeasurementTypeYawError,
   MeasurementTypeSweepAngle,
-  MeasurementTypeGyroscope,
-  MeasurementTypeAcceleration,
+  MeasurementTypeGyroscope,     // Not queued, see estimatorEnqueueImu()
+  MeasurementTypeAcceleration,  // Not queued, see estimatorEnqueueImu()
   MeasurementTypeBarometer,
+  MeasurementTypeTDOABatch,
 } MeasurementType;
 
 typedef struct
 {
   MeasurementType type;
+  // Time (ms, system clock) the measurement refers to, or 0 if it is current.
+  // Late measurements may be fused at this time by estimators that support it.
+  uint32_t timestamp;
   union
   {
     tdoaMeasurement_t tdoa;
@@ -75,6 +80,9 @@ typedef struct
     gyroscopeMeasurement_t gyroscope;
     accelerationMeasurement_t acceleration;
     barometerMeasurement_t barometer;
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+    tdoaBatchMeasurement_t tdoaBatch;
+#endif
   } data;
 } measurement_t;
 
@@ -93,14 +101,36 @@ static inline void estimatorEnqueueTDOA(const tdoaMeasurement_t *tdoa)
 {
   measurement_t m;
   m.type = MeasurementTypeTDOA;
+  m.timestamp = 0;
   m.data.tdoa = *tdoa;
   estimatorEnqueue(&m);
 }
 
+static inline void estimatorEnqueueTDOAAt(const tdoaMeasurement_t *tdoa, const uint32_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeTDOA;
+  m.timestamp = timestamp;
+  m.data.tdoa = *tdoa;
+  estimatorEnqueue(&m);
+}
+
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+static inline void estimatorEnqueueTDOABatchAt(const tdoaBatchMeasurement_t *tdoaBatch, const uint32_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeTDOABatch;
+  m.timestamp = timestamp;
+  m.data.tdoaBatch = *tdoaBatch;
+  estimatorEnqueue(&m);
+}
+#endif
+
 static inline void estimatorEnqueuePosition(const positionMeasurement_t *position)
 {
   measurement_t m;
   m.type = MeasurementTypePosition;
+  m.timestamp = 0;
   m.data.position = *position;
   estimatorEnqueue(&m);
 }
@@ -109,6 +139,16 @@ static inline void estimatorEnqueuePose(const poseMeasurement_t *pose)
 {
   measurement_t m;
   m.type = MeasurementTypePose;
+  m.timestamp = 0;
+  m.data.pose = *pose;
+  estimatorEnqueue(&m);
+}
+
+static inline void estimatorEnqueuePoseAt(const poseMeasurement_t *pose, const uint32_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypePose;
+  m.timestamp = timestamp;
   m.data.pose = *pose;
   estimatorEnqueue(&m);
 }
@@ -117,6 +157,7 @@ static inline void estimatorEnqueueDistance(const distanceMeasurement_t *distanc
 {
   measurement_t m;
   m.type = MeasurementTypeDistance;
+  m.timestamp = 0;
   m.data.distance = *distance;
   estimatorEnqueue(&m);
 }
@@ -125,6 +166,7 @@ static inline void estimatorEnqueueTOF(const tofMeasurement_t *tof)
 {
   measurement_t m;
   m.type = MeasurementTypeTOF;
+  m.timestamp = 0;
   m.data.tof = *tof;
   estimatorEnqueue(&m);
 }
@@ -133,6 +175,7 @@ static inline void estimatorEnqueueAbsoluteHeight(const heightMeasurement_t *hei
 {
   measurement_t m;
   m.type = MeasurementTypeAbsoluteHeight;
+  m.timestamp = 0;
   m.data.height = *height;
   estimatorEnqueue(&m);
 }
@@ -141,6 +184,16 @@ static inline void estimatorEnqueueFlow(const flowMeasurement_t *flow)
 {
   measurement_t m;
   m.type = MeasurementTypeFlow;
+  m.timestamp = 0;
+  m.data.flow = *flow;
+  estimatorEnqueue(&m);
+}
+
+static inline void estimatorEnqueueFlowAt(const flowMeasurement_t *flow, const uint32_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeFlow;
+  m.timestamp = timestamp;
   m.data.flow = *flow;
   estimatorEnqueue(&m);
 }
@@ -149,6 +202,7 @@ static inline void estimatorEnqueueYawError(const yawErrorMeasurement_t *yawErro
 {
   measurement_t m;
   m.type = MeasurementTypeYawError;
+  m.timestamp = 0;
   m.data.yawError = *yawError;
   estimatorEnqueue(&m);
 }
@@ -157,12 +211,26 @@ static inline void estimatorEnqueueSweepAngles(const sweepAngleMeasurement_t *sw
 {
   measurement_t m;
   m.type = MeasurementTypeSweepAngle;
+  m.timestamp = 0;
   m.data.sweepAngle = *sweepAngle;
   estimatorEnqueue(&m);
 }
 
+static inline void estimatorEnqueueSweepAnglesAt(const sweepAngleMeasurement_t *sweepAngle, const uint32_t timestamp)
+{
+  measurement_t m;
+  m.type = MeasurementTypeSweepAngle;
+  m.timestamp = timestamp;
+  m.data.sweepAngle = *sweepAngle;
+  estimatorEnqueue(&m);
+}
+
+// IMU samples bypass the measurement queue, see imuChannel.h
+void estimatorEnqueueImu(const Axis3f *gyro, const Axis3f *acc);
+
 // Helper function for state estimators
 bool estimatorDequeue(measurement_t *measurement);
+bool estimatorDequeueImu(imuSample_t *sample);
 
 #ifdef CONFIG_ESTIMATOR_OOT
 void estimatorOutOfTreeInit(void);
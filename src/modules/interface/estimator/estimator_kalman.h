@@ -69,3 +69,8 @@ void estimatorKalmanGetEstimatedPos(point_t* pos);
  * Copies 9 floats representing the current state rotation matrix
  */
 void estimatorKalmanGetEstimatedRot(float * rotationMatrix);
+
+/**
+ * Copies 9 floats representing the covariance of the current position estimate
+ */
+void estimatorKalmanGetEstimatedPosCovariance(float * covariance);
@@ -0,0 +1,85 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "imu_types.h"
+
+// Number of IMU samples that can be buffered between two estimator updates, must be a power of two
+#define IMU_CHANNEL_SIZE 32
+
+typedef struct {
+  Axis3f gyro;
+  Axis3f acc;
+} imuSample_t;
+
+/**
+ * Single producer, single consumer ring of IMU samples. The producer never waits for the consumer,
+ * the oldest samples are overwritten if the consumer falls behind. Neither side uses locks, a
+ * sample that is overwritten while the consumer reads it is detected and skipped.
+ */
+typedef struct {
+  imuSample_t samples[IMU_CHANNEL_SIZE];
+  // Written by the producer only
+  volatile uint32_t head;
+  // Written by the consumer only
+  uint32_t tail;
+  uint32_t dropped;
+} imuChannel_t;
+
+/**
+ * @brief Initialize an empty channel
+ *
+ * @param this  Pointer to the channel
+ */
+void imuChannelInit(imuChannel_t* this);
+
+/**
+ * @brief Add a sample, called by the producer
+ *
+ * @param this  Pointer to the channel
+ * @param gyro  Gyroscope sample
+ * @param acc  Accelerometer sample
+ */
+void imuChannelPut(imuChannel_t* this, const Axis3f* gyro, const Axis3f* acc);
+
+/**
+ * @brief Get the oldest sample that has not been read yet, called by the consumer
+ *
+ * @param this  Pointer to the channel
+ * @param sample  Pointer to where the sample is stored
+ * @return true  If a sample was read
+ * @return false  If there are no new samples
+ */
+bool imuChannelGet(imuChannel_t* this, imuSample_t* sample);
+
+/**
+ * @brief Skip all samples that have not been read yet, called by the consumer
+ *
+ * @param this  Pointer to the channel
+ */
+void imuChannelFlush(imuChannel_t* this);
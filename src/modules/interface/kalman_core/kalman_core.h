@@ -167,4 +167,40 @@ void kalmanCoreDecoupleXY(kalmanCoreData_t* this);
 
 void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise);
 
-void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, arm_matrix_instance_f32 *Km, arm_matrix_instance_f32 *P_w_m, float error);
+// The maximum number of rows in a batch update
+#define KC_BATCH_UPDATE_MAX_ROWS 4
+
+/**
+ * @brief Update the state with several measurements in one step
+ *
+ * @param this Core data
+ * @param Hm The measurement matrix, one row per measurement and KC_STATE_DIM columns
+ * @param errors The innovation (measured - predicted) of each measurement
+ * @param Rm The measurement noise covariance, square with one row per measurement
+ */
+void kalmanCoreBatchUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *errors, arm_matrix_instance_f32 *Rm);
+
+/**
+ * @brief Measurement model of a scalar measurement of the position, used by the robust update
+ *
+ * @param position The position to linearize around
+ * @param measurement The measurement data
+ * @param predicted Set to the predicted measurement at the position
+ * @param h Set to the derivative of the measurement with respect to the position
+ * @return false if the measurement can not be linearized around the position
+ */
+typedef bool (*kalmanCoreRobustModel_t)(const float position[3], const void* measurement, float* predicted, float h[3]);
+
+/**
+ * @brief M-estimation based robust update with a scalar measurement of the position. The measurement and the
+ * state errors are reweighted with Geman-McClure weights, iterating until the weights settle.
+ *
+ * @param this Core data
+ * @param model The measurement model
+ * @param measurement The measurement data, passed to the model
+ * @param measured The measured value
+ * @param stdDev The standard deviation of the measurement noise
+ * @param sigmaMeasurement The sigma of the weight function of the measurement error
+ * @param sigmaState The sigma of the weight function of the state error
+ */
+void kalmanCoreRobustScalarUpdate(kalmanCoreData_t* this, kalmanCoreRobustModel_t model, const void* measurement, const float measured, const float stdDev, const float sigmaMeasurement, const float sigmaState);
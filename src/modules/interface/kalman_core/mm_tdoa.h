@@ -30,3 +30,6 @@
 
 // Measurements of a UWB Tx/Rx
 void kalmanCoreUpdateWithTdoa(kalmanCoreData_t* this, tdoaMeasurement_t *tdoa, const uint32_t nowMs, OutlierFilterTdoaState_t* outlierFilterState);
+
+// Measurements of a UWB Tx/Rx paired with several remote anchors, fused in one update
+void kalmanCoreUpdateWithTdoaBatch(kalmanCoreData_t* this, tdoaBatchMeasurement_t *tdoaBatch, const uint32_t nowMs, OutlierFilterTdoaState_t* outlierFilterState);
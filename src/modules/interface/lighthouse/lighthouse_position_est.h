@@ -48,5 +48,12 @@ void lighthousePositionSetGeometryData(const uint8_t baseStation, const baseStat
  */
 void lighthousePositionCalibrationDataWritten(const uint8_t baseStation);
 
+/**
+ * @brief Get the standard deviation of LH2 sweep angle measurements, as sent to the estimator
+ *
+ * @return float The standard deviation (radians)
+ */
+float lighthousePositionGetSweepStdLh2();
+
 void lighthousePositionEstimatePoseCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation1, int baseStation2);
 void lighthousePositionEstimatePoseSweeps(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation);
@@ -27,16 +27,23 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include "lighthouse_geometry.h"
+#include "pulse_processor.h"
 
 /**
  * @brief Throttles how much of the data from lighthouse base stations that is used. When multiple base stations
  * are received, pushing all the data to the estimator is nor necessary and it increases the risk of overloading
  * the system.
  *
- * This function tries to limit the rate of the samples used by randomly discarding samples when needed.
+ * When the rate must be limited, the samples are scored by the expected information gain, based on the current
+ * position covariance of the kalman estimator and the direction and distance to the base station. The samples from
+ * the best base stations are used, within the rate budget. With other estimators the base stations take turns.
  *
  * @param now_ms The current time in ms
+ * @param baseStation The base station the sample comes from
+ * @param geometry The geometry of the base station
+ * @param measurement The sweeps from the base station
  * @return true   If the sample is to be used
  * @return false  If the sample should be discarded
  */
-bool throttleLh2Samples(const uint32_t now_ms);
+bool throttleLh2Samples(const uint32_t now_ms, const int baseStation, const baseStationGeometry_t* geometry, const pulseProcessorBaseStationMeasurement_t* measurement);
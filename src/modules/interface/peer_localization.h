@@ -20,15 +20,24 @@ void peerLocalizationInit();
 bool peerLocalizationTest();
 
 typedef struct peerLocalizationOtherPosition_s {
-  uint8_t id;  // CF id
-  point_t pos; // position and timestamp (millisecs)
+  uint8_t id;       // CF id
+  point_t pos;      // position and timestamp (millisecs)
+  velocity_t vel;   // velocity (m/s), estimated from consecutive positions
+  bool hasVel;      // true if vel is valid
 } peerLocalizationOtherPosition_t;
 
 // Tell the peer localization system the position of another Crazyflie.
 // Should be called when the position is already known with high accuracy,
-// e.g. when a motion capture measurement packet is received.
+// e.g. when a motion capture measurement packet is received. The velocity of
+// the peer is estimated from consecutive positions.
 bool peerLocalizationTellPosition(int id, positionMeasurement_t const *pos);
 
+// Predicts the position of a peer at the given tick, assuming that it moves
+// with constant velocity. The prediction extends at most maxHorizonMillis
+// past the last measured position.
+void peerLocalizationPredictPosition(peerLocalizationOtherPosition_t const *other,
+  uint32_t tick, uint32_t maxHorizonMillis, point_t *pos);
+
 // Returns true if we have a position value for the given radio ID.
 bool peerLocalizationIsIDActive(uint8_t id);
 
@@ -27,6 +27,7 @@
 #pragma once
 
 #include "pptraj.h"
+#include <stdint.h>
 #include <stdio.h>
 
 enum piecewise_traj_storage_type {
@@ -36,6 +37,55 @@ enum piecewise_traj_storage_type {
 	PPTRAJ_STORAGE_FULL = 3
 };
 
+// Maximum size of a single piece in the compressed representation: one byte
+// for the storage types, two bytes for the duration and at most seven 16-bit
+// control points for each of the four coordinates
+#define PPTRAJ_COMPRESSED_MAX_PIECE_SIZE (3 + 4 * 7 * 2)
+
+// ---------------------------------------------//
+// streamed compressed trajectories             //
+// ---------------------------------------------//
+
+// Ring buffer feeding a streamed compressed trajectory. Offsets are absolute
+// positions in the stream; the position in the buffer is the offset modulo
+// the capacity. The producer appends data at write_offset, the trajectory
+// evaluator never reads beyond it and releases everything before read_offset
+// once it has copied the piece being executed. There must be a single
+// producer and a single consumer.
+struct piecewise_traj_compressed_stream
+{
+	uint8_t* buffer;
+	uint32_t capacity;
+	volatile uint32_t write_offset;
+	volatile uint32_t read_offset;
+};
+
+// Initializes an empty stream on top of the given buffer
+void piecewise_compressed_stream_init(
+	struct piecewise_traj_compressed_stream *stream, uint8_t* buffer, uint32_t capacity);
+
+// Drops all data from the stream and restarts it from offset zero
+void piecewise_compressed_stream_reset(struct piecewise_traj_compressed_stream *stream);
+
+// Returns the number of bytes that are buffered and not yet consumed
+static inline uint32_t piecewise_compressed_stream_available(
+	struct piecewise_traj_compressed_stream const *stream)
+{
+	return stream->write_offset - stream->read_offset;
+}
+
+// Returns the number of bytes that can be appended to the stream
+static inline uint32_t piecewise_compressed_stream_free(
+	struct piecewise_traj_compressed_stream const *stream)
+{
+	return stream->capacity - piecewise_compressed_stream_available(stream);
+}
+
+// Appends data to the stream. Returns the number of bytes appended, which is
+// less than length if the buffer is full.
+uint32_t piecewise_compressed_stream_write(
+	struct piecewise_traj_compressed_stream *stream, const void* data, uint32_t length);
+
 // ---------------------------------------------//
 // compressed piecewise polynomial trajectories //
 // ---------------------------------------------//
@@ -48,6 +98,9 @@ struct piecewise_traj_compressed
 	struct vec shift;
 	const void* data;
 
+	// source of a streamed trajectory, NULL if the whole trajectory is in data
+	struct piecewise_traj_compressed_stream* stream;
+
 	// mutable part of the data structure. We plan to mess around with this part
 	// but keep the rest untouched (i.e. supplied by the user)
 	struct {
@@ -60,7 +113,16 @@ struct piecewise_traj_compressed
 
 		// poly4d representation of the current piece
 		struct poly4d poly4d;
+
+		// copy of the current piece and stream offset of the next piece for
+		// streamed trajectories
+		uint8_t buffer[PPTRAJ_COMPRESSED_MAX_PIECE_SIZE];
+		uint32_t next_offset;
 	} current_piece;
+
+	// set when the next piece of a streamed trajectory was not available in
+	// time; the trajectory then holds the end of the last piece forever
+	bool underrun;
 };
 
 // Returns the total duration of a compressed trajectory. The total duration
@@ -83,3 +145,10 @@ struct traj_eval piecewise_compressed_eval(
 // Loads the compressed trajectory at the given pointer
 void piecewise_compressed_load(
 	struct piecewise_traj_compressed *traj, const void* data);
+
+// Loads a streamed compressed trajectory starting at the oldest unconsumed
+// data of the stream. The duration of the trajectory is infinite until the
+// end of the trajectory has been read from the stream. Returns false if the
+// header and the first piece are not available yet.
+bool piecewise_compressed_load_stream(
+	struct piecewise_traj_compressed *traj, struct piecewise_traj_compressed_stream *stream);
@@ -0,0 +1,66 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * show_clock.h - Clock shared by a fleet of Crazyflies
+ *
+ * The show clock follows a master clock, typically the ground station, that
+ * broadcasts its time on the radio. Offset and skew relative to the local
+ * clock are estimated from the broadcasts, so that Crazyflies that fly
+ * together agree on the time even if their crystals drift.
+ */
+#ifndef __SHOW_CLOCK_H__
+#define __SHOW_CLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Get the current time of the show clock
+ *
+ * Before the first time sync broadcast has been received, the show clock is
+ * the local usecTimestamp(). The clock is monotonic, except when it is stepped
+ * to the master clock. Offset errors are slewed in over a second, at most
+ * 10 ms per second. The clock is only stepped at the first broadcast or when
+ * the error is too large to slew, and only on the ground (not armed and not
+ * flying).
+ *
+ * @return The time of the master clock, as estimated by this Crazyflie [us]
+ */
+uint64_t showClockGetUs(void);
+
+/**
+ * @brief Check if the show clock follows a master clock
+ *
+ * @return true if at least one time sync broadcast has been received
+ */
+bool showClockIsSynchronized(void);
+
+/**
+ * @brief Handle a time sync broadcast from the master clock
+ *
+ * @param masterUs  The time of the master clock when the broadcast was sent [us]
+ * @param localUs   The local usecTimestamp() when the broadcast was received
+ */
+void showClockHandleSync(const uint64_t masterUs, const uint64_t localUs);
+
+#endif // __SHOW_CLOCK_H__
@@ -106,6 +106,22 @@ typedef struct tdoaMeasurement_s {
   float stdDev;
 } tdoaMeasurement_t;
 
+#define TDOA_BATCH_MAX_PAIRS 3
+
+/** TDoA measurements from one received packet, the anchor that sent it paired with several remote anchors */
+typedef struct tdoaBatchMeasurement_s {
+  point_t anchorPosition;
+  point_t remoteAnchorPositions[TDOA_BATCH_MAX_PAIRS];
+  // Distance to the anchor minus distance to the remote anchor
+  float distanceDiffs[TDOA_BATCH_MAX_PAIRS];
+  uint8_t anchorId;
+  uint8_t remoteAnchorIds[TDOA_BATCH_MAX_PAIRS];
+  uint8_t pairCount;
+  // Standard deviation of one distance difference. The pairs share the receive time of the anchor packet, which
+  // makes their errors correlated.
+  float stdDev;
+} tdoaBatchMeasurement_t;
+
 typedef struct baro_s {
   float pressure;           // mbar
   float temperature;        // degree Celcius
@@ -332,6 +348,7 @@ typedef struct {
   float stdDev;
   const lighthouseCalibrationSweep_t* calib;
   lighthouseCalibrationMeasurementModel_t calibrationMeasurementModel;
+  const lighthouseCalibrationSweepCache_t* calibCache; // Precomputed LH2 model terms, used instead of the model if not NULL
 } sweepAngleMeasurement_t;
 
 /** gyroscope measurement */
@@ -28,6 +28,18 @@
 
 #include <stdbool.h>
 
+#include "FreeRTOS.h"
+
+/**
+ * Priority of a scheduled job. Pending jobs are executed highest priority
+ * first, and earliest deadline first within the same priority.
+ */
+typedef enum {
+  WORKER_PRIORITY_LOW = 0,
+  WORKER_PRIORITY_NORMAL,
+  WORKER_PRIORITY_HIGH,
+} workerPriority_t;
+
 void workerInit();
 
 bool workerTest();
@@ -42,8 +54,10 @@ void workerLoop();
 
 /**
  * Schedule a function for execution by the worker loop
- * The function will be executed as soon as possible by the worker loop.
- * Scheduled functions are stacked in a FIFO queue.
+ * The function will be executed as soon as possible by the worker loop with
+ * normal priority. Jobs of the same priority are executed in FIFO order.
+ * If the same function and argument is already pending, the request is
+ * merged into the pending job and the function is only executed once.
  *
  * @param function Function to be executed
  * @param arg      Argument that will be passed to the function when executed
@@ -51,4 +65,19 @@ void workerLoop();
  */
 int workerSchedule(void (*function)(void*), void *arg);
 
+/**
+ * Schedule a function for execution by the worker loop with a priority and
+ * an optional deadline. Jobs of the same priority are executed earliest
+ * deadline first. A request for a function and argument that is already
+ * pending raises the priority and deadline of the pending job if needed.
+ *
+ * @param function Function to be executed
+ * @param arg      Argument that will be passed to the function when executed
+ * @param priority Priority of the job
+ * @param deadline Deadline relative to now in ticks, 0 for no deadline
+ * @return         0 in case of success. Anything else on failure.
+ */
+int workerScheduleWithPriority(void (*function)(void*), void *arg,
+                               workerPriority_t priority, TickType_t deadline);
+
 #endif //__WORKER_H
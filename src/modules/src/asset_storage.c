@@ -0,0 +1,248 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2024 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * asset_storage.c - Persistent storage of show assets in internal flash
+ *
+ * Show assets (trajectories, light programs) are stored in the last sector
+ * of the internal flash, which is excluded from the firmware image by the
+ * linker script. The assets survive resets and battery swaps and are used
+ * in place, directly from the memory mapped flash.
+ *
+ * The region is exposed through the memory subsystem. The first 16 bytes
+ * contain a header with a magic number, the length and the CRC32 of the
+ * assets, followed by the assets themselves. An upload is done by
+ * 1. writing the data from address ASSET_DATA_OFFSET and up. A write to
+ *    ASSET_DATA_OFFSET erases the region and starts a new upload.
+ * 2. writing the header. The header is only accepted if the CRC matches the
+ *    data in flash, which commits the upload.
+ * Reading the header returns the content hash of the stored assets.
+ */
+
+#include <string.h>
+
+#include "stm32fxxx.h"
+
+#include "asset_storage.h"
+#include "mem.h"
+#include "crc32.h"
+#include "supervisor.h"
+#include "param.h"
+
+#define DEBUG_MODULE "ASSET"
+#include "debug.h"
+
+// Sector 11, the last 128 kB of the 1 MB flash
+#define ASSET_SECTOR FLASH_Sector_11
+#define ASSET_FLASH_BASE 0x080E0000
+#define ASSET_FLASH_SIZE (128 * 1024)
+
+#define ASSET_MAGIC 0x54455341 // "ASET"
+#define ASSET_DATA_OFFSET sizeof(assetHeader_t)
+#define ASSET_DATA_CAPACITY (ASSET_FLASH_SIZE - ASSET_DATA_OFFSET)
+
+#define IWDG_KEY_RELOAD 0xAAAA
+
+typedef struct {
+  uint32_t magic;
+  uint32_t length;
+  uint32_t crc;
+  uint32_t reserved;
+} __attribute__((packed)) assetHeader_t;
+
+static const assetHeader_t* const header = (const assetHeader_t*)ASSET_FLASH_BASE;
+static const uint8_t* const data = (const uint8_t*)(ASSET_FLASH_BASE + ASSET_DATA_OFFSET);
+
+static bool isInit = false;
+static bool isValid = false;
+static bool isUploading = false;
+static uint32_t hash = 0;
+
+static uint32_t handleMemGetSize(void) { return ASSET_FLASH_SIZE; }
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_ASSETS,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = handleMemWrite,
+};
+
+static bool validate(void) {
+  isValid = header->magic == ASSET_MAGIC
+         && header->length <= ASSET_DATA_CAPACITY
+         && crc32CalculateBuffer(data, header->length) == header->crc;
+  hash = isValid ? header->crc : 0;
+  return isValid;
+}
+
+void assetStorageInit(void) {
+  if (isInit) {
+    return;
+  }
+
+  if (validate()) {
+    DEBUG_PRINT("%lu bytes of assets, hash %08lx\n", header->length, hash);
+  }
+
+  memoryRegisterHandler(&memDef);
+  isInit = true;
+}
+
+bool assetStorageTest(void) {
+  return isInit;
+}
+
+const uint8_t* assetStorageData(void) {
+  return isValid ? data : 0;
+}
+
+uint32_t assetStorageLength(void) {
+  return isValid ? header->length : 0;
+}
+
+uint32_t assetStorageHash(void) {
+  return hash;
+}
+
+// Any access to the flash stalls the CPU while the sector is erased, which
+// takes longer than the watchdog timeout. The erase is therefore executed
+// from RAM with interrupts disabled, feeding the watchdog while waiting.
+static __attribute__((section(".RAMtext"), noinline, long_call)) void eraseSectorFromRam(uint32_t sector) {
+  FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+  FLASH->CR |= FLASH_PSIZE_WORD | FLASH_CR_SER | sector;
+  FLASH->CR |= FLASH_CR_STRT;
+
+  while (FLASH->SR & FLASH_FLAG_BSY) {
+    IWDG->KR = IWDG_KEY_RELOAD;
+  }
+
+  FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+}
+
+static bool eraseRegion(void) {
+  isValid = false;
+  hash = 0;
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                  FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+  __disable_irq();
+  eraseSectorFromRam(ASSET_SECTOR);
+  __enable_irq();
+  bool result = (FLASH->SR & (FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR)) == 0;
+  FLASH_Lock();
+
+  return result;
+}
+
+static bool program(const uint32_t address, const uint8_t* buffer, const uint32_t length) {
+  bool result = true;
+
+  FLASH_Unlock();
+  for (uint32_t i = 0; i < length && result; i++) {
+    result = FLASH_ProgramByte(address + i, buffer[i]) == FLASH_COMPLETE;
+  }
+  FLASH_Lock();
+
+  return result;
+}
+
+static bool isErased(const uint32_t memAddr, const uint8_t length) {
+  const uint8_t* flash = (const uint8_t*)(ASSET_FLASH_BASE + memAddr);
+  for (int i = 0; i < length; i++) {
+    if (flash[i] != 0xff) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool commit(const assetHeader_t* newHeader) {
+  if (newHeader->magic != ASSET_MAGIC || newHeader->length > ASSET_DATA_CAPACITY) {
+    return false;
+  }
+
+  if (crc32CalculateBuffer(data, newHeader->length) != newHeader->crc) {
+    DEBUG_PRINT("Upload rejected, CRC mismatch\n");
+    return false;
+  }
+
+  if (!program(ASSET_FLASH_BASE, (const uint8_t*)newHeader, sizeof(*newHeader))) {
+    return false;
+  }
+
+  isUploading = false;
+  return validate();
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
+  if (memAddr + readLen > ASSET_FLASH_SIZE) {
+    return false;
+  }
+
+  memcpy(buffer, (const uint8_t*)(ASSET_FLASH_BASE + memAddr), readLen);
+  return true;
+}
+
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer) {
+  if (memAddr + writeLen > ASSET_FLASH_SIZE) {
+    return false;
+  }
+
+  if (memAddr == 0) {
+    return isUploading && writeLen == sizeof(assetHeader_t) && commit((const assetHeader_t*)buffer);
+  }
+
+  if (memAddr < ASSET_DATA_OFFSET) {
+    return false;
+  }
+
+  if (memAddr == ASSET_DATA_OFFSET) {
+    // A new upload, the assets might be in use by a running trajectory so
+    // this is not allowed while flying
+    if (supervisorIsFlying()) {
+      return false;
+    }
+
+    isUploading = eraseRegion();
+  }
+
+  // Flash can only be written once after an erase
+  if (!isUploading || !isErased(memAddr, writeLen)) {
+    return false;
+  }
+
+  return program(ASSET_FLASH_BASE + memAddr, buffer, writeLen);
+}
+
+/**
+ * Show assets stored in flash
+ */
+PARAM_GROUP_START(assets)
+
+/**
+ * @brief Content hash (CRC32) of the stored assets, 0 if no valid assets are stored
+ */
+PARAM_ADD(PARAM_UINT32 | PARAM_RONLY, hash, &hash)
+
+PARAM_GROUP_STOP(assets)
@@ -277,6 +277,7 @@ static collision_avoidance_params_t params = {
   .maxSpeed = 0.5f,  // Fairly conservative.
   .sidestepThreshold = 0.25f,
   .maxPeerLocAgeMillis = 5000,  // Probably longer than desired in most applications.
+  .maxPeerPredictionMillis = 250,
   .voronoiProjectionTolerance = 1e-5,
   .voronoiProjectionMaxIters = 100,
 };
@@ -313,6 +314,8 @@ void collisionAvoidanceUpdateSetpoint(
 
   TickType_t const time = xTaskGetTickCount();
   bool doAgeFilter = params.maxPeerLocAgeMillis >= 0;
+  uint32_t const maxPredictionMillis = params.maxPeerPredictionMillis > 0 ? params.maxPeerPredictionMillis : 0;
+  point_t predicted;
 
   // Counts the actual number of neighbors after we filter stale measurements.
   int nOthers = 0;
@@ -329,9 +332,11 @@ void collisionAvoidanceUpdateSetpoint(
       continue;
     }
 
-    workspace[3 * nOthers + 0] = otherPos->pos.x;
-    workspace[3 * nOthers + 1] = otherPos->pos.y;
-    workspace[3 * nOthers + 2] = otherPos->pos.z;
+    peerLocalizationPredictPosition(otherPos, time, maxPredictionMillis, &predicted);
+
+    workspace[3 * nOthers + 0] = predicted.x;
+    workspace[3 * nOthers + 1] = predicted.y;
+    workspace[3 * nOthers + 2] = predicted.z;
     ++nOthers;
   }
 
@@ -423,6 +428,12 @@ PARAM_GROUP_START(colAv)
   PARAM_ADD(PARAM_FLOAT, maxSpeed, &params.maxSpeed)
   PARAM_ADD(PARAM_FLOAT, sidestepThrsh, &params.sidestepThreshold)
   PARAM_ADD(PARAM_INT32, maxPeerLocAge, &params.maxPeerLocAgeMillis)
+
+  /**
+   * @brief Maximum time that peer positions are extrapolated with their estimated velocity [ms]
+  */
+  PARAM_ADD(PARAM_INT32, maxPeerPredict, &params.maxPeerPredictionMillis)
+
   PARAM_ADD(PARAM_FLOAT, vorTol, &params.voronoiProjectionTolerance)
   PARAM_ADD(PARAM_INT32, vorIters, &params.voronoiProjectionMaxIters)
 PARAM_GROUP_STOP(colAv)
@@ -57,12 +57,16 @@ such as: take-off, landing, polynomial trajectories.
 #include "commander.h"
 #include "stabilizer_types.h"
 #include "stabilizer.h"
+#include "worker.h"
+#include "asset_storage.h"
+#include "show_clock.h"
 
 // Local types
 enum TrajectoryLocation_e {
   TRAJECTORY_LOCATION_INVALID = 0,
   TRAJECTORY_LOCATION_MEM     = 1, // for trajectories that are uploaded dynamically
-  // Future features might include trajectories on flash or uSD card
+  TRAJECTORY_LOCATION_STREAM  = 2, // for compressed trajectories streamed through the trajectory stream buffer
+  TRAJECTORY_LOCATION_FLASH   = 3, // for trajectories in the show assets stored in flash
 };
 
 struct trajectoryDescription
@@ -74,7 +78,7 @@ struct trajectoryDescription
     struct {
       uint32_t offset;  // offset in uploaded memory
       uint8_t n_pieces;
-    } __attribute__((packed)) mem; // if trajectoryLocation is TRAJECTORY_LOCATION_MEM
+    } __attribute__((packed)) mem; // if trajectoryLocation is TRAJECTORY_LOCATION_MEM or TRAJECTORY_LOCATION_FLASH
   } trajectoryIdentifier;
 } __attribute__((packed));
 
@@ -83,6 +87,15 @@ struct trajectoryDescription
 // other (compressed) formats might be added in the future
 #define TRAJECTORY_MEMORY_SIZE 4096
 
+// ring buffer for streamed compressed trajectories, refilled ahead of the
+// playhead from the memory subsystem or from a registered source
+#define TRAJECTORY_STREAM_SIZE 2048
+
+// flags in the trajectory stream status
+#define TRAJECTORY_STREAM_FLAG_LOW_WATER 0x01
+#define TRAJECTORY_STREAM_FLAG_UNDERRUN  0x02
+#define TRAJECTORY_STREAM_FLAG_PLAYING   0x04
+
 #define ALL_GROUPS 0
 
 // Global variables
@@ -103,6 +116,19 @@ static float yaw; // last known setpoint yaw (yaw [rad])
 static struct piecewise_traj trajectory;
 static struct piecewise_traj_compressed  compressed_trajectory;
 
+static uint8_t trajectoryStreamBuffer[TRAJECTORY_STREAM_SIZE];
+static struct piecewise_traj_compressed_stream trajectoryStream;
+static struct piecewise_traj_compressed streamTrajectory;
+static void (*trajectoryStreamRefill)(void*);
+static uint16_t trajectoryStreamLowWater = 512;
+static uint32_t trajectoryStreamBuffered;
+static uint8_t trajectoryStreamIsLow;
+static uint8_t trajectoryStreamUnderrun;
+
+// serializes the producers of the trajectory stream
+static xSemaphoreHandle lockStream;
+static StaticSemaphore_t lockStreamBuffer;
+
 // makes sure that we don't evaluate the trajectory while it is being changed
 static xSemaphoreHandle lockTraj;
 static StaticSemaphore_t lockTrajBuffer;
@@ -122,6 +148,25 @@ static const MemoryHandlerDef_t memDef = {
   .write = handleMemWrite,
 };
 
+// Trajectory stream handling from the memory module. Writes must be done at
+// the current write offset of the stream, reads return the stream status.
+static uint32_t handleStreamMemGetSize(void) { return UINT32_MAX; }
+static bool handleStreamMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleStreamMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t streamMemDef = {
+  .type = MEM_TYPE_TRAJ_STREAM,
+  .getSize = handleStreamMemGetSize,
+  .read = handleStreamMemRead,
+  .write = handleStreamMemWrite,
+};
+
+struct trajectoryStreamStatus {
+  uint32_t writeOffset; // absolute stream offset where the next write is expected
+  uint32_t readOffset;  // absolute stream offset of the oldest unconsumed byte
+  uint32_t capacity;    // size of the stream buffer
+  uint8_t flags;        // TRAJECTORY_STREAM_FLAG_*
+} __attribute__((packed));
+
 STATIC_MEM_TASK_ALLOC(crtpCommanderHighLevelTask, CMD_HIGH_LEVEL_TASK_STACKSIZE);
 
 // CRTP Packet definitions
@@ -261,6 +306,29 @@ bool crtpCommanderHighLevelMatchesGroupMask(uint8_t g) {
   return g == ALL_GROUPS || (g & group_mask) != 0;
 }
 
+// True while the streamed trajectory is executed and its end has not been
+// read from the stream yet. Must be called with lockTraj taken.
+static bool isStreamPlaying() {
+  return planner.state == TRAJECTORY_STATE_FLYING
+      && planner.type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED
+      && planner.compressed_trajectory == &streamTrajectory
+      && isinf(streamTrajectory.duration);
+}
+
+// Updates the stream status and asks the registered source for more data
+// when the buffer runs low. The evaluation of the trajectory never waits for
+// the source; if it falls behind the trajectory holds its last position.
+static void updateTrajectoryStream() {
+  trajectoryStreamBuffered = piecewise_compressed_stream_available(&trajectoryStream);
+  trajectoryStreamIsLow = trajectoryStreamBuffered < trajectoryStreamLowWater;
+  trajectoryStreamUnderrun = streamTrajectory.underrun;
+
+  if (trajectoryStreamRefill && trajectoryStreamBuffered < trajectoryStream.capacity / 2) {
+    workerPriority_t priority = trajectoryStreamIsLow ? WORKER_PRIORITY_HIGH : WORKER_PRIORITY_NORMAL;
+    workerScheduleWithPriority(trajectoryStreamRefill, NULL, priority, 0);
+  }
+}
+
 void crtpCommanderHighLevelInit(void)
 {
   if (isInit) {
@@ -268,12 +336,15 @@ void crtpCommanderHighLevelInit(void)
   }
 
   memoryRegisterHandler(&memDef);
+  memoryRegisterHandler(&streamMemDef);
   plan_init(&planner);
+  piecewise_compressed_stream_init(&trajectoryStream, trajectoryStreamBuffer, sizeof(trajectoryStreamBuffer));
 
   //Start the trajectory task
   STATIC_MEM_TASK_CREATE(crtpCommanderHighLevelTask, crtpCommanderHighLevelTask, CMD_HIGH_LEVEL_TASK_NAME, NULL, CMD_HIGH_LEVEL_TASK_PRI);
 
   lockTraj = xSemaphoreCreateMutexStatic(&lockTrajBuffer);
+  lockStream = xSemaphoreCreateMutexStatic(&lockStreamBuffer);
 
   pos = vzero();
   vel = vzero();
@@ -309,10 +380,15 @@ bool crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *stat
   }
 
   xSemaphoreTake(lockTraj, portMAX_DELAY);
-  float t = usecTimestamp() / 1e6;
+  float t = showClockGetUs() / 1e6;
   struct traj_eval ev = plan_current_goal(&planner, t);
+  bool streaming = isStreamPlaying();
   xSemaphoreGive(lockTraj);
 
+  if (streaming) {
+    updateTrajectoryStream();
+  }
+
   // If we are not actively following a trajectory, then update the "last
   // setpoint" values with the current state estimate, so we have the right
   // initial conditions for future trajectory planning.
@@ -443,7 +519,7 @@ int takeoff(const struct data_takeoff* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
     result = plan_takeoff(&planner, pos, yaw, data->height, 0.0f, data->duration, t);
     xSemaphoreGive(lockTraj);
   }
@@ -455,7 +531,7 @@ int takeoff2(const struct data_takeoff_2* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -473,7 +549,7 @@ int takeoff_with_velocity(const struct data_takeoff_with_velocity* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -499,7 +575,7 @@ int land(const struct data_land* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
     result = plan_land(&planner, pos, yaw, data->height, 0.0f, data->duration, t);
     xSemaphoreGive(lockTraj);
   }
@@ -511,7 +587,7 @@ int land2(const struct data_land_2* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -529,7 +605,7 @@ int land_with_velocity(const struct data_land_with_velocity* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -572,7 +648,7 @@ int go_to(const struct data_go_to* data)
   if (isInGroup(data->groupMask)) {
     struct vec hover_pos = mkvec(data->x, data->y, data->z);
     xSemaphoreTake(lockTraj, portMAX_DELAY);
-    float t = usecTimestamp() / 1e6;
+    float t = showClockGetUs() / 1e6;
     if (plan_is_disabled(&planner) || plan_is_stopped(&planner)) {
       ev.pos = pos;
       ev.vel = vel;
@@ -587,6 +663,35 @@ int go_to(const struct data_go_to* data)
   return result;
 }
 
+// Returns a pointer to the data of a trajectory that is stored in memory or
+// in flash, NULL for other locations or if the trajectory is out of bounds.
+// Trajectories in flash are used in place.
+static const uint8_t* getTrajectoryData(const struct trajectoryDescription* trajDesc)
+{
+  uint32_t offset = trajDesc->trajectoryIdentifier.mem.offset;
+  uint32_t size = 0;
+  if (trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    size = trajDesc->trajectoryIdentifier.mem.n_pieces * sizeof(struct poly4d);
+  }
+
+  switch (trajDesc->trajectoryLocation) {
+    case TRAJECTORY_LOCATION_MEM:
+      if (offset < sizeof(trajectories_memory) && size <= sizeof(trajectories_memory) - offset) {
+        return &trajectories_memory[offset];
+      }
+      break;
+    case TRAJECTORY_LOCATION_FLASH:
+      if (offset < assetStorageLength() && size <= assetStorageLength() - offset) {
+        return assetStorageData() + offset;
+      }
+      break;
+    default:
+      break;
+  }
+
+  return 0;
+}
+
 int start_trajectory(const struct data_start_trajectory* data, float offset)
 {
   int result = 0;
@@ -596,28 +701,45 @@ int start_trajectory(const struct data_start_trajectory* data, float offset)
   if (isInGroup(data->groupMask)) {
     if (data->trajectoryId < NUM_TRAJECTORY_DEFINITIONS) {
       struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
-      if (   trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+      const uint8_t* trajData = getTrajectoryData(trajDesc);
+      if (   trajData
           && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
         xSemaphoreTake(lockTraj, portMAX_DELAY);
-        float t = usecTimestamp() / 1e6f - offset;
+        float t = showClockGetUs() / 1e6f - offset;
         trajectory.t_begin = t;
         trajectory.timescale = data->timescale;
         trajectory.n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
-        trajectory.pieces = (struct poly4d*)&trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset];
+        trajectory.pieces = (struct poly4d*)trajData;
         result = plan_start_trajectory(&planner, &trajectory, data->reversed, data->relative, pos);
         xSemaphoreGive(lockTraj);
-      } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+      } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_STREAM
           && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
 
         if (data->timescale != 1 || data->reversed) {
           result = ENOEXEC;
         } else {
           xSemaphoreTake(lockTraj, portMAX_DELAY);
-          float t = usecTimestamp() / 1e6f - offset;
-          piecewise_compressed_load(
-            &compressed_trajectory,
-            &trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset]
-          );
+          float t = showClockGetUs() / 1e6f - offset;
+          if (isStreamPlaying()) {
+            result = EBUSY;
+          } else if (!piecewise_compressed_load_stream(&streamTrajectory, &trajectoryStream)) {
+            result = ENODATA;
+          } else {
+            streamTrajectory.t_begin = t;
+            result = plan_start_compressed_trajectory(&planner, &streamTrajectory, data->relative, pos);
+          }
+          xSemaphoreGive(lockTraj);
+        }
+
+      } else if (trajData
+          && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
+
+        if (data->timescale != 1 || data->reversed) {
+          result = ENOEXEC;
+        } else {
+          xSemaphoreTake(lockTraj, portMAX_DELAY);
+          float t = showClockGetUs() / 1e6f - offset;
+          piecewise_compressed_load(&compressed_trajectory, trajData);
           compressed_trajectory.t_begin = t;
           result = plan_start_compressed_trajectory(&planner, &compressed_trajectory, data->relative, pos);
           xSemaphoreGive(lockTraj);
@@ -634,6 +756,28 @@ int define_trajectory(const struct data_define_trajectory* data)
   if (data->trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
     return ENOEXEC;
   }
+
+  if (data->description.trajectoryLocation == TRAJECTORY_LOCATION_STREAM) {
+    // Defining a streamed trajectory starts a new stream, unless the stream
+    // is in use
+    xSemaphoreTake(lockTraj, portMAX_DELAY);
+    bool playing = isStreamPlaying();
+    if (!playing) {
+      xSemaphoreTake(lockStream, portMAX_DELAY);
+      piecewise_compressed_stream_reset(&trajectoryStream);
+      xSemaphoreGive(lockStream);
+    }
+    xSemaphoreGive(lockTraj);
+
+    if (playing) {
+      return EBUSY;
+    }
+
+    if (trajectoryStreamRefill) {
+      workerScheduleWithPriority(trajectoryStreamRefill, NULL, WORKER_PRIORITY_NORMAL, 0);
+    }
+  }
+
   trajectory_descriptions[data->trajectoryId] = data->description;
   return 0;
 }
@@ -646,6 +790,37 @@ static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const
   return crtpCommanderHighLevelWriteTrajectory(memAddr, writeLen, buffer);
 }
 
+static bool handleStreamMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
+  struct trajectoryStreamStatus status;
+
+  if (memAddr + readLen > sizeof(status)) {
+    return false;
+  }
+
+  xSemaphoreTake(lockTraj, portMAX_DELAY);
+  status.writeOffset = trajectoryStream.write_offset;
+  status.readOffset = trajectoryStream.read_offset;
+  status.capacity = trajectoryStream.capacity;
+  status.flags = 0;
+  if (piecewise_compressed_stream_available(&trajectoryStream) < trajectoryStreamLowWater) {
+    status.flags |= TRAJECTORY_STREAM_FLAG_LOW_WATER;
+  }
+  if (streamTrajectory.underrun) {
+    status.flags |= TRAJECTORY_STREAM_FLAG_UNDERRUN;
+  }
+  if (isStreamPlaying()) {
+    status.flags |= TRAJECTORY_STREAM_FLAG_PLAYING;
+  }
+  xSemaphoreGive(lockTraj);
+
+  memcpy(buffer, ((uint8_t*)&status) + memAddr, readLen);
+  return true;
+}
+
+static bool handleStreamMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer) {
+  return crtpCommanderHighLevelWriteTrajectoryStream(memAddr, writeLen, buffer);
+}
+
 uint8_t* initCrtpPacket(CRTPPacket* packet, const enum TrajectoryCommand_e command)
 {
   packet->port = CRTP_PORT_SETPOINT_HL;
@@ -811,6 +986,32 @@ int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crt
   return handleCommand(COMMAND_DEFINE_TRAJECTORY, (const uint8_t*)&data);
 }
 
+int crtpCommanderHighLevelDefineTrajectoryInFlash(const uint8_t trajectoryId, const crtpCommanderTrajectoryType_t type, const uint32_t offset, const uint8_t nPieces)
+{
+  struct data_define_trajectory data =
+  {
+    .trajectoryId = trajectoryId,
+    .description.trajectoryLocation = TRAJECTORY_LOCATION_FLASH,
+    .description.trajectoryType = type,
+    .description.trajectoryIdentifier.mem.offset = offset,
+    .description.trajectoryIdentifier.mem.n_pieces = nPieces,
+  };
+
+  return handleCommand(COMMAND_DEFINE_TRAJECTORY, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelDefineTrajectoryStream(const uint8_t trajectoryId)
+{
+  struct data_define_trajectory data =
+  {
+    .trajectoryId = trajectoryId,
+    .description.trajectoryLocation = TRAJECTORY_LOCATION_STREAM,
+    .description.trajectoryType = CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED,
+  };
+
+  return handleCommand(COMMAND_DEFINE_TRAJECTORY, (const uint8_t*)&data);
+}
+
 uint32_t crtpCommanderHighLevelTrajectoryMemSize()
 {
   return sizeof(trajectories_memory);
@@ -839,8 +1040,37 @@ bool crtpCommanderHighLevelReadTrajectory(const uint32_t offset, const uint32_t
   return result;
 }
 
+bool crtpCommanderHighLevelWriteTrajectoryStream(const uint32_t offset, const uint32_t length, const uint8_t* data)
+{
+  bool result = false;
+
+  xSemaphoreTake(lockStream, portMAX_DELAY);
+  if (offset == trajectoryStream.write_offset && length <= piecewise_compressed_stream_free(&trajectoryStream)) {
+    piecewise_compressed_stream_write(&trajectoryStream, data, length);
+    result = true;
+  }
+  xSemaphoreGive(lockStream);
+
+  return result;
+}
+
+uint32_t crtpCommanderHighLevelTrajectoryStreamWriteOffset()
+{
+  return trajectoryStream.write_offset;
+}
+
+uint32_t crtpCommanderHighLevelTrajectoryStreamFree()
+{
+  return piecewise_compressed_stream_free(&trajectoryStream);
+}
+
+void crtpCommanderHighLevelSetTrajectoryStreamSource(void (*refill)(void*))
+{
+  trajectoryStreamRefill = refill;
+}
+
 bool crtpCommanderHighLevelIsTrajectoryFinished() {
-  float t = usecTimestamp() / 1e6;
+  float t = showClockGetUs() / 1e6;
   return plan_is_finished(&planner, t);
 }
 
@@ -860,4 +1090,31 @@ PARAM_ADD_CORE(PARAM_FLOAT, vtoff, &defaultTakeoffVelocity)
  */
 PARAM_ADD_CORE(PARAM_FLOAT, vland, &defaultLandingVelocity)
 
+/**
+ * @brief Number of buffered bytes below which the trajectory stream is considered low and refilled with high priority
+ */
+PARAM_ADD(PARAM_UINT16, streamLowWm, &trajectoryStreamLowWater)
+
 PARAM_GROUP_STOP(hlCommander)
+
+/**
+ * Status of the streamed trajectory buffer
+ */
+LOG_GROUP_START(hlStream)
+
+/**
+ * @brief Number of bytes buffered ahead of the playhead
+ */
+LOG_ADD(LOG_UINT32, buffered, &trajectoryStreamBuffered)
+
+/**
+ * @brief Nonzero if the buffered data is below the low watermark
+ */
+LOG_ADD(LOG_UINT8, lowWater, &trajectoryStreamIsLow)
+
+/**
+ * @brief Nonzero if the stream ran dry and the trajectory is holding its last position
+ */
+LOG_ADD(LOG_UINT8, underrun, &trajectoryStreamUnderrun)
+
+LOG_GROUP_STOP(hlStream)
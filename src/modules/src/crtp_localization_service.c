@@ -50,6 +50,8 @@
 #include "quatcompress.h"
 
 #include "peer_localization.h"
+#include "show_clock.h"
+#include "usec_time.h"
 
 #include "num.h"
 
@@ -61,6 +63,12 @@
 #define NBR_OF_
 #define DEFAULT_EMERGENCY_STOP_TIMEOUT (1 * RATE_MAIN_LOOP)
 
+// The clock offset estimate of timestamped poses follows the fastest packets. It is allowed to rise at this rate
+// to track clock drift and changes in the minimum latency [ms/ms]
+#define EXT_POSE_CLOCK_DRIFT_RATE 0.001f
+// A jump larger than this in the offset means the sender clock was reset, start over [ms]
+#define EXT_POSE_CLOCK_RESYNC_MS 500
+
 typedef enum
 {
   EXT_POSITION        = 0,
@@ -106,6 +114,14 @@ typedef struct {
   uint32_t quat; // compressed quaternion, see quatcompress.h
 } __attribute__((packed)) extPosePackedItem;
 
+// Estimated offset between the clock of the sender of timestamped poses and the system clock
+typedef struct {
+  bool isValid;
+  int32_t offsetMs;
+  float rise; // Part of a ms the offset has risen since it was last changed
+  uint32_t latestUpdateMs;
+} extPoseClock_t;
+
 // Struct for logging position information
 static positionMeasurement_t ext_pos;
 // Struct for logging pose information
@@ -124,6 +140,11 @@ static float extQuatStdDev = 4.5e-3;
 static bool isInit = false;
 static uint8_t my_id;
 static uint16_t tickOfLastPacket; // tick when last packet was received
+static extPoseClock_t extPoseClock;
+// Minimum delay of the radio link, not visible to the offset estimate. The default is the latency budget of a
+// Crazyradio PA link: a USB frame (1 ms) plus the radio packet and the syslink transfer to the STM32 (< 1 ms).
+static uint8_t extPoseLinkDelayMs = 2;
+static uint16_t extPoseLatencyMs; // Age of the latest timestamped pose when it was received
 
 static void locSrvCrtpCB(CRTPPacket* pk);
 static void extPositionHandler(CRTPPacket* pk);
@@ -199,10 +220,9 @@ static void extPoseHandler(const CRTPPacket* pk) {
   tickOfLastPacket = xTaskGetTickCount();
 }
 
-static void extPosePackedHandler(const CRTPPacket* pk) {
-  uint8_t numItems = (pk->size - 1) / sizeof(extPosePackedItem);
+static void handleExtPosePackedItems(const uint8_t* data, const uint8_t numItems, const uint32_t timestamp) {
   for (uint8_t i = 0; i < numItems; ++i) {
-    const extPosePackedItem* item = (const extPosePackedItem*)&pk->data[1 + i * sizeof(extPosePackedItem)];
+    const extPosePackedItem* item = (const extPosePackedItem*)&data[i * sizeof(extPosePackedItem)];
     if (item->id == my_id) {
       ext_pose.x = item->x / 1000.0f;
       ext_pose.y = item->y / 1000.0f;
@@ -210,7 +230,7 @@ static void extPosePackedHandler(const CRTPPacket* pk) {
       quatdecompress(item->quat, (float *)&ext_pose.quat.q0);
       ext_pose.stdDevPos = extPosStdDev;
       ext_pose.stdDevQuat = extQuatStdDev;
-      estimatorEnqueuePose(&ext_pose);
+      estimatorEnqueuePoseAt(&ext_pose, timestamp);
       tickOfLastPacket = xTaskGetTickCount();
     } else {
       ext_pos.x = item->x / 1000.0f;
@@ -222,6 +242,69 @@ static void extPosePackedHandler(const CRTPPacket* pk) {
   }
 }
 
+static void extPosePackedHandler(const CRTPPacket* pk) {
+  uint8_t numItems = (pk->size - 1) / sizeof(extPosePackedItem);
+  handleExtPosePackedItems(&pk->data[1], numItems, 0);
+}
+
+/**
+ * Converts a capture time in the clock of the sender to the system clock.
+ *
+ * The difference between the arrival time and the capture time is the clock offset plus the latency of the packet.
+ * The offset is estimated as the smallest difference seen, which is allowed to slowly rise to follow drift. The
+ * remaining error is the minimum latency of the link, which can be set with the extPoseLinkDly parameter. It can be
+ * calibrated as half the shortest round trip time of packets sent to the echo channel of the link port.
+ */
+static uint32_t extPoseCaptureTimeToSystemMs(const uint32_t captureTime, const uint32_t nowMs) {
+  const int32_t sample = (int32_t)(nowMs - captureTime);
+
+  const int32_t deviation = sample - extPoseClock.offsetMs;
+  if (!extPoseClock.isValid || deviation > EXT_POSE_CLOCK_RESYNC_MS || deviation < -EXT_POSE_CLOCK_RESYNC_MS) {
+    extPoseClock.offsetMs = sample;
+    extPoseClock.rise = 0.0f;
+    extPoseClock.isValid = true;
+  } else if (deviation <= 0) {
+    extPoseClock.offsetMs = sample;
+    extPoseClock.rise = 0.0f;
+  } else {
+    extPoseClock.rise += (nowMs - extPoseClock.latestUpdateMs) * EXT_POSE_CLOCK_DRIFT_RATE;
+    if (extPoseClock.rise >= 1.0f) {
+      const int32_t step = (int32_t)extPoseClock.rise;
+      extPoseClock.offsetMs += (step < deviation) ? step : deviation;
+      extPoseClock.rise -= step;
+    }
+  }
+  extPoseClock.latestUpdateMs = nowMs;
+
+  const uint32_t timestamp = captureTime + extPoseClock.offsetMs - extPoseLinkDelayMs;
+  extPoseLatencyMs = nowMs - timestamp;
+  return timestamp;
+}
+
+static void extPosePackedTimestampedHandler(const CRTPPacket* pk) {
+  if (pk->size < 1 + sizeof(uint32_t)) {
+    return;
+  }
+
+  uint32_t captureTime;
+  memcpy(&captureTime, &pk->data[1], sizeof(captureTime));
+  const uint32_t timestamp = extPoseCaptureTimeToSystemMs(captureTime, T2M(xTaskGetTickCount()));
+
+  uint8_t numItems = (pk->size - 1 - sizeof(uint32_t)) / sizeof(extPosePackedItem);
+  handleExtPosePackedItems(&pk->data[1 + sizeof(uint32_t)], numItems, timestamp);
+}
+
+static void showClockSyncHandler(const CRTPPacket* pk) {
+  const uint64_t localUs = usecTimestamp();
+  if (pk->size < 1 + sizeof(uint64_t)) {
+    return;
+  }
+
+  uint64_t masterUs;
+  memcpy(&masterUs, &pk->data[1], sizeof(masterUs));
+  showClockHandleSync(masterUs, localUs);
+}
+
 static void lpsShortLppPacketHandler(CRTPPacket* pk) {
   if (pk->size >= 2) {
 #ifdef CONFIG_DECK_LOCO
@@ -280,7 +363,7 @@ static void lhPersistDataWorker(void* arg) {
 static void lhPersistDataHandler(CRTPPacket* pk) {
   if (pk->size >= (1 + sizeof(LhPersistArgs_t))) {
     LhPersistArgs_t* args = (LhPersistArgs_t*) &pk->data[1];
-    workerSchedule(lhPersistDataWorker, (void*)args->combinedField);
+    workerScheduleWithPriority(lhPersistDataWorker, (void*)args->combinedField, WORKER_PRIORITY_LOW, 0);
   }
 }
 
@@ -305,6 +388,12 @@ static void genericLocHandle(CRTPPacket* pk)
     case EXT_POSE_PACKED:
       extPosePackedHandler(pk);
       break;
+    case EXT_POSE_PACKED_TIMESTAMPED:
+      extPosePackedTimestampedHandler(pk);
+      break;
+    case SHOW_CLOCK_SYNC:
+      showClockSyncHandler(pk);
+      break;
     case LH_PERSIST_DATA:
       lhPersistDataHandler(pk);
       break;
@@ -429,6 +518,10 @@ LOG_GROUP_START(locSrv)
  * @brief Quaternion w meas from an external system
  */
   LOG_ADD_CORE(LOG_FLOAT, qw, &ext_pose.quat.w)
+/**
+ * @brief Estimated age of the latest timestamped pose when it was received [ms]
+ */
+  LOG_ADD(LOG_UINT16, extPoseLat, &extPoseLatencyMs)
 LOG_GROUP_STOP(locSrv)
 
 /**
@@ -461,4 +554,8 @@ PARAM_GROUP_START(locSrv)
  * @brief Standard deviation of the quarternion data to kalman filter
  */
   PARAM_ADD_CORE(PARAM_FLOAT, extQuatStdDev, &extQuatStdDev)
+/**
+ * @brief Minimum delay of the link for timestamped poses [ms], added to the estimated latency. Half the shortest echo round trip time (default: 2)
+ */
+  PARAM_ADD(PARAM_UINT8, extPoseLinkDly, &extPoseLinkDelayMs)
 PARAM_GROUP_STOP(locSrv)
@@ -24,6 +24,10 @@ static StateEstimatorType currentEstimator = StateEstimatorTypeAutoSelect;
 static xQueueHandle measurementsQueue;
 STATIC_MEM_QUEUE_ALLOC(measurementsQueue, MEASUREMENTS_QUEUE_SIZE, sizeof(measurement_t));
 
+// IMU samples arrive at 1 kHz and are kept out of the queue, it only carries sporadic measurements.
+// The sensors task may start producing before the estimator is initialized, the zeroed channel is empty.
+static imuChannel_t imuChannel;
+
 // Statistics
 #define ONE_SECOND 1000
 static STATS_CNT_RATE_DEFINE(measurementAppendedCounter, ONE_SECOND);
@@ -42,6 +46,9 @@ EVENTTRIGGER(estSweepAngle, uint8, sensorId, uint8, baseStationId, uint8, sweepI
 EVENTTRIGGER(estGyroscope)
 EVENTTRIGGER(estAcceleration)
 EVENTTRIGGER(estBarometer)
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+EVENTTRIGGER(estTDOABatch, uint8, idA, uint8, pairCount)
+#endif
 
 static void initEstimator(const StateEstimatorType estimator);
 static void deinitEstimator(const StateEstimatorType estimator);
@@ -170,6 +177,9 @@ const char* stateEstimatorGetName() {
 
 
 void estimatorEnqueue(const measurement_t *measurement) {
+  // IMU samples are passed through the IMU channel, see estimatorEnqueueImu()
+  ASSERT(measurement->type != MeasurementTypeGyroscope && measurement->type != MeasurementTypeAcceleration);
+
   if (!measurementsQueue) {
     return;
   }
@@ -200,6 +210,13 @@ void estimatorEnqueue(const measurement_t *measurement) {
       eventTrigger_estTDOA_payload.distanceDiff = measurement->data.tdoa.distanceDiff;
       eventTrigger(&eventTrigger_estTDOA);
       break;
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+    case MeasurementTypeTDOABatch:
+      eventTrigger_estTDOABatch_payload.idA = measurement->data.tdoaBatch.anchorId;
+      eventTrigger_estTDOABatch_payload.pairCount = measurement->data.tdoaBatch.pairCount;
+      eventTrigger(&eventTrigger_estTDOABatch);
+      break;
+#endif
     case MeasurementTypePosition:
       // for additional data, see locSrv.{x,y,z} and lighthouse.{x,y,z}
       eventTrigger_estPosition_payload.source = measurement->data.position.source;
@@ -238,14 +255,6 @@ void estimatorEnqueue(const measurement_t *measurement) {
       eventTrigger_estSweepAngle_payload.sweepAngle = measurement->data.sweepAngle.measuredSweepAngle;
       eventTrigger(&eventTrigger_estSweepAngle);
       break;
-    case MeasurementTypeGyroscope:
-      // no payload needed, see gyro.{x,y,z}
-      eventTrigger(&eventTrigger_estGyroscope);
-      break;
-    case MeasurementTypeAcceleration:
-      // no payload needed, see acc.{x,y,z}
-      eventTrigger(&eventTrigger_estAcceleration);
-      break;
     case MeasurementTypeBarometer:
       // no payload needed, see baro.asl
       eventTrigger(&eventTrigger_estBarometer);
@@ -255,11 +264,28 @@ void estimatorEnqueue(const measurement_t *measurement) {
   }
 }
 
+void estimatorEnqueueImu(const Axis3f *gyro, const Axis3f *acc) {
+  imuChannelPut(&imuChannel, gyro, acc);
+
+  // no payload needed, see gyro.{x,y,z} and acc.{x,y,z}
+  eventTrigger(&eventTrigger_estGyroscope);
+  eventTrigger(&eventTrigger_estAcceleration);
+}
+
 bool estimatorDequeue(measurement_t *measurement) {
   return pdTRUE == xQueueReceive(measurementsQueue, measurement, 0);
 }
 
+bool estimatorDequeueImu(imuSample_t *sample) {
+  return imuChannelGet(&imuChannel, sample);
+}
+
 LOG_GROUP_START(estimator)
   STATS_CNT_RATE_LOG_ADD(rtApnd, &measurementAppendedCounter)
   STATS_CNT_RATE_LOG_ADD(rtRej, &measurementNotAppendedCounter)
+
+  /**
+   * @brief Number of IMU samples dropped since startup because the estimator did not keep up
+   */
+  LOG_ADD(LOG_UINT32, imuDrop, &imuChannel.dropped)
 LOG_GROUP_STOP(estimator)
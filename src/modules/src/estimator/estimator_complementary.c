@@ -67,16 +67,16 @@ bool estimatorComplementaryTest(void)
 void estimatorComplementary(state_t *state, const uint32_t tick)
 {
   // Pull the latest sensors values of interest; discard the rest
+  imuSample_t imu;
+  while (estimatorDequeueImu(&imu)) {
+    gyro = imu.gyro;
+    acc = imu.acc;
+  }
+
   measurement_t m;
   while (estimatorDequeue(&m)) {
     switch (m.type)
     {
-    case MeasurementTypeGyroscope:
-      gyro = m.data.gyroscope.gyro;
-      break;
-    case MeasurementTypeAcceleration:
-      acc = m.data.acceleration.acc;
-      break;
     case MeasurementTypeBarometer:
       baro = m.data.barometer.baro;
       break;
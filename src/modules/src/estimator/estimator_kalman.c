@@ -95,6 +95,7 @@
 #define DEBUG_MODULE "ESTKALMAN"
 #include "debug.h"
 #include "cfassert.h"
+#include "test_support.h"
 
 
 // #define KALMAN_USE_BARO_UPDATE
@@ -118,7 +119,7 @@ static StaticSemaphore_t dataMutexBuffer;
 #define MIN_COVARIANCE (1e-6f)
 
 // Use the robust implementations of TWR and TDoA, off by default but can be turned on through a parameter.
-// The robust implementations use around 10% more CPU VS the standard flavours
+// The robust implementations iterate on the position only and use about the same CPU as the standard flavours
 static bool robustTwr = false;
 static bool robustTdoa = false;
 
@@ -166,7 +167,15 @@ static STATS_CNT_RATE_DEFINE(finalizeCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementAppendedCounter, ONE_SECOND);
 // static STATS_CNT_RATE_DEFINE(measurementNotAppendedCounter, ONE_SECOND);
 
+// The unused stack of the task at its peak (high water mark), in words. It is checked once per second and a
+// warning is printed if it gets below the margin, for instance when an update function grows its stack usage.
+#define STACK_MIN_FREE_WORDS 64
+static uint16_t stackFreeWords;
+static uint32_t nextStackCheckMs = 0;
+static bool isStackWarningPrinted = false;
+
 static rateSupervisor_t rateSupervisorContext;
+static uint32_t nextPredictionMs;
 
 #define WARNING_HOLD_BACK_TIME_MS 2000
 static uint32_t warningBlockTimeMs = 0;
@@ -177,8 +186,73 @@ static const bool useBaroUpdate = true;
 static const bool useBaroUpdate = false;
 #endif
 
+#ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+/**
+ * History used to fuse late measurements at the time they refer to.
+ *
+ * A snapshot of the filter is stored after every prediction, together with the IMU data used by it. All
+ * measurements fused since the oldest snapshot are kept in time order. When a measurement older than the latest
+ * prediction arrives, it is inserted in the measurement buffer, the filter is restored from the newest snapshot
+ * that precedes it and everything after that point is replayed, updating the snapshots on the way.
+ *
+ * All late measurements dequeued in one loop are inserted first and replayed together, the number of predictions
+ * that may be replayed in one loop is limited to bound the CPU usage. Measurements that are older than that are
+ * fused at the oldest prediction that may be replayed.
+ */
+#define HISTORY_LENGTH CONFIG_ESTIMATOR_KALMAN_HISTORY_LENGTH
+#define HISTORY_MEASUREMENTS CONFIG_ESTIMATOR_KALMAN_HISTORY_MEASUREMENTS
+
+typedef struct {
+  kalmanCoreData_t coreData; // The filter right after the prediction (and process noise)
+  OutlierFilterTdoaState_t outlierFilterTdoaState;
+  OutlierFilterLhState_t sweepOutlierFilterState;
+  Axis3f acc; // Sub sampled IMU data used by the prediction
+  Axis3f gyro;
+  Axis3f gyroLatest; // Latest gyro sample at the time of the prediction, used by the flow model
+  bool quadIsFlying;
+} historyEntry_t;
+
+typedef struct {
+  measurement_t measurement;
+  uint32_t fusedMs; // The time the measurement was fused at
+} historyMeasurement_t;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static historyEntry_t history[HISTORY_LENGTH];
+static uint8_t historyNewest;
+static uint8_t historyCount;
+
+NO_DMA_CCM_SAFE_ZERO_INIT static historyMeasurement_t historyMeasurements[HISTORY_MEASUREMENTS];
+static uint8_t historyMeasurementsFirst;
+static uint8_t historyMeasurementsCount;
+
+// Measurements fused at or before this time have been dropped from the buffer, snapshots up to this time can not
+// be replayed any more
+static uint32_t historyValidAfterMs;
+
+// Set when late measurements have been inserted in the buffer in this loop, the replay starts at historyReplayFromMs
+static bool historyReplayPending;
+static uint32_t historyReplayFromMs;
+
+// Parameters
+static uint16_t historyMaxLagMs = 100;
+static uint8_t historyMaxReplay = 4;
+
+// Statistics
+static uint16_t lateMeasurementCount;
+static uint16_t droppedMeasurementCount;
+static uint16_t overflowMeasurementCount;
+static uint16_t clampedMeasurementCount;
+static uint16_t lateMeasurementLagMs;
+static uint8_t replayedPredictionCount;
+#endif
+
 static void kalmanTask(void* parameters);
+TESTABLE_STATIC void kalmanTaskLoop(const uint32_t nowMs);
 static void updateQueuedMeasurements(const uint32_t nowMs, const bool quadIsFlying);
+#ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+static void historyReset(void);
+static void historyAddPrediction(const Axis3f* acc, const Axis3f* gyro, const bool quadIsFlying);
+#endif
 
 STATIC_MEM_TASK_ALLOC_STACK_NO_DMA_CCM_SAFE(kalmanTask, KALMAN_TASK_STACKSIZE);
 
@@ -208,7 +282,7 @@ static void kalmanTask(void* parameters) {
   systemWaitStart();
 
   uint32_t nowMs = T2M(xTaskGetTickCount());
-  uint32_t nextPredictionMs = nowMs;
+  nextPredictionMs = nowMs;
 
   rateSupervisorInit(&rateSupervisorContext, nowMs, ONE_SECOND, PREDICT_RATE - 1, PREDICT_RATE + 1, 1);
 
@@ -216,60 +290,82 @@ static void kalmanTask(void* parameters) {
     xSemaphoreTake(runTaskSemaphore, portMAX_DELAY);
     nowMs = T2M(xTaskGetTickCount()); // would be nice if this had a precision higher than 1ms...
 
-    if (resetEstimation) {
-      estimatorKalmanInit();
-      resetEstimation = false;
-    }
+    kalmanTaskLoop(nowMs);
+  }
+}
 
-    bool quadIsFlying = supervisorIsFlying();
+// One loop of the task: prediction, measurement updates and externalization of the state
+TESTABLE_STATIC void kalmanTaskLoop(const uint32_t nowMs) {
+  if (resetEstimation) {
+    estimatorKalmanInit();
+    resetEstimation = false;
+  }
+
+  bool quadIsFlying = supervisorIsFlying();
 
   #ifdef KALMAN_DECOUPLE_XY
-    kalmanCoreDecoupleXY(&coreData);
+  kalmanCoreDecoupleXY(&coreData);
   #endif
 
-    // Run the system dynamics to predict the state forward.
-    if (nowMs >= nextPredictionMs) {
-      axis3fSubSamplerFinalize(&accSubSampler);
-      axis3fSubSamplerFinalize(&gyroSubSampler);
+  // Run the system dynamics to predict the state forward.
+  bool isPredicted = false;
+  if (nowMs >= nextPredictionMs) {
+    axis3fSubSamplerFinalize(&accSubSampler);
+    axis3fSubSamplerFinalize(&gyroSubSampler);
 
-      kalmanCorePredict(&coreData, &accSubSampler.subSample, &gyroSubSampler.subSample, nowMs, quadIsFlying);
-      nextPredictionMs = nowMs + (1000.0f / PREDICT_RATE);
+    kalmanCorePredict(&coreData, &accSubSampler.subSample, &gyroSubSampler.subSample, nowMs, quadIsFlying);
+    nextPredictionMs = nowMs + (1000.0f / PREDICT_RATE);
+    isPredicted = true;
 
-      STATS_CNT_RATE_EVENT(&predictionCounter);
+    STATS_CNT_RATE_EVENT(&predictionCounter);
 
-      if (!rateSupervisorValidate(&rateSupervisorContext, nowMs)) {
-        // DEBUG_PRINT("WARNING: Kalman prediction rate low (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
-      }
+    if (!rateSupervisorValidate(&rateSupervisorContext, nowMs)) {
+      // DEBUG_PRINT("WARNING: Kalman prediction rate low (%lu)\n", rateSupervisorLatestCount(&rateSupervisorContext));
     }
+  }
 
-    // Add process noise every loop, rather than every prediction
-    kalmanCoreAddProcessNoise(&coreData, &coreParams, nowMs);
+  // Add process noise every loop, rather than every prediction
+  kalmanCoreAddProcessNoise(&coreData, &coreParams, nowMs);
 
-    updateQueuedMeasurements(nowMs, quadIsFlying);
+  #ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+  if (isPredicted) {
+    historyAddPrediction(&accSubSampler.subSample, &gyroSubSampler.subSample, quadIsFlying);
+  }
+  #endif
 
-    if (kalmanCoreFinalize(&coreData))
-    {
-      STATS_CNT_RATE_EVENT(&finalizeCounter);
-    }
+  updateQueuedMeasurements(nowMs, quadIsFlying);
+
+  if (kalmanCoreFinalize(&coreData))
+  {
+    STATS_CNT_RATE_EVENT(&finalizeCounter);
+  }
 
-    if (! kalmanSupervisorIsStateWithinBounds(&coreData)) {
-      resetEstimation = true;
+  if (! kalmanSupervisorIsStateWithinBounds(&coreData)) {
+    resetEstimation = true;
 
-      if (nowMs > warningBlockTimeMs) {
-        warningBlockTimeMs = nowMs + WARNING_HOLD_BACK_TIME_MS;
-        DEBUG_PRINT("State out of bounds, resetting\n");
-      }
+    if (nowMs > warningBlockTimeMs) {
+      warningBlockTimeMs = nowMs + WARNING_HOLD_BACK_TIME_MS;
+      DEBUG_PRINT("State out of bounds, resetting\n");
     }
+  }
 
-    /**
-     * Finally, the internal state is externalized.
-     * This is done every round, since the external state includes some sensor data
-     */
-    xSemaphoreTake(dataMutex, portMAX_DELAY);
-    kalmanCoreExternalizeState(&coreData, &taskEstimatorState, &accLatest);
-    xSemaphoreGive(dataMutex);
+  /**
+   * Finally, the internal state is externalized.
+   * This is done every round, since the external state includes some sensor data
+   */
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  kalmanCoreExternalizeState(&coreData, &taskEstimatorState, &accLatest);
+  xSemaphoreGive(dataMutex);
+
+  STATS_CNT_RATE_EVENT(&updateCounter);
 
-    STATS_CNT_RATE_EVENT(&updateCounter);
+  if (nowMs >= nextStackCheckMs) {
+    nextStackCheckMs = nowMs + ONE_SECOND;
+    stackFreeWords = uxTaskGetStackHighWaterMark(NULL);
+    if (stackFreeWords < STACK_MIN_FREE_WORDS && !isStackWarningPrinted) {
+      isStackWarningPrinted = true;
+      DEBUG_PRINT("WARNING: Kalman task stack margin low (%u words)\n", stackFreeWords);
+    }
   }
 }
 
@@ -285,72 +381,331 @@ void estimatorKalman(state_t *state, const uint32_t tick) {
   xSemaphoreGive(runTaskSemaphore);
 }
 
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+static void fuseTdoaBatchRobust(const tdoaBatchMeasurement_t* tdoaBatch) {
+  for (int i = 0; i < tdoaBatch->pairCount && i < TDOA_BATCH_MAX_PAIRS; i++) {
+    tdoaMeasurement_t tdoa = {
+      .anchorPositions = {tdoaBatch->remoteAnchorPositions[i], tdoaBatch->anchorPosition},
+      .anchorIds = {tdoaBatch->remoteAnchorIds[i], tdoaBatch->anchorId},
+      .distanceDiff = tdoaBatch->distanceDiffs[i],
+      .stdDev = tdoaBatch->stdDev,
+    };
+    kalmanCoreRobustUpdateWithTdoa(&coreData, &tdoa, &outlierFilterTdoaState);
+  }
+}
+#endif
+
+static void fuseMeasurement(measurement_t* m, const uint32_t nowMs, const Axis3f* gyro) {
+  switch (m->type) {
+    case MeasurementTypeTDOA:
+      if(robustTdoa){
+        // robust KF update with TDOA measurements
+        kalmanCoreRobustUpdateWithTdoa(&coreData, &m->data.tdoa, &outlierFilterTdoaState);
+      }else{
+        // standard KF update
+        kalmanCoreUpdateWithTdoa(&coreData, &m->data.tdoa, nowMs, &outlierFilterTdoaState);
+      }
+      break;
+#ifdef CONFIG_DECK_LOCO_TDOA3_BATCH
+    case MeasurementTypeTDOABatch:
+      if(robustTdoa){
+        // the robust update is scalar, fuse the pairs one by one
+        fuseTdoaBatchRobust(&m->data.tdoaBatch);
+      }else{
+        kalmanCoreUpdateWithTdoaBatch(&coreData, &m->data.tdoaBatch, nowMs, &outlierFilterTdoaState);
+      }
+      break;
+#endif
+    case MeasurementTypePosition:
+      kalmanCoreUpdateWithPosition(&coreData, &m->data.position);
+      break;
+    case MeasurementTypePose:
+      kalmanCoreUpdateWithPose(&coreData, &m->data.pose);
+      break;
+    case MeasurementTypeDistance:
+      if(robustTwr){
+          // robust KF update with UWB TWR measurements
+          kalmanCoreRobustUpdateWithDistance(&coreData, &m->data.distance);
+      }else{
+          // standard KF update
+          kalmanCoreUpdateWithDistance(&coreData, &m->data.distance);
+      }
+      break;
+    case MeasurementTypeTOF:
+      kalmanCoreUpdateWithTof(&coreData, &m->data.tof);
+      break;
+    case MeasurementTypeAbsoluteHeight:
+      kalmanCoreUpdateWithAbsoluteHeight(&coreData, &m->data.height);
+      break;
+    case MeasurementTypeFlow:
+      kalmanCoreUpdateWithFlow(&coreData, &m->data.flow, gyro);
+      break;
+    case MeasurementTypeYawError:
+      kalmanCoreUpdateWithYawError(&coreData, &m->data.yawError);
+      break;
+    case MeasurementTypeSweepAngle:
+      kalmanCoreUpdateWithSweepAngles(&coreData, &m->data.sweepAngle, nowMs, &sweepOutlierFilterState);
+      break;
+    default:
+      break;
+  }
+}
+
+#ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+static void historyReset(void) {
+  historyCount = 0;
+  historyMeasurementsCount = 0;
+  historyValidAfterMs = 0;
+  historyReplayPending = false;
+}
+
+static historyEntry_t* historyEntryAtAge(const uint8_t age) {
+  return &history[(historyNewest + HISTORY_LENGTH - age) % HISTORY_LENGTH];
+}
+
+static historyMeasurement_t* historyMeasurementAt(const uint8_t index) {
+  return &historyMeasurements[(historyMeasurementsFirst + index) % HISTORY_MEASUREMENTS];
+}
+
+static void historySnapshot(historyEntry_t* entry) {
+  memcpy(&entry->coreData, &coreData, sizeof(coreData));
+  entry->outlierFilterTdoaState = outlierFilterTdoaState;
+  entry->sweepOutlierFilterState = sweepOutlierFilterState;
+}
+
+static void historyAddPrediction(const Axis3f* acc, const Axis3f* gyro, const bool quadIsFlying) {
+  historyNewest = (historyNewest + 1) % HISTORY_LENGTH;
+  if (historyCount < HISTORY_LENGTH) {
+    historyCount++;
+  }
+
+  historyEntry_t* entry = &history[historyNewest];
+  historySnapshot(entry);
+  entry->acc = *acc;
+  entry->gyro = *gyro;
+  entry->gyroLatest = gyroLatest;
+  entry->quadIsFlying = quadIsFlying;
+}
+
+// Inserts a measurement in the buffer, keeping it sorted on time. The oldest measurement is dropped if the buffer
+// is full.
+static void historyAddMeasurement(const measurement_t* m, const uint32_t fusedMs) {
+  if (historyMeasurementsCount == HISTORY_MEASUREMENTS) {
+    const uint32_t oldestMs = historyMeasurementAt(0)->fusedMs;
+    if ((int32_t)(fusedMs - oldestMs) < 0) {
+      // Older than anything in the buffer, it is the one to drop
+      historyValidAfterMs = fusedMs;
+      overflowMeasurementCount++;
+      return;
+    }
+
+    historyValidAfterMs = oldestMs;
+    historyMeasurementsFirst = (historyMeasurementsFirst + 1) % HISTORY_MEASUREMENTS;
+    historyMeasurementsCount--;
+  }
+
+  uint8_t index = historyMeasurementsCount;
+  while (index > 0 && (int32_t)(historyMeasurementAt(index - 1)->fusedMs - fusedMs) > 0) {
+    *historyMeasurementAt(index) = *historyMeasurementAt(index - 1);
+    index--;
+  }
+
+  historyMeasurement_t* item = historyMeasurementAt(index);
+  item->measurement = *m;
+  item->fusedMs = fusedMs;
+  historyMeasurementsCount++;
+}
+
+// The task adds process noise once per loop (1 ms). The noise model is not linear in dt, step the same way when
+// replaying to end up with the same covariance.
+static void historyAddProcessNoiseUntil(const uint32_t targetMs) {
+  for (uint32_t ms = coreData.lastProcessNoiseUpdateMs + 1; (int32_t)(targetMs - ms) >= 0; ms++) {
+    kalmanCoreAddProcessNoise(&coreData, &coreParams, ms);
+  }
+}
+
+// Replays one loop of the task: process noise, the measurements fused at loopMs and finalization
+static void historyReplayLoop(uint8_t* index, const uint32_t loopMs, const Axis3f* gyro) {
+  historyAddProcessNoiseUntil(loopMs);
+  while (*index < historyMeasurementsCount) {
+    historyMeasurement_t* item = historyMeasurementAt(*index);
+    if (item->fusedMs != loopMs) {
+      break;
+    }
+    fuseMeasurement(&item->measurement, loopMs, gyro);
+    (*index)++;
+  }
+  kalmanCoreFinalize(&coreData);
+}
+
+// The number of snapshots that can be restored, limited by the replay budget and by dropped measurements
+static uint8_t historyReplayableCount(void) {
+  uint8_t maxReplay = historyMaxReplay;
+  if (maxReplay < 1) {
+    maxReplay = 1;
+  }
+
+  uint8_t count = 0;
+  while (count < historyCount && count < maxReplay) {
+    const uint32_t entryMs = historyEntryAtAge(count)->coreData.lastPredictionMs;
+    if ((int32_t)(entryMs - historyValidAfterMs) <= 0) {
+      break;
+    }
+    count++;
+  }
+
+  return count;
+}
+
+/**
+ * Restores the filter to the newest snapshot taken at or before fromMs and replays all predictions and buffered
+ * measurements from there up to nowMs. If that snapshot can not be restored (measurements have been dropped from a
+ * full buffer), the oldest one that can is used.
+ *
+ * @return false if no snapshot can be restored, the filter is left untouched in that case
+ */
+static bool historyReplayFrom(const uint32_t fromMs, const uint32_t nowMs) {
+  const uint8_t replayableCount = historyReplayableCount();
+  if (replayableCount == 0) {
+    return false;
+  }
+
+  int age = replayableCount - 1;
+  for (uint8_t i = 0; i < replayableCount; i++) {
+    if ((int32_t)(historyEntryAtAge(i)->coreData.lastPredictionMs - fromMs) <= 0) {
+      age = i;
+      break;
+    }
+  }
+
+  replayedPredictionCount = age + 1;
+
+  historyEntry_t* entry = historyEntryAtAge(age);
+  memcpy(&coreData, &entry->coreData, sizeof(coreData));
+  coreData.Pm.pData = (float*)coreData.P;
+  outlierFilterTdoaState = entry->outlierFilterTdoaState;
+  sweepOutlierFilterState = entry->sweepOutlierFilterState;
+
+  // Skip measurements fused before the snapshot
+  uint8_t index = 0;
+  while (index < historyMeasurementsCount && (int32_t)(historyMeasurementAt(index)->fusedMs - coreData.lastPredictionMs) < 0) {
+    index++;
+  }
+
+  for (; age >= 0; age--) {
+    entry = historyEntryAtAge(age);
+    historyEntry_t* next = (age > 0) ? historyEntryAtAge(age - 1) : 0;
+
+    // The loop that made the prediction, followed by the ones that fused measurements until the next prediction
+    historyReplayLoop(&index, entry->coreData.lastPredictionMs, &entry->gyroLatest);
+    while (index < historyMeasurementsCount) {
+      const uint32_t fusedMs = historyMeasurementAt(index)->fusedMs;
+      if (next && (int32_t)(fusedMs - next->coreData.lastPredictionMs) >= 0) {
+        break;
+      }
+      historyReplayLoop(&index, fusedMs, &entry->gyroLatest);
+    }
+
+    if (next) {
+      const uint32_t nextMs = next->coreData.lastPredictionMs;
+      historyAddProcessNoiseUntil(nextMs - 1);
+      kalmanCorePredict(&coreData, &next->acc, &next->gyro, nextMs, next->quadIsFlying);
+      historyAddProcessNoiseUntil(nextMs);
+      historySnapshot(next);
+    }
+  }
+
+  historyAddProcessNoiseUntil(nowMs);
+  return true;
+}
+
+// Inserts a late measurement in the buffer, it is fused when the history is replayed at the end of the loop
+static void historyAddLateMeasurement(const measurement_t* m, const uint32_t nowMs) {
+  const uint32_t lagMs = nowMs - m->timestamp;
+  lateMeasurementCount++;
+  lateMeasurementLagMs = lagMs;
+
+  if (lagMs > historyMaxLagMs) {
+    droppedMeasurementCount++;
+    return;
+  }
+
+  // Snapshots older than the replay budget can not be restored, fuse at the oldest one that can
+  uint32_t fusedMs = m->timestamp;
+  const uint32_t oldestMs = historyEntryAtAge(historyReplayableCount() - 1)->coreData.lastPredictionMs;
+  if ((int32_t)(fusedMs - oldestMs) < 0) {
+    fusedMs = oldestMs;
+    clampedMeasurementCount++;
+  }
+
+  historyAddMeasurement(m, fusedMs);
+  if (!historyReplayPending || (int32_t)(fusedMs - historyReplayFromMs) < 0) {
+    historyReplayFromMs = fusedMs;
+  }
+  historyReplayPending = true;
+}
+
+static void historyReplayPendingMeasurements(const uint32_t nowMs) {
+  if (historyReplayPending) {
+    historyReplayPending = false;
+    if (!historyReplayFrom(historyReplayFromMs, nowMs)) {
+      // The buffer overflowed and no snapshot is left, the measurements of this loop are lost
+      overflowMeasurementCount++;
+    }
+  }
+}
+#endif
+
+static void fuseQueuedMeasurement(measurement_t* m, const uint32_t nowMs) {
+#ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+  const bool isLate = m->timestamp != 0 && (int32_t)(m->timestamp - coreData.lastPredictionMs) < 0;
+  if (isLate && historyReplayableCount() > 0) {
+    historyAddLateMeasurement(m, nowMs);
+    return;
+  }
+
+  historyAddMeasurement(m, nowMs);
+  if (historyReplayPending) {
+    // Fused by the replay
+    return;
+  }
+#endif
+
+  fuseMeasurement(m, nowMs, &gyroLatest);
+}
+
 static void updateQueuedMeasurements(const uint32_t nowMs, const bool quadIsFlying) {
   /**
    * Sensor measurements can come in sporadically and faster than the stabilizer loop frequency,
    * we therefore consume all measurements since the last loop, rather than accumulating
    */
 
+  imuSample_t imu;
+  while (estimatorDequeueImu(&imu)) {
+    axis3fSubSamplerAccumulate(&gyroSubSampler, &imu.gyro);
+    axis3fSubSamplerAccumulate(&accSubSampler, &imu.acc);
+    gyroLatest = imu.gyro;
+    accLatest = imu.acc;
+  }
+
   // Pull the latest sensors values of interest; discard the rest
   measurement_t m;
   while (estimatorDequeue(&m)) {
     switch (m.type) {
-      case MeasurementTypeTDOA:
-        if(robustTdoa){
-          // robust KF update with TDOA measurements
-          kalmanCoreRobustUpdateWithTdoa(&coreData, &m.data.tdoa, &outlierFilterTdoaState);
-        }else{
-          // standard KF update
-          kalmanCoreUpdateWithTdoa(&coreData, &m.data.tdoa, nowMs, &outlierFilterTdoaState);
-        }
-        break;
-      case MeasurementTypePosition:
-        kalmanCoreUpdateWithPosition(&coreData, &m.data.position);
-        break;
-      case MeasurementTypePose:
-        kalmanCoreUpdateWithPose(&coreData, &m.data.pose);
-        break;
-      case MeasurementTypeDistance:
-        if(robustTwr){
-            // robust KF update with UWB TWR measurements
-            kalmanCoreRobustUpdateWithDistance(&coreData, &m.data.distance);
-        }else{
-            // standard KF update
-            kalmanCoreUpdateWithDistance(&coreData, &m.data.distance);
-        }
-        break;
-      case MeasurementTypeTOF:
-        kalmanCoreUpdateWithTof(&coreData, &m.data.tof);
-        break;
-      case MeasurementTypeAbsoluteHeight:
-        kalmanCoreUpdateWithAbsoluteHeight(&coreData, &m.data.height);
-        break;
-      case MeasurementTypeFlow:
-        kalmanCoreUpdateWithFlow(&coreData, &m.data.flow, &gyroLatest);
-        break;
-      case MeasurementTypeYawError:
-        kalmanCoreUpdateWithYawError(&coreData, &m.data.yawError);
-        break;
-      case MeasurementTypeSweepAngle:
-        kalmanCoreUpdateWithSweepAngles(&coreData, &m.data.sweepAngle, nowMs, &sweepOutlierFilterState);
-        break;
-      case MeasurementTypeGyroscope:
-        axis3fSubSamplerAccumulate(&gyroSubSampler, &m.data.gyroscope.gyro);
-        gyroLatest = m.data.gyroscope.gyro;
-        break;
-      case MeasurementTypeAcceleration:
-        axis3fSubSamplerAccumulate(&accSubSampler, &m.data.acceleration.acc);
-        accLatest = m.data.acceleration.acc;
-        break;
       case MeasurementTypeBarometer:
         if (useBaroUpdate) {
           kalmanCoreUpdateWithBaro(&coreData, &coreParams, m.data.barometer.baro.asl, quadIsFlying);
         }
         break;
       default:
+        fuseQueuedMeasurement(&m, nowMs);
         break;
     }
   }
+
+  #ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+  historyReplayPendingMeasurements(nowMs);
+  #endif
 }
 
 // Called when this estimator is activated
@@ -364,6 +719,10 @@ void estimatorKalmanInit(void)
 
   uint32_t nowMs = T2M(xTaskGetTickCount());
   kalmanCoreInit(&coreData, &coreParams, nowMs);
+
+  #ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+  historyReset();
+  #endif
 }
 
 bool estimatorKalmanTest(void)
@@ -381,6 +740,14 @@ void estimatorKalmanGetEstimatedRot(float * rotationMatrix) {
   memcpy(rotationMatrix, coreData.R, 9*sizeof(float));
 }
 
+void estimatorKalmanGetEstimatedPosCovariance(float * covariance) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      covariance[i * 3 + j] = coreData.P[KC_STATE_X + i][KC_STATE_X + j];
+    }
+  }
+}
+
 /**
  * Variables and results from the Extended Kalman Filter
  */
@@ -497,8 +864,58 @@ LOG_GROUP_START(kalman)
   * @brief Statistics rate full estimation step
   */
   STATS_CNT_RATE_LOG_ADD(rtFinal, &finalizeCounter)
+  /**
+  * @brief Unused stack of the kalman task at its peak [words]
+  */
+  LOG_ADD(LOG_UINT16, stackFree, &stackFreeWords)
 LOG_GROUP_STOP(kalman)
 
+#ifdef CONFIG_ESTIMATOR_KALMAN_HISTORY
+/**
+ * Measurements fused at the time they refer to, rather than when they were received
+ */
+LOG_GROUP_START(kalmanHist)
+  /**
+  * @brief Number of measurements that were older than the latest prediction
+  */
+  LOG_ADD(LOG_UINT16, late, &lateMeasurementCount)
+  /**
+  * @brief Number of late measurements that were dropped since they lagged more than kalmanHist.maxLag
+  */
+  LOG_ADD(LOG_UINT16, dropped, &droppedMeasurementCount)
+  /**
+  * @brief Number of times late measurements were lost because the measurement buffer was full
+  */
+  LOG_ADD(LOG_UINT16, overflow, &overflowMeasurementCount)
+  /**
+  * @brief Number of late measurements fused at the oldest prediction within the replay budget, instead of at their time
+  */
+  LOG_ADD(LOG_UINT16, clamped, &clampedMeasurementCount)
+  /**
+  * @brief Lag of the latest late measurement [ms]
+  */
+  LOG_ADD(LOG_UINT16, lag, &lateMeasurementLagMs)
+  /**
+  * @brief Number of predictions replayed to fuse the latest late measurements
+  */
+  LOG_ADD(LOG_UINT8, replayed, &replayedPredictionCount)
+LOG_GROUP_STOP(kalmanHist)
+
+/**
+ * Limits for fusing late measurements at the time they refer to
+ */
+PARAM_GROUP_START(kalmanHist)
+  /**
+  * @brief Late measurements that lag more than this are dropped [ms] (default: 100)
+  */
+  PARAM_ADD(PARAM_UINT16, maxLag, &historyMaxLagMs)
+  /**
+  * @brief Maximum number of predictions (10 ms each) that are replayed in one loop of the estimator (default: 4)
+  */
+  PARAM_ADD(PARAM_UINT8, maxReplay, &historyMaxReplay)
+PARAM_GROUP_STOP(kalmanHist)
+#endif
+
 LOG_GROUP_START(outlierf)
   LOG_ADD(LOG_INT32, lhWin, &sweepOutlierFilterState.openingWindowMs)
 LOG_GROUP_STOP(outlierf)
@@ -791,27 +791,26 @@ static bool updateQueuedMeasurements(const uint32_t tick, Axis3f *gyroAverage)
 
   const uint32_t nowMs = T2M(tick);
 
+  imuSample_t imu;
+  while (estimatorDequeueImu(&imu))
+  {
+    gyroAccumulator.x += imu.gyro.x;
+    gyroAccumulator.y += imu.gyro.y;
+    gyroAccumulator.z += imu.gyro.z;
+    gyroLatest = imu.gyro;
+    gyroAccumulatorCount++;
+
+    accAccumulator.x += imu.acc.x;
+    accAccumulator.y += imu.acc.y;
+    accAccumulator.z += imu.acc.z;
+    accLatest = imu.acc;
+    accAccumulatorCount++;
+  }
+
   // Pull the latest sensors values of interest; discard the rest
   measurement_t m;
   while (estimatorDequeue(&m))
   {
-
-    if (m.type == MeasurementTypeGyroscope)
-    {
-      gyroAccumulator.x += m.data.gyroscope.gyro.x;
-      gyroAccumulator.y += m.data.gyroscope.gyro.y;
-      gyroAccumulator.z += m.data.gyroscope.gyro.z;
-      gyroLatest = m.data.gyroscope.gyro;
-      gyroAccumulatorCount++;
-    }
-    if (m.type == MeasurementTypeAcceleration)
-    {
-      accAccumulator.x += m.data.acceleration.acc.x;
-      accAccumulator.y += m.data.acceleration.acc.y;
-      accAccumulator.z += m.data.acceleration.acc.z;
-      accLatest = m.data.acceleration.acc;
-      accAccumulatorCount++;
-    }
     if((m.type==MeasurementTypeBarometer)&&(!initializedNav))
     {
       baroAslAccumulator += m.data.barometer.baro.asl;
@@ -0,0 +1,76 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "imuChannel.h"
+
+// The producer and consumer run on the same core, it is enough to keep the compiler from reordering
+#define COMPILER_BARRIER() __asm volatile ("" ::: "memory")
+
+void imuChannelInit(imuChannel_t* this) {
+  memset(this, 0, sizeof(imuChannel_t));
+}
+
+void imuChannelPut(imuChannel_t* this, const Axis3f* gyro, const Axis3f* acc) {
+  const uint32_t head = this->head;
+  imuSample_t* slot = &this->samples[head % IMU_CHANNEL_SIZE];
+  slot->gyro = *gyro;
+  slot->acc = *acc;
+
+  // Publish the sample after it has been written
+  COMPILER_BARRIER();
+  this->head = head + 1;
+}
+
+bool imuChannelGet(imuChannel_t* this, imuSample_t* sample) {
+  while (true) {
+    const uint32_t head = this->head;
+    if (head == this->tail) {
+      return false;
+    }
+
+    // The slot following the head may be written by the producer at any time, skip samples
+    // that are about to be overwritten
+    if (head - this->tail >= IMU_CHANNEL_SIZE) {
+      const uint32_t newTail = head - IMU_CHANNEL_SIZE + 1;
+      this->dropped += newTail - this->tail;
+      this->tail = newTail;
+    }
+
+    COMPILER_BARRIER();
+    *sample = this->samples[this->tail % IMU_CHANNEL_SIZE];
+    COMPILER_BARRIER();
+
+    // Make sure the producer did not start writing to the slot while it was read
+    if (this->head - this->tail < IMU_CHANNEL_SIZE) {
+      this->tail++;
+      return true;
+    }
+  }
+}
+
+void imuChannelFlush(imuChannel_t* this) {
+  this->tail = this->head;
+}
@@ -209,22 +209,22 @@ void kalmanCoreInit(kalmanCoreData_t *this, const kalmanCoreParams_t *params, co
   this->lastProcessNoiseUpdateMs = nowMs;
 }
 
+// Temporary matrices for the covariance updates, shared by the scalar and the batch update
+NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
+static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
+
+NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
+static arm_matrix_instance_f32 tmpNN2m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
+
+NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN3d[KC_STATE_DIM * KC_STATE_DIM];
+static arm_matrix_instance_f32 tmpNN3m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN3d};
+
 void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, float error, float stdMeasNoise)
 {
   // The Kalman gain as a column vector
   NO_DMA_CCM_SAFE_ZERO_INIT static float K[KC_STATE_DIM];
   static arm_matrix_instance_f32 Km = {KC_STATE_DIM, 1, (float *)K};
 
-  // Temporary matrices for the covariance updates
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN1d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN1d};
-
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN2d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN2m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN2d};
-
-  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float tmpNN3d[KC_STATE_DIM * KC_STATE_DIM];
-  static arm_matrix_instance_f32 tmpNN3m = {KC_STATE_DIM, KC_STATE_DIM, tmpNN3d};
-
   NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float HTd[KC_STATE_DIM * 1];
   static arm_matrix_instance_f32 HTm = {KC_STATE_DIM, 1, HTd};
 
@@ -281,41 +281,224 @@ void kalmanCoreScalarUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm,
   this->isUpdated = true;
 }
 
-void kalmanCoreUpdateWithPKE(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, arm_matrix_instance_f32 *Km, arm_matrix_instance_f32 *P_w_m, float error)
+void kalmanCoreBatchUpdate(kalmanCoreData_t* this, arm_matrix_instance_f32 *Hm, const float *errors, arm_matrix_instance_f32 *Rm)
 {
-    // kalman filter update with weighted covariance matrix P_w_m, kalman gain Km, and innovation error
-    // Temporary matrices for the covariance updates
-    static float tmpNN1d[KC_STATE_DIM][KC_STATE_DIM];
-    static arm_matrix_instance_f32 tmpNN1m = {KC_STATE_DIM, KC_STATE_DIM, (float *)tmpNN1d};
-    for (int i=0; i<KC_STATE_DIM; i++){
-        this->S[i] = this->S[i] + Km->pData[i] * error;
+  const uint16_t rows = Hm->numRows;
+
+  // The Kalman gain, one column per measurement
+  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float Kd[KC_STATE_DIM * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 Km = {KC_STATE_DIM, rows, Kd};
+
+  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float HTd[KC_STATE_DIM * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 HTm = {KC_STATE_DIM, rows, HTd};
+
+  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float PHTd[KC_STATE_DIM * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 PHTm = {KC_STATE_DIM, rows, PHTd};
+
+  NO_DMA_CCM_SAFE_ZERO_INIT __attribute__((aligned(4))) static float KRd[KC_STATE_DIM * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 KRm = {KC_STATE_DIM, rows, KRd};
+
+  __attribute__((aligned(4))) float HPHRd[KC_BATCH_UPDATE_MAX_ROWS * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 HPHRm = {rows, rows, HPHRd};
+
+  __attribute__((aligned(4))) float HPHRInvd[KC_BATCH_UPDATE_MAX_ROWS * KC_BATCH_UPDATE_MAX_ROWS];
+  arm_matrix_instance_f32 HPHRInvm = {rows, rows, HPHRInvd};
+
+  ASSERT(rows >= 1 && rows <= KC_BATCH_UPDATE_MAX_ROWS);
+  ASSERT(Hm->numCols == KC_STATE_DIM);
+  ASSERT(Rm->numRows == rows && Rm->numCols == rows);
+
+  // ====== INNOVATION COVARIANCE ======
+
+  mat_trans(Hm, &HTm);
+  mat_mult(&this->Pm, &HTm, &PHTm); // PH'
+  mat_mult(Hm, &PHTm, &HPHRm); // HPH'
+  for (int i=0; i<rows*rows; i++) {
+    HPHRd[i] += Rm->pData[i]; // HPH' + R
+    ASSERT(!isnan(HPHRd[i]));
+  }
+
+  // ====== MEASUREMENT UPDATE ======
+  // Calculate the Kalman gain and perform the state update
+  mat_inv(&HPHRm, &HPHRInvm); // (HPH' + R)^-1, note that HPHRm is overwritten
+  mat_mult(&PHTm, &HPHRInvm, &Km); // kalman gain = (PH' (HPH' + R )^-1)
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    for (int j=0; j<rows; j++) {
+      this->S[i] = this->S[i] + Kd[i*rows + j] * errors[j]; // state update
+    }
+  }
+  assertStateNotNaN(this);
+
+  // ====== COVARIANCE UPDATE ======
+  mat_mult(&Km, Hm, &tmpNN1m); // KH
+  for (int i=0; i<KC_STATE_DIM; i++) { tmpNN1d[KC_STATE_DIM*i+i] -= 1; } // KH - I
+  mat_trans(&tmpNN1m, &tmpNN2m); // (KH - I)'
+  mat_mult(&tmpNN1m, &this->Pm, &tmpNN3m); // (KH - I)*P
+  mat_mult(&tmpNN3m, &tmpNN2m, &this->Pm); // (KH - I)*P*(KH - I)'
+  assertStateNotNaN(this);
+
+  // add the measurement variance KRK' and ensure boundedness and symmetry
+  mat_mult(&Km, Rm, &KRm); // KR
+  for (int i=0; i<KC_STATE_DIM; i++) {
+    for (int j=i; j<KC_STATE_DIM; j++) {
+      float v = 0.0f;
+      for (int k=0; k<rows; k++) {
+        v += KRd[i*rows + k] * Kd[j*rows + k];
+      }
+      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i] + v; // add measurement noise
+      if (isnan(p) || p > MAX_COVARIANCE) {
+        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
+      } else if ( i==j && p < MIN_COVARIANCE ) {
+        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
+      } else {
+        this->P[i][j] = this->P[j][i] = p;
+      }
     }
-    // ====== COVARIANCE UPDATE ====== //
-    mat_mult(Km, Hm, &tmpNN1m);                 // KH,  the Kalman Gain and H are the updated Kalman Gain and H
-    mat_scale(&tmpNN1m, -1.0f, &tmpNN1m);       //  I-KH
-    for (int i=0; i<KC_STATE_DIM; i++) { tmpNN1d[i][i] = 1.0f + tmpNN1d[i][i]; }
-    float Ppo[KC_STATE_DIM][KC_STATE_DIM]={0};
-    arm_matrix_instance_f32 Ppom = {KC_STATE_DIM, KC_STATE_DIM, (float *)Ppo};
-    mat_mult(&tmpNN1m, P_w_m, &Ppom);          // Pm = (I-KH)*P_w_m
-    memcpy(this->P, Ppo, sizeof(this->P));
-
-    assertStateNotNaN(this);
-
-    for (int i=0; i<KC_STATE_DIM; i++) {
-        for (int j=i; j<KC_STATE_DIM; j++) {
-        float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i];
-        if (isnan(p) || p > MAX_COVARIANCE) {
-            this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
-        } else if ( i==j && p < MIN_COVARIANCE ) {
-            this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
-        } else {
-            this->P[i][j] = this->P[j][i] = p;
-            }
+  }
+
+  assertStateNotNaN(this);
+
+  this->isUpdated = true;
+}
+
+// The robust update only handles measurements of the position
+#define ROBUST_DIM 3
+#define ROBUST_MAX_ITER 2
+// Iterations stop when all weights and the measurement Jacobian are this close to the previous iteration
+#define ROBUST_TOLERANCE 0.01f
+#define ROBUST_MIN_VALUE 0.0001f
+#define ROBUST_CHOLESKY_BOUND 100.0f
+
+// Geman-McClure weight of a normalized error
+static float robustWeight(const float error, const float sigma) {
+  const float denominator = sigma + error * error;
+  return (sigma * sigma) / (denominator * denominator);
+}
+
+void kalmanCoreRobustScalarUpdate(kalmanCoreData_t* this, kalmanCoreRobustModel_t model, const void* measurement, const float measured, const float stdDev, const float sigmaMeasurement, const float sigmaState)
+{
+  // Only the first three columns of the Cholesky factor L of P are involved in a position measurement.
+  // Reweighting the state errors scales these columns, P_w = L C^2 L' where C is diagonal and one for
+  // all other states. The iterations are done on the three scale factors in C, the covariance matrix is
+  // updated once at the end.
+  NO_DMA_CCM_SAFE_ZERO_INIT static float L[KC_STATE_DIM][ROBUST_DIM];
+
+  const float prior[ROBUST_DIM] = {this->S[KC_STATE_X], this->S[KC_STATE_Y], this->S[KC_STATE_Z]};
+  float predicted;
+  float h[ROBUST_DIM];
+  if (!model(prior, measurement, &predicted, h)) {
+    return;
+  }
+
+  // The innovation based on the prior state, it does not change during the iterations
+  const float error = measured - predicted;
+
+  for (int j = 0; j < ROBUST_DIM; j++) {
+    float diagonal = this->P[j][j];
+    for (int k = 0; k < j; k++) {
+      diagonal -= L[j][k] * L[j][k];
+    }
+    L[j][j] = diagonal > 0.0f ? fminf(sqrtf(diagonal), ROBUST_CHOLESKY_BOUND) : 0.0f;
+
+    for (int i = j + 1; i < KC_STATE_DIM; i++) {
+      float v = 0.0f;
+      if (L[j][j] > 0.0f) {
+        v = this->P[i][j];
+        for (int k = 0; k < j; k++) {
+          v -= L[i][k] * L[j][k];
+        }
+        v /= L[j][j];
+      }
+      L[i][j] = isnan(v) ? ROBUST_CHOLESKY_BOUND : fmaxf(fminf(v, ROBUST_CHOLESKY_BOUND), -ROBUST_CHOLESKY_BOUND);
+    }
+  }
+
+  float c[ROBUST_DIM] = {1.0f, 1.0f, 1.0f};
+  float cu[ROBUST_DIM] = {0};   // C L' h'
+  float R = stdDev * stdDev;
+  float s = 1.0f;               // h P_w h' + R
+
+  for (int iter = 0; iter < ROBUST_MAX_ITER; iter++) {
+    float errorIter = error;
+    float wx[ROBUST_DIM] = {1.0f, 1.0f, 1.0f};
+    bool isConverged = (iter > 0);
+
+    if (iter > 0) {
+      // Linearize around the state of the previous iteration, x_err = L C C L' h' error / s
+      float position[ROBUST_DIM];
+      float hPrevious[ROBUST_DIM];
+      for (int i = 0; i < ROBUST_DIM; i++) {
+        position[i] = prior[i];
+        for (int j = 0; j <= i; j++) {
+          position[i] += L[i][j] * c[j] * cu[j] * error / s;
         }
+        hPrevious[i] = h[i];
+      }
+      if (!model(position, measurement, &predicted, h)) {
+        break;
+      }
+      errorIter = measured - predicted;
+
+      // The normalized state error (L C)^-1 x_err is C L' h' error / s
+      for (int j = 0; j < ROBUST_DIM; j++) {
+        wx[j] = robustWeight(cu[j] * error / s, sigmaState);
+        isConverged = isConverged && fabsf(wx[j] - 1.0f) < ROBUST_TOLERANCE && fabsf(h[j] - hPrevious[j]) < ROBUST_TOLERANCE;
+      }
+    }
+
+    const float wy = robustWeight(errorIter / fmaxf(sqrtf(R), ROBUST_MIN_VALUE), sigmaMeasurement);
+    if (isConverged && fabsf(wy - 1.0f) < ROBUST_TOLERANCE) {
+      // One more iteration would reproduce the gain of the previous one
+      break;
     }
-    assertStateNotNaN(this);
 
-    this->isUpdated = true;
+    R = R / fmaxf(wy, ROBUST_MIN_VALUE);
+
+    s = R;
+    for (int j = 0; j < ROBUST_DIM; j++) {
+      c[j] = c[j] / sqrtf(wx[j]);
+      float u = 0.0f;
+      for (int i = j; i < ROBUST_DIM; i++) {
+        u += L[i][j] * h[i];
+      }
+      cu[j] = c[j] * u;
+      s += cu[j] * cu[j];
+    }
+  }
+
+  // ====== MEASUREMENT UPDATE ======
+  // The Kalman gain K = P_w h' / s = L C C L' h' / s
+  float K[KC_STATE_DIM];
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    K[i] = 0.0f;
+    for (int j = 0; j < ROBUST_DIM && j <= i; j++) {
+      K[i] += L[i][j] * c[j] * cu[j];
+    }
+    K[i] /= s;
+    this->S[i] = this->S[i] + K[i] * error;
+  }
+  assertStateNotNaN(this);
+
+  // ====== COVARIANCE UPDATE ======
+  // (I - Kh) P_w = P_w - s K K' where P_w = P + L (C^2 - I) L', ensure boundedness and symmetry
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = i; j < KC_STATE_DIM; j++) {
+      float p = 0.5f*this->P[i][j] + 0.5f*this->P[j][i] - s * K[i] * K[j];
+      for (int k = 0; k < ROBUST_DIM && k <= i; k++) {
+        p += (c[k] * c[k] - 1.0f) * L[i][k] * L[j][k];
+      }
+      if (isnan(p) || p > MAX_COVARIANCE) {
+        this->P[i][j] = this->P[j][i] = MAX_COVARIANCE;
+      } else if ( i==j && p < MIN_COVARIANCE ) {
+        this->P[i][j] = this->P[j][i] = MIN_COVARIANCE;
+      } else {
+        this->P[i][j] = this->P[j][i] = p;
+      }
+    }
+  }
+  assertStateNotNaN(this);
+
+  this->isUpdated = true;
 }
 
 void kalmanCoreUpdateWithBaro(kalmanCoreData_t *this, const kalmanCoreParams_t *params, float baroAsl, bool quadIsFlying)
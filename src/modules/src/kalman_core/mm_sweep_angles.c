@@ -24,6 +24,7 @@
  */
 
 #include "mm_sweep_angles.h"
+#include "lighthouse_calibration.h"
 
 
 void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasurement_t *sweepInfo, const uint32_t nowMs, OutlierFilterLhState_t* sweepOutlierFilterState) {
@@ -55,12 +56,18 @@ void kalmanCoreUpdateWithSweepAngles(kalmanCoreData_t *this, sweepAngleMeasureme
   const float y = sr[1];
   const float z = sr[2];
   const float t = sweepInfo->t;
-  const float tan_t = tanf(t);
+  const lighthouseCalibrationSweepCache_t* calibCache = sweepInfo->calibCache;
+  const float tan_t = calibCache ? calibCache->tanT : tanf(t);
 
   const float r2 = x * x + y * y;
   const float r = arm_sqrt(r2);
 
-  const float predictedSweepAngle = sweepInfo->calibrationMeasurementModel(x, y, z, t, sweepInfo->calib);
+  float predictedSweepAngle;
+  if (calibCache) {
+    predictedSweepAngle = lighthouseCalibrationMeasurementModelLh2Cached(x, y, z, r, calibCache);
+  } else {
+    predictedSweepAngle = sweepInfo->calibrationMeasurementModel(x, y, z, t, sweepInfo->calib);
+  }
   const float measuredSweepAngle = sweepInfo->measuredSweepAngle;
   const float error = measuredSweepAngle - predictedSweepAngle;
 
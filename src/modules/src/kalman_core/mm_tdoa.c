@@ -23,6 +23,8 @@
  *
  */
 
+#include <string.h>
+
 #include "mm_tdoa.h"
 #include "test_support.h"
 
@@ -92,3 +94,97 @@ void kalmanCoreUpdateWithTdoa(kalmanCoreData_t* this, tdoaMeasurement_t *tdoa, c
     }
   }
 }
+
+void kalmanCoreUpdateWithTdoaBatch(kalmanCoreData_t* this, tdoaBatchMeasurement_t *tdoaBatch, const uint32_t nowMs, OutlierFilterTdoaState_t* outlierFilterState)
+{
+  /**
+   * Measurement equation for each pair:
+   * dR = dT + d1 - d0
+   * where d1 is the distance to the anchor that sent the packet and d0 the distance to the remote anchor
+   */
+
+  float h[TDOA_BATCH_MAX_PAIRS * KC_STATE_DIM] = {0};
+  float errors[TDOA_BATCH_MAX_PAIRS];
+  int rows = 0;
+
+  float x = this->S[KC_STATE_X];
+  float y = this->S[KC_STATE_Y];
+  float z = this->S[KC_STATE_Z];
+
+  float dx1 = x - tdoaBatch->anchorPosition.x;
+  float dy1 = y - tdoaBatch->anchorPosition.y;
+  float dz1 = z - tdoaBatch->anchorPosition.z;
+  float d1 = sqrtf(powf(dx1, 2) + powf(dy1, 2) + powf(dz1, 2));
+
+  if (d1 == 0.0f) {
+    return;
+  }
+
+  for (int i = 0; i < tdoaBatch->pairCount && i < TDOA_BATCH_MAX_PAIRS; i++) {
+    tdoaMeasurement_t tdoa = {
+      .anchorPositions = {tdoaBatch->remoteAnchorPositions[i], tdoaBatch->anchorPosition},
+      .anchorIds = {tdoaBatch->remoteAnchorIds[i], tdoaBatch->anchorId},
+      .distanceDiff = tdoaBatch->distanceDiffs[i],
+      .stdDev = tdoaBatch->stdDev,
+    };
+
+    float dx0 = x - tdoa.anchorPositions[0].x;
+    float dy0 = y - tdoa.anchorPositions[0].y;
+    float dz0 = z - tdoa.anchorPositions[0].z;
+    float d0 = sqrtf(powf(dx0, 2) + powf(dy0, 2) + powf(dz0, 2));
+
+    if (d0 == 0.0f) {
+      continue;
+    }
+
+    float error = tdoa.distanceDiff - (d1 - d0);
+    float* row = &h[rows * KC_STATE_DIM];
+    row[KC_STATE_X] = (dx1 / d1 - dx0 / d0);
+    row[KC_STATE_Y] = (dy1 / d1 - dy0 / d0);
+    row[KC_STATE_Z] = (dz1 / d1 - dz0 / d0);
+
+  #if CONFIG_ESTIMATOR_KALMAN_TDOA_OUTLIERFILTER_FALLBACK
+    vector_t jacobian = {
+      .x = row[KC_STATE_X],
+      .y = row[KC_STATE_Y],
+      .z = row[KC_STATE_Z],
+    };
+
+    point_t estimatedPosition = {
+      .x = x,
+      .y = y,
+      .z = z,
+    };
+
+    bool sampleIsGood = outlierFilterTdoaValidateSteps(&tdoa, error, &jacobian, &estimatedPosition);
+  #else
+    bool sampleIsGood = outlierFilterTdoaValidateIntegrator(outlierFilterState, &tdoa, error, nowMs);
+  #endif
+
+    if (sampleIsGood) {
+      errors[rows] = error;
+      rows++;
+    } else {
+      memset(row, 0, KC_STATE_DIM * sizeof(float));
+    }
+  }
+
+  if (rows == 1) {
+    arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+    kalmanCoreScalarUpdate(this, &H, errors[0], tdoaBatch->stdDev);
+  } else if (rows > 1) {
+    // All pairs share the receive time of the packet from the anchor, half of the variance of a distance
+    // difference is common to all rows.
+    float variance = tdoaBatch->stdDev * tdoaBatch->stdDev;
+    float r[TDOA_BATCH_MAX_PAIRS * TDOA_BATCH_MAX_PAIRS];
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < rows; j++) {
+        r[i * rows + j] = (i == j) ? variance : 0.5f * variance;
+      }
+    }
+
+    arm_matrix_instance_f32 H = {rows, KC_STATE_DIM, h};
+    arm_matrix_instance_f32 R = {rows, rows, r};
+    kalmanCoreBatchUpdate(this, &H, errors, &R);
+  }
+}
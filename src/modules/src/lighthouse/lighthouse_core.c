@@ -401,7 +401,7 @@ static void usePulseResult(pulseProcessor_t *appState, pulseProcessorResult_t* a
         STATS_CNT_RATE_EVENT_DEBUG(&preThrottleRate);
         bool useSample = true;
         if (lighthouseBsTypeV2 == angles->measurementType) {
-          useSample = throttleLh2Samples(now_ms);
+          useSample = throttleLh2Samples(now_ms, baseStation, &appState->bsGeometry[baseStation], &angles->baseStationMeasurementsLh2[baseStation]);
         }
 
         if (useSample) {
@@ -25,6 +25,9 @@
  * lighthouse_position_est.c - position estimaton for the lighthouse system
  */
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "stabilizer_types.h"
 #include "estimator.h"
 #include "estimator_kalman.h"
@@ -80,6 +83,7 @@ static void modifyBit(uint16_t *bitmap, const int index, const bool value) {
 void lighthousePositionEstInit() {
   for (int i = 0; i < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS; i++) {
     lighthousePositionGeometryDataUpdated(i);
+    lighthousePositionCalibrationDataWritten(i);
   }
   memoryRegisterHandler(&memDef);
 }
@@ -162,7 +166,14 @@ static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const
 
 void lighthousePositionCalibrationDataWritten(const uint8_t baseStation) {
   if (baseStation < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS) {
-    modifyBit(&lighthouseCoreState.baseStationCalibValidMap, baseStation, lighthouseCoreState.bsCalibration[baseStation].valid);
+    const lighthouseCalibration_t* calib = &lighthouseCoreState.bsCalibration[baseStation];
+    if (calib->valid) {
+      lighthouseCalibrationSweepCache_t* cache = lighthouseCoreState.bsCalibCache[baseStation];
+      lighthouseCalibrationPrecomputeLh2(&calib->sweep[0], -t30, &cache[0]);
+      lighthouseCalibrationPrecomputeLh2(&calib->sweep[1], t30, &cache[1]);
+    }
+
+    modifyBit(&lighthouseCoreState.baseStationCalibValidMap, baseStation, calib->valid);
   }
 }
 
@@ -221,35 +232,44 @@ static float sweepStdLh2 = 0.001;
 static vec3d position;
 static vec3d positionLog;
 static float deltaLog;
+static float residualLog;
+static lighthouseGeometryRays_t crossingBeamRays;
+static float crossingBeamResidualFactor = 2.0f;
 
-static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation1, int baseStation2) {
-  memset(&ext_pos, 0, sizeof(ext_pos));
-  uint8_t sensorsUsed = 0;
-  float deltaSum = 0;
-  float delta;
+float lighthousePositionGetSweepStdLh2() {
+  return sweepStdLh2;
+}
 
-  const baseStationGeometry_t* geo1 = &state->bsGeometry[baseStation1];
-  const baseStationGeometry_t* geo2 = &state->bsGeometry[baseStation2];
+static void addCrossingBeamRays(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation) {
+  float anglesH[PULSE_PROCESSOR_N_SENSORS];
+  float anglesV[PULSE_PROCESSOR_N_SENSORS];
+  uint8_t sensorMask = 0;
 
-  // Average over all sensors with valid data
   for (size_t sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
-      // LH2 angles are converted to LH1 angles, so it is OK to use sensorMeasurementsLh1
-    pulseProcessorSensorMeasurement_t* measurement1 = &angles->baseStationMeasurementsLh1[baseStation1].sensorMeasurements[sensor];
-    pulseProcessorSensorMeasurement_t* measurement2 = &angles->baseStationMeasurementsLh1[baseStation2].sensorMeasurements[sensor];
+    // LH2 angles are converted to LH1 angles, so it is OK to use sensorMeasurementsLh1
+    const pulseProcessorSensorMeasurement_t* measurement = &angles->baseStationMeasurementsLh1[baseStation].sensorMeasurements[sensor];
+    anglesH[sensor] = measurement->correctedAngles[0];
+    anglesV[sensor] = measurement->correctedAngles[1];
+    if (measurement->validCount == PULSE_PROCESSOR_N_SWEEPS) {
+      sensorMask |= (1 << sensor);
+    }
+  }
 
-    if (measurement1->validCount == PULSE_PROCESSOR_N_SWEEPS && measurement2->validCount == PULSE_PROCESSOR_N_SWEEPS) {
-      if (lighthouseGeometryGetPositionFromRayIntersection(geo1, geo2, measurement1->correctedAngles, measurement2->correctedAngles, position, &delta)) {
+  lighthouseGeometryRaysAdd(&crossingBeamRays, &state->bsGeometry[baseStation], anglesH, anglesV, sensorMask);
+}
 
-        deltaSum += delta;
+static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulseProcessorResult_t* angles, int baseStation1, int baseStation2) {
+  memset(&ext_pos, 0, sizeof(ext_pos));
 
-        ext_pos.x += position[0];
-        ext_pos.y += position[1];
-        ext_pos.z += position[2];
-        sensorsUsed++;
+  // All sensors and base stations are solved in one least squares pass
+  lighthouseGeometryRaysInit(&crossingBeamRays, PULSE_PROCESSOR_N_SENSORS);
+  addCrossingBeamRays(state, angles, baseStation1);
+  addCrossingBeamRays(state, angles, baseStation2);
 
-        STATS_CNT_RATE_EVENT(&positionRate);
-      }
-    }
+  float residual;
+  const int sensorsUsed = lighthouseGeometryRaysSolve(&crossingBeamRays, position, &residual);
+  for (int i = 0; i < sensorsUsed; i++) {
+    STATS_CNT_RATE_EVENT(&positionRate);
   }
 
   // Only use measurement if we got all sensors, otherwise we would need to know the exact orientation
@@ -257,10 +277,12 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
   // We shouldn't use the kalman filter here, since crossing beam method should not make any assumptions about
   // robot dynamics.
   if (sensorsUsed == PULSE_PROCESSOR_N_SENSORS) {
-    deltaLog = deltaSum / sensorsUsed;
-    ext_pos.x /= sensorsUsed;
-    ext_pos.y /= sensorsUsed;
-    ext_pos.z /= sensorsUsed;
+    // With two rays per sensor, the distance between the rays is twice the residual
+    deltaLog = 2.0f * residual;
+    residualLog = residual;
+    ext_pos.x = position[0];
+    ext_pos.y = position[1];
+    ext_pos.z = position[2];
 
     positionLog[0] = ext_pos.x;
     positionLog[1] = ext_pos.y;
@@ -268,7 +290,8 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
 
     // Make sure we feed sane data into the estimator
     if (isfinite(ext_pos.pos[0]) && isfinite(ext_pos.pos[1]) && isfinite(ext_pos.pos[2])) {
-      ext_pos.stdDev = 0.01;
+      // Rays that do not meet indicate a bad fix, trust it less
+      ext_pos.stdDev = fmaxf(0.01f, residual * crossingBeamResidualFactor);
       ext_pos.source = MeasurementSourceLighthouse;
       #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
         estimatorEnqueuePosition(&ext_pos);
@@ -276,6 +299,7 @@ static void estimatePositionCrossingBeams(const pulseProcessor_t *state, pulsePr
     }
   } else {
     deltaLog = 0;
+    residualLog = 0;
   }
 }
 
@@ -286,6 +310,7 @@ static void estimatePositionSweepsLh1(const pulseProcessor_t* appState, pulsePro
   sweepInfo.rotorPos = &appState->bsGeometry[baseStation].origin;
   sweepInfo.t = 0;
   sweepInfo.calibrationMeasurementModel = lighthouseCalibrationMeasurementModelLh1;
+  sweepInfo.calibCache = 0;
   sweepInfo.baseStationId = baseStation;
 
   for (size_t sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
@@ -334,6 +359,9 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
   sweepInfo.calibrationMeasurementModel = lighthouseCalibrationMeasurementModelLh2;
   sweepInfo.baseStationId = baseStation;
 
+  // The angles are processed when the next block from the base station is received, use the time they were measured
+  const uint32_t captureMs = T2M(xTaskGetTickCount()) - angles->ageUs[baseStation] / 1000;
+
   for (size_t sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
     sweepInfo.sensorId = sensor;
     pulseProcessorSensorMeasurement_t* measurement = &angles->baseStationMeasurementsLh2[baseStation].sensorMeasurements[sensor];
@@ -344,9 +372,10 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
       if (sweepInfo.measuredSweepAngle != 0) {
         sweepInfo.t = -t30;
         sweepInfo.calib = &bsCalib->sweep[0];
+        sweepInfo.calibCache = &appState->bsCalibCache[baseStation][0];
         sweepInfo.sweepId = 0;
         #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-          estimatorEnqueueSweepAngles(&sweepInfo);
+          estimatorEnqueueSweepAnglesAt(&sweepInfo, captureMs);
         #endif
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
@@ -356,9 +385,10 @@ static void estimatePositionSweepsLh2(const pulseProcessor_t* appState, pulsePro
       if (sweepInfo.measuredSweepAngle != 0) {
         sweepInfo.t = t30;
         sweepInfo.calib = &bsCalib->sweep[1];
+        sweepInfo.calibCache = &appState->bsCalibCache[baseStation][1];
         sweepInfo.sweepId = 1;
         #ifndef CONFIG_DECK_LIGHTHOUSE_AS_GROUNDTRUTH
-          estimatorEnqueueSweepAngles(&sweepInfo);
+          estimatorEnqueueSweepAnglesAt(&sweepInfo, captureMs);
         #endif
         STATS_CNT_RATE_EVENT(bsEstRates[baseStation]);
         STATS_CNT_RATE_EVENT(&positionRate);
@@ -480,6 +510,10 @@ LOG_ADD_CORE(LOG_FLOAT, y, &positionLog[1])
 LOG_ADD_CORE(LOG_FLOAT, z, &positionLog[2])
 
 LOG_ADD(LOG_FLOAT, delta, &deltaLog)
+/**
+ * @brief Root mean square distance (m) from the rays to the sensor positions found with the crossing beams method
+ */
+LOG_ADD(LOG_FLOAT, cbResidual, &residualLog)
 
 LOG_ADD_CORE(LOG_UINT16, bsGeoVal, &lighthouseCoreState.baseStationGeoValidMap)
 LOG_ADD_CORE(LOG_UINT16, bsCalVal, &lighthouseCoreState.baseStationCalibValidMap)
@@ -495,4 +529,8 @@ PARAM_ADD_CORE(PARAM_FLOAT, sweepStd, &sweepStd)
  * @brief Standard deviation Sweep angles Lighthouse V2
  */
 PARAM_ADD_CORE(PARAM_FLOAT, sweepStd2, &sweepStdLh2)
+/**
+ * @brief Standard deviation of crossing beam positions, relative to the residual of the rays. The minimum is 0.01 m.
+ */
+PARAM_ADD(PARAM_FLOAT, cbResStd, &crossingBeamResidualFactor)
 PARAM_GROUP_STOP(lighthouse)
@@ -92,7 +92,7 @@ static void lhPersistDataWorker(void* arg) {
 
 void lighthouseStoragePersistCalibDataBackground(const uint8_t baseStation) {
   if (baseStation < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS) {
-    workerSchedule(lhPersistDataWorker, (void*)(uint32_t)baseStation);
+    workerScheduleWithPriority(lhPersistDataWorker, (void*)(uint32_t)baseStation, WORKER_PRIORITY_LOW, 0);
   }
 }
 
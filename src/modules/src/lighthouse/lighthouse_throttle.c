@@ -24,8 +24,12 @@
  *
  */
 
-#include <stdlib.h>
+
+#include <math.h>
 #include "lighthouse_throttle.h"
+#include "lighthouse_position_est.h"
+#include "estimator.h"
+#include "estimator_kalman.h"
 #include "param.h"
 
 // Uncomment next line to add extra debug log variables
@@ -33,14 +37,106 @@
 #include "log.h"
 
 static const uint32_t evaluationIntervalMs = 100;
+// Scores older than this belong to base stations that are no longer received
+static const uint32_t scoreTimeoutMs = 2 * evaluationIntervalMs;
+// The number of samples that can be forwarded in a burst
+static const float maxTokens = 2.0f;
+
 static uint16_t maxRate = 50;  // Samples / second
 static float discardProbability = 0.0f;
+static float latestScore = 0.0f;
+
+static float scores[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+static uint32_t scoreTimesMs[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+static bool hasScore[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+static uint32_t usedTimesMs[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+
+// The information score needs the position covariance, which only the kalman estimator has
+static bool isInformationScoreAvailable() {
+    #ifdef CONFIG_ESTIMATOR_KALMAN_ENABLE
+    return stateEstimatorGetType() == StateEstimatorTypeKalman;
+    #else
+    return false;
+    #endif
+}
+
+// Expected information (nats) in the sweeps from one base station. Each sensor measures the two directions
+// perpendicular to the ray from the base station, the uncertainty of the estimated position in those directions is
+// compared to the measurement noise at the current distance. The uncertainty along the ray can not be reduced by the sample.
+static float informationScore(const baseStationGeometry_t* geometry, const pulseProcessorBaseStationMeasurement_t* measurement) {
+    int sensorCount = 0;
+    for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+        if (measurement->sensorMeasurements[sensor].validCount == PULSE_PROCESSOR_N_SWEEPS) {
+            sensorCount++;
+        }
+    }
+
+    if (sensorCount == 0) {
+        return 0.0f;
+    }
+
+    point_t position;
+    estimatorKalmanGetEstimatedPos(&position);
+    float P[3][3];
+    estimatorKalmanGetEstimatedPosCovariance((float*)P);
+
+    vec3d baseStationPos;
+    lighthouseGeometryGetBaseStationPosition(geometry, baseStationPos);
+
+    const float d[3] = {position.x - baseStationPos[0], position.y - baseStationPos[1], position.z - baseStationPos[2]};
+    float distanceSquared = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    if (distanceSquared < 0.01f) {
+        distanceSquared = 0.01f;
+    }
+
+    float rayVariance = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            rayVariance += d[i] * P[i][j] * d[j];
+        }
+    }
+    rayVariance /= distanceSquared;
+
+    const float trace = P[0][0] + P[1][1] + P[2][2];
+    float perpendicularVariance = (trace - rayVariance) / 2.0f;
+    if (perpendicularVariance < 0.0f) {
+        perpendicularVariance = 0.0f;
+    }
+    const float sweepStdDev = lighthousePositionGetSweepStdLh2();
+    const float noiseVariance = distanceSquared * sweepStdDev * sweepStdDev;
 
-bool throttleLh2Samples(const uint32_t nowMs) {
+    // Two directions per sensor, 0.5 * log(1 + signal / noise) each
+    return sensorCount * logf(1.0f + perpendicularVariance / noiseVariance);
+}
+
+// Used when there is no information score, the base station that has waited the longest since it was used scores
+// the highest. The base stations take turns and share the rate evenly.
+static float waitingScore(const int baseStation, const uint32_t nowMs) {
+    return (float)(nowMs - usedTimesMs[baseStation]);
+}
+
+// The number of base stations, received recently, that have a better score than the given one
+static int rankOfScore(const int baseStation, const float score, const uint32_t nowMs, int* activeCount) {
+    int rank = 0;
+    *activeCount = 0;
+    for (int bs = 0; bs < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS; bs++) {
+        if (hasScore[bs] && (nowMs - scoreTimesMs[bs]) <= scoreTimeoutMs) {
+            (*activeCount)++;
+            if (bs != baseStation && scores[bs] > score) {
+                rank++;
+            }
+        }
+    }
+
+    return rank;
+}
+
+bool throttleLh2Samples(const uint32_t nowMs, const int baseStation, const baseStationGeometry_t* geometry, const pulseProcessorBaseStationMeasurement_t* measurement) {
     static uint32_t previousEvaluationTime = 0;
     static uint32_t nextEvaluationTime = 0;
     static uint32_t eventCounter = 0;
-    static int discardThreshold = 0;
+    static uint32_t previousTokenTime = 0;
+    static float tokens = 0.0f;
 
     eventCounter++;
 
@@ -51,14 +147,49 @@ bool throttleLh2Samples(const uint32_t nowMs) {
         } else {
             discardProbability = 1.0f - (float)maxRate / currentRate;
         }
-        discardThreshold = RAND_MAX * discardProbability;
 
         previousEvaluationTime = nowMs;
         eventCounter = 0;
         nextEvaluationTime = nowMs + evaluationIntervalMs;
     }
 
-    return (rand() > discardThreshold);
+    tokens += (float)maxRate * (float)(nowMs - previousTokenTime) / 1000.0f;
+    if (tokens > maxTokens) {
+        tokens = maxTokens;
+    }
+    previousTokenTime = nowMs;
+
+    if (discardProbability == 0.0f) {
+        if (tokens >= 1.0f) {
+            tokens -= 1.0f;
+        }
+        usedTimesMs[baseStation] = nowMs;
+        return true;
+    }
+
+    float score;
+    if (isInformationScoreAvailable()) {
+        score = informationScore(geometry, measurement);
+    } else {
+        score = waitingScore(baseStation, nowMs);
+    }
+    latestScore = score;
+    scores[baseStation] = score;
+    scoreTimesMs[baseStation] = nowMs;
+    hasScore[baseStation] = true;
+
+    // Forward the samples from the base stations that are best right now, as many as the rate allows
+    int activeCount = 0;
+    const int rank = rankOfScore(baseStation, score, nowMs, &activeCount);
+    const int keepCount = (int)ceilf((1.0f - discardProbability) * activeCount);
+
+    if (rank < keepCount && tokens >= 1.0f) {
+        tokens -= 1.0f;
+        usedTimesMs[baseStation] = nowMs;
+        return true;
+    }
+
+    return false;
 }
 
 PARAM_GROUP_START(lighthouse)
@@ -75,4 +206,5 @@ PARAM_GROUP_STOP(lighthouse)
 
 LOG_GROUP_START(lighthouse)
 LOG_ADD_DEBUG(LOG_FLOAT, disProb, &discardProbability)
+LOG_ADD_DEBUG(LOG_FLOAT, lh2Score, &latestScore)
 LOG_GROUP_STOP(lighthouse)
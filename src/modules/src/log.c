@@ -98,16 +98,30 @@ struct log_ops {
   acquisitionType_t acquisitionType;
 };
 
+/* Bundles send several blocks in one packet on the bundle channel. Blocks
+ * whose period is a multiple of the bundle period share its timer and phase. */
+#define LOG_MAX_BUNDLES 4
+struct log_bundle {
+  unsigned int period;          // ms, 0 if the bundle is free
+  xTimerHandle timer;
+  StaticTimer_t timerBuffer;
+  uint32_t tick;
+  uint32_t droppedPackets;
+};
+
 struct log_block {
   int id;
   xTimerHandle timer;
   StaticTimer_t timerBuffer;
   uint32_t droppedPackets;
   struct log_ops * ops;
+  struct log_bundle * bundle;   // NULL if the block is not bundled
+  uint16_t bundleDivider;       // block is sent every bundleDivider bundle ticks
 };
 
 NO_DMA_CCM_SAFE_ZERO_INIT static struct log_ops logOps[LOG_MAX_OPS];
 NO_DMA_CCM_SAFE_ZERO_INIT static struct log_block logBlocks[LOG_MAX_BLOCKS];
+NO_DMA_CCM_SAFE_ZERO_INIT static struct log_bundle logBundles[LOG_MAX_BUNDLES];
 static xSemaphoreHandle logLock;
 static StaticSemaphore_t logLockBuffer;
 
@@ -125,6 +139,7 @@ struct ops_setting_v2 {
 #define TOC_CH      0
 #define CONTROL_CH  1
 #define LOG_CH      2
+#define BUNDLE_CH   3
 
 #define CMD_GET_ITEM    0 // original version: up to 255 entries
 #define CMD_GET_INFO    1 // original version: up to 255 entries
@@ -139,6 +154,7 @@ struct ops_setting_v2 {
 #define CONTROL_RESET           5
 #define CONTROL_CREATE_BLOCK_V2 6
 #define CONTROL_APPEND_BLOCK_V2 7
+#define CONTROL_START_BUNDLED   8
 
 #define BLOCK_ID_FREE -1
 
@@ -149,6 +165,8 @@ static void logControlProcess(void);
 
 void logRunBlock(void * arg);
 void logBlockTimed(xTimerHandle timer);
+void logRunBundle(void * arg);
+void logBundleTimed(xTimerHandle timer);
 
 //These are set by the Linker
 extern struct log_s _log_start;
@@ -171,6 +189,7 @@ static int logCreateBlock(unsigned char id, struct ops_setting * settings, int l
 static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings, int len);
 static int logDeleteBlock(int id);
 static int logStartBlock(int id, unsigned int period);
+static int logStartBundledBlock(int id, unsigned int period);
 static int logStopBlock(int id);
 static void logReset();
 static acquisitionType_t acquisitionTypeFromLogType(uint8_t logType);
@@ -406,6 +425,9 @@ void logControlProcess()
     case CONTROL_STOP_BLOCK:
       ret = logStopBlock( p.data[1] );
       break;
+    case CONTROL_START_BUNDLED:
+      ret = logStartBundledBlock( p.data[1], p.data[2]*10);
+      break;
     case CONTROL_RESET:
       logReset();
       ret = 0;
@@ -628,6 +650,57 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
   return 0;
 }
 
+static void bundleRemoveBlock(struct log_block * block)
+{
+  struct log_bundle * bundle = block->bundle;
+
+  if (!bundle)
+    return;
+
+  block->bundle = NULL;
+
+  for (int i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id != BLOCK_ID_FREE && logBlocks[i].bundle == bundle)
+      return;
+
+  // Last block left the bundle
+  xTimerStop(bundle->timer, portMAX_DELAY);
+  xTimerDelete(bundle->timer, portMAX_DELAY);
+  bundle->timer = 0;
+  bundle->period = 0;
+}
+
+/* Finds a bundle whose period divides the requested period or creates a new
+ * one. Returns NULL if no bundle is free. */
+static struct log_bundle * bundleGetOrCreate(unsigned int period)
+{
+  struct log_bundle * freeBundle = NULL;
+
+  for (int i=0; i<LOG_MAX_BUNDLES; i++)
+  {
+    if (logBundles[i].period == 0) {
+      if (!freeBundle)
+        freeBundle = &logBundles[i];
+    } else if (period % logBundles[i].period == 0) {
+      return &logBundles[i];
+    }
+  }
+
+  if (!freeBundle)
+    return NULL;
+
+  freeBundle->timer = xTimerCreateStatic("logBundle", M2T(period), pdTRUE,
+    freeBundle, logBundleTimed, &freeBundle->timerBuffer);
+  if (freeBundle->timer == NULL)
+    return NULL;
+
+  freeBundle->period = period;
+  freeBundle->tick = 0;
+  xTimerStart(freeBundle->timer, 100);
+
+  return freeBundle;
+}
+
 static int logDeleteBlock(int id)
 {
   int i;
@@ -655,6 +728,7 @@ static int logDeleteBlock(int id)
     xTimerDelete(logBlocks[i].timer, portMAX_DELAY);
     logBlocks[i].timer = 0;
   }
+  bundleRemoveBlock(&logBlocks[i]);
 
   logBlocks[i].id = BLOCK_ID_FREE;
   return 0;
@@ -674,6 +748,8 @@ static int logStartBlock(int id, unsigned int period)
 
   LOG_DEBUG("Starting block %d with period %dms\n", id, period);
 
+  bundleRemoveBlock(&logBlocks[i]);
+
   if (period>0)
   {
     xTimerChangePeriod(logBlocks[i].timer, M2T(period), 100);
@@ -686,6 +762,37 @@ static int logStartBlock(int id, unsigned int period)
   return 0;
 }
 
+static int logStartBundledBlock(int id, unsigned int period)
+{
+  int i;
+  struct log_bundle * bundle;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to start block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
+
+  if (period == 0)
+    return EINVAL;
+
+  LOG_DEBUG("Starting bundled block %d with period %dms\n", id, period);
+
+  xTimerStop(logBlocks[i].timer, portMAX_DELAY);
+  bundleRemoveBlock(&logBlocks[i]);
+
+  bundle = bundleGetOrCreate(period);
+  if (!bundle)
+    return ENOMEM;
+
+  logBlocks[i].bundleDivider = period / bundle->period;
+  logBlocks[i].bundle = bundle;
+
+  return 0;
+}
+
 static int logStopBlock(int id)
 {
   int i;
@@ -699,6 +806,7 @@ static int logStopBlock(int id)
   }
 
   xTimerStop(logBlocks[i].timer, portMAX_DELAY);
+  bundleRemoveBlock(&logBlocks[i]);
 
   return 0;
 }
@@ -706,7 +814,16 @@ static int logStopBlock(int id)
 /* This function is called by the timer subsystem */
 void logBlockTimed(xTimerHandle timer)
 {
-  workerSchedule(logRunBlock, pvTimerGetTimerID(timer));
+  // the block has to be sent before the next period starts
+  workerScheduleWithPriority(logRunBlock, pvTimerGetTimerID(timer),
+                             WORKER_PRIORITY_HIGH, xTimerGetPeriod(timer));
+}
+
+/* This function is called by the timer subsystem */
+void logBundleTimed(xTimerHandle timer)
+{
+  workerScheduleWithPriority(logRunBundle, pvTimerGetTimerID(timer),
+                             WORKER_PRIORITY_HIGH, xTimerGetPeriod(timer));
 }
 
 /* Appends data to a packet if space is available; returns false on failure. */
@@ -720,24 +837,11 @@ static bool appendToPacket(CRTPPacket * pk, const void * data, size_t n) {
   else return false;
 }
 
-/* This function is usually called by the worker subsystem */
-void logRunBlock(void * arg)
+/* Appends the values of a block to a packet. Values that do not fit are
+ * dropped. Must be called with logLock taken. */
+static void blockAppendValues(struct log_block * blk, unsigned int timestamp, CRTPPacket * pk)
 {
-  struct log_block *blk = arg;
   struct log_ops *ops = blk->ops;
-  static CRTPPacket pk;
-  unsigned int timestamp;
-
-  xSemaphoreTake(logLock, portMAX_DELAY);
-
-  timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
-
-  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
-  pk.size = 4;
-  pk.data[0] = blk->id;
-  pk.data[1] = timestamp&0x0ff;
-  pk.data[2] = (timestamp>>8)&0x0ff;
-  pk.data[3] = (timestamp>>16)&0x0ff;
 
   while (ops)
   {
@@ -853,21 +957,42 @@ void logRunBlock(void * arg)
       // drop this and subsequent items.
       if (ops->logType == LOG_FLOAT)
       {
-        if (!appendToPacket(&pk, &valuef, 4)) break;
+        if (!appendToPacket(pk, &valuef, 4)) break;
       }
       else
       {
         valuei = single2half(valuef);
-        if (!appendToPacket(&pk, &valuei, 2)) break;
+        if (!appendToPacket(pk, &valuei, 2)) break;
       }
     }
     else  //logType is an integer
     {
-      if (!appendToPacket(&pk, &valuei, typeLength[ops->logType])) break;
+      if (!appendToPacket(pk, &valuei, typeLength[ops->logType])) break;
     }
 
     ops = ops->next;
   }
+}
+
+/* This function is usually called by the worker subsystem */
+void logRunBlock(void * arg)
+{
+  struct log_block *blk = arg;
+  static CRTPPacket pk;
+  unsigned int timestamp;
+
+  xSemaphoreTake(logLock, portMAX_DELAY);
+
+  timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
+
+  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
+  pk.size = 4;
+  pk.data[0] = blk->id;
+  pk.data[1] = timestamp&0x0ff;
+  pk.data[2] = (timestamp>>8)&0x0ff;
+  pk.data[3] = (timestamp>>16)&0x0ff;
+
+  blockAppendValues(blk, timestamp, &pk);
 
   xSemaphoreGive(logLock);
 
@@ -892,6 +1017,76 @@ void logRunBlock(void * arg)
   }
 }
 
+static void bundleStartPacket(CRTPPacket * pk, unsigned int timestamp)
+{
+  pk->header = CRTP_HEADER(CRTP_PORT_LOG, BUNDLE_CH);
+  pk->size = 3;
+  pk->data[0] = timestamp&0x0ff;
+  pk->data[1] = (timestamp>>8)&0x0ff;
+  pk->data[2] = (timestamp>>16)&0x0ff;
+}
+
+static void bundleSendPacket(struct log_bundle * bundle, CRTPPacket * pk)
+{
+  // No need to block here, since logging is not guaranteed
+  if (!crtpSendPacket(pk))
+  {
+    if (bundle->droppedPackets++ % 100 == 0)
+    {
+      DEBUG_PRINT("WARNING: LOG bundle packets drop detected (%lu packets lost)\n",
+                  bundle->droppedPackets);
+    }
+  }
+}
+
+/* Sends all blocks of a bundle that are due in this tick. Blocks are packed
+ * into as few packets as possible, each block preceded by its id. Blocks
+ * never span packets. This function is usually called by the worker subsystem */
+void logRunBundle(void * arg)
+{
+  struct log_bundle *bundle = arg;
+  static CRTPPacket pk;
+  unsigned int timestamp;
+
+  // Check if the connection is still up, oherwise disable
+  // all the logging and flush all the CRTP queues.
+  if (!crtpIsConnected())
+  {
+    logReset();
+    crtpReset();
+    return;
+  }
+
+  xSemaphoreTake(logLock, portMAX_DELAY);
+
+  timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
+  bundleStartPacket(&pk, timestamp);
+
+  for (int i=0; i<LOG_MAX_BLOCKS; i++)
+  {
+    struct log_block *blk = &logBlocks[i];
+
+    if (blk->id == BLOCK_ID_FREE || blk->bundle != bundle || bundle->tick % blk->bundleDivider != 0)
+      continue;
+
+    if (pk.size + 1 + blockCalcLength(blk) > CRTP_MAX_DATA_SIZE)
+    {
+      bundleSendPacket(bundle, &pk);
+      bundleStartPacket(&pk, timestamp);
+    }
+
+    pk.data[pk.size++] = blk->id;
+    blockAppendValues(blk, timestamp, &pk);
+  }
+
+  if (pk.size > 3)
+    bundleSendPacket(bundle, &pk);
+
+  bundle->tick++;
+
+  xSemaphoreGive(logLock);
+}
+
 static int variableGetIndex(int id)
 {
   int i;
@@ -974,8 +1169,10 @@ static void logReset(void)
   }
 
   //Force free all the log block objects
-  for(i=0; i<LOG_MAX_BLOCKS; i++)
+  for(i=0; i<LOG_MAX_BLOCKS; i++) {
     logBlocks[i].id = BLOCK_ID_FREE;
+    logBlocks[i].bundle = NULL;
+  }
 
   //Force free the log ops
   for (i=0; i<LOG_MAX_OPS; i++)
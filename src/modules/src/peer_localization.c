@@ -16,24 +16,96 @@ bool peerLocalizationTest()
   return true;
 }
 
+// Velocities are only estimated from positions that are at most this far apart
+#define VELOCITY_MAX_GAP_MS 500
+// Time constant of the low pass filter on the estimated velocity
+#define VELOCITY_FILTER_TAU_MS 100.0f
+
 // array of other's position
 static peerLocalizationOtherPosition_t other_positions[PEER_LOCALIZATION_MAX_NEIGHBORS];
 
+static void updateVelocity(peerLocalizationOtherPosition_t *other, positionMeasurement_t const *pos, uint32_t now)
+{
+  uint32_t const dtMillis = T2M(now - other->pos.timestamp);
+
+  if (dtMillis == 0) {
+    // Several positions in one tick, keep the estimate
+    return;
+  }
+
+  if (dtMillis > VELOCITY_MAX_GAP_MS) {
+    other->hasVel = false;
+    other->vel.x = other->vel.y = other->vel.z = 0.0f;
+    return;
+  }
+
+  float const dt = dtMillis / 1000.0f;
+  float const vx = (pos->x - other->pos.x) / dt;
+  float const vy = (pos->y - other->pos.y) / dt;
+  float const vz = (pos->z - other->pos.z) / dt;
+
+  if (other->hasVel) {
+    float const alpha = dtMillis / (VELOCITY_FILTER_TAU_MS + dtMillis);
+    other->vel.x += alpha * (vx - other->vel.x);
+    other->vel.y += alpha * (vy - other->vel.y);
+    other->vel.z += alpha * (vz - other->vel.z);
+  } else {
+    other->vel.x = vx;
+    other->vel.y = vy;
+    other->vel.z = vz;
+    other->hasVel = true;
+  }
+  other->vel.timestamp = now;
+}
+
 bool peerLocalizationTellPosition(int cfid, positionMeasurement_t const *pos)
 {
+  uint32_t const now = xTaskGetTickCount();
+
   for (uint8_t i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
-    if (other_positions[i].id == 0 || other_positions[i].id == cfid) {
-      other_positions[i].id = cfid;
-      other_positions[i].pos.x = pos->x;
-      other_positions[i].pos.y = pos->y;
-      other_positions[i].pos.z = pos->z;
-      other_positions[i].pos.timestamp = xTaskGetTickCount();
-      return true;
+    if (other_positions[i].id == cfid) {
+      updateVelocity(&other_positions[i], pos, now);
+    } else if (other_positions[i].id == 0) {
+      other_positions[i].hasVel = false;
+    } else {
+      continue;
     }
+
+    other_positions[i].id = cfid;
+    other_positions[i].pos.x = pos->x;
+    other_positions[i].pos.y = pos->y;
+    other_positions[i].pos.z = pos->z;
+    other_positions[i].pos.timestamp = now;
+    return true;
   }
   return false;
 }
 
+void peerLocalizationPredictPosition(peerLocalizationOtherPosition_t const *other,
+  uint32_t tick, uint32_t maxHorizonMillis, point_t *pos)
+{
+  *pos = other->pos;
+
+  if (!other->hasVel) {
+    return;
+  }
+
+  // Ticks may be slightly older than the measurement if it arrived during the caller's loop
+  int32_t horizonMillis = (int32_t)T2M(tick - other->pos.timestamp);
+  if (horizonMillis <= 0) {
+    return;
+  }
+  if ((uint32_t)horizonMillis > maxHorizonMillis) {
+    horizonMillis = maxHorizonMillis;
+  }
+
+  float const dt = horizonMillis / 1000.0f;
+  pos->x += other->vel.x * dt;
+  pos->y += other->vel.y * dt;
+  pos->z += other->vel.z * dt;
+  pos->timestamp = tick;
+}
+
 bool peerLocalizationIsIDActive(uint8_t cfid)
 {
   for (uint8_t i = 0; i < PEER_LOCALIZATION_MAX_NEIGHBORS; ++i) {
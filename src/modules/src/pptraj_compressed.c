@@ -25,6 +25,7 @@
  */
 
 #include <stdint.h>
+#include <math.h>
 #include <string.h>
 
 #include "pptraj_compressed.h"
@@ -69,6 +70,11 @@ static inline float end_time_of_current_piece(const struct piecewise_traj_compre
 static inline float start_time_of_current_piece(const struct piecewise_traj_compressed *traj);
 static inline float time_relative_to_start_of_current_piece(const struct piecewise_traj_compressed *traj, float t);
 
+static uint8_t piece_length(compressed_piece_ptr ptr);
+static bool stream_copy(const struct piecewise_traj_compressed_stream *stream,
+  uint32_t offset, uint8_t* dst, uint32_t length);
+static bool stream_fetch_next_piece(struct piecewise_traj_compressed *traj);
+
 static void piecewise_compressed_advance_playhead(struct piecewise_traj_compressed *traj);
 static void piecewise_compressed_rewind(struct piecewise_traj_compressed *traj);
 static void piecewise_compressed_update_current_poly4d(
@@ -187,6 +193,76 @@ static compressed_piece_ptr parse_header_of_current_piece(
   }
 }
 
+// Returns the total length of the piece starting at the given pointer,
+// including its header. Only the header of the piece needs to be valid.
+// The terminating piece with zero duration has no body.
+static uint8_t piece_length(compressed_piece_ptr ptr)
+{
+  uint8_t header = *ptr;
+  uint16_t duration_in_msec;
+
+  next_duration(ptr + 1, &duration_in_msec);
+  if (duration_in_msec == 0) {
+    return 3;
+  }
+
+  return 3 + (
+    control_points_by_type[header & 0x03] +
+    control_points_by_type[(header >> 2) & 0x03] +
+    control_points_by_type[(header >> 4) & 0x03] +
+    control_points_by_type[(header >> 6) & 0x03]
+  ) * sizeof(compressed_piece_coordinate);
+}
+
+// Copies data from the given absolute offset of a stream, handling the
+// wrap-around at the end of the buffer. Returns false without copying if the
+// requested data has not been written to the stream yet.
+static bool stream_copy(const struct piecewise_traj_compressed_stream *stream,
+  uint32_t offset, uint8_t* dst, uint32_t length)
+{
+  uint32_t start, until_end;
+
+  if (stream->write_offset - offset < length) {
+    return false;
+  }
+
+  start = offset % stream->capacity;
+  until_end = stream->capacity - start;
+  if (length <= until_end) {
+    memcpy(dst, stream->buffer + start, length);
+  } else {
+    memcpy(dst, stream->buffer + start, until_end);
+    memcpy(dst + until_end, stream->buffer, length - until_end);
+  }
+
+  return true;
+}
+
+// Copies the next piece of a streamed trajectory into the piece buffer and
+// releases the stream data up to the end of the piece. Returns false if the
+// piece is not (fully) available in the stream.
+static bool stream_fetch_next_piece(struct piecewise_traj_compressed *traj)
+{
+  struct piecewise_traj_compressed_stream *stream = traj->stream;
+  uint32_t offset = traj->current_piece.next_offset;
+  uint8_t* buffer = traj->current_piece.buffer;
+  uint8_t length;
+
+  if (!stream_copy(stream, offset, buffer, 3)) {
+    return false;
+  }
+
+  length = piece_length(buffer);
+  if (!stream_copy(stream, offset + 3, buffer + 3, length - 3)) {
+    return false;
+  }
+
+  traj->current_piece.next_offset = offset + length;
+  stream->read_offset = offset + length;
+
+  return true;
+}
+
 // Returns the start time of the current piece being executed
 static inline float start_time_of_current_piece(const struct piecewise_traj_compressed *traj) {
   return traj->t_begin + traj->current_piece.t_begin_relative;
@@ -212,7 +288,8 @@ struct traj_eval piecewise_compressed_eval(
    * a different value while the poly4d is already pre-calculated, and we
    * have no way of detecting it */
 
-  if (t < start_time_of_current_piece(traj)) {
+  if (t < start_time_of_current_piece(traj) && !traj->stream) {
+    /* streamed trajectories cannot be rewound, data of past pieces is gone */
     piecewise_compressed_rewind(traj);
   }
 
@@ -234,12 +311,96 @@ void piecewise_compressed_load(struct piecewise_traj_compressed *traj, const voi
   traj->timescale = 1;
 
   traj->data = data;
+  traj->stream = 0;
+  traj->underrun = false;
   traj->shift = vzero();
   piecewise_compressed_rewind(traj);
 
   traj->duration = calculate_total_duration(traj->current_piece.data);
 }
 
+bool piecewise_compressed_load_stream(
+  struct piecewise_traj_compressed *traj, struct piecewise_traj_compressed_stream *stream)
+{
+  struct traj_eval stopped;
+  compressed_piece_coordinate value;
+  uint8_t start[4 * sizeof(compressed_piece_coordinate)];
+  compressed_piece_ptr ptr;
+  uint32_t offset = stream->read_offset;
+
+  if (!stream_copy(stream, offset, start, sizeof(start))) {
+    return false;
+  }
+
+  traj->t_begin = 0;
+  traj->timescale = 1;
+  traj->duration = INFINITY;
+  traj->data = 0;
+  traj->stream = stream;
+  traj->underrun = false;
+  traj->shift = vzero();
+  traj->current_piece.next_offset = offset + sizeof(start);
+
+  if (!stream_fetch_next_piece(traj)) {
+    return false;
+  }
+
+  /* Parse header that stores the start coordinates */
+  bzero(&stopped, sizeof(stopped));
+  ptr = start;
+  ptr = next_coordinate(ptr, &value); stopped.pos.x = value / STORED_DISTANCE_SCALE;
+  ptr = next_coordinate(ptr, &value); stopped.pos.y = value / STORED_DISTANCE_SCALE;
+  ptr = next_coordinate(ptr, &value); stopped.pos.z = value / STORED_DISTANCE_SCALE;
+  ptr = next_coordinate(ptr, &value); stopped.yaw = value / STORED_ANGLE_SCALE;
+  traj->current_piece.t_begin_relative = 0;
+  traj->current_piece.data = traj->current_piece.buffer;
+
+  piecewise_compressed_update_current_poly4d(traj, &stopped);
+
+  return true;
+}
+
+void piecewise_compressed_stream_init(
+  struct piecewise_traj_compressed_stream *stream, uint8_t* buffer, uint32_t capacity)
+{
+  stream->buffer = buffer;
+  stream->capacity = capacity;
+  piecewise_compressed_stream_reset(stream);
+}
+
+void piecewise_compressed_stream_reset(struct piecewise_traj_compressed_stream *stream)
+{
+  stream->read_offset = 0;
+  stream->write_offset = 0;
+}
+
+uint32_t piecewise_compressed_stream_write(
+  struct piecewise_traj_compressed_stream *stream, const void* data, uint32_t length)
+{
+  uint32_t free_space = piecewise_compressed_stream_free(stream);
+  uint32_t start, until_end;
+  const uint8_t* src = data;
+
+  if (length > free_space) {
+    length = free_space;
+  }
+
+  start = stream->write_offset % stream->capacity;
+  until_end = stream->capacity - start;
+  if (length <= until_end) {
+    memcpy(stream->buffer + start, src, length);
+  } else {
+    memcpy(stream->buffer + start, src, until_end);
+    memcpy(stream->buffer, src + until_end, length - until_end);
+  }
+
+  /* make sure the data is in place before the consumer can see it */
+  __sync_synchronize();
+  stream->write_offset += length;
+
+  return length;
+}
+
 static void piecewise_compressed_rewind(struct piecewise_traj_compressed *traj)
 {
   struct traj_eval stopped;
@@ -292,7 +453,19 @@ static void piecewise_compressed_advance_playhead(struct piecewise_traj_compress
   struct traj_eval end_of_previous_piece = poly4d_eval(&traj->current_piece.poly4d, duration);
 
   traj->current_piece.t_begin_relative += duration;
-  traj->current_piece.data = next_piece(traj->current_piece.data);
+
+  if (!traj->stream) {
+    traj->current_piece.data = next_piece(traj->current_piece.data);
+  } else if (traj->current_piece.data && duration <= 0) {
+    /* the terminating piece has been reached, the duration is now known */
+    traj->current_piece.data = 0;
+    traj->duration = traj->current_piece.t_begin_relative;
+  } else if (!stream_fetch_next_piece(traj)) {
+    /* underrun; hold the end of the last piece, the hold piece has no data
+     * so we never try to advance again */
+    traj->current_piece.data = 0;
+    traj->underrun = true;
+  }
 
   piecewise_compressed_update_current_poly4d(traj, &end_of_previous_piece);
 }
@@ -0,0 +1,270 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * show_clock.c - Clock shared by a fleet of Crazyflies
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "show_clock.h"
+#include "clockCorrectionEngine.h"
+#include "usec_time.h"
+#include "supervisor.h"
+#include "system.h"
+#include "log.h"
+#include "param.h"
+
+// The latency of the sync broadcasts varies, only the one with the lowest latency in each window is used [us]
+#define SYNC_WINDOW_US 1000000
+// Number of windows that the skew is estimated over
+#define SKEW_WINDOWS 8
+// Skew estimates outside this range are rejected [ppm]
+#define MAX_SKEW_PPM 100.0f
+#define SKEW_FILTER 0.8f
+// Offset corrections are slewed over the next window, at most at this rate relative to the local clock
+#define MAX_SLEW_RATE 0.01f
+// A larger error means that the master clock was reset, step to it as soon as possible [us]
+#define RESYNC_US 100000
+
+typedef struct {
+  uint64_t localUs;
+  uint64_t masterUs;
+} syncPoint_t;
+
+// The mapping from the local clock to the show clock
+// show = refShowUs + dt + dt * skewPpm / 1e6 + slew(dt), where dt = local - refLocalUs
+// slew(dt) adds slewUs linearly over the first SYNC_WINDOW_US
+static uint64_t refLocalUs;
+static uint64_t refShowUs;
+static float skewPpm;
+static int64_t slewUs;
+
+// The latest value returned by showClockGetUs(), used to keep the clock monotonic
+static uint64_t latestShowUs;
+
+static bool isSynchronized = false;
+
+// Only used by the sync handler
+static bool isWindowOpen = false;
+static uint64_t windowStartUs;
+static syncPoint_t windowBest;
+static int64_t windowBestErrorUs;
+
+static syncPoint_t skewPoints[SKEW_WINDOWS];
+static uint8_t skewPointsNewest;
+static uint8_t skewPointsCount;
+
+// Parameters
+static uint16_t linkDelayUs = 0;
+
+// Log
+static int32_t residualUs;
+static uint16_t stepCount;
+
+// The part of the offset correction that has been slewed in at the local time
+static int64_t slewedUs(const uint64_t localUs) {
+  const int64_t dt = (int64_t)(localUs - refLocalUs);
+  if (dt <= 0) {
+    return 0;
+  } else if (dt >= SYNC_WINDOW_US) {
+    return slewUs;
+  }
+
+  return slewUs * dt / SYNC_WINDOW_US;
+}
+
+static uint64_t localToShowUs(const uint64_t localUs) {
+  const int64_t dt = (int64_t)(localUs - refLocalUs);
+  return refShowUs + dt + (int64_t)(dt * skewPpm * 1e-6f) + slewedUs(localUs);
+}
+
+uint64_t showClockGetUs(void) {
+  const uint64_t localUs = usecTimestamp();
+
+  taskENTER_CRITICAL();
+  uint64_t showUs = localToShowUs(localUs);
+  if (showUs < latestShowUs) {
+    showUs = latestShowUs;
+  } else {
+    latestShowUs = showUs;
+  }
+  taskEXIT_CRITICAL();
+
+  return showUs;
+}
+
+bool showClockIsSynchronized(void) {
+  return isSynchronized;
+}
+
+// The show clock is only stepped when a discontinuity can not disturb a trajectory or a light program in progress
+static bool canStep(void) {
+  return !systemIsArmed() && !supervisorIsFlying();
+}
+
+static void addSkewPoint(const syncPoint_t* point) {
+  skewPointsNewest = (skewPointsNewest + 1) % SKEW_WINDOWS;
+  skewPoints[skewPointsNewest] = *point;
+  if (skewPointsCount < SKEW_WINDOWS) {
+    skewPointsCount++;
+  }
+}
+
+static void step(const syncPoint_t* point) {
+  taskENTER_CRITICAL();
+  refLocalUs = point->localUs;
+  refShowUs = point->masterUs + linkDelayUs;
+  slewUs = 0;
+  latestShowUs = 0;
+  taskEXIT_CRITICAL();
+
+  skewPointsCount = 0;
+  addSkewPoint(point);
+  isWindowOpen = false;
+  isSynchronized = true;
+  stepCount++;
+}
+
+static float estimateSkewPpm(void) {
+  if (skewPointsCount < 2) {
+    return skewPpm;
+  }
+
+  const syncPoint_t* newest = &skewPoints[skewPointsNewest];
+  const syncPoint_t* oldest = &skewPoints[(skewPointsNewest + SKEW_WINDOWS + 1 - skewPointsCount) % SKEW_WINDOWS];
+  const double ratio = clockCorrectionEngineCalculate(newest->masterUs, oldest->masterUs, newest->localUs, oldest->localUs, UINT64_MAX);
+  if (ratio < 0) {
+    return skewPpm;
+  }
+
+  const float candidatePpm = (float)((ratio - 1.0) * 1e6);
+  if (candidatePpm < -MAX_SKEW_PPM || candidatePpm > MAX_SKEW_PPM) {
+    return skewPpm;
+  }
+
+  return skewPpm * SKEW_FILTER + candidatePpm * (1.0f - SKEW_FILTER);
+}
+
+// Adjusts the clock using the broadcast with the lowest latency in the window. The offset is slewed over the next
+// window, errors that are too large to slew are stepped if possible.
+static void closeWindow(const uint64_t localUs) {
+  isWindowOpen = false;
+
+  addSkewPoint(&windowBest);
+  const float newSkewPpm = estimateSkewPpm();
+
+  // The slew of the previous correction may have continued after the best broadcast was received
+  int64_t correctionUs = windowBestErrorUs - (slewedUs(localUs) - slewedUs(windowBest.localUs));
+
+  const int64_t maxSlewUs = (int64_t)(SYNC_WINDOW_US * MAX_SLEW_RATE);
+  int64_t stepUs = 0;
+  if (correctionUs > maxSlewUs || correctionUs < -maxSlewUs) {
+    if (canStep()) {
+      stepUs = correctionUs;
+      correctionUs = 0;
+      stepCount++;
+    } else if (correctionUs > maxSlewUs) {
+      correctionUs = maxSlewUs;
+    } else {
+      correctionUs = -maxSlewUs;
+    }
+  }
+
+  taskENTER_CRITICAL();
+  refShowUs = localToShowUs(localUs) + stepUs;
+  refLocalUs = localUs;
+  slewUs = correctionUs;
+  skewPpm = newSkewPpm;
+  if (stepUs != 0) {
+    latestShowUs = 0;
+  }
+  taskEXIT_CRITICAL();
+}
+
+void showClockHandleSync(const uint64_t masterUs, const uint64_t localUs) {
+  const syncPoint_t point = {.localUs = localUs, .masterUs = masterUs};
+
+  // The latency delays the arrival of the broadcast, the error is negative and the largest one is the most accurate
+  const int64_t errorUs = (int64_t)(masterUs + linkDelayUs - localToShowUs(localUs));
+
+  if (!isSynchronized || errorUs > RESYNC_US || errorUs < -RESYNC_US) {
+    if (canStep()) {
+      step(&point);
+    }
+    return;
+  }
+
+  if (!isWindowOpen) {
+    isWindowOpen = true;
+    windowStartUs = localUs;
+    windowBest = point;
+    windowBestErrorUs = errorUs;
+  } else if (errorUs > windowBestErrorUs) {
+    windowBest = point;
+    windowBestErrorUs = errorUs;
+  }
+
+  residualUs = (int32_t)windowBestErrorUs;
+
+  if (localUs - windowStartUs >= SYNC_WINDOW_US) {
+    closeWindow(localUs);
+  }
+}
+
+/**
+ * The show clock follows the master clock that broadcasts time sync packets,
+ * see the localization CRTP port.
+ */
+LOG_GROUP_START(showClk)
+  /**
+   * @brief Error of the show clock versus the lowest latency time sync broadcast in the current window [us]
+   */
+  LOG_ADD(LOG_INT32, residual, &residualUs)
+  /**
+   * @brief Estimated skew of the master clock relative to the local clock [ppm]
+   */
+  LOG_ADD(LOG_FLOAT, skew, &skewPpm)
+  /**
+   * @brief Nonzero if the show clock follows a master clock
+   */
+  LOG_ADD(LOG_UINT8, synced, &isSynchronized)
+  /**
+   * @brief Number of times the show clock has been stepped to the master clock
+   */
+  LOG_ADD(LOG_UINT16, steps, &stepCount)
+LOG_GROUP_STOP(showClk)
+
+/**
+ * The show clock follows the master clock that broadcasts time sync packets,
+ * see the localization CRTP port.
+ */
+PARAM_GROUP_START(showClk)
+  /**
+   * @brief The minimum latency of the time sync broadcasts, added to the master time [us] (default 0)
+   */
+  PARAM_ADD(PARAM_UINT16, linkDly, &linkDelayUs)
+PARAM_GROUP_STOP(showClk)
@@ -56,6 +56,7 @@
 #include "statsCnt.h"
 #include "static_mem.h"
 #include "rateSupervisor.h"
+#include "histogram.h"
 
 static bool isInit;
 static bool emergencyStop = false;
@@ -63,6 +64,14 @@ static int emergencyStopTimeout = EMERGENCY_STOP_TIMEOUT_DISABLED;
 
 static uint32_t inToOutLatency;
 
+// Percentiles of the latency, updated once per LATENCY_PERCENTILE_SAMPLES
+#define LATENCY_PERCENTILE_SAMPLES 1000
+#define LATENCY_BIN_WIDTH_US 50
+static histogram_t inToOutLatencyHistogram;
+static uint32_t inToOutLatencyP50;
+static uint32_t inToOutLatencyP90;
+static uint32_t inToOutLatencyP99;
+
 // State variables for the stabilizer
 static setpoint_t setpoint;
 static sensorData_t sensorData;
@@ -127,6 +136,14 @@ static void calcSensorToOutputLatency(const sensorData_t *sensorData)
 {
   uint64_t outTimestamp = usecTimestamp();
   inToOutLatency = outTimestamp - sensorData->interruptTimestamp;
+
+  histogramAdd(&inToOutLatencyHistogram, inToOutLatency);
+  if (histogramCount(&inToOutLatencyHistogram) >= LATENCY_PERCENTILE_SAMPLES) {
+    inToOutLatencyP50 = histogramPercentile(&inToOutLatencyHistogram, 50);
+    inToOutLatencyP90 = histogramPercentile(&inToOutLatencyHistogram, 90);
+    inToOutLatencyP99 = histogramPercentile(&inToOutLatencyHistogram, 99);
+    histogramReset(&inToOutLatencyHistogram);
+  }
 }
 
 static void compressState()
@@ -182,6 +199,7 @@ void stabilizerInit(StateEstimatorType estimator)
   powerDistributionInit();
   motorsInit(platformConfigGetMotorMapping());
   collisionAvoidanceInit();
+  histogramInit(&inToOutLatencyHistogram, LATENCY_BIN_WIDTH_US);
   estimatorType = stateEstimatorGetType();
   controllerType = controllerGetType();
 
@@ -532,6 +550,18 @@ STATS_CNT_RATE_LOG_ADD(rtStab, &stabilizerRate)
  *    Note: Used for debugging but could also be used as a system test
  */
 LOG_ADD(LOG_UINT32, intToOut, &inToOutLatency)
+/**
+ * @brief Median latency from sampling of sensor to motor output [us], resolution 50 us
+ */
+LOG_ADD(LOG_UINT32, intToOutP50, &inToOutLatencyP50)
+/**
+ * @brief 90th percentile of the latency from sampling of sensor to motor output [us], resolution 50 us
+ */
+LOG_ADD(LOG_UINT32, intToOutP90, &inToOutLatencyP90)
+/**
+ * @brief 99th percentile of the latency from sampling of sensor to motor output [us], resolution 50 us
+ */
+LOG_ADD(LOG_UINT32, intToOutP99, &inToOutLatencyP99)
 LOG_GROUP_STOP(stabilizer)
 
 /**
@@ -44,6 +44,7 @@
 #include "system.h"
 #include "platform.h"
 #include "storage.h"
+#include "asset_storage.h"
 #include "configblock.h"
 #include "worker.h"
 #include "freeRTOSdebug.h"
@@ -144,6 +145,7 @@ void systemInit(void)
 
   configblockInit();
   storageInit();
+  assetStorageInit();
   workerInit();
   adcInit();
   ledseqInit();
@@ -165,6 +167,7 @@ bool systemTest()
   pass &= ledseqTest();
   pass &= pmTest();
   pass &= workerTest();
+  pass &= assetStorageTest();
   pass &= buzzerTest();
   return pass;
 }
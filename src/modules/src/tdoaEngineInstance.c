@@ -77,6 +77,26 @@ STATS_CNT_RATE_LOG_ADD(stHit, &tdoaEngineState.stats.contextHitCount)
  */
 STATS_CNT_RATE_LOG_ADD(stMiss, &tdoaEngineState.stats.contextMissCount)
 
+/**
+ * @brief Rate of misses where an anchor in the TDoA storage was replaced to make room for a new one [1/s].
+ *
+ * If this number is high, increase CONFIG_DECK_LOCO_TDOA_ANCHOR_STORAGE_COUNT.
+ */
+STATS_CNT_RATE_LOG_ADD(stEvict, &tdoaEngineState.stats.contextEvictionCount)
+
+/**
+ * @brief Rate of hits when looking up remote anchors to pair with a received packet [1/s]
+ */
+STATS_CNT_RATE_LOG_ADD(stRHit, &tdoaEngineState.stats.remoteContextHitCount)
+
+/**
+ * @brief Rate of misses when looking up remote anchors to pair with a received packet [1/s].
+ *
+ * Remote anchors that the CF has not received packets from are missing, a high number may also indicate that the
+ * TDoA storage is too small.
+ */
+STATS_CNT_RATE_LOG_ADD(stRMiss, &tdoaEngineState.stats.remoteContextMissCount)
+
 /**
  * @brief The clock correction factor for the anchor with the id selected by the tdoaEngine.logId parameter
  */
@@ -26,66 +26,236 @@
 #include "worker.h"
 
 #include <errno.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
-#include "queuemonitor.h"
-#include "static_mem.h"
+#include "semphr.h"
 
+#include "log.h"
+#include "usec_time.h"
 #include "console.h"
 
-#define WORKER_QUEUE_LENGTH 5
+#define WORKER_MAX_JOBS 16
 
 struct worker_work {
   void (*function)(void*);
   void* arg;
+  workerPriority_t priority;
+  bool pending;
+  bool hasDeadline;
+  TickType_t deadline;    // absolute deadline in ticks
+  uint32_t sequence;      // FIFO order within the same priority
 };
 
-static xQueueHandle workerQueue;
-STATIC_MEM_QUEUE_ALLOC(workerQueue, WORKER_QUEUE_LENGTH, sizeof(struct worker_work));
+struct worker_stats {
+  uint8_t pending;        // jobs waiting for execution
+  uint8_t maxPending;     // high water mark of pending jobs
+  uint32_t coalesced;     // schedule requests merged into a pending job
+  uint32_t dropped;       // schedule requests rejected, out of job slots
+  uint32_t deadlineMissed;
+  uint32_t lastRuntime;   // [us]
+  uint32_t maxRuntime;    // [us]
+  uint32_t maxRuntimeFunction;  // address of the job with the longest runtime
+  uint32_t busyTime;      // accumulated job runtime [us]
+};
+
+static struct worker_work jobs[WORKER_MAX_JOBS];
+static struct worker_stats stats;
+static uint32_t nextSequence;
+
+static SemaphoreHandle_t workerSemaphore;
+static StaticSemaphore_t workerSemaphoreBuffer;
 
 void workerInit()
 {
-  if (workerQueue)
+  if (workerSemaphore)
     return;
 
-  workerQueue = STATIC_MEM_QUEUE_CREATE(workerQueue);
-  DEBUG_QUEUE_MONITOR_REGISTER(workerQueue);
+  workerSemaphore = xSemaphoreCreateBinaryStatic(&workerSemaphoreBuffer);
 }
 
 bool workerTest()
 {
-  return (workerQueue != NULL);
+  return (workerSemaphore != NULL);
+}
+
+// Returns true if job a should be executed before job b
+static bool workerIsMoreUrgent(const struct worker_work* a, const struct worker_work* b)
+{
+  if (a->priority != b->priority) {
+    return a->priority > b->priority;
+  }
+
+  // earliest deadline first, jobs without deadline after the ones with
+  if (a->hasDeadline != b->hasDeadline) {
+    return a->hasDeadline;
+  }
+  if (a->hasDeadline && a->deadline != b->deadline) {
+    return (int32_t)(a->deadline - b->deadline) < 0;
+  }
+
+  return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+// Takes the most urgent pending job. Returns false if there is none.
+static bool workerTakeNext(struct worker_work* work)
+{
+  struct worker_work* next = NULL;
+
+  taskENTER_CRITICAL();
+  for (int i = 0; i < WORKER_MAX_JOBS; i++) {
+    if (jobs[i].pending && (!next || workerIsMoreUrgent(&jobs[i], next))) {
+      next = &jobs[i];
+    }
+  }
+  if (next) {
+    *work = *next;
+    next->pending = false;
+    stats.pending--;
+  }
+  taskEXIT_CRITICAL();
+
+  return next != NULL;
+}
+
+static void workerRun(const struct worker_work* work)
+{
+  if (work->hasDeadline && (int32_t)(xTaskGetTickCount() - work->deadline) > 0) {
+    stats.deadlineMissed++;
+  }
+
+  uint64_t start = usecTimestamp();
+  work->function(work->arg);
+  uint32_t runtime = usecTimestamp() - start;
+
+  stats.lastRuntime = runtime;
+  stats.busyTime += runtime;
+  if (runtime > stats.maxRuntime) {
+    stats.maxRuntime = runtime;
+    stats.maxRuntimeFunction = (uint32_t)work->function;
+  }
 }
 
 void workerLoop()
 {
   struct worker_work work;
 
-  if (!workerQueue)
+  if (!workerSemaphore)
     return;
 
   while (1)
   {
-    xQueueReceive(workerQueue, &work, portMAX_DELAY);
+    xSemaphoreTake(workerSemaphore, portMAX_DELAY);
 
-    if (work.function)
-      work.function(work.arg);
+    while (workerTakeNext(&work)) {
+      workerRun(&work);
+    }
   }
 }
 
-int workerSchedule(void (*function)(void*), void *arg)
+int workerScheduleWithPriority(void (*function)(void*), void *arg,
+                               workerPriority_t priority, TickType_t deadline)
 {
-  struct worker_work work;
+  struct worker_work* slot = NULL;
+  int result = 0;
 
   if (!function)
     return ENOEXEC;
 
-  work.function = function;
-  work.arg = arg;
-  if (xQueueSend(workerQueue, &work, 0) == pdFALSE)
-    return ENOMEM;
+  TickType_t now = xTaskGetTickCount();
+
+  taskENTER_CRITICAL();
+  for (int i = 0; i < WORKER_MAX_JOBS; i++) {
+    if (jobs[i].pending) {
+      if (jobs[i].function == function && jobs[i].arg == arg) {
+        // Already pending, merge into the existing job
+        if (priority > jobs[i].priority) {
+          jobs[i].priority = priority;
+        }
+        if (deadline > 0 && (!jobs[i].hasDeadline || (int32_t)(now + deadline - jobs[i].deadline) < 0)) {
+          jobs[i].hasDeadline = true;
+          jobs[i].deadline = now + deadline;
+        }
+        stats.coalesced++;
+        slot = &jobs[i];
+        break;
+      }
+    } else if (!slot) {
+      slot = &jobs[i];
+    }
+  }
+
+  if (!slot) {
+    stats.dropped++;
+    result = ENOMEM;
+  } else if (!slot->pending) {
+    slot->function = function;
+    slot->arg = arg;
+    slot->priority = priority;
+    slot->hasDeadline = deadline > 0;
+    slot->deadline = now + deadline;
+    slot->sequence = nextSequence++;
+    slot->pending = true;
 
-  return 0;
+    stats.pending++;
+    if (stats.pending > stats.maxPending) {
+      stats.maxPending = stats.pending;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (result == 0) {
+    xSemaphoreGive(workerSemaphore);
+  }
+
+  return result;
+}
+
+int workerSchedule(void (*function)(void*), void *arg)
+{
+  return workerScheduleWithPriority(function, arg, WORKER_PRIORITY_NORMAL, 0);
 }
+
+/**
+ * Statistics of the worker that executes asynchronous jobs, such as log
+ * blocks and periodic checks, in the system task.
+ */
+LOG_GROUP_START(worker)
+/**
+ * @brief Number of jobs waiting for execution
+ */
+LOG_ADD(LOG_UINT8, pending, &stats.pending)
+/**
+ * @brief Highest number of jobs waiting for execution at the same time
+ */
+LOG_ADD(LOG_UINT8, maxPend, &stats.maxPending)
+/**
+ * @brief Number of schedule requests merged into an already pending job
+ */
+LOG_ADD(LOG_UINT32, coalesced, &stats.coalesced)
+/**
+ * @brief Number of schedule requests rejected because all job slots were in use
+ */
+LOG_ADD(LOG_UINT32, dropped, &stats.dropped)
+/**
+ * @brief Number of jobs that started after their deadline
+ */
+LOG_ADD(LOG_UINT32, missed, &stats.deadlineMissed)
+/**
+ * @brief Runtime of the latest job [us]
+ */
+LOG_ADD(LOG_UINT32, runUs, &stats.lastRuntime)
+/**
+ * @brief Longest runtime of a job [us]
+ */
+LOG_ADD(LOG_UINT32, maxRunUs, &stats.maxRuntime)
+/**
+ * @brief Address of the job function with the longest runtime, look it up in the map file
+ */
+LOG_ADD(LOG_UINT32, maxRunFn, &stats.maxRuntimeFunction)
+/**
+ * @brief Accumulated runtime of all jobs [us]
+ */
+LOG_ADD(LOG_UINT32, busyUs, &stats.busyTime)
+LOG_GROUP_STOP(worker)
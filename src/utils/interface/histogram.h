@@ -0,0 +1,80 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * histogram.h - distribution of non negative integer samples
+ *
+ *
+ * Samples are counted in bins of equal width, percentiles are found with a
+ * resolution of one bin. Samples beyond the last bin are counted in it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define HISTOGRAM_BINS 64
+
+typedef struct {
+  uint16_t bins[HISTOGRAM_BINS];
+  uint32_t binWidth;
+  uint16_t count;
+} histogram_t;
+
+/**
+ * @brief Initialize an empty histogram.
+ *
+ * @param histogram The histogram to initialize
+ * @param binWidth The width of the bins, the histogram covers samples up to HISTOGRAM_BINS * binWidth
+ */
+void histogramInit(histogram_t* histogram, const uint32_t binWidth);
+
+/**
+ * @brief Remove all samples.
+ *
+ * @param histogram The histogram
+ */
+void histogramReset(histogram_t* histogram);
+
+/**
+ * @brief Add a sample. Samples are ignored when UINT16_MAX samples have been added.
+ *
+ * @param histogram The histogram
+ * @param sample The new sample
+ */
+void histogramAdd(histogram_t* histogram, const uint32_t sample);
+
+/**
+ * @brief The number of samples in the histogram.
+ */
+static inline uint16_t histogramCount(const histogram_t* histogram) {
+  return histogram->count;
+}
+
+/**
+ * @brief The upper edge of the bin that holds the given percentile, 0 if the histogram is empty.
+ *
+ * @param histogram The histogram
+ * @param percentile The percentile, 0 - 100
+ */
+uint32_t histogramPercentile(const histogram_t* histogram, const uint8_t percentile);
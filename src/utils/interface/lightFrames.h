@@ -0,0 +1,114 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * lightFrames.h - compressed color frame sequences with a seek index
+ *
+ * A sequence of RGB (3 bytes) or RGB565 (2 bytes) frames is encoded as a list
+ * of operations, each covering 1 to 64 frames:
+ *
+ * | Op byte    | Payload          | Frames                                      |
+ * |------------|------------------|---------------------------------------------|
+ * | 00nnnnnn   | -                | n+1 frames holding the previous color       |
+ * | 01nnnnnn   | 3 x int8 delta   | n+1 frames, delta added to the color each   |
+ * | 10nnnnnn   | color            | n+1 frames of the color                     |
+ * | 11nnnnnn   | color            | as 10nnnnnn, and a keyframe in the index    |
+ *
+ * Colors in the payload use the bytes per frame of the sequence. A keyframe
+ * does not depend on earlier operations, and the encoder starts a new one
+ * after LIGHT_FRAMES_KEYFRAME_SPACING bytes of operations so that a seek never
+ * decodes more than that.
+ *
+ * Layout, all values little endian:
+ *   uint8_t  version (LIGHT_FRAMES_VERSION)
+ *   uint8_t  bytes per frame (2 or 3)
+ *   uint16_t reserved, 0
+ *   uint32_t number of keyframes
+ *   uint32_t number of frames
+ *   uint32_t offset of the index
+ *   operations
+ *   index: for each keyframe, uint32_t frame and uint32_t offset of the operation
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LIGHT_FRAMES_VERSION 1
+#define LIGHT_FRAMES_HEADER_SIZE 16
+#define LIGHT_FRAMES_KEYFRAME_SPACING 64
+
+typedef struct {
+  const uint8_t* data;
+  uint32_t size;
+  uint8_t bytesPerFrame;
+  uint32_t keyframeCount;
+  uint32_t frameCount;
+  uint32_t indexOffset;
+
+  // The operation that the last decoded frame belongs to
+  bool isOpValid;
+  uint32_t opOffset;
+  uint32_t opFirstFrame;
+  uint8_t opFrameCount;
+  uint8_t opCode;
+  uint8_t opColor[3];       // Color set by the operation, or the delta of a ramp
+  uint8_t colorBeforeOp[3]; // Color of the frame before the operation
+} lightFramesDecoder_t;
+
+/**
+ * @brief Encode a sequence of frames.
+ *
+ * @param frames The frames, bytesPerFrame bytes each
+ * @param frameCount The number of frames
+ * @param bytesPerFrame 3 for RGB frames, 2 for RGB565 frames
+ * @param out The buffer to write the encoded sequence to
+ * @param outSize The size of the buffer
+ * @return uint32_t The size of the encoded sequence, 0 if it does not fit in the buffer
+ */
+uint32_t lightFramesEncode(const uint8_t* frames, const uint32_t frameCount, const uint8_t bytesPerFrame, uint8_t* out, const uint32_t outSize);
+
+/**
+ * @brief Initialize a decoder for an encoded sequence. The data is used in place.
+ *
+ * @param decoder The decoder to initialize
+ * @param data The encoded sequence
+ * @param size The size of the encoded sequence
+ * @return true if the header of the sequence is valid
+ */
+bool lightFramesDecoderInit(lightFramesDecoder_t* decoder, const uint8_t* data, const uint32_t size);
+
+/**
+ * @brief Decode the color of a frame, and of the frame after it.
+ *
+ * Frames are found in constant time when they are requested in increasing
+ * order, and with a binary search in the index otherwise.
+ *
+ * @param decoder The decoder
+ * @param frame The frame to decode
+ * @param color The RGB color of the frame (3 bytes)
+ * @param nextColor The RGB color of the next frame, the color of the frame if it is the last one (3 bytes). May be NULL.
+ * @return true if the frame exists and could be decoded
+ */
+bool lightFramesDecode(lightFramesDecoder_t* decoder, const uint32_t frame, uint8_t* color, uint8_t* nextColor);
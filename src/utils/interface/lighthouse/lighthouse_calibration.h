@@ -1,5 +1,7 @@
 #pragma once
 
+#include <math.h>
+#include "cf_math.h"
 #include "ootx_decoder.h"
 #include "lighthouse_types.h"
 
@@ -58,3 +60,32 @@ float lighthouseCalibrationMeasurementModelLh1(const float x, const float y, con
  * @return float The predicted uncompensated sweep angle of the rotor
  */
 float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, const float z, const float t, const lighthouseCalibrationSweep_t* calib);
+
+/**
+ * @brief Compute the terms of the lighthouse 2 measurement model that do not depend on the position.
+ * @param calib Calibration data for the rotor
+ * @param t Tilt of the light plane in radians
+ * @param cache (output) The precomputed terms
+ */
+void lighthouseCalibrationPrecomputeLh2(const lighthouseCalibrationSweep_t* calib, const float t, lighthouseCalibrationSweepCache_t* cache);
+
+/**
+ * @brief Predict the measured sweep angle based on a position for a lighthouse 2 rotor, using precomputed terms. The
+ * result is the same as from lighthouseCalibrationMeasurementModelLh2(). The position is relative to the rotor reference frame.
+ * @param x meters
+ * @param y meters
+ * @param z meters
+ * @param r The distance to the rotor axis, sqrt(x * x + y * y)
+ * @param cache Terms from lighthouseCalibrationPrecomputeLh2()
+ * @return float The predicted uncompensated sweep angle of the rotor
+ */
+static inline float lighthouseCalibrationMeasurementModelLh2Cached(const float x, const float y, const float z, const float r, const lighthouseCalibrationSweepCache_t* cache) {
+  const float ax = atan2f(y, x);
+  const float rInv = r > 0.0f ? 1.0f / r : 0.0f;
+
+  const float base = ax + asinf(clip1(z * cache->tanTMinusTilt * rInv));
+  // gibmag * cos(ax + gibphase), where cos(ax) = x / r and sin(ax) = y / r
+  const float compGib = -(x * cache->gibCos - y * cache->gibSin) * rInv;
+
+  return base - (cache->phase + compGib);
+}
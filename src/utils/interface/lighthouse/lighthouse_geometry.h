@@ -28,6 +28,55 @@ typedef struct {
  */
 bool lighthouseGeometryGetPositionFromRayIntersection(const baseStationGeometry_t* geo1, const baseStationGeometry_t* geo2, float angles1[2], float angles2[2], vec3d position, float *position_delta);
 
+#define LIGHTHOUSE_GEOMETRY_MAX_SENSORS 4
+#define LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS 4
+
+/**
+ * @brief Rays from base stations to the sensors on the deck. The position of each sensor is the point closest to all
+ * its rays in a least squares sense. The directions use a structure of arrays layout, one element per sensor.
+ */
+typedef struct {
+  __attribute__((aligned(4))) vec3d origin[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS];
+  float dx[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS][LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+  float dy[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS][LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+  float dz[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS][LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+  // 1 if the sensor has a ray from the base station, otherwise 0
+  float weight[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS][LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+  int baseStationCount;
+  int sensorCount;
+} lighthouseGeometryRays_t;
+
+/**
+ * @brief Remove all rays.
+ *
+ * @param rays - The rays to initialize
+ * @param sensorCount - The number of sensors, at most LIGHTHOUSE_GEOMETRY_MAX_SENSORS
+ */
+void lighthouseGeometryRaysInit(lighthouseGeometryRays_t* rays, const int sensorCount);
+
+/**
+ * @brief Add the rays from one base station to the sensors.
+ *
+ * @param rays - The rays
+ * @param geo - Geometry data for the base station (position and orientation)
+ * @param anglesH - horizontal sweep angle for each sensor
+ * @param anglesV - vertical sweep angle for each sensor
+ * @param sensorMask - bit n is set if sensor n has valid angles
+ * @return true if added, false if there already are rays from LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS base stations
+ */
+bool lighthouseGeometryRaysAdd(lighthouseGeometryRays_t* rays, const baseStationGeometry_t* geo, const float anglesH[], const float anglesV[], const uint8_t sensorMask);
+
+/**
+ * @brief Solve the position of each sensor that has at least two rays that are not parallel, in one least squares
+ * pass over all sensors and base stations.
+ *
+ * @param rays - The rays
+ * @param position - (output) the mean of the positions of the solved sensors
+ * @param residual - (output) the root mean square of the distances from the rays to the solved sensor positions
+ * @return the number of solved sensors
+ */
+int lighthouseGeometryRaysSolve(const lighthouseGeometryRays_t* rays, vec3d position, float* residual);
+
 /**
  * @brief Get the base station position from the base station geometry in world reference frame. This position can be seen as the
  * point where the lazers originate from.
@@ -17,6 +17,18 @@ typedef struct {
   bool valid;
 } __attribute__((packed)) lighthouseCalibration_t;
 
+/**
+ * @brief Terms of the LH2 measurement model that only depend on the calibration data of a rotor and the tilt of the
+ * light plane. They are computed when the calibration data is updated, to keep trigonometry out of the per sample path.
+ */
+typedef struct {
+  float tanT;          // tan(t), t is the tilt of the light plane
+  float tanTMinusTilt; // tan(t - tilt)
+  float phase;
+  float gibCos;        // gibmag * cos(gibphase)
+  float gibSin;        // gibmag * sin(gibphase)
+} lighthouseCalibrationSweepCache_t;
+
 /**
  * @brief Generic function pointer type for a calibration measurement model.
  *        Predict the measured sweep angle based on a position for a lighthouse rotor. The position is relative to the rotor reference frame.
@@ -223,6 +223,7 @@ typedef struct pulseProcessor_s {
   lighthouseCalibration_t bsCalibration[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
   baseStationGeometry_t bsGeometry[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
   baseStationGeometryCache_t bsGeoCache[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+  lighthouseCalibrationSweepCache_t bsCalibCache[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS][PULSE_PROCESSOR_N_SWEEPS];
 
   // Health check data
   uint32_t healthFirstSensorTs;
@@ -250,6 +251,8 @@ typedef struct {
   pulseProcessorBaseStationMeasurement_t baseStationMeasurementsLh2[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
   lighthouseBaseStationType_t measurementType;
   uint64_t lastUsecTimestamp[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
+  // Time from when the angles were measured to when the frame that completed them was received (only LH2)
+  uint32_t ageUs[CONFIG_DECK_LIGHTHOUSE_MAX_N_BS];
 } pulseProcessorResult_t;
 
 /**
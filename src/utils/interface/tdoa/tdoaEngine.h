@@ -12,20 +12,25 @@
 #endif
 
 typedef void (*tdoaEngineSendTdoaToEstimator)(tdoaMeasurement_t* tdoaMeasurement);
+typedef void (*tdoaEngineSendTdoaBatchToEstimator)(tdoaBatchMeasurement_t* tdoaBatchMeasurement);
 
 typedef enum {
   TdoaEngineMatchingAlgorithmNone = 0,
   TdoaEngineMatchingAlgorithmRandom,
   TdoaEngineMatchingAlgorithmYoungest,
+  // Pair the anchor with all suitable remote anchors (up to TDOA_BATCH_MAX_PAIRS, the most spread out ones) and
+  // send them as one batch
+  TdoaEngineMatchingAlgorithmBatch,
 } tdoaEngineMatchingAlgorithm_t;
 
 typedef struct {
   // State
-  tdaoAnchorInfoArray_t anchorInfoArray;
+  tdoaAnchorStorage_t anchorStorage;
   tdoaStats_t stats;
 
   // Configuration
   tdoaEngineSendTdoaToEstimator sendTdoaToEstimator;
+  tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator;
   double locodeckTsFreq;
   tdoaEngineMatchingAlgorithm_t matchingAlgorithm;
 
@@ -33,11 +38,12 @@ typedef struct {
   struct {
     uint8_t seqNr[REMOTE_ANCHOR_DATA_COUNT];
     uint8_t id[REMOTE_ANCHOR_DATA_COUNT];
+    point_t position[REMOTE_ANCHOR_DATA_COUNT];
     uint8_t offset;
   } matching;
 } tdoaEngineState_t;
 
-void tdoaEngineInit(tdoaEngineState_t* state, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm);
+void tdoaEngineInit(tdoaEngineState_t* state, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm);
 
 void tdoaEngineGetAnchorCtxForPacketProcessing(tdoaEngineState_t* engineState, const uint8_t anchorId, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
 void tdoaEngineProcessPacket(tdoaEngineState_t* engineState, tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T);
@@ -9,6 +9,9 @@ typedef struct {
   statsCntRateLogger_t packetsToEstimator;
   statsCntRateLogger_t contextHitCount;
   statsCntRateLogger_t contextMissCount;
+  statsCntRateLogger_t contextEvictionCount;
+  statsCntRateLogger_t remoteContextHitCount;
+  statsCntRateLogger_t remoteContextMissCount;
   statsCntRateLogger_t timeIsGood;
   statsCntRateLogger_t suitableDataFound;
 
@@ -3,10 +3,28 @@
 
 #include "stabilizer_types.h"
 #include "clockCorrectionEngine.h"
+#include "autoconf.h"
 
+#ifdef CONFIG_DECK_LOCO_TDOA_ANCHOR_STORAGE_COUNT
+#define ANCHOR_STORAGE_COUNT CONFIG_DECK_LOCO_TDOA_ANCHOR_STORAGE_COUNT
+#else
 #define ANCHOR_STORAGE_COUNT 16
+#endif
+
+#ifdef CONFIG_DECK_LOCO_TDOA_REMOTE_ANCHOR_COUNT
+#define REMOTE_ANCHOR_DATA_COUNT CONFIG_DECK_LOCO_TDOA_REMOTE_ANCHOR_COUNT
+#define TOF_PER_ANCHOR_COUNT CONFIG_DECK_LOCO_TDOA_REMOTE_ANCHOR_COUNT
+#else
 #define REMOTE_ANCHOR_DATA_COUNT 16
 #define TOF_PER_ANCHOR_COUNT 16
+#endif
+
+#if ANCHOR_STORAGE_COUNT > 254
+#error "The TDoA storage can not hold more than 254 anchors"
+#endif
+
+// Marks anchor ids that are not in the storage
+#define ANCHOR_STORAGE_NO_SLOT 0xff
 
 
 typedef struct {
@@ -26,6 +44,7 @@ typedef struct {
   bool isInitialized;
   uint32_t lastUpdateTime; // The time when this anchor was updated the last time
   uint8_t id; // Anchor id
+  uint8_t usefulness; // Number of packets received from the anchor, saturates at ANCHOR_USEFULNESS_MAX and decays when idle
 
   int64_t txTime; // Transmit time of last packet, in remote DWM clock
   int64_t rxTime; // Receive time of last packet, in local DWM clock
@@ -39,7 +58,13 @@ typedef struct {
   tdoaRemoteAnchorData_t remoteAnchorData[REMOTE_ANCHOR_DATA_COUNT];
 } tdoaAnchorInfo_t;
 
-typedef tdoaAnchorInfo_t tdaoAnchorInfoArray_t[ANCHOR_STORAGE_COUNT];
+typedef struct {
+  tdoaAnchorInfo_t anchorInfo[ANCHOR_STORAGE_COUNT];
+  uint8_t usedCount;
+
+  // The slot of each anchor id, or ANCHOR_STORAGE_NO_SLOT
+  uint8_t slotOfId[256];
+} tdoaAnchorStorage_t;
 
 
 // The anchor context is used to pass information about an anchor as well as
@@ -51,12 +76,12 @@ typedef struct {
 } tdoaAnchorContext_t;
 
 
-void tdoaStorageInitialize(tdoaAnchorInfo_t anchorStorage[]);
+void tdoaStorageInitialize(tdoaAnchorStorage_t* anchorStorage);
 
-bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
-bool tdoaStorageGetAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
-uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize);
-uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms);
+bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
+bool tdoaStorageGetAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx);
+uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize);
+uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms);
 
 uint8_t tdoaStorageGetId(const tdoaAnchorContext_t* anchorCtx);
 int64_t tdoaStorageGetRxTime(const tdoaAnchorContext_t* anchorCtx);
@@ -75,7 +100,11 @@ void tdoaStorageGetRemoteSeqNrList(const tdoaAnchorContext_t* anchorCtx, int* re
 int64_t tdoaStorageGetTimeOfFlight(const tdoaAnchorContext_t* anchorCtx, const uint8_t otherAnchor);
 void tdoaStorageSetTimeOfFlight(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteAnchor, const int64_t tof);
 
+static inline bool tdoaStorageIsFull(const tdoaAnchorStorage_t* anchorStorage) {
+  return anchorStorage->usedCount >= ANCHOR_STORAGE_COUNT;
+}
+
 // Mainly for test
-bool tdoaStorageIsAnchorInStorage(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor);
+bool tdoaStorageIsAnchorInStorage(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor);
 
 #endif // __TDOA_STORAGE_H__
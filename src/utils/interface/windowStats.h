@@ -0,0 +1,113 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * windowStats.h - statistics of the latest samples of a signal
+ *
+ * Min and max are kept in monotonic queues, mean, variance and the slope of
+ * a least squares line are kept as running sums. Adding a sample takes
+ * constant time on average, reading a statistic always takes constant time.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WINDOW_STATS_MAX_LENGTH 64
+
+typedef struct {
+  float samples[WINDOW_STATS_MAX_LENGTH];
+  uint8_t length;
+  uint8_t count;
+  uint8_t oldest;
+  uint8_t addedSinceResync;
+
+  // Positions of samples in increasing (min) and decreasing (max) order, oldest first
+  uint8_t minQueue[WINDOW_STATS_MAX_LENGTH];
+  uint8_t minQueueFirst;
+  uint8_t minQueueCount;
+  uint8_t maxQueue[WINDOW_STATS_MAX_LENGTH];
+  uint8_t maxQueueFirst;
+  uint8_t maxQueueCount;
+
+  float sum;
+  float sumOfSquares;
+  float sumOfWeighted; // Sum of the samples multiplied by their age order, 0 for the oldest
+} windowStats_t;
+
+/**
+ * @brief Initialize the statistics for a window of samples.
+ *
+ * @param stats The statistics to initialize
+ * @param length The number of samples in the window, at most WINDOW_STATS_MAX_LENGTH
+ */
+void windowStatsInit(windowStats_t* stats, const uint8_t length);
+
+/**
+ * @brief Remove all samples.
+ *
+ * @param stats The statistics
+ */
+void windowStatsReset(windowStats_t* stats);
+
+/**
+ * @brief Add a sample, the oldest sample is removed if the window is full.
+ *
+ * @param stats The statistics
+ * @param sample The new sample
+ */
+void windowStatsAdd(windowStats_t* stats, const float sample);
+
+/**
+ * @brief The number of samples in the window.
+ */
+static inline uint8_t windowStatsCount(const windowStats_t* stats) {
+  return stats->count;
+}
+
+/**
+ * @brief The smallest sample in the window, 0 if the window is empty.
+ */
+float windowStatsMin(const windowStats_t* stats);
+
+/**
+ * @brief The largest sample in the window, 0 if the window is empty.
+ */
+float windowStatsMax(const windowStats_t* stats);
+
+/**
+ * @brief The mean of the samples in the window, 0 if the window is empty.
+ */
+float windowStatsMean(const windowStats_t* stats);
+
+/**
+ * @brief The variance of the samples in the window, 0 if there are less than two samples.
+ */
+float windowStatsVariance(const windowStats_t* stats);
+
+/**
+ * @brief The slope of the least squares line through the samples in the window, per sample.
+ * 0 if there are less than two samples.
+ */
+float windowStatsSlope(const windowStats_t* stats);
@@ -0,0 +1,76 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * histogram.c - distribution of non negative integer samples
+ */
+
+#include <string.h>
+#include "histogram.h"
+
+void histogramInit(histogram_t* histogram, const uint32_t binWidth) {
+  histogram->binWidth = binWidth > 0 ? binWidth : 1;
+  histogramReset(histogram);
+}
+
+void histogramReset(histogram_t* histogram) {
+  memset(histogram->bins, 0, sizeof(histogram->bins));
+  histogram->count = 0;
+}
+
+void histogramAdd(histogram_t* histogram, const uint32_t sample) {
+  if (histogram->count == UINT16_MAX) {
+    return;
+  }
+
+  uint32_t bin = sample / histogram->binWidth;
+  if (bin >= HISTOGRAM_BINS) {
+    bin = HISTOGRAM_BINS - 1;
+  }
+
+  histogram->bins[bin]++;
+  histogram->count++;
+}
+
+uint32_t histogramPercentile(const histogram_t* histogram, const uint8_t percentile) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  // The number of samples at or below the percentile, rounded up
+  const uint32_t limited = percentile > 100 ? 100 : percentile;
+  uint32_t needed = (histogram->count * limited + 99) / 100;
+  if (needed == 0) {
+    needed = 1;
+  }
+
+  uint32_t cumulative = 0;
+  for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+    cumulative += histogram->bins[bin];
+    if (cumulative >= needed) {
+      return (bin + 1) * histogram->binWidth;
+    }
+  }
+
+  return HISTOGRAM_BINS * histogram->binWidth;
+}
@@ -0,0 +1,379 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * lightFrames.c - compressed color frame sequences with a seek index
+ */
+
+#include <string.h>
+
+#include "lightFrames.h"
+
+#define OP_HOLD 0
+#define OP_RAMP 1
+#define OP_SET 2
+#define OP_KEY 3
+
+#define OP_MAX_FRAMES 64
+#define INDEX_ENTRY_SIZE 8
+
+typedef struct {
+  uint8_t* out;
+  uint32_t outSize;
+  uint32_t length;
+} writer_t;
+
+static uint32_t readUint32(const uint8_t* ptr) {
+  return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static void writeUint32(uint8_t* ptr, const uint32_t value) {
+  ptr[0] = value & 0xff;
+  ptr[1] = (value >> 8) & 0xff;
+  ptr[2] = (value >> 16) & 0xff;
+  ptr[3] = value >> 24;
+}
+
+static void decodeFrameColor(const uint8_t bytesPerFrame, const uint8_t* ptr, uint8_t* color) {
+  uint8_t x;
+
+  if (bytesPerFrame == 3) {
+    memcpy(color, ptr, 3);
+    return;
+  }
+
+  x = ptr[0] & 0xf8;
+  color[0] = x | (x >> 5);
+
+  x = ((ptr[0] & 0x07) << 3) | ((ptr[1] & 0xe0) >> 5);
+  color[1] = (x << 2) | (x >> 4);
+
+  x = ptr[1] & 0x1f;
+  color[2] = (x << 3) | (x >> 2);
+}
+
+static uint8_t opPayloadSize(const uint8_t opCode, const uint8_t bytesPerFrame) {
+  switch (opCode) {
+    case OP_HOLD:
+      return 0;
+    case OP_RAMP:
+      return 3;
+    default:
+      return bytesPerFrame;
+  }
+}
+
+
+/* Encoder */
+
+static void put(writer_t* writer, const uint8_t value) {
+  if (writer->length < writer->outSize) {
+    writer->out[writer->length] = value;
+  }
+  writer->length++;
+}
+
+static void putOp(writer_t* writer, const uint8_t opCode, const uint32_t frames, const uint8_t* payload, const uint8_t payloadSize) {
+  put(writer, (opCode << 6) | (frames - 1));
+  for (int i = 0; i < payloadSize; i++) {
+    put(writer, payload[i]);
+  }
+}
+
+// Counts the frames from start that continue a ramp from base with the given delta per frame
+static uint32_t countRamp(const uint8_t* frames, const uint32_t frameCount, const uint8_t bytesPerFrame,
+  const uint32_t start, const uint8_t* base, const int* delta, const uint32_t maxCount) {
+  uint8_t color[3];
+  uint32_t count = 0;
+
+  while (count < maxCount && start + count < frameCount) {
+    decodeFrameColor(bytesPerFrame, &frames[(start + count) * bytesPerFrame], color);
+    for (int j = 0; j < 3; j++) {
+      if (base[j] + delta[j] * (int)(count + 1) != color[j]) {
+        return count;
+      }
+    }
+    count++;
+  }
+
+  return count;
+}
+
+uint32_t lightFramesEncode(const uint8_t* frames, const uint32_t frameCount, const uint8_t bytesPerFrame, uint8_t* out, const uint32_t outSize) {
+  static const int noDelta[3] = {0, 0, 0};
+  writer_t writer = {.out = out, .outSize = outSize, .length = LIGHT_FRAMES_HEADER_SIZE};
+  uint32_t keyframeOffset = 0;
+  bool isKeyframeNeeded = true;
+  uint8_t previous[3];
+  uint8_t color[3];
+  uint32_t count;
+  uint32_t i = 0;
+
+  if ((bytesPerFrame != 2 && bytesPerFrame != 3) || outSize < LIGHT_FRAMES_HEADER_SIZE) {
+    return 0;
+  }
+
+  while (i < frameCount) {
+    const uint8_t* frame = &frames[i * bytesPerFrame];
+    decodeFrameColor(bytesPerFrame, frame, color);
+
+    if (isKeyframeNeeded || writer.length - keyframeOffset >= LIGHT_FRAMES_KEYFRAME_SPACING) {
+      count = 1 + countRamp(frames, frameCount, bytesPerFrame, i + 1, color, noDelta, OP_MAX_FRAMES - 1);
+      keyframeOffset = writer.length;
+      putOp(&writer, OP_KEY, count, frame, bytesPerFrame);
+      memcpy(previous, color, 3);
+      isKeyframeNeeded = false;
+      i += count;
+      continue;
+    }
+
+    count = countRamp(frames, frameCount, bytesPerFrame, i, previous, noDelta, OP_MAX_FRAMES);
+    if (count > 0) {
+      putOp(&writer, OP_HOLD, count, 0, 0);
+      i += count;
+      continue;
+    }
+
+    int delta[3];
+    bool isRampPossible = true;
+    for (int j = 0; j < 3; j++) {
+      delta[j] = color[j] - previous[j];
+      isRampPossible &= (delta[j] >= INT8_MIN && delta[j] <= INT8_MAX);
+    }
+
+    // A ramp of a single frame is no shorter than setting the color
+    count = isRampPossible ? countRamp(frames, frameCount, bytesPerFrame, i, previous, delta, OP_MAX_FRAMES) : 0;
+    if (count >= 2) {
+      uint8_t payload[3];
+      for (int j = 0; j < 3; j++) {
+        payload[j] = (uint8_t)(int8_t)delta[j];
+        previous[j] += delta[j] * (int)count;
+      }
+      putOp(&writer, OP_RAMP, count, payload, 3);
+      i += count;
+      continue;
+    }
+
+    count = 1 + countRamp(frames, frameCount, bytesPerFrame, i + 1, color, noDelta, OP_MAX_FRAMES - 1);
+    putOp(&writer, OP_SET, count, frame, bytesPerFrame);
+    memcpy(previous, color, 3);
+    i += count;
+  }
+
+  if (writer.length > outSize) {
+    return 0;
+  }
+
+  // The index is built from the encoded operations
+  const uint32_t indexOffset = writer.length;
+  uint32_t keyframeCount = 0;
+  uint32_t offset = LIGHT_FRAMES_HEADER_SIZE;
+  uint32_t firstFrame = 0;
+  while (offset < indexOffset) {
+    const uint8_t opCode = out[offset] >> 6;
+    if (opCode == OP_KEY) {
+      uint8_t entry[INDEX_ENTRY_SIZE];
+      writeUint32(&entry[0], firstFrame);
+      writeUint32(&entry[4], offset);
+      for (int j = 0; j < INDEX_ENTRY_SIZE; j++) {
+        put(&writer, entry[j]);
+      }
+      keyframeCount++;
+    }
+    firstFrame += (out[offset] & 0x3f) + 1;
+    offset += 1 + opPayloadSize(opCode, bytesPerFrame);
+  }
+
+  if (writer.length > outSize) {
+    return 0;
+  }
+
+  out[0] = LIGHT_FRAMES_VERSION;
+  out[1] = bytesPerFrame;
+  out[2] = 0;
+  out[3] = 0;
+  writeUint32(&out[4], keyframeCount);
+  writeUint32(&out[8], frameCount);
+  writeUint32(&out[12], indexOffset);
+
+  return writer.length;
+}
+
+
+/* Decoder */
+
+bool lightFramesDecoderInit(lightFramesDecoder_t* decoder, const uint8_t* data, const uint32_t size) {
+  memset(decoder, 0, sizeof(lightFramesDecoder_t));
+
+  if (size < LIGHT_FRAMES_HEADER_SIZE || data[0] != LIGHT_FRAMES_VERSION || (data[1] != 2 && data[1] != 3)) {
+    return false;
+  }
+
+  decoder->data = data;
+  decoder->size = size;
+  decoder->bytesPerFrame = data[1];
+  decoder->keyframeCount = readUint32(&data[4]);
+  decoder->frameCount = readUint32(&data[8]);
+  decoder->indexOffset = readUint32(&data[12]);
+
+  if (decoder->indexOffset < LIGHT_FRAMES_HEADER_SIZE || decoder->indexOffset > size ||
+      (size - decoder->indexOffset) / INDEX_ENTRY_SIZE < decoder->keyframeCount ||
+      (decoder->frameCount > 0 && decoder->keyframeCount == 0)) {
+    decoder->frameCount = 0;
+    return false;
+  }
+
+  return true;
+}
+
+static bool loadOp(lightFramesDecoder_t* decoder, const uint32_t offset, const uint32_t firstFrame, const uint8_t* colorBefore) {
+  uint8_t opByte, payloadSize;
+
+  decoder->isOpValid = false;
+
+  if (offset >= decoder->indexOffset) {
+    return false;
+  }
+
+  opByte = decoder->data[offset];
+  payloadSize = opPayloadSize(opByte >> 6, decoder->bytesPerFrame);
+  if (decoder->indexOffset - offset - 1 < payloadSize) {
+    return false;
+  }
+
+  memmove(decoder->colorBeforeOp, colorBefore, 3);
+  decoder->opOffset = offset;
+  decoder->opFirstFrame = firstFrame;
+  decoder->opFrameCount = (opByte & 0x3f) + 1;
+  decoder->opCode = opByte >> 6;
+
+  if (decoder->opCode == OP_RAMP) {
+    memcpy(decoder->opColor, &decoder->data[offset + 1], 3);
+  } else if (decoder->opCode != OP_HOLD) {
+    decodeFrameColor(decoder->bytesPerFrame, &decoder->data[offset + 1], decoder->opColor);
+  }
+
+  decoder->isOpValid = true;
+  return true;
+}
+
+static void opColorAt(const lightFramesDecoder_t* decoder, const uint32_t frameInOp, uint8_t* color) {
+  int value;
+
+  switch (decoder->opCode) {
+    case OP_HOLD:
+      memcpy(color, decoder->colorBeforeOp, 3);
+      break;
+
+    case OP_RAMP:
+      for (int j = 0; j < 3; j++) {
+        value = decoder->colorBeforeOp[j] + (int8_t)decoder->opColor[j] * (int)(frameInOp + 1);
+        color[j] = value < 0 ? 0 : (value > 255 ? 255 : value);
+      }
+      break;
+
+    default:
+      memcpy(color, decoder->opColor, 3);
+      break;
+  }
+}
+
+static bool isFrameInOp(const lightFramesDecoder_t* decoder, const uint32_t frame) {
+  return decoder->isOpValid && frame >= decoder->opFirstFrame && frame - decoder->opFirstFrame < decoder->opFrameCount;
+}
+
+static bool advance(lightFramesDecoder_t* decoder) {
+  uint8_t lastColor[3];
+
+  opColorAt(decoder, decoder->opFrameCount - 1, lastColor);
+  return loadOp(decoder,
+    decoder->opOffset + 1 + opPayloadSize(decoder->opCode, decoder->bytesPerFrame),
+    decoder->opFirstFrame + decoder->opFrameCount,
+    lastColor);
+}
+
+static bool seek(lightFramesDecoder_t* decoder, const uint32_t frame) {
+  static const uint8_t black[3] = {0, 0, 0};
+  const uint8_t* index = &decoder->data[decoder->indexOffset];
+  uint32_t low = 0;
+  uint32_t high = decoder->keyframeCount;
+
+  // Find the last keyframe at or before the frame
+  while (high - low > 1) {
+    const uint32_t middle = (low + high) / 2;
+    if (readUint32(&index[middle * INDEX_ENTRY_SIZE]) <= frame) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  if (readUint32(&index[low * INDEX_ENTRY_SIZE]) > frame ||
+      !loadOp(decoder, readUint32(&index[low * INDEX_ENTRY_SIZE + 4]), readUint32(&index[low * INDEX_ENTRY_SIZE]), black) ||
+      decoder->opCode != OP_KEY) {
+    decoder->isOpValid = false;
+    return false;
+  }
+
+  while (!isFrameInOp(decoder, frame)) {
+    if (!advance(decoder)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool lightFramesDecode(lightFramesDecoder_t* decoder, const uint32_t frame, uint8_t* color, uint8_t* nextColor) {
+  if (frame >= decoder->frameCount) {
+    return false;
+  }
+
+  if (!isFrameInOp(decoder, frame)) {
+    // Playback moves forward by at most one operation between calls
+    if (!(decoder->isOpValid && frame > decoder->opFirstFrame && advance(decoder) && isFrameInOp(decoder, frame))) {
+      if (!seek(decoder, frame)) {
+        return false;
+      }
+    }
+  }
+
+  opColorAt(decoder, frame - decoder->opFirstFrame, color);
+
+  if (nextColor) {
+    if (frame + 1 >= decoder->frameCount) {
+      memcpy(nextColor, color, 3);
+    } else if (isFrameInOp(decoder, frame + 1)) {
+      opColorAt(decoder, frame + 1 - decoder->opFirstFrame, nextColor);
+    } else {
+      lightFramesDecoder_t peek = *decoder;
+      if (advance(&peek)) {
+        opColorAt(&peek, 0, nextColor);
+      } else {
+        memcpy(nextColor, color, 3);
+      }
+    }
+  }
+
+  return true;
+}
@@ -148,3 +148,11 @@ float lighthouseCalibrationMeasurementModelLh2(const float x, const float y, con
 
   return base - (calib->phase + compGib);
 }
+
+void lighthouseCalibrationPrecomputeLh2(const lighthouseCalibrationSweep_t* calib, const float t, lighthouseCalibrationSweepCache_t* cache) {
+  cache->tanT = tanf(t);
+  cache->tanTMinusTilt = tanf(t - calib->tilt);
+  cache->phase = calib->phase;
+  cache->gibCos = calib->gibmag * arm_cos_f32(calib->gibphase);
+  cache->gibSin = calib->gibmag * arm_sin_f32(calib->gibphase);
+}
@@ -34,6 +34,7 @@
  * lighthouseGeometry.c: lighthouse tracking system geometry functions
  */
 
+#include <string.h>
 #include "lighthouse_geometry.h"
 #include "cf_math.h"
 
@@ -113,6 +114,159 @@ bool lighthouseGeometryGetPositionFromRayIntersection(const baseStationGeometry_
     return intersect_lines(origin1, ray1, origin2, ray2, position, position_delta);
 }
 
+void lighthouseGeometryRaysInit(lighthouseGeometryRays_t* rays, const int sensorCount) {
+    memset(rays, 0, sizeof(lighthouseGeometryRays_t));
+    rays->sensorCount = sensorCount < LIGHTHOUSE_GEOMETRY_MAX_SENSORS ? sensorCount : LIGHTHOUSE_GEOMETRY_MAX_SENSORS;
+}
+
+bool lighthouseGeometryRaysAdd(lighthouseGeometryRays_t* rays, const baseStationGeometry_t* geo, const float anglesH[], const float anglesV[], const uint8_t sensorMask) {
+    if (rays->baseStationCount >= LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS) {
+        return false;
+    }
+
+    const int bs = rays->baseStationCount;
+    lighthouseGeometryGetBaseStationPosition(geo, rays->origin[bs]);
+
+    for (int sensor = 0; sensor < rays->sensorCount; sensor++) {
+        if (sensorMask & (1 << sensor)) {
+            vec3d ray;
+            lighthouseGeometryGetRay(geo, anglesH[sensor], anglesV[sensor], ray);
+            rays->dx[bs][sensor] = ray[0];
+            rays->dy[bs][sensor] = ray[1];
+            rays->dz[bs][sensor] = ray[2];
+            rays->weight[bs][sensor] = 1.0f;
+        } else {
+            rays->dx[bs][sensor] = 0.0f;
+            rays->dy[bs][sensor] = 0.0f;
+            rays->dz[bs][sensor] = 0.0f;
+            rays->weight[bs][sensor] = 0.0f;
+        }
+    }
+
+    rays->baseStationCount++;
+    return true;
+}
+
+// acc += scale * w - u * v, element wise for all sensors. w is skipped if NULL.
+static void accumulateRays(float* acc, const float* w, const float scale, const float* u, const float* v, float* tmp, const int n) {
+    arm_mult_f32((float32_t*)u, (float32_t*)v, tmp, n);
+    arm_sub_f32(acc, tmp, acc, n);
+    if (w) {
+        arm_scale_f32((float32_t*)w, scale, tmp, n);
+        arm_add_f32(acc, tmp, acc, n);
+    }
+}
+
+int lighthouseGeometryRaysSolve(const lighthouseGeometryRays_t* rays, vec3d position, float* residual) {
+    const int n = rays->sensorCount;
+
+    // Normal equations A * p = b, where A is the sum of the projections (I - d * d^T) and b is the sum of
+    // (I - d * d^T) * o. A is symmetric, only the upper triangle is computed. The origins are relative to the
+    // first base station to keep the numbers small.
+    float a00[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float a01[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float a02[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float a11[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float a12[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float a22[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float b0[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float b1[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float b2[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float rayCount[LIGHTHOUSE_GEOMETRY_MAX_SENSORS] = {0};
+    float k[LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+    float tmp[LIGHTHOUSE_GEOMETRY_MAX_SENSORS];
+
+    const float* reference = rays->origin[0];
+    vec3d origins[LIGHTHOUSE_GEOMETRY_MAX_RAY_BASE_STATIONS];
+
+    for (int bs = 0; bs < rays->baseStationCount; bs++) {
+        const float* dx = rays->dx[bs];
+        const float* dy = rays->dy[bs];
+        const float* dz = rays->dz[bs];
+        const float* w = rays->weight[bs];
+        float* o = origins[bs];
+        arm_sub_f32((float32_t*)rays->origin[bs], (float32_t*)reference, o, vec3d_size);
+
+        // k = d^T * o
+        arm_scale_f32((float32_t*)dx, o[0], k, n);
+        arm_scale_f32((float32_t*)dy, o[1], tmp, n);
+        arm_add_f32(k, tmp, k, n);
+        arm_scale_f32((float32_t*)dz, o[2], tmp, n);
+        arm_add_f32(k, tmp, k, n);
+
+        accumulateRays(a00, w, 1.0f, dx, dx, tmp, n);
+        accumulateRays(a01, NULL, 0.0f, dx, dy, tmp, n);
+        accumulateRays(a02, NULL, 0.0f, dx, dz, tmp, n);
+        accumulateRays(a11, w, 1.0f, dy, dy, tmp, n);
+        accumulateRays(a12, NULL, 0.0f, dy, dz, tmp, n);
+        accumulateRays(a22, w, 1.0f, dz, dz, tmp, n);
+
+        accumulateRays(b0, w, o[0], dx, k, tmp, n);
+        accumulateRays(b1, w, o[1], dy, k, tmp, n);
+        accumulateRays(b2, w, o[2], dz, k, tmp, n);
+
+        arm_add_f32(rayCount, (float32_t*)w, rayCount, n);
+    }
+
+    int solvedCount = 0;
+    int usedRayCount = 0;
+    float squaredDistanceSum = 0.0f;
+    vec3d positionSum = {0};
+
+    for (int sensor = 0; sensor < n; sensor++) {
+        if (rayCount[sensor] < 2.0f) {
+            continue;
+        }
+
+        // Cofactors
+        const float c00 = a11[sensor] * a22[sensor] - a12[sensor] * a12[sensor];
+        const float c01 = a02[sensor] * a12[sensor] - a01[sensor] * a22[sensor];
+        const float c02 = a01[sensor] * a12[sensor] - a02[sensor] * a11[sensor];
+        const float c11 = a00[sensor] * a22[sensor] - a02[sensor] * a02[sensor];
+        const float c12 = a01[sensor] * a02[sensor] - a00[sensor] * a12[sensor];
+        const float c22 = a00[sensor] * a11[sensor] - a01[sensor] * a01[sensor];
+
+        const float det = a00[sensor] * c00 + a01[sensor] * c01 + a02[sensor] * c02;
+        // The rays are parallel
+        if (fabsf(det) < 1e-5f) {
+            continue;
+        }
+
+        const vec3d p = {
+            (c00 * b0[sensor] + c01 * b1[sensor] + c02 * b2[sensor]) / det,
+            (c01 * b0[sensor] + c11 * b1[sensor] + c12 * b2[sensor]) / det,
+            (c02 * b0[sensor] + c12 * b1[sensor] + c22 * b2[sensor]) / det,
+        };
+
+        // Distances from the rays to the solution
+        for (int bs = 0; bs < rays->baseStationCount; bs++) {
+            if (rays->weight[bs][sensor] > 0.0f) {
+                const vec3d d = {rays->dx[bs][sensor], rays->dy[bs][sensor], rays->dz[bs][sensor]};
+                vec3d e = {p[0] - origins[bs][0], p[1] - origins[bs][1], p[2] - origins[bs][2]};
+                const float t = vec_dot(d, e);
+                e[0] -= t * d[0];
+                e[1] -= t * d[1];
+                e[2] -= t * d[2];
+                squaredDistanceSum += vec_dot(e, e);
+            }
+        }
+
+        vec_add(positionSum, p, positionSum);
+        usedRayCount += (int)rayCount[sensor];
+        solvedCount++;
+    }
+
+    if (solvedCount > 0) {
+        arm_scale_f32(positionSum, 1.0f / solvedCount, position, vec3d_size);
+        arm_add_f32(position, (float32_t*)reference, position, vec3d_size);
+        *residual = arm_sqrt(squaredDistanceSum / usedRayCount);
+    } else {
+        *residual = 0.0f;
+    }
+
+    return solvedCount;
+}
+
 void lighthouseGeometryGetBaseStationPosition(const baseStationGeometry_t* bs, vec3d baseStationPos) {
     // TODO: Make geometry adjustments within base station.
     vec3d rotated_origin_delta = {};
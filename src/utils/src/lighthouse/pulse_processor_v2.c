@@ -244,7 +244,7 @@ void pulseProcessorV2ConvertToV1Angles(const float v2Angle1, const float v2Angle
     v1Angles[1] = atan2f(sinf(v2Angle2 - v2Angle1), (tant * (cosf(v2Angle1) + cosf(v2Angle2))));
 }
 
-static void calculateAngles(const pulseProcessorV2SweepBlock_t* latestBlock, const pulseProcessorV2SweepBlock_t* previousBlock, pulseProcessorResult_t* angles) {
+static void calculateAngles(const pulseProcessorV2SweepBlock_t* latestBlock, const pulseProcessorV2SweepBlock_t* previousBlock, const uint32_t frameTimestamp, pulseProcessorResult_t* angles) {
     const uint8_t channel = latestBlock->channel;
 
     for (int i = 0; i < PULSE_PROCESSOR_N_SENSORS; i++) {
@@ -261,6 +261,11 @@ static void calculateAngles(const pulseProcessorV2SweepBlock_t* latestBlock, con
         measurement->validCount = 2;
     }
     angles->lastUsecTimestamp[channel] = usecTimestamp();
+
+    // The block is completed by a later frame, use the time the second beam hit the first sensor as the time of
+    // the measurement
+    const uint32_t hitTimestamp = (latestBlock->timestamp0 + latestBlock->offset[0]) & PULSE_PROCESSOR_TIMESTAMP_BITMASK;
+    angles->ageUs[channel] = cyclePeriodToMicroseconds(TS_DIFF(frameTimestamp, hitTimestamp));
 }
 
 TESTABLE_STATIC bool isBlockPairGood(const pulseProcessorV2SweepBlock_t* latest, const pulseProcessorV2SweepBlock_t* storage) {
@@ -307,7 +312,7 @@ bool handleAngles(pulseProcessor_t *state, const pulseProcessorFrame_t* frameDat
         if (channel < CONFIG_DECK_LIGHTHOUSE_MAX_N_BS) {
             pulseProcessorV2SweepBlock_t* previousBlock = &state->v2.blocks[channel];
             if (isBlockPairGood(block, previousBlock)) {
-                calculateAngles(block, previousBlock, angles);
+                calculateAngles(block, previousBlock, frameData->timestamp, angles);
 
                 *baseStation = channel;
                 *axis = sweepIdSecond;
@@ -53,10 +53,11 @@ The implementation must handle
 #include "clockCorrectionEngine.h"
 #include "physicalConstants.h"
 
-void tdoaEngineInit(tdoaEngineState_t* engineState, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm) {
-  tdoaStorageInitialize(engineState->anchorInfoArray);
+void tdoaEngineInit(tdoaEngineState_t* engineState, const uint32_t now_ms, tdoaEngineSendTdoaToEstimator sendTdoaToEstimator, tdoaEngineSendTdoaBatchToEstimator sendTdoaBatchToEstimator, const double locodeckTsFreq, const tdoaEngineMatchingAlgorithm_t matchingAlgorithm) {
+  tdoaStorageInitialize(&engineState->anchorStorage);
   tdoaStatsInit(&engineState->stats, now_ms);
   engineState->sendTdoaToEstimator = sendTdoaToEstimator;
+  engineState->sendTdoaBatchToEstimator = sendTdoaBatchToEstimator;
   engineState->locodeckTsFreq = locodeckTsFreq;
   engineState->matchingAlgorithm = matchingAlgorithm;
 
@@ -130,6 +131,18 @@ static double calcDistanceDiff(const tdoaAnchorContext_t* otherAnchorCtx, const
   return SPEED_OF_LIGHT * tdoa / locodeckTsFreq;
 }
 
+// Remote anchors are only looked up, not created. A remote anchor that is not in the storage has not been heard by
+// the tag and can not be used, creating it would evict an anchor that can.
+static bool getRemoteAnchorCtx(tdoaEngineState_t* engineState, const uint8_t anchorId, const uint32_t now_ms, tdoaAnchorContext_t* anchorCtx) {
+  if (tdoaStorageGetAnchorCtx(&engineState->anchorStorage, anchorId, now_ms, anchorCtx)) {
+    STATS_CNT_RATE_EVENT(&engineState->stats.remoteContextHitCount);
+    return true;
+  }
+
+  STATS_CNT_RATE_EVENT(&engineState->stats.remoteContextMissCount);
+  return false;
+}
+
 static bool matchRandomAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_t* otherAnchorCtx, const tdoaAnchorContext_t* anchorCtx, const bool doExcludeId, const uint8_t excludedId) {
   engineState->matching.offset++;
   int remoteCount = 0;
@@ -144,7 +157,7 @@ static bool matchRandomAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext_
     uint8_t index = i % remoteCount;
     const uint8_t candidateAnchorId = engineState->matching.id[index];
     if (!doExcludeId || (excludedId != candidateAnchorId)) {
-      if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, candidateAnchorId, now_ms, otherAnchorCtx)) {
+      if (getRemoteAnchorCtx(engineState, candidateAnchorId, now_ms, otherAnchorCtx)) {
         if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(otherAnchorCtx) && tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
           return true;
         }
@@ -168,7 +181,7 @@ static bool matchYoungestAnchor(tdoaEngineState_t* engineState, tdoaAnchorContex
       const uint8_t candidateAnchorId = engineState->matching.id[index];
       if (!doExcludeId || (excludedId != candidateAnchorId)) {
         if (tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
-          if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, candidateAnchorId, now_ms, otherAnchorCtx)) {
+          if (getRemoteAnchorCtx(engineState, candidateAnchorId, now_ms, otherAnchorCtx)) {
             uint32_t updateTime = otherAnchorCtx->anchorInfo->lastUpdateTime;
             if (updateTime > youmgestUpdateTime) {
               if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(otherAnchorCtx)) {
@@ -182,7 +195,7 @@ static bool matchYoungestAnchor(tdoaEngineState_t* engineState, tdoaAnchorContex
     }
 
     if (bestId >= 0) {
-      tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, bestId, now_ms, otherAnchorCtx);
+      tdoaStorageGetAnchorCtx(&engineState->anchorStorage, bestId, now_ms, otherAnchorCtx);
       return true;
     }
 
@@ -212,11 +225,133 @@ static bool findSuitableAnchor(tdoaEngineState_t* engineState, tdoaAnchorContext
   return result;
 }
 
+static float distanceSq(const point_t* a, const point_t* b) {
+  const float dx = a->x - b->x;
+  const float dy = a->y - b->y;
+  const float dz = a->z - b->z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+// Find all remote anchors that can be paired with the anchor. The ids and positions of the candidates are stored first
+// in the matching lists, the number of candidates is returned.
+static int matchAllAnchors(tdoaEngineState_t* engineState, const tdoaAnchorContext_t* anchorCtx, const bool doExcludeId, const uint8_t excludedId) {
+  int remoteCount = 0;
+  tdoaStorageGetRemoteSeqNrList(anchorCtx, &remoteCount, engineState->matching.seqNr, engineState->matching.id);
+
+  uint32_t now_ms = anchorCtx->currentTime_ms;
+  int candidateCount = 0;
+
+  for (int index = 0; index < remoteCount; index++) {
+    const uint8_t candidateAnchorId = engineState->matching.id[index];
+    if (!doExcludeId || (excludedId != candidateAnchorId)) {
+      if (tdoaStorageGetTimeOfFlight(anchorCtx, candidateAnchorId)) {
+        tdoaAnchorContext_t otherAnchorCtx;
+        if (getRemoteAnchorCtx(engineState, candidateAnchorId, now_ms, &otherAnchorCtx)) {
+          if (engineState->matching.seqNr[index] == tdoaStorageGetSeqNr(&otherAnchorCtx) &&
+              tdoaStorageGetAnchorPosition(&otherAnchorCtx, &engineState->matching.position[candidateCount])) {
+            engineState->matching.id[candidateCount] = candidateAnchorId;
+            candidateCount++;
+          }
+        }
+      }
+    }
+  }
+
+  return candidateCount;
+}
+
+// The position of the tag is not known here, the candidates that are most spread out in space are used as a proxy for
+// a good geometry. Candidates are picked one by one, each time the one that is farthest from the anchors already
+// picked. The picked candidates are moved first in the matching lists.
+static int selectSpreadOutAnchors(tdoaEngineState_t* engineState, const point_t* anchorPosition, const int candidateCount, const int maxCount) {
+  if (candidateCount <= maxCount) {
+    return candidateCount;
+  }
+
+  float minDistanceSq[REMOTE_ANCHOR_DATA_COUNT];
+  for (int i = 0; i < candidateCount; i++) {
+    minDistanceSq[i] = distanceSq(&engineState->matching.position[i], anchorPosition);
+  }
+
+  for (int picked = 0; picked < maxCount; picked++) {
+    int best = picked;
+    for (int i = picked + 1; i < candidateCount; i++) {
+      if (minDistanceSq[i] > minDistanceSq[best]) {
+        best = i;
+      }
+    }
+
+    const uint8_t id = engineState->matching.id[best];
+    const point_t position = engineState->matching.position[best];
+    const float bestDistanceSq = minDistanceSq[best];
+    engineState->matching.id[best] = engineState->matching.id[picked];
+    engineState->matching.position[best] = engineState->matching.position[picked];
+    minDistanceSq[best] = minDistanceSq[picked];
+    engineState->matching.id[picked] = id;
+    engineState->matching.position[picked] = position;
+    minDistanceSq[picked] = bestDistanceSq;
+
+    for (int i = picked + 1; i < candidateCount; i++) {
+      const float d = distanceSq(&engineState->matching.position[i], &position);
+      if (d < minDistanceSq[i]) {
+        minDistanceSq[i] = d;
+      }
+    }
+  }
+
+  return maxCount;
+}
+
+static void processPacketBatch(tdoaEngineState_t* engineState, const tdoaAnchorContext_t* anchorCtx, const int64_t txAn_in_cl_An, const int64_t rxAn_by_T_in_cl_T, const bool doExcludeId, const uint8_t excludedId) {
+  tdoaStats_t* stats = &engineState->stats;
+
+  tdoaBatchMeasurement_t batch = {
+    .stdDev = TDOA_ENGINE_MEASUREMENT_NOISE_STD,
+    .anchorId = tdoaStorageGetId(anchorCtx),
+  };
+
+  if (tdoaStorageGetClockCorrection(anchorCtx) <= 0.0 || !tdoaStorageGetAnchorPosition(anchorCtx, &batch.anchorPosition)) {
+    return;
+  }
+
+  const int candidateCount = matchAllAnchors(engineState, anchorCtx, doExcludeId, excludedId);
+  const int pairCount = selectSpreadOutAnchors(engineState, &batch.anchorPosition, candidateCount, TDOA_BATCH_MAX_PAIRS);
+
+  for (int i = 0; i < pairCount; i++) {
+    tdoaAnchorContext_t otherAnchorCtx;
+    tdoaStorageGetAnchorCtx(&engineState->anchorStorage, engineState->matching.id[i], anchorCtx->currentTime_ms, &otherAnchorCtx);
+    const double distanceDiff = calcDistanceDiff(&otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, engineState->locodeckTsFreq);
+
+    const uint8_t remoteId = engineState->matching.id[i];
+    if (remoteId == stats->anchorId && batch.anchorId == stats->remoteAnchorId) {
+      stats->tdoa = distanceDiff;
+    }
+    if (batch.anchorId == stats->anchorId && remoteId == stats->remoteAnchorId) {
+      stats->tdoa = -distanceDiff;
+    }
+
+    batch.remoteAnchorIds[i] = remoteId;
+    batch.remoteAnchorPositions[i] = engineState->matching.position[i];
+    batch.distanceDiffs[i] = distanceDiff;
+  }
+  batch.pairCount = pairCount;
+
+  if (pairCount > 0) {
+    STATS_CNT_RATE_EVENT(&stats->suitableDataFound);
+    STATS_CNT_RATE_EVENT(&stats->packetsToEstimator);
+    engineState->sendTdoaBatchToEstimator(&batch);
+  }
+}
+
 void tdoaEngineGetAnchorCtxForPacketProcessing(tdoaEngineState_t* engineState, const uint8_t anchorId, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
-  if (tdoaStorageGetCreateAnchorCtx(engineState->anchorInfoArray, anchorId, currentTime_ms, anchorCtx)) {
+  const bool isFull = tdoaStorageIsFull(&engineState->anchorStorage);
+  if (tdoaStorageGetCreateAnchorCtx(&engineState->anchorStorage, anchorId, currentTime_ms, anchorCtx)) {
     STATS_CNT_RATE_EVENT(&engineState->stats.contextHitCount);
   } else {
     STATS_CNT_RATE_EVENT(&engineState->stats.contextMissCount);
+    if (isFull) {
+      STATS_CNT_RATE_EVENT(&engineState->stats.contextEvictionCount);
+    }
   }
 }
 
@@ -230,7 +365,9 @@ void tdoaEngineProcessPacketFiltered(tdoaEngineState_t* engineState, tdoaAnchorC
     STATS_CNT_RATE_EVENT(&engineState->stats.timeIsGood);
 
     tdoaAnchorContext_t otherAnchorCtx;
-    if (findSuitableAnchor(engineState, &otherAnchorCtx, anchorCtx, doExcludeId, excludedId)) {
+    if (engineState->matchingAlgorithm == TdoaEngineMatchingAlgorithmBatch) {
+      processPacketBatch(engineState, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, doExcludeId, excludedId);
+    } else if (findSuitableAnchor(engineState, &otherAnchorCtx, anchorCtx, doExcludeId, excludedId)) {
       STATS_CNT_RATE_EVENT(&engineState->stats.suitableDataFound);
       double tdoaDistDiff = calcDistanceDiff(&otherAnchorCtx, anchorCtx, txAn_in_cl_An, rxAn_by_T_in_cl_T, engineState->locodeckTsFreq);
       enqueueTDOA(&otherAnchorCtx, anchorCtx, tdoaDistDiff, engineState);
@@ -46,6 +46,9 @@ void tdoaStatsInit(tdoaStats_t* tdoaStats, uint32_t now_ms) {
   STATS_CNT_RATE_INIT(&tdoaStats->clockCorrectionCount, STATS_INTERVAL);
   STATS_CNT_RATE_INIT(&tdoaStats->contextHitCount, STATS_INTERVAL);
   STATS_CNT_RATE_INIT(&tdoaStats->contextMissCount, STATS_INTERVAL);
+  STATS_CNT_RATE_INIT(&tdoaStats->contextEvictionCount, STATS_INTERVAL);
+  STATS_CNT_RATE_INIT(&tdoaStats->remoteContextHitCount, STATS_INTERVAL);
+  STATS_CNT_RATE_INIT(&tdoaStats->remoteContextMissCount, STATS_INTERVAL);
   STATS_CNT_RATE_INIT(&tdoaStats->timeIsGood, STATS_INTERVAL);
   STATS_CNT_RATE_INIT(&tdoaStats->suitableDataFound, STATS_INTERVAL);
 }
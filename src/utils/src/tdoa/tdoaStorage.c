@@ -41,71 +41,66 @@ Data storage encapsulation for the TDoA engine
 #define ANCHOR_POSITION_VALIDITY_PERIOD (2 * 1000)
 #define ANCHOR_ACTIVE_VALIDITY_PERIOD (2 * 1000)
 
+#define ANCHOR_USEFULNESS_MAX 15
+#define ANCHOR_USEFULNESS_HALF_LIFE (1000)
 
-static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorInfo_t anchorStorage[], const uint8_t slot, const uint8_t anchor);
+static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorStorage_t* anchorStorage, const uint8_t slot, const uint8_t anchor);
+static uint8_t findSlotToReuse(const tdoaAnchorStorage_t* anchorStorage, const uint32_t currentTime_ms);
+static uint8_t decayedUsefulness(const tdoaAnchorInfo_t* anchorInfo, const uint32_t currentTime_ms);
 
-void tdoaStorageInitialize(tdoaAnchorInfo_t anchorStorage[]) {
-  memset(anchorStorage, 0, sizeof(tdoaAnchorInfo_t) * ANCHOR_STORAGE_COUNT);
+// Remote anchor data and time of flight entries are searched from a home index given by the id of the remote anchor.
+// New entries end up at their home index when it is free, which makes most lookups hit on the first probe.
+static inline int homeIndex(const uint8_t id, const int count) {
+  return id % count;
 }
 
-bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
-  anchorCtx->currentTime_ms = currentTime_ms;
-  uint32_t oldestUpdateTime = currentTime_ms;
-  int firstUninitializedSlot = -1;
-  int oldestSlot = 0;
+static inline int nextIndex(const int index, const int count) {
+  return (index + 1 < count) ? index + 1 : 0;
+}
 
-  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        anchorCtx->anchorInfo = &anchorStorage[i];
-        return true;
-      }
+void tdoaStorageInitialize(tdoaAnchorStorage_t* anchorStorage) {
+  memset(anchorStorage, 0, sizeof(tdoaAnchorStorage_t));
+  memset(anchorStorage->slotOfId, ANCHOR_STORAGE_NO_SLOT, sizeof(anchorStorage->slotOfId));
+}
 
-      if (anchorStorage[i].lastUpdateTime < oldestUpdateTime) {
-        oldestUpdateTime = anchorStorage[i].lastUpdateTime;
-        oldestSlot = i;
-      }
-    } else {
-      if (firstUninitializedSlot == -1) {
-        firstUninitializedSlot = i;
-      }
-    }
+bool tdoaStorageGetCreateAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
+  if (tdoaStorageGetAnchorCtx(anchorStorage, anchor, currentTime_ms, anchorCtx)) {
+    return true;
   }
 
   // The anchor was not found in storage
-  tdoaAnchorInfo_t* newAnchorInfo = 0;
-  if (firstUninitializedSlot != -1) {
-    newAnchorInfo = initializeSlot(anchorStorage, firstUninitializedSlot, anchor);
+  uint8_t slot;
+  if (!tdoaStorageIsFull(anchorStorage)) {
+    slot = anchorStorage->usedCount;
+    anchorStorage->usedCount++;
   } else {
-    newAnchorInfo = initializeSlot(anchorStorage, oldestSlot, anchor);
+    slot = findSlotToReuse(anchorStorage, currentTime_ms);
+    anchorStorage->slotOfId[anchorStorage->anchorInfo[slot].id] = ANCHOR_STORAGE_NO_SLOT;
   }
 
-  anchorCtx->anchorInfo = newAnchorInfo;
+  anchorCtx->anchorInfo = initializeSlot(anchorStorage, slot, anchor);
   return false;
 }
 
-bool tdoaStorageGetAnchorCtx(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
+bool tdoaStorageGetAnchorCtx(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor, const uint32_t currentTime_ms, tdoaAnchorContext_t* anchorCtx) {
   anchorCtx->currentTime_ms = currentTime_ms;
 
-  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        anchorCtx->anchorInfo = &anchorStorage[i];
-        return true;
-      }
-    }
+  const uint8_t slot = anchorStorage->slotOfId[anchor];
+  if (slot != ANCHOR_STORAGE_NO_SLOT) {
+    anchorCtx->anchorInfo = &anchorStorage->anchorInfo[slot];
+    return true;
   }
 
   anchorCtx->anchorInfo = 0;
   return false;
 }
 
-uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize) {
+uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize) {
   int count = 0;
 
   for (int i = 0; i < ANCHOR_STORAGE_COUNT && count < maxListSize; i++) {
-    if (anchorStorage[i].isInitialized) {
-      unorderedAnchorList[count] = anchorStorage[i].id;
+    if (anchorStorage->anchorInfo[i].isInitialized) {
+      unorderedAnchorList[count] = anchorStorage->anchorInfo[i].id;
       count++;
     }
   }
@@ -113,13 +108,13 @@ uint8_t tdoaStorageGetListOfAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t
   return count;
 }
 
-uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorInfo_t anchorStorage[], uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms) {
+uint8_t tdoaStorageGetListOfActiveAnchorIds(tdoaAnchorStorage_t* anchorStorage, uint8_t unorderedAnchorList[], const int maxListSize, const uint32_t currentTime_ms) {
   int count = 0;
 
   const uint32_t expiryTime = currentTime_ms - ANCHOR_ACTIVE_VALIDITY_PERIOD;
   for (int i = 0; i < ANCHOR_STORAGE_COUNT && count < maxListSize; i++) {
-    if (anchorStorage[i].isInitialized && anchorStorage[i].lastUpdateTime > expiryTime) {
-      unorderedAnchorList[count] = anchorStorage[i].id;
+    if (anchorStorage->anchorInfo[i].isInitialized && anchorStorage->anchorInfo[i].lastUpdateTime > expiryTime) {
+      unorderedAnchorList[count] = anchorStorage->anchorInfo[i].id;
       count++;
     }
   }
@@ -184,7 +179,11 @@ void tdoaStorageSetRxTxData(tdoaAnchorContext_t* anchorCtx, int64_t rxTime, int6
   anchorInfo->rxTime = rxTime;
   anchorInfo->txTime = txTime;
   anchorInfo->seqNr = seqNr;
+  anchorInfo->usefulness = decayedUsefulness(anchorInfo, now);
   anchorInfo->lastUpdateTime = now;
+  if (anchorInfo->usefulness < ANCHOR_USEFULNESS_MAX) {
+    anchorInfo->usefulness++;
+  }
 }
 
 double tdoaStorageGetClockCorrection(const tdoaAnchorContext_t* anchorCtx) {
@@ -207,7 +206,7 @@ bool tdoaStorageGetRemoteRxTimeSeqNr(const tdoaAnchorContext_t* anchorCtx, const
   const tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
   bool result = false;
 
-  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
+  for (int n = 0, i = homeIndex(remoteAnchor, REMOTE_ANCHOR_DATA_COUNT); n < REMOTE_ANCHOR_DATA_COUNT; n++, i = nextIndex(i, REMOTE_ANCHOR_DATA_COUNT)) {
     if (remoteAnchor == anchorInfo->remoteAnchorData[i].id) {
       uint32_t now = anchorCtx->currentTime_ms;
       if (anchorInfo->remoteAnchorData[i].endOfLife > now) {
@@ -229,7 +228,7 @@ void tdoaStorageSetRemoteRxTime(tdoaAnchorContext_t* anchorCtx, const uint8_t re
   uint32_t now = anchorCtx->currentTime_ms;
   uint32_t oldestTime = 0xFFFFFFFF;
 
-  for (int i = 0; i < REMOTE_ANCHOR_DATA_COUNT; i++) {
+  for (int n = 0, i = homeIndex(remoteAnchor, REMOTE_ANCHOR_DATA_COUNT); n < REMOTE_ANCHOR_DATA_COUNT; n++, i = nextIndex(i, REMOTE_ANCHOR_DATA_COUNT)) {
     if (remoteAnchor == anchorInfo->remoteAnchorData[i].id) {
       indexToUpdate = i;
       break;
@@ -267,7 +266,7 @@ void tdoaStorageGetRemoteSeqNrList(const tdoaAnchorContext_t* anchorCtx, int* re
 int64_t tdoaStorageGetTimeOfFlight(const tdoaAnchorContext_t* anchorCtx, const uint8_t otherAnchor) {
   const tdoaAnchorInfo_t* anchorInfo = anchorCtx->anchorInfo;
 
-  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
+  for (int n = 0, i = homeIndex(otherAnchor, TOF_PER_ANCHOR_COUNT); n < TOF_PER_ANCHOR_COUNT; n++, i = nextIndex(i, TOF_PER_ANCHOR_COUNT)) {
     if (otherAnchor == anchorInfo->tof[i].id) {
       uint32_t now = anchorCtx->currentTime_ms;
       if (anchorInfo->tof[i].endOfLife > now) {
@@ -287,7 +286,7 @@ void tdoaStorageSetTimeOfFlight(tdoaAnchorContext_t* anchorCtx, const uint8_t re
   uint32_t now = anchorCtx->currentTime_ms;
   uint32_t oldestTime = 0xFFFFFFFF;
 
-  for (int i = 0; i < TOF_PER_ANCHOR_COUNT; i++) {
+  for (int n = 0, i = homeIndex(remoteAnchor, TOF_PER_ANCHOR_COUNT); n < TOF_PER_ANCHOR_COUNT; n++, i = nextIndex(i, TOF_PER_ANCHOR_COUNT)) {
     if (remoteAnchor == anchorInfo->tof[i].id) {
       indexToUpdate = i;
       break;
@@ -304,22 +303,48 @@ void tdoaStorageSetTimeOfFlight(tdoaAnchorContext_t* anchorCtx, const uint8_t re
   anchorInfo->tof[indexToUpdate].endOfLife = now + TOF_VALIDITY_PERIOD;
 }
 
-bool tdoaStorageIsAnchorInStorage(tdoaAnchorInfo_t anchorStorage[], const uint8_t anchor) {
-  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
-    if (anchorStorage[i].isInitialized) {
-      if (anchor == anchorStorage[i].id) {
-        return true;
-      }
-    }
-  }
+bool tdoaStorageIsAnchorInStorage(tdoaAnchorStorage_t* anchorStorage, const uint8_t anchor) {
+  return anchorStorage->slotOfId[anchor] != ANCHOR_STORAGE_NO_SLOT;
+}
 
-  return false;
+static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorStorage_t* anchorStorage, const uint8_t slot, const uint8_t anchor) {
+  tdoaAnchorInfo_t* anchorInfo = &anchorStorage->anchorInfo[slot];
+  memset(anchorInfo, 0, sizeof(tdoaAnchorInfo_t));
+  anchorInfo->id = anchor;
+  anchorInfo->isInitialized = true;
+  anchorStorage->slotOfId[anchor] = slot;
+
+  return anchorInfo;
+}
+
+// Anchors that are heard often are more useful than anchors that are heard once in a while, for instance far away
+// anchors or remote anchors that were only mentioned in packets. The slot to reuse is the one with the longest time
+// since the last packet, weighted by the inverse of the usefulness.
+// The usefulness is halved for every ANCHOR_USEFULNESS_HALF_LIFE ms without packets, an anchor that was heard often a
+// long time ago is not more useful than one that is heard now.
+static uint8_t decayedUsefulness(const tdoaAnchorInfo_t* anchorInfo, const uint32_t currentTime_ms) {
+  const uint32_t idleTime = anchorInfo->lastUpdateTime < currentTime_ms ? currentTime_ms - anchorInfo->lastUpdateTime : 0;
+  const uint32_t halvings = idleTime / ANCHOR_USEFULNESS_HALF_LIFE;
+  return halvings < 8 ? anchorInfo->usefulness >> halvings : 0;
 }
 
-static tdoaAnchorInfo_t* initializeSlot(tdoaAnchorInfo_t anchorStorage[], const uint8_t slot, const uint8_t anchor) {
-  memset(&anchorStorage[slot], 0, sizeof(tdoaAnchorInfo_t));
-  anchorStorage[slot].id = anchor;
-  anchorStorage[slot].isInitialized = true;
+static uint8_t findSlotToReuse(const tdoaAnchorStorage_t* anchorStorage, const uint32_t currentTime_ms) {
+  uint8_t bestSlot = 0;
+  uint64_t bestIdleTime = 0;
+  uint64_t bestWeight = 1;
+
+  for (int i = 0; i < ANCHOR_STORAGE_COUNT; i++) {
+    const tdoaAnchorInfo_t* anchorInfo = &anchorStorage->anchorInfo[i];
+    const uint64_t idleTime = anchorInfo->lastUpdateTime < currentTime_ms ? currentTime_ms - anchorInfo->lastUpdateTime : 0;
+    const uint64_t weight = 1 + decayedUsefulness(anchorInfo, currentTime_ms);
+
+    // idleTime / weight > bestIdleTime / bestWeight
+    if (idleTime * bestWeight > bestIdleTime * weight) {
+      bestSlot = i;
+      bestIdleTime = idleTime;
+      bestWeight = weight;
+    }
+  }
 
-  return &anchorStorage[slot];
+  return bestSlot;
 }
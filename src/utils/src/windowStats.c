@@ -0,0 +1,156 @@
+/**
+ * ,---------,       ____  _ __
+ * |  ,-^-,  |      / __ )(_) /_______________ _____  ___
+ * | (  O  ) |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * | / ,--´  |    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *    +------`   /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * windowStats.c - statistics of the latest samples of a signal
+ */
+
+#include "windowStats.h"
+
+void windowStatsInit(windowStats_t* stats, const uint8_t length) {
+  stats->length = length > WINDOW_STATS_MAX_LENGTH ? WINDOW_STATS_MAX_LENGTH : (length < 1 ? 1 : length);
+  windowStatsReset(stats);
+}
+
+void windowStatsReset(windowStats_t* stats) {
+  stats->count = 0;
+  stats->oldest = 0;
+  stats->addedSinceResync = 0;
+  stats->minQueueFirst = 0;
+  stats->minQueueCount = 0;
+  stats->maxQueueFirst = 0;
+  stats->maxQueueCount = 0;
+  stats->sum = 0.0f;
+  stats->sumOfSquares = 0.0f;
+  stats->sumOfWeighted = 0.0f;
+}
+
+static uint8_t wrap(const windowStats_t* stats, const uint16_t index) {
+  return index % stats->length;
+}
+
+// Removes the samples at the back that are not better than the new one and appends it
+static void pushToQueue(const windowStats_t* stats, uint8_t* queue, const uint8_t first, uint8_t* count, const uint8_t position, const bool isMin) {
+  const float sample = stats->samples[position];
+
+  while (*count > 0) {
+    const float last = stats->samples[queue[wrap(stats, first + *count - 1)]];
+    if (isMin ? (last < sample) : (last > sample)) {
+      break;
+    }
+    (*count)--;
+  }
+
+  queue[wrap(stats, first + *count)] = position;
+  (*count)++;
+}
+
+static void popFromQueue(const windowStats_t* stats, const uint8_t* queue, uint8_t* first, uint8_t* count, const uint8_t position) {
+  if (*count > 0 && queue[*first] == position) {
+    *first = wrap(stats, *first + 1);
+    (*count)--;
+  }
+}
+
+// Rounding errors of the running sums are removed once per window
+static void resync(windowStats_t* stats) {
+  stats->sum = 0.0f;
+  stats->sumOfSquares = 0.0f;
+  stats->sumOfWeighted = 0.0f;
+
+  for (uint8_t i = 0; i < stats->count; i++) {
+    const float sample = stats->samples[wrap(stats, stats->oldest + i)];
+    stats->sum += sample;
+    stats->sumOfSquares += sample * sample;
+    stats->sumOfWeighted += sample * i;
+  }
+
+  stats->addedSinceResync = 0;
+}
+
+void windowStatsAdd(windowStats_t* stats, const float sample) {
+  uint8_t position;
+
+  if (stats->count == stats->length) {
+    position = stats->oldest;
+    const float removed = stats->samples[position];
+
+    popFromQueue(stats, stats->minQueue, &stats->minQueueFirst, &stats->minQueueCount, position);
+    popFromQueue(stats, stats->maxQueue, &stats->maxQueueFirst, &stats->maxQueueCount, position);
+
+    // All samples move one step closer to the oldest
+    stats->sumOfWeighted += -(stats->sum - removed) + sample * (stats->count - 1);
+    stats->sum += sample - removed;
+    stats->sumOfSquares += sample * sample - removed * removed;
+    stats->oldest = wrap(stats, stats->oldest + 1);
+  } else {
+    position = wrap(stats, stats->oldest + stats->count);
+
+    stats->sumOfWeighted += sample * stats->count;
+    stats->sum += sample;
+    stats->sumOfSquares += sample * sample;
+    stats->count++;
+  }
+
+  stats->samples[position] = sample;
+  pushToQueue(stats, stats->minQueue, stats->minQueueFirst, &stats->minQueueCount, position, true);
+  pushToQueue(stats, stats->maxQueue, stats->maxQueueFirst, &stats->maxQueueCount, position, false);
+
+  stats->addedSinceResync++;
+  if (stats->addedSinceResync >= stats->length) {
+    resync(stats);
+  }
+}
+
+float windowStatsMin(const windowStats_t* stats) {
+  return stats->minQueueCount > 0 ? stats->samples[stats->minQueue[stats->minQueueFirst]] : 0.0f;
+}
+
+float windowStatsMax(const windowStats_t* stats) {
+  return stats->maxQueueCount > 0 ? stats->samples[stats->maxQueue[stats->maxQueueFirst]] : 0.0f;
+}
+
+float windowStatsMean(const windowStats_t* stats) {
+  return stats->count > 0 ? stats->sum / stats->count : 0.0f;
+}
+
+float windowStatsVariance(const windowStats_t* stats) {
+  if (stats->count < 2) {
+    return 0.0f;
+  }
+
+  const float n = stats->count;
+  const float variance = (stats->sumOfSquares - stats->sum * stats->sum / n) / (n - 1.0f);
+  return variance > 0.0f ? variance : 0.0f;
+}
+
+float windowStatsSlope(const windowStats_t* stats) {
+  if (stats->count < 2) {
+    return 0.0f;
+  }
+
+  const float n = stats->count;
+  const float meanOrder = (n - 1.0f) / 2.0f;
+  const float orderVariance = n * (n * n - 1.0f) / 12.0f;
+  return (stats->sumOfWeighted - meanOrder * stats->sum) / orderVariance;
+}
@@ -0,0 +1,243 @@
+// @IGNORE_IF_NOT CONFIG_ESTIMATOR_KALMAN_HISTORY
+
+// File under test estimator_kalman.c
+#include "estimator_kalman.h"
+
+#include <string.h>
+#include "unity.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#include "kalman_core.h"
+#include "kalman_supervisor.h"
+#include "axis3fSubSampler.h"
+#include "mm_pose.h"
+
+#include "mock_estimator.h"
+#include "mock_system.h"
+#include "mock_supervisor.h"
+#include "mock_rateSupervisor.h"
+#include "mock_statsCnt.h"
+#include "mock_outlierFilterTdoa.h"
+#include "mock_outlierFilterLighthouse.h"
+#include "mock_mm_distance.h"
+#include "mock_mm_absolute_height.h"
+#include "mock_mm_position.h"
+#include "mock_mm_tdoa.h"
+#include "mock_mm_flow.h"
+#include "mock_mm_tof.h"
+#include "mock_mm_yaw_error.h"
+#include "mock_mm_sweep_angles.h"
+#include "mock_mm_tdoa_robust.h"
+#include "mock_mm_distance_robust.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+// Runs one loop of the kalman task, normally called from the task when the stabilizer loop releases it
+void kalmanTaskLoop(const uint32_t nowMs);
+
+#define RUN_MS 100
+#define START_INTERVAL_MS 1000
+#define QUEUE_SIZE 4
+
+static uint32_t currentMs;
+static bool isImuPending;
+
+static measurement_t queue[QUEUE_SIZE];
+static int queueCount;
+
+static bool mockEstimatorDequeue(measurement_t* measurement, int cmock_num_calls);
+static bool mockEstimatorDequeueImu(imuSample_t* sample, int cmock_num_calls);
+
+static uint32_t fixtureInit();
+static void fixtureEnqueuePose(const float x, const uint32_t timestamp);
+static void fixtureRunUntil(const uint32_t endMs);
+static void assertStatesEqual(const state_t* expected, const state_t* actual);
+
+void setUp(void) {
+  queueCount = 0;
+
+  estimatorDequeue_StubWithCallback(mockEstimatorDequeue);
+  estimatorDequeueImu_StubWithCallback(mockEstimatorDequeueImu);
+  supervisorIsFlying_IgnoreAndReturn(false);
+  rateSupervisorValidate_IgnoreAndReturn(true);
+  outlierFilterTdoaReset_Ignore();
+  outlierFilterLighthouseReset_Ignore();
+
+  estimatorKalmanTaskInit();
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAnOutOfOrderPoseGivesTheSameStateAsPosesOnTime() {
+  // Fixture
+  state_t expected;
+  uint32_t startMs = fixtureInit();
+  fixtureRunUntil(startMs + 55);
+  fixtureEnqueuePose(0.5f, startMs + 55);
+  fixtureRunUntil(startMs + 65);
+  fixtureEnqueuePose(0.6f, startMs + 65);
+  fixtureRunUntil(startMs + RUN_MS);
+  estimatorKalman(&expected, 0);
+
+  state_t actual;
+  startMs = fixtureInit();
+  fixtureRunUntil(startMs + 65);
+  fixtureEnqueuePose(0.6f, startMs + 65);
+  fixtureRunUntil(startMs + 75);
+
+  // Test
+  fixtureEnqueuePose(0.5f, startMs + 55);
+  fixtureRunUntil(startMs + RUN_MS);
+
+  // Assert
+  estimatorKalman(&actual, 0);
+  assertStatesEqual(&expected, &actual);
+}
+
+void testThatALatePoseIsFused() {
+  // Fixture
+  state_t withoutPose;
+  uint32_t startMs = fixtureInit();
+  fixtureRunUntil(startMs + RUN_MS);
+  estimatorKalman(&withoutPose, 0);
+
+  state_t actual;
+  startMs = fixtureInit();
+  fixtureRunUntil(startMs + 75);
+
+  // Test
+  fixtureEnqueuePose(0.5f, startMs + 55);
+  fixtureRunUntil(startMs + RUN_MS);
+
+  // Assert
+  estimatorKalman(&actual, 0);
+  TEST_ASSERT_TRUE(actual.position.x > withoutPose.position.x + 0.1f);
+}
+
+void testThatAPoseLaggingMoreThanTheMaxLagIsDropped() {
+  // Fixture
+  state_t withoutPose;
+  uint32_t startMs = fixtureInit();
+  fixtureRunUntil(startMs + RUN_MS);
+  estimatorKalman(&withoutPose, 0);
+
+  state_t actual;
+  startMs = fixtureInit();
+  fixtureRunUntil(startMs + 75);
+
+  // Test
+  fixtureEnqueuePose(0.5f, startMs - 500);
+  fixtureRunUntil(startMs + RUN_MS);
+
+  // Assert
+  estimatorKalman(&actual, 0);
+  assertStatesEqual(&withoutPose, &actual);
+}
+
+// Helpers
+
+static bool mockEstimatorDequeue(measurement_t* measurement, int cmock_num_calls) {
+  if (queueCount == 0) {
+    return false;
+  }
+
+  *measurement = queue[0];
+  queueCount--;
+  memmove(&queue[0], &queue[1], queueCount * sizeof(measurement_t));
+  return true;
+}
+
+static bool mockEstimatorDequeueImu(imuSample_t* sample, int cmock_num_calls) {
+  if (!isImuPending) {
+    return false;
+  }
+
+  // Hovering with a slow rotation around z, one sample per loop
+  sample->acc = (Axis3f){.x = 0.0f, .y = 0.0f, .z = 1.0f};
+  sample->gyro = (Axis3f){.x = 0.0f, .y = 0.0f, .z = 10.0f};
+  isImuPending = false;
+  return true;
+}
+
+// Resets the filter at a later time than the previous run, the runs of a test are compared at the same time
+// relative to their start
+static uint32_t fixtureInit() {
+  currentMs += START_INTERVAL_MS;
+  queueCount = 0;
+  estimatorKalmanInit();
+  return currentMs;
+}
+
+static void fixtureEnqueuePose(const float x, const uint32_t timestamp) {
+  TEST_ASSERT_TRUE(queueCount < QUEUE_SIZE);
+
+  measurement_t* m = &queue[queueCount];
+  memset(m, 0, sizeof(measurement_t));
+  m->type = MeasurementTypePose;
+  m->timestamp = timestamp;
+  m->data.pose.x = x;
+  m->data.pose.y = 0.0f;
+  m->data.pose.z = 0.0f;
+  m->data.pose.quat.w = 1.0f;
+  m->data.pose.stdDevPos = 0.01f;
+  m->data.pose.stdDevQuat = 0.05f;
+  queueCount++;
+}
+
+// Runs the loops of the task up to, but not including, endMs. A measurement that is enqueued after the call is
+// dequeued by the loop at endMs.
+static void fixtureRunUntil(const uint32_t endMs) {
+  for (; currentMs < endMs; currentMs++) {
+    isImuPending = true;
+    kalmanTaskLoop(currentMs);
+  }
+}
+
+static void assertStatesEqual(const state_t* expected, const state_t* actual) {
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->position.x, actual->position.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->position.y, actual->position.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->position.z, actual->position.z);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->velocity.x, actual->velocity.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->velocity.y, actual->velocity.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->velocity.z, actual->velocity.z);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->attitudeQuaternion.w, actual->attitudeQuaternion.w);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->attitudeQuaternion.x, actual->attitudeQuaternion.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->attitudeQuaternion.y, actual->attitudeQuaternion.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected->attitudeQuaternion.z, actual->attitudeQuaternion.z);
+}
+
+// FreeRTOS functions used by the task, the test runs the loop of the task directly
+
+TickType_t xTaskGetTickCount(void) {
+  return M2T(currentMs);
+}
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType) {
+  return (QueueHandle_t)1;
+}
+
+QueueHandle_t xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t* pxStaticQueue) {
+  return (QueueHandle_t)pxStaticQueue;
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait) {
+  return pdTRUE;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void* const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+  return pdTRUE;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t pxTaskCode, const char* const pcName, const uint32_t ulStackDepth, void* const pvParameters, UBaseType_t uxPriority, StackType_t* const puxStackBuffer, StaticTask_t* const pxTaskBuffer) {
+  return (TaskHandle_t)pxTaskBuffer;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+  return 1000;
+}
@@ -0,0 +1,216 @@
+// File under test kalman_core.c
+#include "kalman_core.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "unity.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+// A linear measurement of the position, measured = h * position + offset
+typedef struct {
+  float h[3];
+  float offset;
+} linearMeasurement_t;
+
+static kalmanCoreData_t this;
+static kalmanCoreData_t reference;
+static kalmanCoreParams_t params;
+static linearMeasurement_t measurement;
+
+#define STD_DEV 0.1f
+#define SIGMA_MEASUREMENT 2.0f
+#define SIGMA_STATE 1.5f
+
+static bool linearModel(const float position[3], const void* data, float* predicted, float h[3]);
+static float predictedAtPrior(const kalmanCoreData_t* core);
+static void scalarUpdateOfReference(const float error);
+static float positionChange(const kalmanCoreData_t* before, const kalmanCoreData_t* after);
+static void fillCorrelatedCovariance(kalmanCoreData_t* core);
+static float innovationChange(const float h[KC_STATE_DIM], const kalmanCoreData_t* before, const kalmanCoreData_t* after);
+
+void setUp(void) {
+  kalmanCoreDefaultParams(&params);
+  kalmanCoreInit(&this, &params, 0);
+  fillCorrelatedCovariance(&this);
+
+  this.S[KC_STATE_X] = 1.0f;
+  this.S[KC_STATE_Y] = 2.0f;
+  this.S[KC_STATE_Z] = 0.5f;
+
+  measurement.h[0] = 0.6f;
+  measurement.h[1] = -0.8f;
+  measurement.h[2] = 0.0f;
+  measurement.offset = 3.0f;
+
+  memcpy(&reference, &this, sizeof(reference));
+  reference.Pm.pData = (float*)reference.P;
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatRobustUpdateOfInlierMatchesTheScalarUpdate() {
+  // Fixture
+  const float measured = predictedAtPrior(&this);
+  scalarUpdateOfReference(0.0f);
+
+  // Test
+  kalmanCoreRobustScalarUpdate(&this, linearModel, &measurement, measured, STD_DEV, SIGMA_MEASUREMENT, SIGMA_STATE);
+
+  // Assert
+  TEST_ASSERT_TRUE(this.isUpdated);
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, reference.S[i], this.S[i]);
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-5f, reference.P[i][j], this.P[i][j]);
+    }
+  }
+}
+
+void testThatRobustUpdateMovesTheStateMuchLessForAnOutlier() {
+  // Fixture
+  const float error = 5.0f;
+  const float measured = predictedAtPrior(&this) + error;
+
+  kalmanCoreData_t prior;
+  memcpy(&prior, &this, sizeof(prior));
+  scalarUpdateOfReference(error);
+
+  // Test
+  kalmanCoreRobustScalarUpdate(&this, linearModel, &measurement, measured, STD_DEV, SIGMA_MEASUREMENT, SIGMA_STATE);
+
+  // Assert
+  const float standardChange = positionChange(&prior, &reference);
+  const float robustChange = positionChange(&prior, &this);
+  TEST_ASSERT_TRUE(standardChange > 1.0f);
+  TEST_ASSERT_TRUE(robustChange < 0.1f * standardChange);
+}
+
+void testThatRobustUpdateKeepsTheCovarianceSymmetricWithPositiveDiagonal() {
+  // Fixture
+  const float measured = predictedAtPrior(&this) + 5.0f;
+
+  // Test
+  kalmanCoreRobustScalarUpdate(&this, linearModel, &measurement, measured, STD_DEV, SIGMA_MEASUREMENT, SIGMA_STATE);
+
+  // Assert
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_TRUE(this.P[i][i] > 0.0f);
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_EQUAL_FLOAT(this.P[i][j], this.P[j][i]);
+    }
+  }
+}
+
+void testThatRobustUpdateIsSkippedWhenTheModelFails() {
+  // Fixture
+  measurement.offset = NAN;
+
+  // Test
+  kalmanCoreRobustScalarUpdate(&this, linearModel, &measurement, 1.0f, STD_DEV, SIGMA_MEASUREMENT, SIGMA_STATE);
+
+  // Assert
+  TEST_ASSERT_FALSE(this.isUpdated);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(reference.S, this.S, KC_STATE_DIM);
+}
+
+void testThatBatchUpdateWithDiagonalNoiseMatchesSequentialScalarUpdates() {
+  // Fixture
+  float h[2 * KC_STATE_DIM] = {0};
+  h[KC_STATE_X] = 0.6f;
+  h[KC_STATE_Y] = -0.8f;
+  h[KC_STATE_DIM + KC_STATE_Y] = 0.3f;
+  h[KC_STATE_DIM + KC_STATE_Z] = 0.9f;
+  h[KC_STATE_DIM + KC_STATE_PX] = 0.1f;
+  arm_matrix_instance_f32 H = {2, KC_STATE_DIM, h};
+
+  const float errors[2] = {0.2f, -0.3f};
+  const float stdDevs[2] = {0.1f, 0.25f};
+  float r[2 * 2] = {stdDevs[0] * stdDevs[0], 0.0f, 0.0f, stdDevs[1] * stdDevs[1]};
+  arm_matrix_instance_f32 R = {2, 2, r};
+
+  // The second scalar update is done after the first, its innovation is relative to the updated state
+  kalmanCoreData_t prior;
+  memcpy(&prior, &reference, sizeof(prior));
+
+  arm_matrix_instance_f32 H1 = {1, KC_STATE_DIM, &h[0]};
+  kalmanCoreScalarUpdate(&reference, &H1, errors[0], stdDevs[0]);
+
+  arm_matrix_instance_f32 H2 = {1, KC_STATE_DIM, &h[KC_STATE_DIM]};
+  const float error2 = errors[1] - innovationChange(&h[KC_STATE_DIM], &prior, &reference);
+  kalmanCoreScalarUpdate(&reference, &H2, error2, stdDevs[1]);
+
+  // Test
+  kalmanCoreBatchUpdate(&this, &H, errors, &R);
+
+  // Assert
+  TEST_ASSERT_TRUE(this.isUpdated);
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, reference.S[i], this.S[i]);
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-5f, reference.P[i][j], this.P[i][j]);
+    }
+  }
+}
+
+// Helpers
+
+static bool linearModel(const float position[3], const void* data, float* predicted, float h[3]) {
+  const linearMeasurement_t* m = data;
+  if (isnan(m->offset)) {
+    return false;
+  }
+
+  *predicted = m->offset;
+  for (int i = 0; i < 3; i++) {
+    *predicted += m->h[i] * position[i];
+    h[i] = m->h[i];
+  }
+
+  return true;
+}
+
+static float predictedAtPrior(const kalmanCoreData_t* core) {
+  float predicted;
+  float h[3];
+  const float position[3] = {core->S[KC_STATE_X], core->S[KC_STATE_Y], core->S[KC_STATE_Z]};
+  linearModel(position, &measurement, &predicted, h);
+  return predicted;
+}
+
+static void scalarUpdateOfReference(const float error) {
+  float h[KC_STATE_DIM] = {0};
+  arm_matrix_instance_f32 H = {1, KC_STATE_DIM, h};
+  h[KC_STATE_X] = measurement.h[0];
+  h[KC_STATE_Y] = measurement.h[1];
+  h[KC_STATE_Z] = measurement.h[2];
+
+  kalmanCoreScalarUpdate(&reference, &H, error, STD_DEV);
+}
+
+static float positionChange(const kalmanCoreData_t* before, const kalmanCoreData_t* after) {
+  const float dx = after->S[KC_STATE_X] - before->S[KC_STATE_X];
+  const float dy = after->S[KC_STATE_Y] - before->S[KC_STATE_Y];
+  const float dz = after->S[KC_STATE_Z] - before->S[KC_STATE_Z];
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Positive definite with correlations between all states
+static void fillCorrelatedCovariance(kalmanCoreData_t* core) {
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    for (int j = 0; j < KC_STATE_DIM; j++) {
+      core->P[i][j] = (i == j) ? 1.0f : 0.1f / (1 + abs(i - j));
+    }
+  }
+}
+
+static float innovationChange(const float h[KC_STATE_DIM], const kalmanCoreData_t* before, const kalmanCoreData_t* after) {
+  float change = 0.0f;
+  for (int i = 0; i < KC_STATE_DIM; i++) {
+    change += h[i] * (after->S[i] - before->S[i]);
+  }
+  return change;
+}
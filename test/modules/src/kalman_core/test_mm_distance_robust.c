@@ -0,0 +1,107 @@
+// File under test mm_distance_robust.c
+#include "mm_distance_robust.h"
+
+#include <math.h>
+#include "unity.h"
+
+#include "mock_kalman_core.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static kalmanCoreData_t this;
+
+static int robustUpdateCallCount;
+static kalmanCoreRobustModel_t actualModel;
+static const void* actualMeasurement;
+static float actualMeasured;
+static float actualStdDev;
+
+static void mockKalmanCoreRobustScalarUpdateCallback(kalmanCoreData_t* actualThis, kalmanCoreRobustModel_t model, const void* measurement, const float measured, const float stdDev, const float sigmaMeasurement, const float sigmaState, int cmock_num_calls) {
+  TEST_ASSERT_EQUAL_PTR(&this, actualThis);
+  TEST_ASSERT_TRUE(sigmaMeasurement > 0.0f);
+  TEST_ASSERT_TRUE(sigmaState > 0.0f);
+
+  robustUpdateCallCount++;
+  actualModel = model;
+  actualMeasurement = measurement;
+  actualMeasured = measured;
+  actualStdDev = stdDev;
+}
+
+static distanceMeasurement_t createMeasurement() {
+  distanceMeasurement_t measurement = {
+    .x = 1.0, .y = 2.0, .z = 0.0,
+    .anchorId = 3,
+    .distance = 2.5,
+    .stdDev = 0.25,
+  };
+
+  return measurement;
+}
+
+void setUp(void) {
+  memset(&this, 0, sizeof(this));
+  robustUpdateCallCount = 0;
+  actualModel = 0;
+
+  kalmanCoreRobustScalarUpdate_StubWithCallback(mockKalmanCoreRobustScalarUpdateCallback);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatRobustUpdateIsCalledWithTheMeasurement() {
+  // Fixture
+  distanceMeasurement_t measurement = createMeasurement();
+
+  // Test
+  kalmanCoreRobustUpdateWithDistance(&this, &measurement);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, robustUpdateCallCount);
+  TEST_ASSERT_EQUAL_PTR(&measurement, actualMeasurement);
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, actualMeasured);
+  TEST_ASSERT_EQUAL_FLOAT(0.25f, actualStdDev);
+}
+
+void testThatTheModelPredictsTheDistanceAndJacobian() {
+  // Fixture
+  distanceMeasurement_t measurement = createMeasurement();
+  kalmanCoreRobustUpdateWithDistance(&this, &measurement);
+
+  // 3-4-5 triangle from the anchor
+  const float position[3] = {4.0, 6.0, 0.0};
+  const float expectedH[3] = {0.6, 0.8, 0.0};
+  float predicted = 0.0;
+  float h[3];
+
+  // Test
+  bool actual = actualModel(position, actualMeasurement, &predicted, h);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 5.0f, predicted);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[0], h[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[1], h[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[2], h[2]);
+}
+
+void testThatTheModelHasAUnitJacobianAtTheAnchor() {
+  // Fixture
+  distanceMeasurement_t measurement = createMeasurement();
+  kalmanCoreRobustUpdateWithDistance(&this, &measurement);
+
+  const float position[3] = {1.0, 2.0, 0.0};
+  float predicted = 1.0;
+  float h[3];
+
+  // Test
+  bool actual = actualModel(position, actualMeasurement, &predicted, h);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, predicted);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f, sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]));
+}
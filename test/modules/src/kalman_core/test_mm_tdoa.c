@@ -105,3 +105,99 @@ void testThatScalarUpdateIsNotCalledWhenTheOutlierFilterIsBlocking() {
   // Assert
   assertScalarUpdateWasNotCalled();
 }
+
+
+static int batchUpdateCallCount;
+static float batchUpdateExpectedHm[TDOA_BATCH_MAX_PAIRS * KC_STATE_DIM];
+static float batchUpdateExpectedErrors[TDOA_BATCH_MAX_PAIRS];
+static float batchUpdateExpectedR[TDOA_BATCH_MAX_PAIRS * TDOA_BATCH_MAX_PAIRS];
+static uint16_t batchUpdateExpectedRows;
+
+static void mockKalmanCoreBatchUpdateCallback(kalmanCoreData_t* actualThis, arm_matrix_instance_f32* actualHm, const float* actualErrors, arm_matrix_instance_f32* actualRm, int cmock_num_calls) {
+  batchUpdateCallCount++;
+  TEST_ASSERT_EQUAL_PTR(&this, actualThis);
+
+  TEST_ASSERT_EQUAL_UINT16(batchUpdateExpectedRows, actualHm->numRows);
+  TEST_ASSERT_EQUAL_UINT16(KC_STATE_DIM, actualHm->numCols);
+  TEST_ASSERT_EQUAL_UINT16(batchUpdateExpectedRows, actualRm->numRows);
+  TEST_ASSERT_EQUAL_UINT16(batchUpdateExpectedRows, actualRm->numCols);
+
+  for (int i = 0; i < batchUpdateExpectedRows * KC_STATE_DIM; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, batchUpdateExpectedHm[i], actualHm->pData[i]);
+  }
+  for (int i = 0; i < batchUpdateExpectedRows; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, batchUpdateExpectedErrors[i], actualErrors[i]);
+  }
+  for (int i = 0; i < batchUpdateExpectedRows * batchUpdateExpectedRows; i++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, batchUpdateExpectedR[i], actualRm->pData[i]);
+  }
+}
+
+static bool mockRejectFirstTdoaCallback(OutlierFilterTdoaState_t* state, const tdoaMeasurement_t* tdoa, const float error, const uint32_t nowMs, int cmock_num_calls) {
+  return cmock_num_calls > 0;
+}
+
+static tdoaBatchMeasurement_t createBatchWithTwoPairs(const float stdDev) {
+  tdoaBatchMeasurement_t batch = {
+    .anchorPosition = {.x = 1.0, .y = 0.0, .z = 0.0},
+    .remoteAnchorPositions = {
+      {.x = -1.0, .y = 0.0, .z = 0.0},
+      {.x = 0.0, .y = 1.0, .z = 0.0},
+    },
+    .distanceDiffs = {0.5, 0.25},
+    .anchorId = 1,
+    .remoteAnchorIds = {2, 3},
+    .pairCount = 2,
+    .stdDev = stdDev,
+  };
+
+  return batch;
+}
+
+void testThatBatchUpdateIsCalledWithAllPairsAndCorrelatedNoise() {
+  // Fixture
+  batchUpdateCallCount = 0;
+  memset(batchUpdateExpectedHm, 0, sizeof(batchUpdateExpectedHm));
+
+  const float stdDev = 0.2;
+  tdoaBatchMeasurement_t batch = createBatchWithTwoPairs(stdDev);
+
+  batchUpdateExpectedRows = 2;
+  batchUpdateExpectedHm[KC_STATE_X] = -2.0;
+  batchUpdateExpectedHm[KC_STATE_DIM + KC_STATE_X] = -1.0;
+  batchUpdateExpectedHm[KC_STATE_DIM + KC_STATE_Y] = 1.0;
+  batchUpdateExpectedErrors[0] = 0.5;
+  batchUpdateExpectedErrors[1] = 0.25;
+  batchUpdateExpectedR[0] = stdDev * stdDev;
+  batchUpdateExpectedR[1] = 0.5f * stdDev * stdDev;
+  batchUpdateExpectedR[2] = 0.5f * stdDev * stdDev;
+  batchUpdateExpectedR[3] = stdDev * stdDev;
+
+  kalmanCoreBatchUpdate_StubWithCallback(mockKalmanCoreBatchUpdateCallback);
+  outlierFilterTdoaValidateIntegrator_IgnoreAndReturn(true);
+
+  // Test
+  kalmanCoreUpdateWithTdoaBatch(&this, &batch, 0, &outlierFilterTdoaState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, batchUpdateCallCount);
+  assertScalarUpdateWasNotCalled();
+}
+
+void testThatBatchWithOnePairLeftAfterOutlierFilterUsesScalarUpdate() {
+  // Fixture
+  const float stdDev = 0.2;
+  tdoaBatchMeasurement_t batch = createBatchWithTwoPairs(stdDev);
+
+  expectedHm[KC_STATE_X] = -1.0;
+  expectedHm[KC_STATE_Y] = 1.0;
+
+  setKalmanCoreScalarUpdateExpectationsSingleCall(&this, expectedHm, 0.25, stdDev);
+  outlierFilterTdoaValidateIntegrator_StubWithCallback(mockRejectFirstTdoaCallback);
+
+  // Test
+  kalmanCoreUpdateWithTdoaBatch(&this, &batch, 0, &outlierFilterTdoaState);
+
+  // Assert
+  assertScalarUpdateWasCalled();
+}
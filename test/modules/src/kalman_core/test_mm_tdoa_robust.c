@@ -0,0 +1,104 @@
+// File under test mm_tdoa_robust.c
+#include "mm_tdoa_robust.h"
+
+#include "unity.h"
+
+#include "mock_kalman_core.h"
+#include "mock_outlierFilterTdoa.h"
+
+static kalmanCoreData_t this;
+static OutlierFilterTdoaState_t outlierFilterTdoaState;
+
+static int robustUpdateCallCount;
+static kalmanCoreRobustModel_t actualModel;
+static const void* actualMeasurement;
+static float actualMeasured;
+static float actualStdDev;
+
+static void mockKalmanCoreRobustScalarUpdateCallback(kalmanCoreData_t* actualThis, kalmanCoreRobustModel_t model, const void* measurement, const float measured, const float stdDev, const float sigmaMeasurement, const float sigmaState, int cmock_num_calls) {
+  TEST_ASSERT_EQUAL_PTR(&this, actualThis);
+  TEST_ASSERT_TRUE(sigmaMeasurement > 0.0f);
+  TEST_ASSERT_TRUE(sigmaState > 0.0f);
+
+  robustUpdateCallCount++;
+  actualModel = model;
+  actualMeasurement = measurement;
+  actualMeasured = measured;
+  actualStdDev = stdDev;
+}
+
+static tdoaMeasurement_t createMeasurement() {
+  tdoaMeasurement_t measurement = {
+    .anchorPositions = {
+      {.x = -1.0, .y = 0.0, .z = 0.0},
+      {.x = 1.0, .y = 0.0, .z = 0.0},
+    },
+    .distanceDiff = 0.5,
+    .stdDev = 0.123,
+  };
+
+  return measurement;
+}
+
+void setUp(void) {
+  memset(&this, 0, sizeof(this));
+  robustUpdateCallCount = 0;
+  actualModel = 0;
+
+  kalmanCoreRobustScalarUpdate_StubWithCallback(mockKalmanCoreRobustScalarUpdateCallback);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatRobustUpdateIsCalledWithTheMeasurement() {
+  // Fixture
+  tdoaMeasurement_t measurement = createMeasurement();
+
+  // Test
+  kalmanCoreRobustUpdateWithTdoa(&this, &measurement, &outlierFilterTdoaState);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, robustUpdateCallCount);
+  TEST_ASSERT_EQUAL_PTR(&measurement, actualMeasurement);
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, actualMeasured);
+  TEST_ASSERT_EQUAL_FLOAT(0.123f, actualStdDev);
+}
+
+void testThatTheModelPredictsTheDistanceDifferenceAndJacobian() {
+  // Fixture
+  tdoaMeasurement_t measurement = createMeasurement();
+  kalmanCoreRobustUpdateWithTdoa(&this, &measurement, &outlierFilterTdoaState);
+
+  const float position[3] = {0.0, 1.0, 0.0};
+  const float expectedH[3] = {-sqrtf(2.0f), 0.0, 0.0};
+  float predicted = 1.0;
+  float h[3];
+
+  // Test
+  bool actual = actualModel(position, actualMeasurement, &predicted, h);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, predicted);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[0], h[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[1], h[1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, expectedH[2], h[2]);
+}
+
+void testThatTheModelRejectsAPositionInAnAnchor() {
+  // Fixture
+  tdoaMeasurement_t measurement = createMeasurement();
+  kalmanCoreRobustUpdateWithTdoa(&this, &measurement, &outlierFilterTdoaState);
+
+  const float position[3] = {1.0, 0.0, 0.0};
+  float predicted;
+  float h[3];
+
+  // Test
+  bool actual = actualModel(position, actualMeasurement, &predicted, h);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
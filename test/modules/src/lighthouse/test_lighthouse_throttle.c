@@ -0,0 +1,165 @@
+// @IGNORE_IF_NOT CONFIG_DECK_LIGHTHOUSE
+
+// File under test lighthouse_throttle.c
+#include "lighthouse_throttle.h"
+
+#include "unity.h"
+#include "mock_estimator.h"
+#include "mock_estimator_kalman.h"
+#include "mock_lighthouse_position_est.h"
+#include "lighthouse_geometry.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static void mockGetEstimatedPos(point_t* pos, int cmock_num_calls);
+static void mockGetEstimatedPosCovariance(float* covariance, int cmock_num_calls);
+static void runSamples(const uint32_t durationMs, const uint32_t intervalMs, const int baseStationCount, int* usedCount);
+
+static baseStationGeometry_t geometries[2];
+static pulseProcessorBaseStationMeasurement_t measurement;
+static float positionCovariance[9];
+
+// The throttle keeps its state between tests, time must not go backwards
+static uint32_t nowMs = 1000;
+
+void setUp(void) {
+  memset(geometries, 0, sizeof(geometries));
+  memset(&measurement, 0, sizeof(measurement));
+  for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+    measurement.sensorMeasurements[sensor].validCount = PULSE_PROCESSOR_N_SWEEPS;
+  }
+
+  // Base station 0 along the x-axis and base station 1 along the y-axis, both 3 m away
+  geometries[0].origin[0] = -3.0f;
+  geometries[0].valid = true;
+  geometries[1].origin[1] = -3.0f;
+  geometries[1].valid = true;
+
+  // The position is uncertain along the x-axis
+  memset(positionCovariance, 0, sizeof(positionCovariance));
+  positionCovariance[0] = 0.1f;
+  positionCovariance[4] = 0.0001f;
+  positionCovariance[8] = 0.0001f;
+
+  stateEstimatorGetType_IgnoreAndReturn(StateEstimatorTypeKalman);
+  lighthousePositionGetSweepStdLh2_IgnoreAndReturn(0.001f);
+  estimatorKalmanGetEstimatedPos_StubWithCallback(mockGetEstimatedPos);
+  estimatorKalmanGetEstimatedPosCovariance_StubWithCallback(mockGetEstimatedPosCovariance);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAllSamplesAreUsedBelowTheMaxRate() {
+  // Fixture
+  int usedCount[2] = {0};
+  runSamples(500, 50, 2, usedCount);
+  usedCount[0] = 0;
+  usedCount[1] = 0;
+
+  // Test
+  runSamples(1000, 50, 2, usedCount);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(20, usedCount[0]);
+  TEST_ASSERT_EQUAL_INT(20, usedCount[1]);
+}
+
+void testThatTheRateIsLimitedAboveTheMaxRate() {
+  // Fixture
+  int usedCount[2] = {0};
+  runSamples(500, 5, 2, usedCount);
+  usedCount[0] = 0;
+  usedCount[1] = 0;
+
+  // Test
+  runSamples(1000, 5, 2, usedCount);
+
+  // Assert
+  // 400 samples/s with the default max rate of 50 samples/s
+  TEST_ASSERT_INT_WITHIN(5, 50, usedCount[0] + usedCount[1]);
+}
+
+void testThatTheBaseStationThatCanObserveTheUncertainDirectionIsPreferred() {
+  // Fixture
+  int usedCount[2] = {0};
+  runSamples(500, 5, 2, usedCount);
+  usedCount[0] = 0;
+  usedCount[1] = 0;
+
+  // Test
+  runSamples(1000, 5, 2, usedCount);
+
+  // Assert
+  // Base station 0 is looking along the uncertain x-axis and can not reduce the uncertainty
+  TEST_ASSERT_GREATER_THAN_INT(4 * usedCount[0], usedCount[1]);
+}
+
+void testThatSamplesWithoutValidSensorsAreNotPreferred() {
+  // Fixture
+  positionCovariance[0] = 0.0001f;
+  int usedCount[2] = {0};
+  runSamples(500, 5, 2, usedCount);
+  usedCount[0] = 0;
+  usedCount[1] = 0;
+
+  // Test
+  for (uint32_t t = 0; t < 1000; t += 5) {
+    nowMs += 5;
+    const int baseStation = (t / 5) % 2;
+    for (int sensor = 0; sensor < PULSE_PROCESSOR_N_SENSORS; sensor++) {
+      measurement.sensorMeasurements[sensor].validCount = (baseStation == 0 && sensor > 0) ? 0 : PULSE_PROCESSOR_N_SWEEPS;
+    }
+
+    if (throttleLh2Samples(nowMs, baseStation, &geometries[baseStation], &measurement)) {
+      usedCount[baseStation]++;
+    }
+  }
+
+  // Assert
+  TEST_ASSERT_GREATER_THAN_INT(usedCount[0], usedCount[1]);
+}
+
+void testThatTheBaseStationsTakeTurnsWithoutTheKalmanEstimator() {
+  // Fixture
+  stateEstimatorGetType_IgnoreAndReturn(StateEstimatorTypeComplementary);
+  int usedCount[2] = {0};
+  runSamples(500, 5, 2, usedCount);
+  usedCount[0] = 0;
+  usedCount[1] = 0;
+
+  // Test
+  runSamples(1000, 5, 2, usedCount);
+
+  // Assert
+  TEST_ASSERT_INT_WITHIN(5, 50, usedCount[0] + usedCount[1]);
+  TEST_ASSERT_INT_WITHIN(2, usedCount[0], usedCount[1]);
+}
+
+// Helpers
+
+static void mockGetEstimatedPos(point_t* pos, int cmock_num_calls) {
+  pos->x = 0.0f;
+  pos->y = 0.0f;
+  pos->z = 0.0f;
+}
+
+static void mockGetEstimatedPosCovariance(float* covariance, int cmock_num_calls) {
+  memcpy(covariance, positionCovariance, sizeof(positionCovariance));
+}
+
+static void runSamples(const uint32_t durationMs, const uint32_t intervalMs, const int baseStationCount, int* usedCount) {
+  for (uint32_t t = 0; t < durationMs; t += intervalMs) {
+    nowMs += intervalMs;
+    for (int baseStation = 0; baseStation < baseStationCount; baseStation++) {
+      if (throttleLh2Samples(nowMs, baseStation, &geometries[baseStation], &measurement)) {
+        usedCount[baseStation]++;
+      }
+    }
+  }
+}
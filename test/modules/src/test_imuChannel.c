@@ -0,0 +1,116 @@
+// File under test imuChannel.c
+#include "imuChannel.h"
+
+#include "unity.h"
+
+static imuChannel_t channel;
+
+// Helpers
+static void putSamples(uint32_t first, uint32_t count);
+static void assertSample(uint32_t expected, const imuSample_t* sample);
+
+void setUp(void) {
+  imuChannelInit(&channel);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+
+void testThatEmptyChannelHasNoSamples() {
+  // Fixture
+  imuSample_t sample;
+
+  // Test
+  bool actual = imuChannelGet(&channel, &sample);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+
+void testThatSamplesAreReadInOrder() {
+  // Fixture
+  putSamples(0, 10);
+  imuSample_t sample;
+
+  // Test
+  // Assert
+  for (uint32_t i = 0; i < 10; i++) {
+    TEST_ASSERT_TRUE(imuChannelGet(&channel, &sample));
+    assertSample(i, &sample);
+  }
+  TEST_ASSERT_FALSE(imuChannelGet(&channel, &sample));
+  TEST_ASSERT_EQUAL_UINT32(0, channel.dropped);
+}
+
+
+void testThatReadingCanBeInterleavedWithWritingAcrossTheEndOfTheRing() {
+  // Fixture
+  imuSample_t sample;
+
+  // Test
+  // Assert
+  for (uint32_t i = 0; i < 5 * IMU_CHANNEL_SIZE; i += 3) {
+    putSamples(i, 3);
+    for (uint32_t j = 0; j < 3; j++) {
+      TEST_ASSERT_TRUE(imuChannelGet(&channel, &sample));
+      assertSample(i + j, &sample);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, channel.dropped);
+}
+
+
+void testThatOldestSamplesAreDroppedWhenTheConsumerFallsBehind() {
+  // Fixture
+  const uint32_t count = IMU_CHANNEL_SIZE + 10;
+  putSamples(0, count);
+  imuSample_t sample;
+
+  // Test
+  bool actual = imuChannelGet(&channel, &sample);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  // The slot that the producer writes next is never read
+  const uint32_t expectedDropped = count - (IMU_CHANNEL_SIZE - 1);
+  assertSample(expectedDropped, &sample);
+  TEST_ASSERT_EQUAL_UINT32(expectedDropped, channel.dropped);
+}
+
+
+void testThatFlushSkipsAllSamples() {
+  // Fixture
+  putSamples(0, 10);
+  imuSample_t sample;
+
+  // Test
+  imuChannelFlush(&channel);
+
+  // Assert
+  TEST_ASSERT_FALSE(imuChannelGet(&channel, &sample));
+  putSamples(10, 1);
+  TEST_ASSERT_TRUE(imuChannelGet(&channel, &sample));
+  assertSample(10, &sample);
+}
+
+// Helpers
+
+static void putSamples(uint32_t first, uint32_t count) {
+  for (uint32_t i = first; i < first + count; i++) {
+    const Axis3f gyro = {.x = i, .y = i + 0.25f, .z = i + 0.5f};
+    const Axis3f acc = {.x = -1.0f * i, .y = 2.0f * i, .z = 3.0f * i};
+    imuChannelPut(&channel, &gyro, &acc);
+  }
+}
+
+static void assertSample(uint32_t expected, const imuSample_t* sample) {
+  TEST_ASSERT_EQUAL_FLOAT(expected, sample->gyro.x);
+  TEST_ASSERT_EQUAL_FLOAT(expected + 0.25f, sample->gyro.y);
+  TEST_ASSERT_EQUAL_FLOAT(expected + 0.5f, sample->gyro.z);
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f * expected, sample->acc.x);
+  TEST_ASSERT_EQUAL_FLOAT(2.0f * expected, sample->acc.y);
+  TEST_ASSERT_EQUAL_FLOAT(3.0f * expected, sample->acc.z);
+}
@@ -373,6 +373,100 @@ void testCompressedSimplifiedFigure8Evaluation(void) {
   // Assert
 }
 
+static void feedStream(struct piecewise_traj_compressed_stream* stream, const uint8_t* data, uint32_t length) {
+  uint32_t offset = stream->write_offset;
+  if (offset < length) {
+    piecewise_compressed_stream_write(stream, data + offset, length - offset);
+  }
+}
+
+void testCompressedFigure8StreamedEvaluation(void) {
+  // Fixture
+  struct piecewise_traj_compressed expected_traj;
+  struct piecewise_traj_compressed traj;
+  struct piecewise_traj_compressed_stream stream;
+  uint8_t buffer[64];
+  float duration, t;
+  bool loaded;
+
+  piecewise_compressed_load(&expected_traj, figure8_compressed_pieces);
+  expected_traj.t_begin = 2;
+  expected_traj.shift = mkvec(-1, 2, 3);
+  duration = piecewise_compressed_duration(&expected_traj);
+
+  piecewise_compressed_stream_init(&stream, buffer, sizeof(buffer));
+  feedStream(&stream, figure8_compressed_pieces, sizeof(figure8_compressed_pieces));
+  loaded = piecewise_compressed_load_stream(&traj, &stream);
+  traj.t_begin = 2;
+  traj.shift = mkvec(-1, 2, 3);
+
+  // Test
+  for (t = traj.t_begin; t < traj.t_begin + duration + 0.5; t += 0.01) {
+    struct traj_eval expected = piecewise_compressed_eval(&expected_traj, t);
+    struct traj_eval actual = piecewise_compressed_eval(&traj, t);
+    feedStream(&stream, figure8_compressed_pieces, sizeof(figure8_compressed_pieces));
+
+    // Assert
+    TEST_ASSERT_EQUAL_FLOAT(expected.pos.x, actual.pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pos.y, actual.pos.y);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pos.z, actual.pos.z);
+    TEST_ASSERT_EQUAL_FLOAT(expected.vel.x, actual.vel.x);
+    TEST_ASSERT_EQUAL_FLOAT(expected.vel.y, actual.vel.y);
+  }
+
+  // Assert
+  TEST_ASSERT_TRUE(loaded);
+  TEST_ASSERT_FALSE(traj.underrun);
+  TEST_ASSERT_EQUAL_FLOAT(duration, piecewise_compressed_duration(&traj));
+  TEST_ASSERT_EQUAL_UINT32(sizeof(figure8_compressed_pieces), stream.read_offset);
+}
+
+void testCompressedStreamUnderrunHoldsLastPosition(void) {
+  // Fixture
+  struct piecewise_traj_compressed expected_traj;
+  struct piecewise_traj_compressed traj;
+  struct piecewise_traj_compressed_stream stream;
+  uint8_t buffer[64];
+
+  piecewise_compressed_load(&expected_traj, figure8_compressed_pieces);
+  expected_traj.t_begin = 0;
+
+  // Only the start position and the first piece of 1.05s
+  piecewise_compressed_stream_init(&stream, buffer, sizeof(buffer));
+  piecewise_compressed_stream_write(&stream, figure8_compressed_pieces, 8 + 31);
+  piecewise_compressed_load_stream(&traj, &stream);
+  traj.t_begin = 0;
+
+  // Test
+  struct traj_eval expected = piecewise_compressed_eval(&expected_traj, 1.05);
+  struct traj_eval actual = piecewise_compressed_eval(&traj, 3.0);
+
+  // Assert
+  TEST_ASSERT_TRUE(traj.underrun);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.x, actual.pos.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, expected.pos.y, actual.pos.y);
+  TEST_ASSERT_EQUAL_FLOAT(0, actual.vel.x);
+  TEST_ASSERT_EQUAL_FLOAT(0, actual.vel.y);
+  TEST_ASSERT_FALSE(piecewise_compressed_is_finished(&traj, 100.0));
+}
+
+void testCompressedStreamLoadFailsWithoutFirstPiece(void) {
+  // Fixture
+  struct piecewise_traj_compressed traj;
+  struct piecewise_traj_compressed_stream stream;
+  uint8_t buffer[64];
+
+  piecewise_compressed_stream_init(&stream, buffer, sizeof(buffer));
+  piecewise_compressed_stream_write(&stream, figure8_compressed_pieces, 8 + 10);
+
+  // Test
+  bool actual = piecewise_compressed_load_stream(&traj, &stream);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL_UINT32(0, stream.read_offset);
+}
+
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
 void testCompressedFigure8RandomOrderQueries(void) {
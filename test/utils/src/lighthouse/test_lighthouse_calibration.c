@@ -0,0 +1,71 @@
+// @IGNORE_IF_NOT CONFIG_DECK_LIGHTHOUSE
+
+// File under test lighthouse_calibration.c
+#include "lighthouse_calibration.h"
+
+#include <math.h>
+#include "unity.h"
+#include "physicalConstants.h"
+
+// Build the arm dsp math lib and use the "real thing" instead of mocking calls to it
+// @BUILD_LIB ARM_DSP_MATH
+
+static const lighthouseCalibrationSweep_t calib = {
+  .phase = 0.012f,
+  .tilt = -0.0087f,
+  .curve = 0.0f,
+  .gibmag = 0.0034f,
+  .gibphase = 1.7f,
+};
+
+static void assertCachedModelMatchesModel(const float t);
+
+void setUp(void) {
+}
+
+void testThatPrecomputedTermsAreFromCalibrationAndTilt() {
+  // Fixture
+  const float t = M_PI_F / 6.0f;
+  lighthouseCalibrationSweepCache_t cache;
+
+  // Test
+  lighthouseCalibrationPrecomputeLh2(&calib, t, &cache);
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, tanf(t), cache.tanT);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, tanf(t - calib.tilt), cache.tanTMinusTilt);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, calib.phase, cache.phase);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, calib.gibmag * cosf(calib.gibphase), cache.gibCos);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, calib.gibmag * sinf(calib.gibphase), cache.gibSin);
+}
+
+void testThatCachedModelMatchesModelForFirstSweep() {
+  assertCachedModelMatchesModel(-M_PI_F / 6.0f);
+}
+
+void testThatCachedModelMatchesModelForSecondSweep() {
+  assertCachedModelMatchesModel(M_PI_F / 6.0f);
+}
+
+// Helpers
+
+static void assertCachedModelMatchesModel(const float t) {
+  // Fixture
+  lighthouseCalibrationSweepCache_t cache;
+  lighthouseCalibrationPrecomputeLh2(&calib, t, &cache);
+
+  for (float x = 0.5f; x < 5.0f; x += 1.1f) {
+    for (float y = -3.0f; y < 3.0f; y += 0.7f) {
+      for (float z = -2.0f; z < 2.0f; z += 0.9f) {
+        const float r = sqrtf(x * x + y * y);
+
+        // Test
+        const float expected = lighthouseCalibrationMeasurementModelLh2(x, y, z, t, &calib);
+        const float actual = lighthouseCalibrationMeasurementModelLh2Cached(x, y, z, r, &cache);
+
+        // Assert
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected, actual);
+      }
+    }
+  }
+}
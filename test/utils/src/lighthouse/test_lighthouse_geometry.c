@@ -3,6 +3,7 @@
 // File under test lighthouse_geometry.c
 #include "lighthouse_geometry.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "unity.h"
@@ -256,3 +257,145 @@ void testThatYawDeltaIsNotCalculatedForSmallIntersectionPointVector() {
   // Assert
   TEST_ASSERT_FALSE(actualResult);
 }
+
+static void anglesToPoint(const baseStationGeometry_t* geo, const vec3d point, float* angleH, float* angleV) {
+  // Only valid for non rotated base stations
+  const float x = point[0] - geo->origin[0];
+  const float y = point[1] - geo->origin[1];
+  const float z = point[2] - geo->origin[2];
+  *angleH = atan2f(y, x);
+  *angleV = atan2f(z, x);
+}
+
+static void addRaysToSensors(lighthouseGeometryRays_t* rays, const baseStationGeometry_t* geo, const vec3d sensors[4], const uint8_t sensorMask) {
+  float anglesH[4];
+  float anglesV[4];
+  for (int i = 0; i < 4; i++) {
+    anglesToPoint(geo, sensors[i], &anglesH[i], &anglesV[i]);
+  }
+
+  lighthouseGeometryRaysAdd(rays, geo, anglesH, anglesV, sensorMask);
+}
+
+static const vec3d raySensors[4] = {
+  {1.985f, 0.9925f, 0.5f},
+  {1.985f, 1.0075f, 0.5f},
+  {2.015f, 0.9925f, 0.5f},
+  {2.015f, 1.0075f, 0.5f},
+};
+
+void testThatRaysFromTwoBaseStationsGiveTheCenterOfTheSensors() {
+  // Fixture
+  baseStationGeometry_t bs1 = {.origin = {0.0f, 0.0f, 2.0f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  baseStationGeometry_t bs2 = {.origin = {0.0f, 3.0f, 2.5f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  lighthouseGeometryRays_t rays;
+  lighthouseGeometryRaysInit(&rays, 4);
+  addRaysToSensors(&rays, &bs1, raySensors, 0x0f);
+  addRaysToSensors(&rays, &bs2, raySensors, 0x0f);
+
+  vec3d expected = {2.0f, 1.0f, 0.5f};
+  vec3d actual;
+  float residual;
+
+  // Test
+  int actualCount = lighthouseGeometryRaysSolve(&rays, actual, &residual);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(4, actualCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[0], actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[1], actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[2], actual[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0f, residual);
+}
+
+void testThatRaysSolverMatchesTheIntersectionOfRayPairs() {
+  // Fixture
+  baseStationGeometry_t bs1 = {.origin = {0.0f, 0.0f, 2.0f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  baseStationGeometry_t bs2 = {.origin = {0.0f, 3.0f, 2.5f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+
+  float anglesH[2][4];
+  float anglesV[2][4];
+  vec3d expected = {0};
+  float expectedDeltaSquareSum = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    anglesToPoint(&bs1, raySensors[i], &anglesH[0][i], &anglesV[0][i]);
+    anglesToPoint(&bs2, raySensors[i], &anglesH[1][i], &anglesV[1][i]);
+    // Add some noise
+    anglesH[0][i] += 0.002f * (i - 1.5f);
+    anglesV[1][i] -= 0.001f * i;
+
+    float angles1[2] = {anglesH[0][i], anglesV[0][i]};
+    float angles2[2] = {anglesH[1][i], anglesV[1][i]};
+    vec3d pairPosition;
+    float delta;
+    lighthouseGeometryGetPositionFromRayIntersection(&bs1, &bs2, angles1, angles2, pairPosition, &delta);
+    expected[0] += pairPosition[0] / 4.0f;
+    expected[1] += pairPosition[1] / 4.0f;
+    expected[2] += pairPosition[2] / 4.0f;
+    expectedDeltaSquareSum += delta * delta;
+  }
+
+  // Each ray is at half the distance between the rays from the closest point
+  const float expectedResidual = sqrtf(expectedDeltaSquareSum / 4.0f) / 2.0f;
+
+  lighthouseGeometryRays_t rays;
+  lighthouseGeometryRaysInit(&rays, 4);
+  lighthouseGeometryRaysAdd(&rays, &bs1, anglesH[0], anglesV[0], 0x0f);
+  lighthouseGeometryRaysAdd(&rays, &bs2, anglesH[1], anglesV[1], 0x0f);
+
+  vec3d actual;
+  float residual;
+
+  // Test
+  int actualCount = lighthouseGeometryRaysSolve(&rays, actual, &residual);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(4, actualCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[0], actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[1], actual[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expected[2], actual[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, expectedResidual, residual);
+  TEST_ASSERT_TRUE(residual > 0.001f);
+}
+
+void testThatSensorsWithOneRayAreNotSolved() {
+  // Fixture
+  baseStationGeometry_t bs1 = {.origin = {0.0f, 0.0f, 2.0f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  baseStationGeometry_t bs2 = {.origin = {0.0f, 3.0f, 2.5f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  lighthouseGeometryRays_t rays;
+  lighthouseGeometryRaysInit(&rays, 4);
+  addRaysToSensors(&rays, &bs1, raySensors, 0x0f);
+  addRaysToSensors(&rays, &bs2, raySensors, 0x05);
+
+  vec3d actual;
+  float residual;
+
+  // Test
+  int actualCount = lighthouseGeometryRaysSolve(&rays, actual, &residual);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(2, actualCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, actual[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.9925f, actual[1]);
+}
+
+void testThatParallelRaysAreNotSolved() {
+  // Fixture
+  baseStationGeometry_t bs1 = {.origin = {0.0f, 0.0f, 2.0f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  baseStationGeometry_t bs2 = {.origin = {-1.0f, -0.5f, 2.75f}, .mat = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  lighthouseGeometryRays_t rays;
+  lighthouseGeometryRaysInit(&rays, 4);
+  // bs2 is on the line from bs1 through the center of the sensors
+  const vec3d center[4] = {{2.0f, 1.0f, 0.5f}, {2.0f, 1.0f, 0.5f}, {2.0f, 1.0f, 0.5f}, {2.0f, 1.0f, 0.5f}};
+  addRaysToSensors(&rays, &bs1, center, 0x0f);
+  addRaysToSensors(&rays, &bs2, center, 0x0f);
+
+  vec3d actual;
+  float residual;
+
+  // Test
+  int actualCount = lighthouseGeometryRaysSolve(&rays, actual, &residual);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, actualCount);
+}
@@ -0,0 +1,155 @@
+// File under test tdoaEngine.c
+#include "tdoaEngine.h"
+
+#include <string.h>
+#include "unity.h"
+
+#include "tdoaStorage.h"
+#include "mock_tdoaStats.h"
+#include "mock_clockCorrectionEngine.h"
+
+#define NOW_MS 10000
+#define ANCHOR_ID 1
+#define SEQ_NR 17
+#define LOCODECK_TS_FREQ (499.2e6 * 128)
+
+static tdoaEngineState_t engineState;
+
+static int batchCallCount;
+static tdoaBatchMeasurement_t actualBatch;
+
+static void mockSendTdoaBatchToEstimator(tdoaBatchMeasurement_t* tdoaBatchMeasurement) {
+  batchCallCount++;
+  actualBatch = *tdoaBatchMeasurement;
+}
+
+static void fixtureAddRemoteAnchor(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteId, const float x, const float y, const float z);
+static bool isRemoteAnchorInBatch(const uint8_t remoteId);
+
+void setUp(void) {
+  tdoaStatsInit_Ignore();
+  clockCorrectionEngineCalculate_IgnoreAndReturn(1.0);
+  clockCorrectionEngineUpdate_IgnoreAndReturn(true);
+  clockCorrectionEngineGet_IgnoreAndReturn(1.0);
+
+  tdoaEngineInit(&engineState, NOW_MS, 0, mockSendTdoaBatchToEstimator, LOCODECK_TS_FREQ, TdoaEngineMatchingAlgorithmBatch);
+  memset(&engineState.stats, 0, sizeof(engineState.stats));
+
+  batchCallCount = 0;
+  memset(&actualBatch, 0, sizeof(actualBatch));
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatAllCandidatesArePairedWhenTheyFitInTheBatch() {
+  // Fixture
+  tdoaAnchorContext_t anchorCtx;
+  tdoaEngineGetAnchorCtxForPacketProcessing(&engineState, ANCHOR_ID, NOW_MS, &anchorCtx);
+  tdoaStorageSetAnchorPosition(&anchorCtx, 0.0f, 0.0f, 0.0f);
+  tdoaStorageSetRxTxData(&anchorCtx, 1000, 1000, SEQ_NR);
+
+  fixtureAddRemoteAnchor(&anchorCtx, 2, 1.0f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 3, 0.0f, 1.0f, 0.0f);
+
+  // Test
+  tdoaEngineProcessPacket(&engineState, &anchorCtx, 2000, 2000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, batchCallCount);
+  TEST_ASSERT_EQUAL_UINT8(ANCHOR_ID, actualBatch.anchorId);
+  TEST_ASSERT_EQUAL_UINT8(2, actualBatch.pairCount);
+  TEST_ASSERT_TRUE(isRemoteAnchorInBatch(2));
+  TEST_ASSERT_TRUE(isRemoteAnchorInBatch(3));
+}
+
+void testThatTheMostSpreadOutCandidatesArePickedWhenThereAreTooMany() {
+  // Fixture
+  tdoaAnchorContext_t anchorCtx;
+  tdoaEngineGetAnchorCtxForPacketProcessing(&engineState, ANCHOR_ID, NOW_MS, &anchorCtx);
+  tdoaStorageSetAnchorPosition(&anchorCtx, 0.0f, 0.0f, 0.0f);
+  tdoaStorageSetRxTxData(&anchorCtx, 1000, 1000, SEQ_NR);
+
+  // Anchor 2 is next to 3 and anchor 5 is next to 6, only one of each pair adds to the geometry
+  fixtureAddRemoteAnchor(&anchorCtx, 2, 1.0f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 3, 1.1f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 4, -1.0f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 5, 0.0f, 1.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 6, 0.0f, 1.05f, 0.0f);
+
+  // Test
+  tdoaEngineProcessPacket(&engineState, &anchorCtx, 2000, 2000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(1, batchCallCount);
+  TEST_ASSERT_EQUAL_UINT8(TDOA_BATCH_MAX_PAIRS, actualBatch.pairCount);
+  TEST_ASSERT_TRUE(isRemoteAnchorInBatch(3));
+  TEST_ASSERT_TRUE(isRemoteAnchorInBatch(4));
+  TEST_ASSERT_TRUE(isRemoteAnchorInBatch(6));
+}
+
+void testThatTheRemoteAnchorPositionsFollowTheIds() {
+  // Fixture
+  tdoaAnchorContext_t anchorCtx;
+  tdoaEngineGetAnchorCtxForPacketProcessing(&engineState, ANCHOR_ID, NOW_MS, &anchorCtx);
+  tdoaStorageSetAnchorPosition(&anchorCtx, 0.0f, 0.0f, 0.0f);
+  tdoaStorageSetRxTxData(&anchorCtx, 1000, 1000, SEQ_NR);
+
+  fixtureAddRemoteAnchor(&anchorCtx, 2, 1.0f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 3, 1.1f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 4, -1.0f, 0.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 5, 0.0f, 1.0f, 0.0f);
+  fixtureAddRemoteAnchor(&anchorCtx, 6, 0.0f, 1.05f, 0.0f);
+
+  // Test
+  tdoaEngineProcessPacket(&engineState, &anchorCtx, 2000, 2000);
+
+  // Assert
+  for (int i = 0; i < actualBatch.pairCount; i++) {
+    tdoaAnchorContext_t remoteCtx;
+    point_t expected;
+    tdoaStorageGetAnchorCtx(&engineState.anchorStorage, actualBatch.remoteAnchorIds[i], NOW_MS, &remoteCtx);
+    tdoaStorageGetAnchorPosition(&remoteCtx, &expected);
+
+    TEST_ASSERT_EQUAL_FLOAT(expected.x, actualBatch.remoteAnchorPositions[i].x);
+    TEST_ASSERT_EQUAL_FLOAT(expected.y, actualBatch.remoteAnchorPositions[i].y);
+    TEST_ASSERT_EQUAL_FLOAT(expected.z, actualBatch.remoteAnchorPositions[i].z);
+  }
+}
+
+void testThatNoBatchIsSentWithoutCandidates() {
+  // Fixture
+  tdoaAnchorContext_t anchorCtx;
+  tdoaEngineGetAnchorCtxForPacketProcessing(&engineState, ANCHOR_ID, NOW_MS, &anchorCtx);
+  tdoaStorageSetAnchorPosition(&anchorCtx, 0.0f, 0.0f, 0.0f);
+  tdoaStorageSetRxTxData(&anchorCtx, 1000, 1000, SEQ_NR);
+
+  // Test
+  tdoaEngineProcessPacket(&engineState, &anchorCtx, 2000, 2000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(0, batchCallCount);
+}
+
+// Helpers
+
+static void fixtureAddRemoteAnchor(tdoaAnchorContext_t* anchorCtx, const uint8_t remoteId, const float x, const float y, const float z) {
+  tdoaAnchorContext_t remoteCtx;
+  tdoaStorageGetCreateAnchorCtx(&engineState.anchorStorage, remoteId, NOW_MS, &remoteCtx);
+  tdoaStorageSetAnchorPosition(&remoteCtx, x, y, z);
+  tdoaStorageSetRxTxData(&remoteCtx, 500, 500, remoteId);
+
+  tdoaStorageSetRemoteRxTime(anchorCtx, remoteId, 900, remoteId);
+  tdoaStorageSetTimeOfFlight(anchorCtx, remoteId, 100);
+}
+
+static bool isRemoteAnchorInBatch(const uint8_t remoteId) {
+  for (int i = 0; i < actualBatch.pairCount; i++) {
+    if (actualBatch.remoteAnchorIds[i] == remoteId) {
+      return true;
+    }
+  }
+
+  return false;
+}
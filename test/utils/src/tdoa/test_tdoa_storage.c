@@ -38,12 +38,12 @@
 #define ANCHOR_POSITION_VALIDITY_PERIOD (2 * 1000)
 
 
-static tdaoAnchorInfoArray_t storage;
+static tdoaAnchorStorage_t storage;
 static void fixtureSetRemoteRxTime(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t remoteRxTime, const uint8_t seqNr);
 static void fixtureSetTof(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t tof);
 
 void setUp(void) {
-  tdoaStorageInitialize(storage);
+  tdoaStorageInitialize(&storage);
 }
 
 void testThatCurrentTimeIsSetInContextForGet() {
@@ -53,7 +53,7 @@ void testThatCurrentTimeIsSetInContextForGet() {
 
   // Test
   tdoaAnchorContext_t result;
-  tdoaStorageGetAnchorCtx(storage, anchor, expectedTime, &result);
+  tdoaStorageGetAnchorCtx(&storage, anchor, expectedTime, &result);
 
   // Assert
   TEST_ASSERT_EQUAL_UINT8(expectedTime, result.currentTime_ms);
@@ -67,7 +67,7 @@ void testThatCurrentTimeIsSetInContextForGetCreate() {
 
   // Test
   tdoaAnchorContext_t result;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, expectedTime, &result);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, expectedTime, &result);
 
   // Assert
   TEST_ASSERT_EQUAL_UINT8(expectedTime, result.currentTime_ms);
@@ -81,7 +81,7 @@ void testThatNoAnchorIsReturnedWhenItDoesNotExistInStorage() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did not exist
@@ -97,7 +97,7 @@ void testThatANewAnchorContextIsReturnedWhenItDoesNotExistInStorage() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did not exist
@@ -113,11 +113,11 @@ void testThatTheSameAnchorContextIsReturnedWhenItAlreadyExistsInStorageForGet()
 
   // Make sure the anchor exists
   tdoaAnchorContext_t firstContext;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &firstContext);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &firstContext);
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did exist
@@ -133,11 +133,11 @@ void testThatTheSameAnchorContextIsReturnedWhenItAlreadyExistsInStorageForGetCre
 
   // Make sure the anchor exists
   tdoaAnchorContext_t firstContext;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &firstContext);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &firstContext);
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &result);
 
   // Assert
   // False indicates that the anchor did exist
@@ -160,7 +160,7 @@ void testThatTheOldestAnchorContextIsReplacedWhenStorageIsFull() {
   // time for one slot to be oldest
   tdoaAnchorContext_t context;
   for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
-    tdoaStorageGetCreateAnchorCtx(storage, id, currentTime, &context);
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
 
     uint32_t updateTime = baseAnchorTime + id;
     if (id == oldestAnchor) {
@@ -173,12 +173,117 @@ void testThatTheOldestAnchorContextIsReplacedWhenStorageIsFull() {
 
   // Test
   tdoaAnchorContext_t result;
-  bool actual = tdoaStorageGetCreateAnchorCtx(storage, newAnchor, currentTime, &result);
+  bool actual = tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &result);
 
   // Assert
   TEST_ASSERT_FALSE(actual);
-  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(storage, newAnchor));
-  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(storage, oldestAnchor));
+  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(&storage, newAnchor));
+  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(&storage, oldestAnchor));
+}
+
+
+void testThatAnAnchorThatIsHeardOftenIsKeptWhenStorageIsFull() {
+  // Fixture
+  const uint32_t usefulAnchorTime = 1900;
+  const uint32_t baseAnchorTime = 1950;
+  const uint32_t currentTime = 2000;
+
+  uint8_t newAnchor = ANCHOR_STORAGE_COUNT;
+  uint8_t usefulAnchor = 4;
+  uint8_t onceHeardAnchor = 7;
+
+  // Fill the storage, all anchors are heard once except one that is heard many times but a bit longer ago
+  tdoaAnchorContext_t context;
+  for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
+
+    context.currentTime_ms = baseAnchorTime + id;
+    if (id == usefulAnchor) {
+      for (int i = 0; i < 10; i++) {
+        context.currentTime_ms = usefulAnchorTime;
+        tdoaStorageSetRxTxData(&context, 0, 0, 0);
+      }
+    } else if (id == onceHeardAnchor) {
+      context.currentTime_ms = baseAnchorTime - 1;
+      tdoaStorageSetRxTxData(&context, 0, 0, 0);
+    } else {
+      tdoaStorageSetRxTxData(&context, 0, 0, 0);
+    }
+  }
+
+  // Test
+  tdoaAnchorContext_t result;
+  tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &result);
+
+  // Assert
+  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(&storage, newAnchor));
+  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(&storage, usefulAnchor));
+  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(&storage, onceHeardAnchor));
+}
+
+
+void testThatAnAnchorThatWasHeardOftenLongAgoIsReplacedWhenStorageIsFull() {
+  // Fixture
+  const uint32_t usefulAnchorTime = 1000;
+  const uint32_t baseAnchorTime = 3000;
+  const uint32_t currentTime = 5000;
+
+  uint8_t newAnchor = ANCHOR_STORAGE_COUNT;
+  uint8_t usefulAnchor = 4;
+
+  // Fill the storage, all anchors are heard once recently except one that was heard many times long ago
+  tdoaAnchorContext_t context;
+  for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
+
+    if (id == usefulAnchor) {
+      for (int i = 0; i < 10; i++) {
+        context.currentTime_ms = usefulAnchorTime;
+        tdoaStorageSetRxTxData(&context, 0, 0, 0);
+      }
+    } else {
+      context.currentTime_ms = baseAnchorTime + id;
+      tdoaStorageSetRxTxData(&context, 0, 0, 0);
+    }
+  }
+
+  // Test
+  tdoaAnchorContext_t result;
+  tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &result);
+
+  // Assert
+  TEST_ASSERT_TRUE(tdoaStorageIsAnchorInStorage(&storage, newAnchor));
+  TEST_ASSERT_FALSE(tdoaStorageIsAnchorInStorage(&storage, usefulAnchor));
+}
+
+
+void testThatAReplacedAnchorIsNotFoundAndTheNewIsFoundWithGet() {
+  // Fixture
+  const uint32_t currentTime = 2000;
+  uint8_t newAnchor = 200;
+  uint8_t oldestAnchor = 0;
+
+  tdoaAnchorContext_t context;
+  for (int id = 0; id < ANCHOR_STORAGE_COUNT; id++) {
+    tdoaStorageGetCreateAnchorCtx(&storage, id, currentTime, &context);
+    context.currentTime_ms = 1000 + id;
+    tdoaStorageSetRxTxData(&context, 0, 0, 0);
+  }
+
+  tdoaAnchorContext_t newContext;
+  tdoaStorageGetCreateAnchorCtx(&storage, newAnchor, currentTime, &newContext);
+
+  // Test
+  tdoaAnchorContext_t oldResult;
+  bool actualOld = tdoaStorageGetAnchorCtx(&storage, oldestAnchor, currentTime, &oldResult);
+  tdoaAnchorContext_t newResult;
+  bool actualNew = tdoaStorageGetAnchorCtx(&storage, newAnchor, currentTime, &newResult);
+
+  // Assert
+  TEST_ASSERT_FALSE(actualOld);
+  TEST_ASSERT_TRUE(actualNew);
+  TEST_ASSERT_EQUAL_PTR(newContext.anchorInfo, newResult.anchorInfo);
+  TEST_ASSERT_EQUAL_UINT8(newAnchor, tdoaStorageGetId(&newResult));
 }
 
 
@@ -193,14 +298,14 @@ void testThatAListOfAnchorIdsIsReturned() {
 
   uint8_t expectedCount = 3;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId2, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId2, currentTime, &context);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(storage, unorderedAnchorList, 10);
+  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(&storage, unorderedAnchorList, 10);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -220,14 +325,14 @@ void testThatAListOfAnchorIdsIsReturnedButNotMoreThanTheListLength() {
 
   uint8_t expectedCount = 2;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, currentTime, &context);
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId2, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId2, currentTime, &context);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(storage, unorderedAnchorList, expectedCount);
+  uint8_t actualCount = tdoaStorageGetListOfAnchorIds(&storage, unorderedAnchorList, expectedCount);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -251,19 +356,19 @@ void testThatAListOfActiveAnchorIdsIsReturned() {
 
   uint8_t expectedCount = 2;
 
-  tdoaStorageGetCreateAnchorCtx(storage, otherId, oldTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, otherId, oldTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, recentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, recentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId1, recentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId1, recentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(storage, unorderedAnchorList, 10, currentTime);
+  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(&storage, unorderedAnchorList, 10, currentTime);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -283,16 +388,16 @@ void testThatAListOfActiveAnchorIdsIsReturnedButNotMoreThanTheListLength() {
 
   uint8_t expectedCount = 1;
 
-  tdoaStorageGetCreateAnchorCtx(storage, expectedId0, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, expectedId0, currentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
-  tdoaStorageGetCreateAnchorCtx(storage, otherId, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, otherId, currentTime, &context);
   tdoaStorageSetRxTxData(&context, 0, 0, 0);
 
   uint8_t unorderedAnchorList[10];
 
   // Test
-  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(storage, unorderedAnchorList, expectedCount, currentTime);
+  uint8_t actualCount = tdoaStorageGetListOfActiveAnchorIds(&storage, unorderedAnchorList, expectedCount, currentTime);
 
   // Assert
   TEST_ASSERT_EQUAL_INT8(expectedCount, actualCount);
@@ -308,12 +413,12 @@ void testThatAnchorPositionIsSetAndGet() {
   uint32_t expectedTime = 1234;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, expectedTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, expectedTime, &context);
 
   tdoaStorageSetAnchorPosition(&context, expectedX, expectedY, expectedZ);
 
   uint32_t now = 2345;
-  tdoaStorageGetAnchorCtx(storage, 0, now, &context);
+  tdoaStorageGetAnchorCtx(&storage, 0, now, &context);
   point_t actual;
 
   // Test
@@ -336,7 +441,7 @@ void testThatAnchorPositionIsNotReturnedWhenTooOld() {
   uint32_t now = 1234;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, now, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, now, &context);
 
   tdoaStorageSetAnchorPosition(&context, x, y, z);
 
@@ -359,7 +464,7 @@ void testThatRxTxDataIsSet() {
   uint8_t expectedSeqNr = 17;
 
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, expectedUpdateTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, expectedUpdateTime, &context);
 
   // Test
   tdoaStorageSetRxTxData(&context, expectedRxTime, expectedTxTime, expectedSeqNr);
@@ -375,7 +480,7 @@ void testThatRxTxDataIsSet() {
 void testThatClockCorrectionIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   double expected = 123.456;
   clockCorrectionStorage_t* clockCorrectionStorage = tdoaStorageGetClockCorrectionStorage(&context);
@@ -392,7 +497,7 @@ void testThatClockCorrectionIsReturned() {
 void testThatRemoteRxTimeIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t seqNr = 13;
   const uint8_t remoteAnchor = 17;
@@ -419,7 +524,7 @@ void testThatRemoteRxTimeIsNotReturnedWhenOutdated() {
   const uint8_t remoteAnchor = 17;
   fixtureSetRemoteRxTime(&context, anchor, storageTime, remoteAnchor, 4711, seqNr);
 
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, expiryTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, expiryTime, &context);
   const int64_t expectedRemoteRxTime = 0;
 
   // Test
@@ -433,7 +538,7 @@ void testThatRemoteRxTimeIsNotReturnedWhenOutdated() {
 void testThatRemoteRxTimeIsNotReturnedForUnknownRemoteAnchor() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
   const uint8_t unkownRemoteAnchor = 17;
   const int64_t expectedRemoteRxTime = 0;
 
@@ -448,7 +553,7 @@ void testThatRemoteRxTimeIsNotReturnedForUnknownRemoteAnchor() {
 void testThatRemoteRxTimeIsOverwrittenWhenSetWithTheSameRemoteId() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t seqNr = 13;
   const uint8_t remoteAnchor = 17;
@@ -510,7 +615,7 @@ void testThatRemoteRxTimeReplacesTheOldestEntryWhenStorageIsFull() {
 void testThatRemoteRxTimeAndSequenceNumberIsReturned() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t remoteAnchor = 17;
   const uint8_t expectedRemoteSeqNr = 13;
@@ -531,7 +636,7 @@ void testThatRemoteRxTimeAndSequenceNumberIsReturned() {
 void testThatRemoteRxTimeAndSequenceNumberIsNotReturnedWhenNotInList() {
   // Fixture
   tdoaAnchorContext_t context;
-  tdoaStorageGetCreateAnchorCtx(storage, 0, 0, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, 0, 0, &context);
 
   const uint8_t remoteAnchor = 17;
 
@@ -568,7 +673,7 @@ void testThatAListOfSequenceNumbersAndIdsOfRemoteAnchorsIsReturned() {
   fixtureSetRemoteRxTime(&context, anchor, activeStorageTime, activeRemoteAnchor1, someRemoteRxTime, activeSeqNr1);
 
   const uint32_t currentTime = oldStorageTime + REMOTE_DATA_VALIDITY_PERIOD;
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, currentTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, currentTime, &context);
 
   int actualRemoteCount;
   uint8_t actualSequenceNumbers[REMOTE_ANCHOR_DATA_COUNT];
@@ -580,11 +685,15 @@ void testThatAListOfSequenceNumbersAndIdsOfRemoteAnchorsIsReturned() {
   // Assert
   TEST_ASSERT_EQUAL_INT32(2, actualRemoteCount);
 
-  TEST_ASSERT_EQUAL_INT8(actualIds[0], activeRemoteAnchor0);
-  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[0], activeSeqNr0);
+  // The entries are stored by id, the order of the list is not defined
+  const int index0 = (actualIds[0] == activeRemoteAnchor0) ? 0 : 1;
+  const int index1 = 1 - index0;
+
+  TEST_ASSERT_EQUAL_INT8(actualIds[index0], activeRemoteAnchor0);
+  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[index0], activeSeqNr0);
 
-  TEST_ASSERT_EQUAL_INT8(actualIds[1], activeRemoteAnchor1);
-  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[1], activeSeqNr1);
+  TEST_ASSERT_EQUAL_INT8(actualIds[index1], activeRemoteAnchor1);
+  TEST_ASSERT_EQUAL_INT8(actualSequenceNumbers[index1], activeSeqNr1);
 }
 
 
@@ -596,7 +705,7 @@ void testThatNoTimeOfFlightIsReturnedWhenRemoteAnchorIsNotInStorage() {
   const uint8_t remoteAnchor = 17;
   const uint64_t expected = 0;
 
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, &context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, &context);
 
   // Test
   int64_t actual = tdoaStorageGetTimeOfFlight(&context, remoteAnchor);
@@ -686,11 +795,11 @@ void testThatTofReplacesTheOldestEntryWhenStorageIsFull() {
 // Helpers ///////////////
 
 static void fixtureSetRemoteRxTime(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t remoteRxTime, const uint8_t seqNr) {
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, context);
   tdoaStorageSetRemoteRxTime(context, remoteAnchor, remoteRxTime, seqNr);
 }
 
 static void fixtureSetTof(tdoaAnchorContext_t* context, const uint8_t anchor, const uint32_t storageTime, const uint8_t remoteAnchor, const uint64_t tof) {
-  tdoaStorageGetCreateAnchorCtx(storage, anchor, storageTime, context);
+  tdoaStorageGetCreateAnchorCtx(&storage, anchor, storageTime, context);
   tdoaStorageSetTimeOfFlight(context, remoteAnchor, tof);
 }
@@ -0,0 +1,102 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Unit tests for histogram
+ */
+
+
+// Module under test
+#include "histogram.h"
+
+#include "unity.h"
+
+static histogram_t histogram;
+
+void setUp(void) {
+  histogramInit(&histogram, 10);
+}
+
+void tearDown(void) {}
+
+void testThatEmptyHistogramHasZeroPercentiles() {
+  // Fixture
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, histogramCount(&histogram));
+  TEST_ASSERT_EQUAL_UINT32(0, histogramPercentile(&histogram, 50));
+}
+
+void testThatPercentilesOfUniformSamplesAreFound() {
+  // Fixture
+  for (uint32_t i = 0; i < 100; i++) {
+    histogramAdd(&histogram, i * 5);
+  }
+
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(100, histogramCount(&histogram));
+  TEST_ASSERT_EQUAL_UINT32(250, histogramPercentile(&histogram, 50));
+  TEST_ASSERT_EQUAL_UINT32(450, histogramPercentile(&histogram, 90));
+  TEST_ASSERT_EQUAL_UINT32(500, histogramPercentile(&histogram, 99));
+  TEST_ASSERT_EQUAL_UINT32(10, histogramPercentile(&histogram, 0));
+}
+
+void testThatOutliersAreCountedInTheLastBin() {
+  // Fixture
+  for (uint32_t i = 0; i < 98; i++) {
+    histogramAdd(&histogram, 15);
+  }
+  histogramAdd(&histogram, 100000);
+  histogramAdd(&histogram, 200000);
+
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(20, histogramPercentile(&histogram, 98));
+  TEST_ASSERT_EQUAL_UINT32(HISTOGRAM_BINS * 10, histogramPercentile(&histogram, 99));
+  TEST_ASSERT_EQUAL_UINT32(HISTOGRAM_BINS * 10, histogramPercentile(&histogram, 100));
+}
+
+void testThatResetRemovesAllSamples() {
+  // Fixture
+  histogramAdd(&histogram, 300);
+
+  // Test
+  histogramReset(&histogram);
+  histogramAdd(&histogram, 42);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(1, histogramCount(&histogram));
+  TEST_ASSERT_EQUAL_UINT32(50, histogramPercentile(&histogram, 99));
+}
+
+void testThatCountSaturates() {
+  // Fixture
+  // Test
+  for (uint32_t i = 0; i < UINT16_MAX + 10; i++) {
+    histogramAdd(&histogram, 0);
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(UINT16_MAX, histogramCount(&histogram));
+  TEST_ASSERT_EQUAL_UINT32(10, histogramPercentile(&histogram, 100));
+}
@@ -0,0 +1,232 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Unit tests for lightFrames
+ */
+
+// Module under test
+#include "lightFrames.h"
+
+#include "unity.h"
+#include <string.h>
+
+#define FRAME_COUNT 1000
+static uint8_t frames[FRAME_COUNT * 3];
+
+#define ENCODED_SIZE (FRAME_COUNT * 4 + 1024)
+static uint8_t encoded[ENCODED_SIZE];
+
+static lightFramesDecoder_t decoder;
+
+// Helpers
+
+static void generateShow(uint8_t bytesPerFrame);
+static void expectedColor(uint8_t bytesPerFrame, uint32_t frame, uint8_t* color);
+static void assertFrame(uint8_t bytesPerFrame, uint32_t frame);
+
+void setUp(void) {
+  memset(frames, 0, sizeof(frames));
+  memset(encoded, 0, sizeof(encoded));
+}
+
+void tearDown(void) {}
+
+void testThatRGBFramesRoundTripInOrder() {
+  // Fixture
+  generateShow(3);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+
+  // Test
+  bool initialized = lightFramesDecoderInit(&decoder, encoded, size);
+
+  // Assert
+  TEST_ASSERT_TRUE(initialized);
+  for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+    assertFrame(3, frame);
+  }
+}
+
+void testThatRGB565FramesRoundTripInOrder() {
+  // Fixture
+  generateShow(2);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 2, encoded, sizeof(encoded));
+
+  // Test
+  bool initialized = lightFramesDecoderInit(&decoder, encoded, size);
+
+  // Assert
+  TEST_ASSERT_TRUE(initialized);
+  for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+    assertFrame(2, frame);
+  }
+}
+
+void testThatFramesRoundTripWithSeeks() {
+  // Fixture
+  generateShow(3);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+  lightFramesDecoderInit(&decoder, encoded, size);
+
+  // Test
+  // Assert
+  uint32_t frame = 17;
+  for (int i = 0; i < 500; i++) {
+    assertFrame(3, frame);
+    frame = (frame * 7919 + 13) % FRAME_COUNT;
+  }
+}
+
+void testThatSmoothShowIsCompressed() {
+  // Fixture
+  generateShow(3);
+
+  // Test
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+
+  // Assert
+  TEST_ASSERT_NOT_EQUAL(0, size);
+  // Less than a third of the raw frames
+  TEST_ASSERT_LESS_THAN(FRAME_COUNT, size);
+}
+
+void testThatKeyframesAreIndexed() {
+  // Fixture
+  generateShow(3);
+
+  // Test
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+  lightFramesDecoderInit(&decoder, encoded, size);
+
+  // Assert
+  uint32_t opsSize = decoder.indexOffset - LIGHT_FRAMES_HEADER_SIZE;
+  TEST_ASSERT_GREATER_OR_EQUAL(opsSize / (LIGHT_FRAMES_KEYFRAME_SPACING + 4), (uint32_t)decoder.keyframeCount);
+  TEST_ASSERT_EQUAL_UINT32(size, decoder.indexOffset + decoder.keyframeCount * 8);
+}
+
+void testThatNextColorOfLastFrameIsTheSameColor() {
+  // Fixture
+  generateShow(3);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+  lightFramesDecoderInit(&decoder, encoded, size);
+  uint8_t color[3];
+  uint8_t nextColor[3];
+
+  // Test
+  bool decoded = lightFramesDecode(&decoder, FRAME_COUNT - 1, color, nextColor);
+  bool decodedAfterEnd = lightFramesDecode(&decoder, FRAME_COUNT, color, nextColor);
+
+  // Assert
+  TEST_ASSERT_TRUE(decoded);
+  TEST_ASSERT_FALSE(decodedAfterEnd);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(color, nextColor, 3);
+}
+
+void testThatEncodingFailsIfTheBufferIsTooSmall() {
+  // Fixture
+  generateShow(3);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+
+  // Test
+  uint32_t actual = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, size - 1);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, actual);
+}
+
+void testThatDecoderRejectsCorruptHeader() {
+  // Fixture
+  generateShow(3);
+  uint32_t size = lightFramesEncode(frames, FRAME_COUNT, 3, encoded, sizeof(encoded));
+
+  // Test
+  bool truncated = lightFramesDecoderInit(&decoder, encoded, size - 1);
+  encoded[0] = LIGHT_FRAMES_VERSION + 1;
+  bool wrongVersion = lightFramesDecoderInit(&decoder, encoded, size);
+
+  // Assert
+  TEST_ASSERT_FALSE(truncated);
+  TEST_ASSERT_FALSE(wrongVersion);
+}
+
+// Helpers
+
+static void setFrame(uint8_t bytesPerFrame, uint32_t frame, uint8_t red, uint8_t green, uint8_t blue) {
+  if (bytesPerFrame == 3) {
+    frames[frame * 3] = red;
+    frames[frame * 3 + 1] = green;
+    frames[frame * 3 + 2] = blue;
+  } else {
+    uint16_t value = ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
+    frames[frame * 2] = value >> 8;
+    frames[frame * 2 + 1] = value & 0xff;
+  }
+}
+
+// Holds, linear fades, a flickering section and fades that are not linear
+static void generateShow(uint8_t bytesPerFrame) {
+  uint32_t seed = 1;
+
+  for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+    if (frame < 200) {
+      setFrame(bytesPerFrame, frame, 255, 0, 0);
+    } else if (frame < 400) {
+      setFrame(bytesPerFrame, frame, 255 - (frame - 200), (frame - 200), 10);
+    } else if (frame < 450) {
+      seed = seed * 1103515245 + 12345;
+      setFrame(bytesPerFrame, frame, seed >> 24, seed >> 16, seed >> 8);
+    } else if (frame < 700) {
+      uint32_t x = frame - 450;
+      setFrame(bytesPerFrame, frame, 0, x * x / 256, 255 - x);
+    } else {
+      setFrame(bytesPerFrame, frame, 255, 255, 255);
+    }
+  }
+}
+
+static void expectedColor(uint8_t bytesPerFrame, uint32_t frame, uint8_t* color) {
+  if (bytesPerFrame == 3) {
+    memcpy(color, &frames[frame * 3], 3);
+  } else {
+    const uint8_t* ptr = &frames[frame * 2];
+    uint8_t x = ptr[0] & 0xf8;
+    color[0] = x | (x >> 5);
+    x = ((ptr[0] & 0x07) << 3) | ((ptr[1] & 0xe0) >> 5);
+    color[1] = (x << 2) | (x >> 4);
+    x = ptr[1] & 0x1f;
+    color[2] = (x << 3) | (x >> 2);
+  }
+}
+
+static void assertFrame(uint8_t bytesPerFrame, uint32_t frame) {
+  uint8_t expected[3];
+  uint8_t expectedNext[3];
+  uint8_t actual[3];
+  uint8_t actualNext[3];
+
+  expectedColor(bytesPerFrame, frame, expected);
+  expectedColor(bytesPerFrame, frame + 1 < FRAME_COUNT ? frame + 1 : frame, expectedNext);
+
+  TEST_ASSERT_TRUE(lightFramesDecode(&decoder, frame, actual, actualNext));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, 3);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expectedNext, actualNext, 3);
+}
@@ -0,0 +1,194 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2026 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Unit tests for windowStats
+ */
+
+// Module under test
+#include "windowStats.h"
+
+#include "unity.h"
+
+#define SAMPLE_COUNT 500
+static float samples[SAMPLE_COUNT];
+
+static windowStats_t stats;
+
+// Helpers
+
+static void generateSamples();
+static void assertStatsOfWindow(uint32_t end, uint8_t length);
+
+void setUp(void) {
+  generateSamples();
+}
+
+void tearDown(void) {}
+
+void testThatEmptyWindowHasZeroStatistics() {
+  // Fixture
+  windowStatsInit(&stats, 10);
+
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(0, windowStatsCount(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, windowStatsMin(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, windowStatsMax(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, windowStatsMean(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, windowStatsVariance(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, windowStatsSlope(&stats));
+}
+
+void testThatStatisticsMatchTheWindowWhileFilling() {
+  // Fixture
+  windowStatsInit(&stats, 10);
+
+  // Test
+  // Assert
+  for (uint32_t i = 0; i < 10; i++) {
+    windowStatsAdd(&stats, samples[i]);
+    assertStatsOfWindow(i + 1, 10);
+  }
+}
+
+void testThatStatisticsMatchTheWindowWhenSliding() {
+  // Fixture
+  windowStatsInit(&stats, 10);
+
+  // Test
+  // Assert
+  for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+    windowStatsAdd(&stats, samples[i]);
+    assertStatsOfWindow(i + 1, 10);
+  }
+}
+
+void testThatStatisticsMatchTheLongestWindow() {
+  // Fixture
+  windowStatsInit(&stats, WINDOW_STATS_MAX_LENGTH);
+
+  // Test
+  // Assert
+  for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+    windowStatsAdd(&stats, samples[i]);
+    assertStatsOfWindow(i + 1, WINDOW_STATS_MAX_LENGTH);
+  }
+}
+
+void testThatSlopeOfALineIsFound() {
+  // Fixture
+  windowStatsInit(&stats, 20);
+
+  // Test
+  for (int i = 0; i < 50; i++) {
+    windowStatsAdd(&stats, 3.0f - 0.25f * i);
+  }
+
+  // Assert
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -0.25f, windowStatsSlope(&stats));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 3.0f - 0.25f * 49, windowStatsMin(&stats));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 3.0f - 0.25f * 30, windowStatsMax(&stats));
+}
+
+void testThatResetRemovesAllSamples() {
+  // Fixture
+  windowStatsInit(&stats, 10);
+  for (int i = 0; i < 15; i++) {
+    windowStatsAdd(&stats, samples[i]);
+  }
+
+  // Test
+  windowStatsReset(&stats);
+  windowStatsAdd(&stats, 7.0f);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(1, windowStatsCount(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, windowStatsMin(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, windowStatsMax(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, windowStatsMean(&stats));
+}
+
+void testThatLengthIsLimited() {
+  // Fixture
+  // Test
+  windowStatsInit(&stats, 255);
+  for (int i = 0; i < 100; i++) {
+    windowStatsAdd(&stats, samples[i]);
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(WINDOW_STATS_MAX_LENGTH, windowStatsCount(&stats));
+}
+
+// Helpers
+
+// Noise with steps, plateaus and trends
+static void generateSamples() {
+  uint32_t seed = 1;
+
+  for (int i = 0; i < SAMPLE_COUNT; i++) {
+    seed = seed * 1103515245 + 12345;
+    float noise = ((seed >> 16) & 0x7fff) / 32768.0f - 0.5f;
+    if (i % 100 < 20) {
+      samples[i] = 5.0f;
+    } else if (i % 100 < 60) {
+      samples[i] = 0.1f * (i % 100) + noise;
+    } else {
+      samples[i] = 20.0f + 10.0f * noise;
+    }
+  }
+}
+
+static void assertStatsOfWindow(uint32_t end, uint8_t length) {
+  uint32_t start = end > length ? end - length : 0;
+  float n = end - start;
+  float min = samples[start];
+  float max = samples[start];
+  float sum = 0.0f;
+
+  for (uint32_t i = start; i < end; i++) {
+    min = samples[i] < min ? samples[i] : min;
+    max = samples[i] > max ? samples[i] : max;
+    sum += samples[i];
+  }
+
+  float mean = sum / n;
+  float squares = 0.0f;
+  float weighted = 0.0f;
+  float meanOrder = (n - 1.0f) / 2.0f;
+  float orderSquares = 0.0f;
+  for (uint32_t i = start; i < end; i++) {
+    squares += (samples[i] - mean) * (samples[i] - mean);
+    weighted += (i - start - meanOrder) * (samples[i] - mean);
+    orderSquares += (i - start - meanOrder) * (i - start - meanOrder);
+  }
+
+  TEST_ASSERT_EQUAL_UINT8(n, windowStatsCount(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(min, windowStatsMin(&stats));
+  TEST_ASSERT_EQUAL_FLOAT(max, windowStatsMax(&stats));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, mean, windowStatsMean(&stats));
+  if (n > 1) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, squares / (n - 1.0f), windowStatsVariance(&stats));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, weighted / orderSquares, windowStatsSlope(&stats));
+  }
+}
@@ -14,6 +14,60 @@ def _get_name(data, idx):
         endIdx = endIdx + 1
     return data[idx:endIdx].decode("utf-8"), endIdx + 1
 
+# decode an unsigned LEB128 varint
+def _get_varint(data, idx):
+    result = 0
+    shift = 0
+    while True:
+        b = data[idx]
+        idx += 1
+        result |= (b & 0x7F) << shift
+        shift += 7
+        if b & 0x80 == 0:
+            return result, idx
+
+def _zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+# convert the 32 bit integer used by the delta encoder back to a value
+def _from_delta_int(value, var_type, scale):
+    value &= 0xFFFFFFFF
+    if var_type == 'f':
+        if scale == 0:
+            return struct.unpack('<f', struct.pack('<I', value))[0]
+        value = value - (1 << 32) if value & 0x80000000 else value
+        return value / scale
+    if var_type in 'bhi' and value & 0x80000000:
+        return value - (1 << 32)
+    return value
+
+# decode a delta-encoded record (file version 3), see usddeck.c
+def _decode_delta_record(data, idx, event, result):
+    flags = data[idx]
+    idx += 1
+    keyframe = flags & 0x01
+    if keyframe:
+        timestamp, = struct.unpack('<Q', data[idx:idx+8])
+        idx += 8
+        event['lastValues'] = [0] * len(event['variables'])
+    else:
+        delta, idx = _get_varint(data, idx)
+        timestamp = event['lastTimestamp'] + delta
+    event['lastTimestamp'] = timestamp
+
+    var_types = event['fmtStr'][1:]
+    for i, (v, var_type, scale) in enumerate(zip(event['variables'], var_types, event['scales'])):
+        if var_type == 'f' and scale == 0:
+            value, = struct.unpack('<I', data[idx:idx+4])
+            idx += 4
+        else:
+            delta, idx = _get_varint(data, idx)
+            value = (event['lastValues'][i] + _zigzag_decode(delta)) & 0xFFFFFFFF
+        event['lastValues'][i] = value
+        result[event['name']][v].append(_from_delta_int(value, var_type, scale))
+    result[event['name']]["timestamp"].append(timestamp / 1000.0)
+    return idx
+
 def decode(filename):
     # read file as binary
     with open(filename, 'rb') as f:
@@ -32,7 +86,7 @@ def decode(filename):
 
     # check version
     version, num_event_types = struct.unpack('HH', data[1:5])
-    if version != 1 and version != 2:
+    if version not in (1, 2, 3):
         print("Unsupported version!", version)
         return
 
@@ -49,8 +103,13 @@ def decode(filename):
         result[event_name]["timestamp"] = []
         num_variables, = struct.unpack('H', data[idx:idx+2])
         idx += 2
+        encoding = 0
+        if version == 3:
+            encoding = data[idx]
+            idx += 1
         fmtStr = "<"
         variables = []
+        scales = []
         for _ in range(num_variables):
             var_name_and_type, idx = _get_name(data, idx)
             var_name = var_name_and_type[0:-3]
@@ -58,18 +117,33 @@ def decode(filename):
             result[event_name][var_name] = []
             fmtStr += var_type
             variables.append(var_name)
+            if encoding == 1:
+                scale, = struct.unpack('<f', data[idx:idx+4])
+                idx += 4
+                scales.append(scale)
         event_by_id[event_id] = {
             'name': event_name,
             'fmtStr': fmtStr,
             'numBytes': struct.calcsize(fmtStr),
             'variables': variables,
+            'encoding': encoding,
+            'scales': scales,
+            'lastTimestamp': 0,
+            'lastValues': [0] * num_variables,
             }
 
     while idx < len(data) - 4:
+        if version == 3:
+            event_id, = struct.unpack('<H', data[idx:idx+2])
+            event = event_by_id[event_id]
+            if event['encoding'] == 1:
+                idx = _decode_delta_record(data, idx + 2, event, result)
+                continue
+
         if version == 1:
             event_id, timestamp, = struct.unpack('<HI', data[idx:idx+6])
             idx += 6
-        elif version == 2:
+        elif version == 2 or version == 3:
             event_id, timestamp, = struct.unpack('<HQ', data[idx:idx+10])
             timestamp = timestamp / 1000.0
             idx += 10